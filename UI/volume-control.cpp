@@ -27,16 +27,6 @@ void VolControl::OBSVolumeChanged(void *data, float db)
 	QMetaObject::invokeMethod(volControl, "VolumeChanged");
 }
 
-void VolControl::OBSVolumeLevel(void *data,
-				const float magnitude[MAX_AUDIO_CHANNELS],
-				const float peak[MAX_AUDIO_CHANNELS],
-				const float inputPeak[MAX_AUDIO_CHANNELS])
-{
-	VolControl *volControl = static_cast<VolControl *>(data);
-
-	volControl->volMeter->setLevels(magnitude, peak, inputPeak);
-}
-
 void VolControl::OBSVolumeMuted(void *data, calldata_t *calldata)
 {
 	VolControl *volControl = static_cast<VolControl *>(data);
@@ -282,7 +272,6 @@ VolControl::VolControl(OBSSource source_, bool showConfig, bool vertical)
 	mute->setChecked(muted);
 	mute->setAccessibleName(QTStr("VolControl.Mute").arg(sourceName));
 	obs_fader_add_callback(obs_fader, OBSVolumeChanged, this);
-	obs_volmeter_add_callback(obs_volmeter, OBSVolumeLevel, this);
 
 	signal_handler_connect(obs_source_get_signal_handler(source), "mute",
 			       OBSVolumeMuted, this);
@@ -319,7 +308,6 @@ void VolControl::EnableSlider(bool enable)
 VolControl::~VolControl()
 {
 	obs_fader_remove_callback(obs_fader, OBSVolumeChanged, this);
-	obs_volmeter_remove_callback(obs_volmeter, OBSVolumeLevel, this);
 
 	signal_handler_disconnect(obs_source_get_signal_handler(source), "mute",
 				  OBSVolumeMuted, this);
@@ -635,6 +623,19 @@ void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS],
 	calculateBallistics(ts);
 }
 
+void VolumeMeter::pollLevels()
+{
+	struct obs_volmeter_levels levels;
+
+	if (!obs_volmeter || !obs_volmeter_get_levels(obs_volmeter, &levels))
+		return;
+	if (levels.timestamp == lastLevelsTimestamp)
+		return;
+
+	lastLevelsTimestamp = levels.timestamp;
+	setLevels(levels.magnitude, levels.peak, levels.input_peak);
+}
+
 inline void VolumeMeter::resetLevels()
 {
 	currentLastUpdateTime = 0;
@@ -1143,6 +1144,12 @@ void VolumeMeterTimer::RemoveVolControl(VolumeMeter *meter)
 
 void VolumeMeterTimer::timerEvent(QTimerEvent *)
 {
-	for (VolumeMeter *meter : volumeMeters)
+	for (VolumeMeter *meter : volumeMeters) {
+		/* meters that are not polled stop being measured */
+		if (!meter->isVisible())
+			continue;
+
+		meter->pollLevels();
 		meter->update();
+	}
 }
@@ -8,6 +8,23 @@
 
 using namespace std;
 
+#define FRAGMENTED_PREFIX "fragmented_"
+
+/* "fragmented_mp4" and "fragmented_mov" record to mp4/mov files that are
+ * written in fragments, so they stay playable if recording is interrupted */
+static inline bool IsFragmentedFormat(const char *format)
+{
+	return strncmp(format, FRAGMENTED_PREFIX,
+		       sizeof(FRAGMENTED_PREFIX) - 1) == 0;
+}
+
+static inline const char *GetFormatExt(const char *format)
+{
+	return IsFragmentedFormat(format)
+		       ? format + sizeof(FRAGMENTED_PREFIX) - 1
+		       : format;
+}
+
 extern bool EncoderAvailable(const char *encoder);
 
 volatile bool streaming_active = false;
@@ -18,6 +35,7 @@ volatile bool virtualcam_active = false;
 
 #define FTL_PROTOCOL "ftl"
 #define RTMP_PROTOCOL "rtmp"
+#define UDP_ARQ_PROTOCOL "udparq"
 
 static void OBSStreamStarting(void *data, calldata_t *params)
 {
@@ -766,6 +784,10 @@ bool SimpleOutput::SetupStreaming(obs_service_t *service)
 		if (url != NULL &&
 		    strncmp(url, FTL_PROTOCOL, strlen(FTL_PROTOCOL)) == 0) {
 			type = "ftl_output";
+		} else if (url != NULL &&
+			   strncmp(url, UDP_ARQ_PROTOCOL,
+				   strlen(UDP_ARQ_PROTOCOL)) == 0) {
+			type = "udp_arq_output";
 		} else if (url != NULL && strncmp(url, RTMP_PROTOCOL,
 						  strlen(RTMP_PROTOCOL)) != 0) {
 			type = "ffmpeg_mpegts_muxer";
@@ -1007,12 +1029,15 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 	obs_data_t *settings = obs_data_create();
 	if (updateReplayBuffer) {
 		f = GetFormatString(filenameFormat, rbPrefix, rbSuffix);
-		strPath = GetOutputFilename(path, ffmpegOutput ? "avi" : format,
+		strPath = GetOutputFilename(path,
+					    ffmpegOutput ? "avi"
+							 : GetFormatExt(format),
 					    noSpace, overwriteIfExists,
 					    f.c_str());
 		obs_data_set_string(settings, "directory", path);
 		obs_data_set_string(settings, "format", f.c_str());
-		obs_data_set_string(settings, "extension", format);
+		obs_data_set_string(settings, "extension",
+				    GetFormatExt(format));
 		obs_data_set_bool(settings, "allow_spaces", !noSpace);
 		obs_data_set_int(settings, "max_time_sec", rbTime);
 		obs_data_set_int(settings, "max_size_mb",
@@ -1025,6 +1050,8 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 					       f.c_str(), ffmpegOutput);
 		obs_data_set_string(settings, ffmpegOutput ? "url" : "path",
 				    strPath.c_str());
+		if (!ffmpegOutput)
+			SetFragmentSettings(settings, format);
 	}
 
 	obs_data_set_string(settings, "muxer_settings", mux);
@@ -1690,6 +1717,10 @@ bool AdvancedOutput::SetupStreaming(obs_service_t *service)
 		if (url != NULL &&
 		    strncmp(url, FTL_PROTOCOL, strlen(FTL_PROTOCOL)) == 0) {
 			type = "ftl_output";
+		} else if (url != NULL &&
+			   strncmp(url, UDP_ARQ_PROTOCOL,
+				   strlen(UDP_ARQ_PROTOCOL)) == 0) {
+			type = "udp_arq_output";
 		} else if (url != NULL && strncmp(url, RTMP_PROTOCOL,
 						  strlen(RTMP_PROTOCOL)) != 0) {
 			type = "ffmpeg_mpegts_muxer";
@@ -1874,6 +1905,8 @@ bool AdvancedOutput::StartRecording()
 		obs_data_t *settings = obs_data_create();
 		obs_data_set_string(settings, ffmpegRecording ? "url" : "path",
 				    strPath.c_str());
+		if (!ffmpegRecording)
+			SetFragmentSettings(settings, recFormat);
 
 		obs_output_update(fileOutput, settings);
 
@@ -1942,6 +1975,9 @@ bool AdvancedOutput::StartReplayBuffer()
 		rbTime = config_get_int(main->Config(), "AdvOut", "RecRBTime");
 		rbSize = config_get_int(main->Config(), "AdvOut", "RecRBSize");
 
+		if (!ffmpegRecording)
+			recFormat = GetFormatExt(recFormat);
+
 		string f = GetFormatString(filenameFormat, rbPrefix, rbSuffix);
 		string strPath = GetOutputFilename(
 			path, recFormat, noSpace, overwriteIfExists, f.c_str());
@@ -2025,12 +2061,27 @@ void BasicOutputHandler::SetupAutoRemux(const char *&ext)
 		ext = "mkv";
 }
 
+void BasicOutputHandler::SetFragmentSettings(obs_data_t *settings,
+					     const char *format)
+{
+	int fragDuration = (int)config_get_uint(main->Config(), "Output",
+						"FragmentDurationMs");
+
+	obs_data_set_bool(settings, "fragmented", IsFragmentedFormat(format));
+	obs_data_set_int(settings, "frag_duration_ms", fragDuration);
+}
+
 std::string
 BasicOutputHandler::GetRecordingFilename(const char *path, const char *ext,
 					 bool noSpace, bool overwrite,
 					 const char *format, bool ffmpeg)
 {
-	if (!ffmpeg)
+	lastRecordingFragmented = !ffmpeg && IsFragmentedFormat(ext);
+
+	/* fragmented files don't need to be remuxed to be safe */
+	if (lastRecordingFragmented)
+		ext = GetFormatExt(ext);
+	else if (!ffmpeg)
 		SetupAutoRemux(ext);
 
 	string dst = GetOutputFilename(path, ext, noSpace, overwrite, format);
@@ -20,6 +20,7 @@ struct BasicOutputHandler {
 	std::string lastError;
 
 	std::string lastRecordingPath;
+	bool lastRecordingFragmented = false;
 
 	OBSSignal startRecording;
 	OBSSignal stopRecording;
@@ -64,6 +65,7 @@ struct BasicOutputHandler {
 
 protected:
 	void SetupAutoRemux(const char *&ext);
+	void SetFragmentSettings(obs_data_t *settings, const char *format);
 	std::string GetRecordingFilename(const char *path, const char *ext,
 					 bool noSpace, bool overwrite,
 					 const char *format, bool ffmpeg);
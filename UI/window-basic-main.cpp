@@ -1440,6 +1440,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_uint(basicConfig, "Output", "MaxRetries", 20);
 
 	config_set_default_string(basicConfig, "Output", "BindIP", "default");
+	config_set_default_uint(basicConfig, "Output", "FragmentDurationMs",
+				2000);
 	config_set_default_bool(basicConfig, "Output", "NewSocketLoopEnable",
 				false);
 	config_set_default_bool(basicConfig, "Output", "LowLatencyEnable",
@@ -6302,6 +6304,10 @@ void OBSBasic::AutoRemux()
 	if (ffmpegOutput)
 		return;
 
+	/* fragmented mp4/mov recordings are already safe to use */
+	if (outputHandler->lastRecordingFragmented)
+		return;
+
 	QString input = outputHandler->lastRecordingPath.c_str();
 	if (input.isEmpty())
 		return;
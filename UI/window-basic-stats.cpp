@@ -92,6 +92,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 
 	fps = new QLabel(this);
 	renderTime = new QLabel(this);
+	renderPhases = new QLabel(this);
 	skippedFrames = new QLabel(this);
 	missedFrames = new QLabel(this);
 
@@ -103,6 +104,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 
 	newStatBare("FPS", fps, 2);
 	newStat("AverageTimeToRender", renderTime, 2);
+	newStat("RenderPhases", renderPhases, 2);
 	newStat("MissedFrames", missedFrames, 2);
 	newStat("SkippedFrames", skippedFrames, 2);
 
@@ -131,6 +133,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	addOutputCol("Basic.Stats.DroppedFrames");
 	addOutputCol("Basic.Stats.MegabytesSent");
 	addOutputCol("Basic.Stats.Bitrate");
+	addOutputCol("Basic.Stats.Encoder");
 
 	/* --------------------------------------------- */
 
@@ -246,6 +249,7 @@ void OBSBasicStats::AddOutputLabels(QString name)
 	ol.droppedFrames = new QLabel(this);
 	ol.megabytesSent = new QLabel(this);
 	ol.bitrate = new QLabel(this);
+	ol.encoder = new QLabel(this);
 
 	int newPointSize = ol.status->font().pointSize();
 	newPointSize *= 13;
@@ -261,6 +265,7 @@ void OBSBasicStats::AddOutputLabels(QString name)
 	outputLayout->addWidget(ol.droppedFrames, row, col++);
 	outputLayout->addWidget(ol.megabytesSent, row, col++);
 	outputLayout->addWidget(ol.bitrate, row, col++);
+	outputLayout->addWidget(ol.encoder, row, col++);
 	outputLabels.push_back(ol);
 }
 
@@ -373,6 +378,25 @@ void OBSBasicStats::Update()
 
 	/* ------------------ */
 
+	struct obs_video_phase_times phases;
+	if (obs_get_video_phase_times(&phases)) {
+		auto ms = [](uint64_t ns) {
+			return QString::number((double)ns / 1000000.0, 'f', 1);
+		};
+
+		str = ms(phases.tick_ns) + QStringLiteral(" / ") +
+		      ms(phases.render_ns) + QStringLiteral(" / ") +
+		      ms(phases.convert_ns) + QStringLiteral(" / ") +
+		      ms(phases.download_ns) + QStringLiteral(" / ") +
+		      ms(phases.output_ns) + QStringLiteral(" ms");
+		renderPhases->setText(str);
+		renderPhases->setToolTip(
+			QTStr("Basic.Stats.RenderPhases.ToolTip")
+				.arg(ms(phases.render_ahead_ns)));
+	}
+
+	/* ------------------ */
+
 	video_t *video = obs_get_video();
 	uint32_t total_encoded = video_output_get_total_frames(video);
 	uint32_t total_skipped = video_output_get_skipped_frames(video);
@@ -547,6 +571,39 @@ void OBSBasicStats::OutputLabels::Update(obs_output_t *output, bool rec)
 		QString("%1 MB").arg(QString::number(num, 'f', 1)));
 	bitrate->setText(QString("%1 kb/s").arg(QString::number(kbps, 'f', 0)));
 
+	obs_encoder_t *venc = output ? obs_output_get_video_encoder(output)
+				     : nullptr;
+	struct obs_encoder_stats stats;
+
+	if (active && venc && obs_encoder_get_stats(venc, &stats)) {
+		static const char types[OBS_ENCODER_FRAME_TYPES] = {'?', 'I',
+								    'P', 'B'};
+		QString qp = stats.avg_qp < 0.0
+				     ? QStringLiteral("-")
+				     : QString::number(stats.avg_qp, 'f', 1);
+
+		encoder->setText(QTStr("Basic.Stats.Encoder.Value")
+					 .arg(qp, QString::number(
+							  stats.avg_encode_ms,
+							  'f', 1)));
+		uint64_t *counts = stats.frame_types;
+		QString i = QString::number(counts[OBS_ENCODER_FRAME_I]);
+		QString p = QString::number(counts[OBS_ENCODER_FRAME_P]);
+		QString b = QString::number(counts[OBS_ENCODER_FRAME_B]);
+		QString type(QChar(types[stats.last_type]));
+
+		encoder->setToolTip(
+			QTStr("Basic.Stats.Encoder.ToolTip")
+				.arg(i, p, b, type,
+				     QString::number(stats.last_qp),
+				     QString::number(stats.last_size),
+				     QString::number(stats.last_encode_ms, 'f',
+						     1)));
+	} else {
+		encoder->setText(QStringLiteral("-"));
+		encoder->setToolTip(QString());
+	}
+
 	if (!rec) {
 		int total = output ? obs_output_get_total_frames(output) : 0;
 		int dropped = output ? obs_output_get_frames_dropped(output)
@@ -22,6 +22,7 @@ class OBSBasicStats : public QWidget {
 	QLabel *memUsage = nullptr;
 
 	QLabel *renderTime = nullptr;
+	QLabel *renderPhases = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
 
@@ -40,6 +41,7 @@ class OBSBasicStats : public QWidget {
 		QPointer<QLabel> droppedFrames;
 		QPointer<QLabel> megabytesSent;
 		QPointer<QLabel> bitrate;
+		QPointer<QLabel> encoder;
 
 		uint64_t lastBytesSent = 0;
 		uint64_t lastBytesSentTime = 0;
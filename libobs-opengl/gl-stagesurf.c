@@ -71,6 +71,8 @@ void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 	if (stagesurf) {
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
+		if (stagesurf->fence)
+			glDeleteSync(stagesurf->fence);
 
 		bfree(stagesurf);
 	}
@@ -107,6 +109,18 @@ static bool can_stage(struct gs_stage_surface *dst, struct gs_texture_2d *src)
 	return true;
 }
 
+/* marks the point in the command stream after which the pack buffer holds
+ * the staged texture */
+static inline void set_stage_fence(struct gs_stage_surface *dst)
+{
+	if (dst->fence)
+		glDeleteSync(dst->fence);
+
+	dst->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		dst->fence = NULL;
+}
+
 #ifdef __APPLE__
 
 /* Apparently for mac, PBOs won't do an asynchronous transfer unless you use
@@ -142,6 +156,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	set_stage_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -175,6 +190,8 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	set_stage_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -225,6 +242,24 @@ fail:
 	return false;
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	GLenum status;
+
+	if (!stagesurf->fence)
+		return true;
+
+	status = glClientWaitSync(stagesurf->fence, 0, 0);
+	if (status == GL_ALREADY_SIGNALED ||
+	    status == GL_CONDITION_SATISFIED) {
+		glDeleteSync(stagesurf->fence);
+		stagesurf->fence = NULL;
+		return true;
+	}
+
+	return status == GL_WAIT_FAILED;
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
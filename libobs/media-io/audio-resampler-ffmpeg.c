@@ -16,13 +16,13 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
-#include "audio-resampler.h"
+#include "audio-resampler-internal.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
-struct audio_resampler {
+struct ffmpeg_resampler {
 	struct SwrContext *context;
 	bool opened;
 
@@ -91,10 +91,20 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
-audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
-					  const struct resample_info *src)
+static void ffmpeg_resampler_destroy(void *data);
+
+static bool ffmpeg_resampler_supports(const struct resample_info *dst,
+				      const struct resample_info *src)
+{
+	UNUSED_PARAMETER(dst);
+	UNUSED_PARAMETER(src);
+	return true;
+}
+
+static void *ffmpeg_resampler_create(const struct resample_info *dst,
+				     const struct resample_info *src)
 {
-	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
+	struct ffmpeg_resampler *rs = bzalloc(sizeof(struct ffmpeg_resampler));
 	int errcode;
 
 	rs->opened = false;
@@ -116,7 +126,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 
 	if (!rs->context) {
 		blog(LOG_ERROR, "swr_alloc_set_opts failed");
-		audio_resampler_destroy(rs);
+		ffmpeg_resampler_destroy(rs);
 		return NULL;
 	}
 
@@ -141,15 +151,17 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	if (errcode != 0) {
 		blog(LOG_ERROR, "avresample_open failed: error code %d",
 		     errcode);
-		audio_resampler_destroy(rs);
+		ffmpeg_resampler_destroy(rs);
 		return NULL;
 	}
 
 	return rs;
 }
 
-void audio_resampler_destroy(audio_resampler_t *rs)
+static void ffmpeg_resampler_destroy(void *data)
 {
+	struct ffmpeg_resampler *rs = data;
+
 	if (rs) {
 		if (rs->context)
 			swr_free(&rs->context);
@@ -160,13 +172,12 @@ void audio_resampler_destroy(audio_resampler_t *rs)
 	}
 }
 
-bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
-			      uint32_t *out_frames, uint64_t *ts_offset,
-			      const uint8_t *const input[], uint32_t in_frames)
+static bool ffmpeg_resampler_resample(void *data, uint8_t *output[],
+				      uint32_t *out_frames, uint64_t *ts_offset,
+				      const uint8_t *const input[],
+				      uint32_t in_frames)
 {
-	if (!rs)
-		return false;
-
+	struct ffmpeg_resampler *rs = data;
 	struct SwrContext *context = rs->context;
 	int ret;
 
@@ -203,3 +214,12 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	*out_frames = (uint32_t)ret;
 	return true;
 }
+
+const struct audio_resampler_backend ffmpeg_resampler_backend = {
+	.name = "swresample",
+	.type = AUDIO_RESAMPLER_FFMPEG,
+	.supports = ffmpeg_resampler_supports,
+	.create = ffmpeg_resampler_create,
+	.destroy = ffmpeg_resampler_destroy,
+	.resample = ffmpeg_resampler_resample,
+};
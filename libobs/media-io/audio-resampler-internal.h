@@ -0,0 +1,49 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "audio-resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* resampler implementation, selected in audio_resampler_create_type */
+struct audio_resampler_backend {
+	const char *name;
+	enum audio_resampler_type type;
+
+	/* returns false if the backend cannot handle the conversion */
+	bool (*supports)(const struct resample_info *dst,
+			 const struct resample_info *src);
+
+	void *(*create)(const struct resample_info *dst,
+			const struct resample_info *src);
+	void (*destroy)(void *data);
+
+	bool (*resample)(void *data, uint8_t *output[], uint32_t *out_frames,
+			 uint64_t *ts_offset, const uint8_t *const input[],
+			 uint32_t in_frames);
+};
+
+extern const struct audio_resampler_backend ffmpeg_resampler_backend;
+extern const struct audio_resampler_backend polyphase_resampler_backend;
+
+#ifdef __cplusplus
+}
+#endif
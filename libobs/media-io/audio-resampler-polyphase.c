@@ -0,0 +1,364 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "../util/base.h"
+#include "../util/sse-intrin.h"
+#include "../graphics/math-defs.h"
+#include "audio-resampler-internal.h"
+
+/*
+ * Polyphase windowed-sinc resampler for float planar output.
+ *
+ * The conversion ratio is reduced to up/down, and one Kaiser-windowed sinc
+ * kernel is precomputed for each of the `up` output phases, so each output
+ * sample is a single SSE dot product against the input history.  This covers
+ * the common 44.1/48/96 kHz conversions at a fraction of the cost of
+ * swresample, which has to interpolate between its filter phases.
+ */
+
+#define BASE_TAPS 32
+#define MAX_PHASES 1024
+#define KAISER_BETA 9.0
+#define CUTOFF 0.97
+
+struct polyphase_resampler {
+	enum audio_format input_format;
+	uint32_t input_freq;
+	uint32_t channels;
+
+	uint32_t up;
+	uint32_t down;
+	uint32_t taps;
+	float *coeffs;
+
+	/* input history, converted to float planar */
+	float *history[MAX_AUDIO_CHANNELS];
+	size_t history_size;
+	size_t history_capacity;
+
+	/* read position in 1/up input samples, relative to history[0] */
+	uint64_t position;
+
+	float *output_buffer[MAX_AUDIO_CHANNELS];
+	size_t output_capacity;
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static bool polyphase_resampler_supports(const struct resample_info *dst,
+					 const struct resample_info *src)
+{
+	uint32_t div;
+
+	if (!dst->samples_per_sec || !src->samples_per_sec)
+		return false;
+	if (dst->samples_per_sec == src->samples_per_sec)
+		return false;
+	if (dst->format != AUDIO_FORMAT_FLOAT_PLANAR)
+		return false;
+	if (src->format == AUDIO_FORMAT_UNKNOWN)
+		return false;
+	if (dst->speakers != src->speakers ||
+	    get_audio_channels(src->speakers) == 0)
+		return false;
+
+	div = gcd(dst->samples_per_sec, src->samples_per_sec);
+	return dst->samples_per_sec / div <= MAX_PHASES;
+}
+
+/* zeroth order modified bessel function of the first kind */
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	double half_x = x * 0.5;
+
+	for (int k = 1; k < 32; k++) {
+		term *= half_x / (double)k;
+		sum += term * term;
+		if (term * term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static void build_coeffs(struct polyphase_resampler *rs)
+{
+	const double cutoff = CUTOFF * (rs->up < rs->down ? (double)rs->up /
+								    (double)rs->down
+							  : 1.0);
+	const double half = (double)rs->taps * 0.5;
+	const double i0_beta = bessel_i0(KAISER_BETA);
+
+	for (uint32_t phase = 0; phase < rs->up; phase++) {
+		float *row = rs->coeffs + phase * rs->taps;
+		double sum = 0.0;
+
+		for (uint32_t k = 0; k < rs->taps; k++) {
+			/* distance between this tap and the output position */
+			double d = half - 1.0 + (double)phase / (double)rs->up -
+				   (double)k;
+			double x = d * cutoff;
+			double sinc = fabs(x) < 1e-9 ? 1.0
+						     : sin(M_PI * x) / (M_PI * x);
+			double w = d / half;
+			double window = 0.0;
+
+			if (w > -1.0 && w < 1.0)
+				window = bessel_i0(KAISER_BETA *
+						   sqrt(1.0 - w * w)) /
+					 i0_beta;
+
+			row[k] = (float)(sinc * window);
+			sum += row[k];
+		}
+
+		/* unity gain at DC for every phase */
+		for (uint32_t k = 0; k < rs->taps; k++)
+			row[k] = (float)(row[k] / sum);
+	}
+}
+
+static void polyphase_resampler_destroy(void *data)
+{
+	struct polyphase_resampler *rs = data;
+
+	if (rs) {
+		for (uint32_t i = 0; i < rs->channels; i++) {
+			bfree(rs->history[i]);
+			bfree(rs->output_buffer[i]);
+		}
+		bfree(rs->coeffs);
+		bfree(rs);
+	}
+}
+
+static void *polyphase_resampler_create(const struct resample_info *dst,
+					const struct resample_info *src)
+{
+	struct polyphase_resampler *rs =
+		bzalloc(sizeof(struct polyphase_resampler));
+	uint32_t div = gcd(dst->samples_per_sec, src->samples_per_sec);
+	uint32_t scale;
+
+	rs->input_format = src->format;
+	rs->input_freq = src->samples_per_sec;
+	rs->channels = get_audio_channels(src->speakers);
+	rs->up = dst->samples_per_sec / div;
+	rs->down = src->samples_per_sec / div;
+
+	/* widen the kernel when downsampling so the transition band stays
+	 * the same width relative to the output rate */
+	scale = (rs->down + rs->up - 1) / rs->up;
+	rs->taps = BASE_TAPS * scale;
+
+	rs->coeffs = bmalloc(sizeof(float) * rs->up * rs->taps);
+	build_coeffs(rs);
+
+	/* prime the history so the first output lines up with the first
+	 * input sample */
+	rs->history_capacity = rs->taps * 2;
+	rs->history_size = rs->taps / 2 - 1;
+	for (uint32_t i = 0; i < rs->channels; i++)
+		rs->history[i] = bzalloc(sizeof(float) * rs->history_capacity);
+
+	return rs;
+}
+
+static inline float dot_product(const float *samples, const float *coeffs,
+				uint32_t count)
+{
+	__m128 sum = _mm_setzero_ps();
+	__m128 shuf;
+
+	for (uint32_t i = 0; i < count; i += 4) {
+		__m128 s = _mm_loadu_ps(samples + i);
+		__m128 c = _mm_load_ps(coeffs + i);
+		sum = _mm_add_ps(sum, _mm_mul_ps(s, c));
+	}
+
+	shuf = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1));
+	sum = _mm_add_ps(sum, shuf);
+	shuf = _mm_movehl_ps(shuf, sum);
+	sum = _mm_add_ss(sum, shuf);
+	return _mm_cvtss_f32(sum);
+}
+
+static inline float sample_to_float(enum audio_format format, const uint8_t *p)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		return ((float)*p - 128.0f) / 128.0f;
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		return (float)*(const int16_t *)p / 32768.0f;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		return (float)((double)*(const int32_t *)p / 2147483648.0);
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return *(const float *)p;
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+
+	return 0.0f;
+}
+
+static void append_input(struct polyphase_resampler *rs,
+			 const uint8_t *const input[], uint32_t frames)
+{
+	size_t needed = rs->history_size + frames;
+	size_t bytes = get_audio_bytes_per_channel(rs->input_format);
+
+	if (needed > rs->history_capacity) {
+		while (rs->history_capacity < needed)
+			rs->history_capacity *= 2;
+		for (uint32_t i = 0; i < rs->channels; i++)
+			rs->history[i] =
+				brealloc(rs->history[i],
+					 sizeof(float) * rs->history_capacity);
+	}
+
+	for (uint32_t ch = 0; ch < rs->channels; ch++) {
+		float *out = rs->history[ch] + rs->history_size;
+
+		if (rs->input_format == AUDIO_FORMAT_FLOAT_PLANAR) {
+			memcpy(out, input[ch], sizeof(float) * frames);
+
+		} else if (is_audio_planar(rs->input_format)) {
+			const uint8_t *in = input[ch];
+			for (uint32_t i = 0; i < frames; i++, in += bytes)
+				out[i] = sample_to_float(rs->input_format, in);
+
+		} else {
+			const size_t stride = bytes * rs->channels;
+			const uint8_t *in = input[0] + bytes * ch;
+			for (uint32_t i = 0; i < frames; i++, in += stride)
+				out[i] = sample_to_float(rs->input_format, in);
+		}
+	}
+
+	rs->history_size = needed;
+}
+
+static uint32_t count_output_frames(const struct polyphase_resampler *rs)
+{
+	uint64_t last;
+
+	if (rs->history_size < rs->taps)
+		return 0;
+
+	/* last read position that still has a full kernel of input */
+	last = (uint64_t)(rs->history_size - rs->taps) * rs->up + rs->up - 1;
+	if (rs->position > last)
+		return 0;
+
+	return (uint32_t)((last - rs->position) / rs->down + 1);
+}
+
+static bool polyphase_resampler_resample(void *data, uint8_t *output[],
+					 uint32_t *out_frames,
+					 uint64_t *ts_offset,
+					 const uint8_t *const input[],
+					 uint32_t in_frames)
+{
+	struct polyphase_resampler *rs = data;
+	uint64_t position = rs->position;
+	size_t consumed;
+	uint32_t frames;
+	double delay;
+
+	/* distance in input samples between the start of the new input and
+	 * the first sample this call outputs */
+	delay = (double)rs->history_size - (double)position / (double)rs->up -
+		((double)rs->taps * 0.5 - 1.0);
+	*ts_offset = delay > 0.0 ? (uint64_t)(delay * 1000000000.0 /
+					      (double)rs->input_freq)
+				 : 0;
+
+	append_input(rs, input, in_frames);
+	frames = count_output_frames(rs);
+
+	if (frames > rs->output_capacity) {
+		rs->output_capacity = frames;
+		for (uint32_t i = 0; i < rs->channels; i++)
+			rs->output_buffer[i] =
+				brealloc(rs->output_buffer[i],
+					 sizeof(float) * frames);
+	}
+
+	for (uint32_t ch = 0; ch < rs->channels; ch++) {
+		const float *history = rs->history[ch];
+		float *out = rs->output_buffer[ch];
+
+		position = rs->position;
+		for (uint32_t i = 0; i < frames; i++) {
+			size_t idx = (size_t)(position / rs->up);
+			uint32_t phase = (uint32_t)(position % rs->up);
+
+			out[i] = dot_product(history + idx,
+					     rs->coeffs + phase * rs->taps,
+					     rs->taps);
+			position += rs->down;
+		}
+
+		output[ch] = (uint8_t *)out;
+	}
+
+	/* drop history that no future output will read */
+	consumed = (size_t)(position / rs->up);
+	if (consumed > rs->history_size)
+		consumed = rs->history_size;
+
+	if (consumed) {
+		size_t remaining = rs->history_size - consumed;
+
+		for (uint32_t ch = 0; ch < rs->channels; ch++)
+			memmove(rs->history[ch], rs->history[ch] + consumed,
+				sizeof(float) * remaining);
+
+		rs->history_size = remaining;
+	}
+
+	rs->position = position - (uint64_t)consumed * rs->up;
+	*out_frames = frames;
+	return true;
+}
+
+const struct audio_resampler_backend polyphase_resampler_backend = {
+	.name = "polyphase",
+	.type = AUDIO_RESAMPLER_POLYPHASE,
+	.supports = polyphase_resampler_supports,
+	.create = polyphase_resampler_create,
+	.destroy = polyphase_resampler_destroy,
+	.resample = polyphase_resampler_resample,
+};
@@ -0,0 +1,105 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/bmem.h"
+#include "../util/base.h"
+#include "audio-resampler-internal.h"
+
+struct audio_resampler {
+	const struct audio_resampler_backend *backend;
+	void *data;
+};
+
+static const struct audio_resampler_backend *backends[] = {
+	&polyphase_resampler_backend,
+	&ffmpeg_resampler_backend,
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+static const struct audio_resampler_backend *
+find_backend(const struct resample_info *dst, const struct resample_info *src,
+	     enum audio_resampler_type type)
+{
+	for (size_t i = 0; i < NUM_BACKENDS; i++) {
+		const struct audio_resampler_backend *backend = backends[i];
+
+		if (type != AUDIO_RESAMPLER_AUTO && backend->type != type)
+			continue;
+		if (backend->supports(dst, src))
+			return backend;
+	}
+
+	return NULL;
+}
+
+audio_resampler_t *audio_resampler_create_type(const struct resample_info *dst,
+					       const struct resample_info *src,
+					       enum audio_resampler_type type)
+{
+	const struct audio_resampler_backend *backend;
+	struct audio_resampler *rs;
+	void *data;
+
+	backend = find_backend(dst, src, type);
+	if (!backend) {
+		blog(LOG_DEBUG, "audio_resampler_create_type: no resampler "
+				"supports %u Hz -> %u Hz with type %d",
+		     src->samples_per_sec, dst->samples_per_sec, (int)type);
+		return NULL;
+	}
+
+	data = backend->create(dst, src);
+	if (!data)
+		return NULL;
+
+	rs = bzalloc(sizeof(struct audio_resampler));
+	rs->backend = backend;
+	rs->data = data;
+	return rs;
+}
+
+audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
+					  const struct resample_info *src)
+{
+	return audio_resampler_create_type(dst, src, AUDIO_RESAMPLER_AUTO);
+}
+
+void audio_resampler_destroy(audio_resampler_t *rs)
+{
+	if (rs) {
+		rs->backend->destroy(rs->data);
+		bfree(rs);
+	}
+}
+
+bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
+			      uint32_t *out_frames, uint64_t *ts_offset,
+			      const uint8_t *const input[], uint32_t in_frames)
+{
+	if (!rs)
+		return false;
+
+	return rs->backend->resample(rs->data, output, out_frames, ts_offset,
+				     input, in_frames);
+}
+
+enum audio_resampler_type
+audio_resampler_get_type(const audio_resampler_t *rs)
+{
+	return rs ? rs->backend->type : AUDIO_RESAMPLER_AUTO;
+}
@@ -33,9 +33,24 @@ struct resample_info {
 	enum speaker_layout speakers;
 };
 
+/**
+ * Resampler implementations.  AUDIO_RESAMPLER_AUTO uses the built-in
+ * polyphase resampler when it can handle the conversion (rate change with an
+ * identical speaker layout), and swresample otherwise.
+ */
+enum audio_resampler_type {
+	AUDIO_RESAMPLER_AUTO,
+	AUDIO_RESAMPLER_FFMPEG,
+	AUDIO_RESAMPLER_POLYPHASE,
+};
+
 EXPORT audio_resampler_t *
 audio_resampler_create(const struct resample_info *dst,
 		       const struct resample_info *src);
+EXPORT audio_resampler_t *
+audio_resampler_create_type(const struct resample_info *dst,
+			    const struct resample_info *src,
+			    enum audio_resampler_type type);
 EXPORT void audio_resampler_destroy(audio_resampler_t *resampler);
 
 EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
@@ -44,6 +59,9 @@ EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
 				     const uint8_t *const input[],
 				     uint32_t in_frames);
 
+EXPORT enum audio_resampler_type
+audio_resampler_get_type(const audio_resampler_t *resampler);
+
 #ifdef __cplusplus
 }
 #endif
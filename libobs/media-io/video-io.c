@@ -46,6 +46,10 @@ struct video_input {
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
 	int cur_frame;
 
+	/* only every Nth output frame is scaled and passed to the callback */
+	uint32_t frame_rate_divisor;
+	uint32_t frame_rate_divisor_counter;
+
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
 };
@@ -81,8 +85,28 @@ struct video_output {
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
+
+	/* set on outputs created with
+	 * video_output_create_with_frame_rate_divisor, which have no frames
+	 * or thread of their own and forward everything to the parent */
+	struct video_output *parent;
+	uint32_t frame_rate_divisor;
 };
 
+static inline video_t *get_root(video_t *video)
+{
+	while (video && video->parent)
+		video = video->parent;
+	return video;
+}
+
+static inline const video_t *get_const_root(const video_t *video)
+{
+	while (video && video->parent)
+		video = video->parent;
+	return video;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static inline bool scale_video_output(struct video_input *input,
@@ -136,10 +160,17 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (input->frame_rate_divisor_counter++ == 0) {
+			struct video_data frame = frame_info->frame;
+
+			if (scale_video_output(input, &frame))
+				input->callback(input->param, &frame);
+		}
+
+		if (input->frame_rate_divisor_counter ==
+		    input->frame_rate_divisor)
+			input->frame_rate_divisor_counter = 0;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -263,11 +294,33 @@ fail:
 	return VIDEO_OUTPUT_FAIL;
 }
 
+video_t *video_output_create_with_frame_rate_divisor(video_t *video,
+						     uint32_t divisor)
+{
+	struct video_output *out;
+
+	if (!video || divisor == 0)
+		return NULL;
+
+	out = bzalloc(sizeof(struct video_output));
+	memcpy(&out->info, &video->info, sizeof(struct video_output_info));
+	out->info.fps_den *= divisor;
+	out->frame_time = video->frame_time * divisor;
+	out->parent = video;
+	out->frame_rate_divisor = divisor;
+	return out;
+}
+
 void video_output_close(video_t *video)
 {
 	if (!video)
 		return;
 
+	if (video->parent) {
+		bfree(video);
+		return;
+	}
+
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
@@ -343,12 +396,25 @@ static inline void reset_frames(video_t *video)
 bool video_output_connect(
 	video_t *video, const struct video_scale_info *conversion,
 	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	return video_output_connect2(video, conversion, 1, callback, param);
+}
+
+bool video_output_connect2(
+	video_t *video, const struct video_scale_info *conversion,
+	uint32_t frame_rate_divisor,
+	void (*callback)(void *param, struct video_data *frame), void *param)
 {
 	bool success = false;
 
-	if (!video || !callback)
+	if (!video || !callback || frame_rate_divisor == 0)
 		return false;
 
+	while (video->parent) {
+		frame_rate_divisor *= video->frame_rate_divisor;
+		video = video->parent;
+	}
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
@@ -357,6 +423,7 @@ bool video_output_connect(
 
 		input.callback = callback;
 		input.param = param;
+		input.frame_rate_divisor = frame_rate_divisor;
 
 		if (conversion) {
 			input.conversion = *conversion;
@@ -413,6 +480,8 @@ void video_output_disconnect(video_t *video,
 	if (!video || !callback)
 		return;
 
+	video = get_root(video);
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
@@ -435,7 +504,7 @@ bool video_output_active(const video_t *video)
 {
 	if (!video)
 		return false;
-	return os_atomic_load_bool(&video->raw_active);
+	return os_atomic_load_bool(&get_const_root(video)->raw_active);
 }
 
 const struct video_output_info *video_output_get_info(const video_t *video)
@@ -452,6 +521,8 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 	if (!video)
 		return false;
 
+	video = get_root(video);
+
 	pthread_mutex_lock(&video->data_mutex);
 
 	if (video->available_frames == 0) {
@@ -485,6 +556,8 @@ void video_output_unlock_frame(video_t *video)
 	if (!video)
 		return;
 
+	video = get_root(video);
+
 	pthread_mutex_lock(&video->data_mutex);
 
 	video->available_frames--;
@@ -505,6 +578,8 @@ void video_output_stop(video_t *video)
 	if (!video)
 		return;
 
+	video = get_root(video);
+
 	if (video->initialized) {
 		video->initialized = false;
 		video->stop = true;
@@ -518,7 +593,7 @@ bool video_output_stopped(video_t *video)
 	if (!video)
 		return true;
 
-	return video->stop;
+	return get_root(video)->stop;
 }
 
 enum video_format video_output_get_format(const video_t *video)
@@ -546,14 +621,21 @@ double video_output_get_frame_rate(const video_t *video)
 
 uint32_t video_output_get_skipped_frames(const video_t *video)
 {
+	video = get_const_root(video);
 	return (uint32_t)os_atomic_load_long(&video->skipped_frames);
 }
 
 uint32_t video_output_get_total_frames(const video_t *video)
 {
+	video = get_const_root(video);
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+video_t *video_output_get_parent(video_t *video)
+{
+	return video ? video->parent : NULL;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
@@ -562,6 +644,7 @@ uint32_t video_output_get_total_frames(const video_t *video)
 
 void video_output_inc_texture_encoders(video_t *video)
 {
+	video = get_root(video);
 	if (os_atomic_inc_long(&video->gpu_refs) == 1 &&
 	    !os_atomic_load_bool(&video->raw_active)) {
 		reset_frames(video);
@@ -570,6 +653,7 @@ void video_output_inc_texture_encoders(video_t *video)
 
 void video_output_dec_texture_encoders(video_t *video)
 {
+	video = get_root(video);
 	if (os_atomic_dec_long(&video->gpu_refs) == 0 &&
 	    !os_atomic_load_bool(&video->raw_active)) {
 		log_skipped(video);
@@ -578,10 +662,12 @@ void video_output_dec_texture_encoders(video_t *video)
 
 void video_output_inc_texture_frames(video_t *video)
 {
+	video = get_root(video);
 	os_atomic_inc_long(&video->total_frames);
 }
 
 void video_output_inc_texture_skipped_frames(video_t *video)
 {
+	video = get_root(video);
 	os_atomic_inc_long(&video->skipped_frames);
 }
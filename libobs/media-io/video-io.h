@@ -233,10 +233,31 @@ EXPORT bool video_format_get_parameters(enum video_colorspace color_space,
 EXPORT int video_output_open(video_t **video, struct video_output_info *info);
 EXPORT void video_output_close(video_t *video);
 
+/**
+ * Creates a video output that delivers every Nth frame of another one.  It
+ * has no frame cache or thread of its own: connections are made on the
+ * parent with the divisor applied, and video_output_get_info reports the
+ * effective frame rate.  Free it with video_output_close before the parent.
+ */
+EXPORT video_t *video_output_create_with_frame_rate_divisor(video_t *video,
+							    uint32_t divisor);
+
+/** Returns the video output a divided output was created from, or NULL */
+EXPORT video_t *video_output_get_parent(video_t *video);
+
 EXPORT bool
 video_output_connect(video_t *video, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param);
+
+/**
+ * Same as video_output_connect, but only every frame_rate_divisor'th frame
+ * is converted and passed to the callback; skipped frames are never scaled.
+ */
+EXPORT bool video_output_connect2(
+	video_t *video, const struct video_scale_info *conversion,
+	uint32_t frame_rate_divisor,
+	void (*callback)(void *param, struct video_data *frame), void *param);
 EXPORT void video_output_disconnect(video_t *video,
 				    void (*callback)(void *param,
 						     struct video_data *frame),
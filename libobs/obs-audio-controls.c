@@ -78,8 +78,23 @@ struct obs_volmeter {
 
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
+
+	/* seqlock protected copy of the last levels for
+	 * obs_volmeter_get_levels, odd while being written */
+	volatile long levels_seq;
+	struct obs_volmeter_levels levels;
+
+	/* set by readers, the meter stops measuring when it has neither
+	 * callbacks nor readers */
+	volatile bool polled;
+	volatile long num_callbacks;
+	uint64_t last_poll_ts;
 };
 
+/* meters with no callbacks that have not been polled for this long are
+ * skipped */
+#define VOLMETER_IDLE_TIMEOUT_NS 1000000000ULL
+
 static float cubic_def_to_db(const float def)
 {
 	if (def == 1.0f)
@@ -271,36 +286,10 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
 	return CLAMP(nr_channels, 0, MAX_AUDIO_CHANNELS);
 }
 
-/* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
- */
-#define SHIFT_RIGHT_2PS(msb, lsb)                                          \
-	{                                                                  \
-		__m128 tmp =                                               \
-			_mm_shuffle_ps(lsb, msb, _MM_SHUFFLE(0, 0, 3, 3)); \
-		lsb = _mm_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));   \
-		msb = _mm_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));   \
-	}
-
 /* x(d, c, b, a) --> (|d|, |c|, |b|, |a|)
  */
 #define abs_ps(v) _mm_andnot_ps(_mm_set1_ps(-0.f), v)
 
-/* Take cross product of a vector with a matrix resulting in vector.
- */
-#define VECTOR_MATRIX_CROSS_PS(out, v, m0, m1, m2, m3)    \
-	{                                                 \
-		out = _mm_mul_ps(v, m0);                  \
-		__m128 mul1 = _mm_mul_ps(v, m1);          \
-		__m128 mul2 = _mm_mul_ps(v, m2);          \
-		__m128 mul3 = _mm_mul_ps(v, m3);          \
-                                                          \
-		_MM_TRANSPOSE4_PS(out, mul1, mul2, mul3); \
-                                                          \
-		out = _mm_add_ps(out, mul1);              \
-		out = _mm_add_ps(out, mul2);              \
-		out = _mm_add_ps(out, mul3);              \
-	}
-
 /* x4(d, c, b, a)  -->  max(a, b, c, d)
  */
 #define hmax_ps(r, x4)                     \
@@ -313,6 +302,42 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
 		r = fmaxf(r, x4_mem[3]);   \
 	} while (false)
 
+/* Normalized-sinc parameters for interpolating over sample points which are
+ * located at x-coords: -1.5, -0.5, +0.5, +1.5.  One row per oversample point
+ * at x-coords: -0.3, -0.1, 0.1, 0.3, one column per sample point. */
+static const float true_peak_coefs[4][4] = {
+	{-0.103943f, 0.233872f, 0.935489f, -0.155915f},
+	{-0.189207f, 0.504551f, 0.756827f, -0.216236f},
+	{-0.216236f, 0.756827f, 0.504551f, -0.189207f},
+	{-0.155915f, 0.935489f, 0.233872f, -0.103943f},
+};
+
+/* Interpolate four consecutive sample positions at once.  x points to the
+ * oldest of the seven samples involved, so that the four overlapping loads
+ * hold the interpolation window of each position in the same lane, and every
+ * oversample point is a plain multiply-add of the four loads. */
+static inline __m128 true_peak_block(__m128 peak, const float *x,
+				     const __m128 c[4][4])
+{
+	const __m128 x0 = _mm_loadu_ps(x);
+	const __m128 x1 = _mm_loadu_ps(x + 1);
+	const __m128 x2 = _mm_loadu_ps(x + 2);
+	const __m128 x3 = _mm_loadu_ps(x + 3);
+
+	/* Include the actual sample values in the peak. */
+	peak = _mm_max_ps(peak, abs_ps(x3));
+
+	for (size_t k = 0; k < 4; k++) {
+		__m128 intrp = _mm_mul_ps(x0, c[k][0]);
+		intrp = _mm_add_ps(intrp, _mm_mul_ps(x1, c[k][1]));
+		intrp = _mm_add_ps(intrp, _mm_mul_ps(x2, c[k][2]));
+		intrp = _mm_add_ps(intrp, _mm_mul_ps(x3, c[k][3]));
+		peak = _mm_max_ps(peak, abs_ps(intrp));
+	}
+
+	return peak;
+}
+
 /* Calculate the true peak over a set of samples.
  * The algorithm implements 5x oversampling by using Whittaker–Shannon
  * interpolation over four samples.
@@ -328,45 +353,28 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
 static float get_true_peak(__m128 previous_samples, const float *samples,
 			   size_t nr_samples)
 {
-	/* These are normalized-sinc parameters for interpolating over sample
-	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
-	 * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3. */
-	const __m128 m3 =
-		_mm_set_ps(-0.155915f, 0.935489f, 0.233872f, -0.103943f);
-	const __m128 m1 =
-		_mm_set_ps(-0.216236f, 0.756827f, 0.504551f, -0.189207f);
-	const __m128 p1 =
-		_mm_set_ps(-0.189207f, 0.504551f, 0.756827f, -0.216236f);
-	const __m128 p3 =
-		_mm_set_ps(-0.103943f, 0.233872f, 0.935489f, -0.155915f);
-
-	__m128 work = previous_samples;
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		__m128 intrp_samples;
-
-		/* Include the actual sample values in the peak. */
-		__m128 abs_new_work = abs_ps(new_work);
-		peak = _mm_max_ps(peak, abs_new_work);
-
-		/* Shift in the next point. */
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
+	__m128 c[4][4];
+	for (size_t k = 0; k < 4; k++) {
+		for (size_t l = 0; l < 4; l++)
+			c[k][l] = _mm_set1_ps(true_peak_coefs[k][l]);
+	}
 
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
+	__m128 peak = previous_samples;
+	if (nr_samples < 4) {
+		float r;
+		hmax_ps(r, peak);
+		return r;
+	}
 
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
+	/* The first block interpolates over the tail of the previous
+	 * iteration, so stitch the two together. */
+	float head[8];
+	_mm_storeu_ps(head, previous_samples);
+	_mm_storeu_ps(head + 4, _mm_load_ps(samples));
+	peak = true_peak_block(peak, head + 1, c);
 
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-	}
+	for (size_t i = 4; (i + 3) < nr_samples; i += 4)
+		peak = true_peak_block(peak, samples + i - 3, c);
 
 	float r;
 	hmax_ps(r, peak);
@@ -499,8 +507,17 @@ static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
 			continue;
 		}
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
+		__m128 sum4 = _mm_setzero_ps();
+		size_t i = 0;
+		for (; (i + 3) < nr_samples; i += 4) {
+			__m128 v = _mm_loadu_ps(&samples[i]);
+			sum4 = _mm_add_ps(sum4, _mm_mul_ps(v, v));
+		}
+
+		float sums[4];
+		_mm_storeu_ps(sums, sum4);
+		float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+		for (; i < nr_samples; i++) {
 			float sample = samples[i];
 			sum += sample * sample;
 		}
@@ -519,6 +536,35 @@ static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
 	volmeter_process_magnitude(volmeter, data, nr_channels);
 }
 
+static void publish_levels(struct obs_volmeter *volmeter,
+			   const float magnitude[MAX_AUDIO_CHANNELS],
+			   const float peak[MAX_AUDIO_CHANNELS],
+			   const float input_peak[MAX_AUDIO_CHANNELS])
+{
+	struct obs_volmeter_levels *levels = &volmeter->levels;
+
+	/* only the audio thread writes, so a plain seqlock is enough */
+	os_atomic_inc_long(&volmeter->levels_seq);
+
+	memcpy(levels->magnitude, magnitude, sizeof(levels->magnitude));
+	memcpy(levels->peak, peak, sizeof(levels->peak));
+	memcpy(levels->input_peak, input_peak, sizeof(levels->input_peak));
+	levels->timestamp = os_gettime_ns();
+
+	os_atomic_inc_long(&volmeter->levels_seq);
+}
+
+static bool volmeter_watched(struct obs_volmeter *volmeter)
+{
+	uint64_t ts = os_gettime_ns();
+
+	if (os_atomic_set_bool(&volmeter->polled, false))
+		volmeter->last_poll_ts = ts;
+
+	return os_atomic_load_long(&volmeter->num_callbacks) > 0 ||
+	       ts - volmeter->last_poll_ts < VOLMETER_IDLE_TIMEOUT_NS;
+}
+
 static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 					  const struct audio_data *data,
 					  bool muted)
@@ -529,6 +575,9 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 	float peak[MAX_AUDIO_CHANNELS];
 	float input_peak[MAX_AUDIO_CHANNELS];
 
+	if (!volmeter_watched(volmeter))
+		return;
+
 	pthread_mutex_lock(&volmeter->mutex);
 
 	volmeter_process_audio_data(volmeter, data);
@@ -549,6 +598,7 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	publish_levels(volmeter, magnitude, peak, input_peak);
 	signal_levels_updated(volmeter, magnitude, peak, input_peak);
 
 	UNUSED_PARAMETER(source);
@@ -782,6 +832,7 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 
 	volmeter->type = type;
+	volmeter->last_poll_ts = os_gettime_ns();
 
 	obs_volmeter_set_update_interval(volmeter, 50);
 
@@ -921,6 +972,8 @@ void obs_volmeter_add_callback(obs_volmeter_t *volmeter,
 
 	pthread_mutex_lock(&volmeter->callback_mutex);
 	da_push_back(volmeter->callbacks, &cb);
+	os_atomic_set_long(&volmeter->num_callbacks,
+			   (long)volmeter->callbacks.num);
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
@@ -934,9 +987,38 @@ void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 
 	pthread_mutex_lock(&volmeter->callback_mutex);
 	da_erase_item(volmeter->callbacks, &cb);
+	os_atomic_set_long(&volmeter->num_callbacks,
+			   (long)volmeter->callbacks.num);
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
+bool obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+			     struct obs_volmeter_levels *levels)
+{
+	long seq;
+
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_get_levels") ||
+	    !obs_ptr_valid(levels, "obs_volmeter_get_levels"))
+		return false;
+
+	os_atomic_set_bool(&volmeter->polled, true);
+
+	do {
+		seq = os_atomic_load_long(&volmeter->levels_seq);
+		if (seq & 1)
+			continue;
+
+		*levels = volmeter->levels;
+
+		/* the compare-and-swap leaves the sequence unchanged, but
+		 * unlike a second plain load it cannot be reordered before
+		 * the copy */
+	} while ((seq & 1) || !os_atomic_compare_swap_long(
+				      &volmeter->levels_seq, seq, seq));
+
+	return seq != 0;
+}
+
 float obs_mul_to_db(float mul)
 {
 	return mul_to_db(mul);
@@ -277,6 +277,33 @@ EXPORT void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 					 obs_volmeter_updated_t callback,
 					 void *param);
 
+/**
+ * @brief Levels of a volume meter, in dB and adjusted for the source volume
+ *        like the values passed to obs_volmeter_updated_t
+ */
+struct obs_volmeter_levels {
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float input_peak[MAX_AUDIO_CHANNELS];
+
+	/** os_gettime_ns() of the update, changes with every update */
+	uint64_t timestamp;
+};
+
+/**
+ * @brief Get the most recent levels of the volume meter without locking
+ * @param volmeter pointer to the volume meter object
+ * @param levels receives the levels
+ * @return false if no levels have been measured yet
+ *
+ * This can be called from any thread and at any rate, it never blocks the
+ * audio thread.  A volume meter that has no callbacks only measures levels
+ * while it is being polled, so after a pause of more than a second the first
+ * call may return old levels.
+ */
+EXPORT bool obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+				    struct obs_volmeter_levels *levels);
+
 EXPORT float obs_mul_to_db(float mul);
 EXPORT float obs_db_to_mul(float db);
 
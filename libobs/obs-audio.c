@@ -441,6 +441,206 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+static void render_audio_source(struct obs_core_audio *audio,
+				obs_source_t *source,
+				const struct audio_render_params *params)
+{
+	if (!source->profile_audio_render_name)
+		source->profile_audio_render_name = profile_store_name(
+			obs_get_profiler_name_store(), "audio_render(%s)",
+			obs_source_get_name(source));
+
+	profile_start(source->profile_audio_render_name);
+
+	obs_source_audio_render(source, params->mixers, params->channels,
+				params->sample_rate, params->audio_size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+	    source->audio_ts < params->start_ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
+#if DEBUG_AUDIO == 1
+			/* this should really be fixed */
+			assert(false);
+#endif
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			bool rerender = ignore_audio(source, params->channels,
+						     params->sample_rate,
+						     params->start_ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, params->mixers,
+							params->channels,
+							params->sample_rate,
+							params->audio_size);
+		}
+	}
+
+	profile_end(source->profile_audio_render_name);
+}
+
+/* sources that render their own audio (scenes, transitions) or submix read
+ * the output of other sources, so they have to run after them in render
+ * order.  everything else only touches its own buffers. */
+static inline bool audio_source_independent(obs_source_t *source)
+{
+	return !source->info.audio_render && !source->info.audio_mix;
+}
+
+static void render_parallel_sources(struct obs_core_audio *audio)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&audio->render_next) - 1;
+		if (idx >= audio->parallel_order.num)
+			break;
+
+		render_audio_source(audio, audio->parallel_order.array[idx],
+				    &audio->render_params);
+	}
+}
+
+static const char *audio_render_thread_name = "audio_render_thread";
+
+static void *audio_render_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+
+	os_set_thread_name("libobs: audio render thread");
+
+	while (os_sem_wait(audio->render_start_sem) == 0) {
+		if (os_atomic_load_bool(&audio->render_stop))
+			break;
+
+		profile_start(audio_render_thread_name);
+		render_parallel_sources(audio);
+		profile_end(audio_render_thread_name);
+
+		profile_reenable_thread();
+
+		if (os_atomic_dec_long(&audio->render_threads_active) == 0)
+			os_event_signal(audio->render_done_event);
+	}
+
+	return NULL;
+}
+
+static void render_audio_sources(struct obs_core_audio *audio,
+				 const struct audio_render_params *params)
+{
+	bool parallel = false;
+
+	if (audio->render_threads.num) {
+		da_resize(audio->parallel_order, 0);
+
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (audio_source_independent(source))
+				da_push_back(audio->parallel_order, &source);
+		}
+
+		parallel = audio->parallel_order.num > 1;
+	}
+
+	/* independent sources are spread across the render threads and this
+	 * thread.  every render thread has to check in before anything reads
+	 * their buffers, so wait for all of them before the dependent sources
+	 * (children are always before their parents) and the mix. */
+	if (parallel) {
+		size_t num_threads = audio->render_threads.num;
+
+		audio->render_params = *params;
+		os_atomic_set_long(&audio->render_next, 0);
+		os_atomic_set_long(&audio->render_threads_active,
+				   (long)num_threads);
+
+		for (size_t i = 0; i < num_threads; i++)
+			os_sem_post(audio->render_start_sem);
+
+		render_parallel_sources(audio);
+		os_event_wait(audio->render_done_event);
+	}
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		if (parallel && audio_source_independent(source))
+			continue;
+
+		render_audio_source(audio, source, params);
+	}
+}
+
+#define MAX_AUDIO_RENDER_THREADS 4
+
+bool obs_init_audio_render_threads(struct obs_core_audio *audio)
+{
+	int cores = os_get_logical_cores();
+	size_t num_threads;
+
+	/* the audio thread itself also renders, so only spin up extra
+	 * threads when there are cores to spare */
+	if (cores <= 2)
+		return true;
+
+	num_threads = (size_t)(cores / 2);
+	if (num_threads > MAX_AUDIO_RENDER_THREADS)
+		num_threads = MAX_AUDIO_RENDER_THREADS;
+
+	if (os_sem_init(&audio->render_start_sem, 0) != 0)
+		return false;
+	if (os_event_init(&audio->render_done_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	for (size_t i = 0; i < num_threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, audio_render_thread, audio) !=
+		    0) {
+			blog(LOG_WARNING, "Failed to create audio render "
+					  "thread");
+			break;
+		}
+
+		da_push_back(audio->render_threads, &thread);
+	}
+
+	blog(LOG_INFO, "Audio rendering using %d additional thread(s)",
+	     (int)audio->render_threads.num);
+	return true;
+}
+
+/* only called once the audio thread has been joined, so no tick can be
+ * waiting on the render threads */
+void obs_free_audio_render_threads(struct obs_core_audio *audio)
+{
+	if (audio->render_threads.num) {
+		os_atomic_set_bool(&audio->render_stop, true);
+
+		for (size_t i = 0; i < audio->render_threads.num; i++)
+			os_sem_post(audio->render_start_sem);
+		for (size_t i = 0; i < audio->render_threads.num; i++)
+			pthread_join(audio->render_threads.array[i], NULL);
+	}
+
+	da_free(audio->render_threads);
+	da_free(audio->parallel_order);
+	os_sem_destroy(audio->render_start_sem);
+	os_event_destroy(audio->render_done_event);
+	audio->render_start_sem = NULL;
+	audio->render_done_event = NULL;
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -451,6 +651,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
+	struct audio_render_params render_params;
 	size_t audio_size;
 	uint64_t min_ts;
 
@@ -493,43 +694,13 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
-		    source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
-#if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
-#endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels,
-							     sample_rate,
-							     ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
-			}
-		}
-	}
+	render_params.mixers = mixers;
+	render_params.channels = channels;
+	render_params.sample_rate = sample_rate;
+	render_params.audio_size = audio_size;
+	render_params.start_ts = ts.start;
+
+	render_audio_sources(audio, &render_params);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
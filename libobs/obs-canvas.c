@@ -0,0 +1,633 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs.h"
+#include "obs-internal.h"
+#include "graphics/matrix4.h"
+#include "graphics/vec2.h"
+#include "graphics/vec4.h"
+#include "media-io/video-frame.h"
+
+static bool set_canvas_conversion(struct obs_canvas *canvas)
+{
+	const struct obs_canvas_info *info = &canvas->info;
+
+	switch ((uint32_t)info->output_format) {
+	case VIDEO_FORMAT_I420:
+		canvas->conversion_techs[0] = "Planar_Y";
+		canvas->conversion_techs[1] = "Planar_U_Left";
+		canvas->conversion_techs[2] = "Planar_V_Left";
+		canvas->conversion_width_i = 1.f / (float)info->output_width;
+		break;
+	case VIDEO_FORMAT_NV12:
+		canvas->conversion_techs[0] = "NV12_Y";
+		canvas->conversion_techs[1] = "NV12_UV";
+		canvas->conversion_width_i = 1.f / (float)info->output_width;
+		break;
+	case VIDEO_FORMAT_I444:
+		canvas->conversion_techs[0] = "Planar_Y";
+		canvas->conversion_techs[1] = "Planar_U";
+		canvas->conversion_techs[2] = "Planar_V";
+		break;
+	case VIDEO_FORMAT_RGBA:
+		return true;
+	default:
+		return false;
+	}
+
+	canvas->gpu_conversion = true;
+	return true;
+}
+
+static void set_canvas_matrix(struct obs_canvas *canvas)
+{
+	struct matrix4 mat;
+	struct vec4 r_row;
+
+	if (format_is_yuv(canvas->info.output_format)) {
+		video_format_get_parameters(canvas->info.colorspace,
+					    canvas->info.range, (float *)&mat,
+					    NULL, NULL);
+		matrix4_inv(&mat, &mat);
+
+		/* swap R and G */
+		r_row = mat.x;
+		mat.x = mat.y;
+		mat.y = r_row;
+	} else {
+		matrix4_identity(&mat);
+	}
+
+	memcpy(canvas->color_matrix, &mat, sizeof(float) * 16);
+}
+
+static bool create_plane(struct obs_canvas *canvas, int plane, uint32_t cx,
+			 uint32_t cy, enum gs_color_format format)
+{
+	canvas->convert_textures[plane] =
+		gs_texture_create(cx, cy, format, 1, NULL, GS_RENDER_TARGET);
+	if (!canvas->convert_textures[plane])
+		return false;
+
+	for (int i = 0; i < NUM_CANVAS_TEXTURES; i++) {
+		canvas->copy_surfaces[i][plane] =
+			gs_stagesurface_create(cx, cy, format);
+		if (!canvas->copy_surfaces[i][plane])
+			return false;
+	}
+
+	return true;
+}
+
+static bool init_canvas_textures(struct obs_canvas *canvas)
+{
+	const struct obs_canvas_info *info = &canvas->info;
+	const uint32_t cx = info->output_width;
+	const uint32_t cy = info->output_height;
+
+	canvas->render_texture =
+		gs_texture_create(info->base_width, info->base_height, GS_RGBA,
+				  1, NULL, GS_RENDER_TARGET);
+	if (!canvas->render_texture)
+		return false;
+
+	canvas->output_texture =
+		gs_texture_create(cx, cy, GS_RGBA, 1, NULL, GS_RENDER_TARGET);
+	if (!canvas->output_texture)
+		return false;
+
+	switch ((uint32_t)info->output_format) {
+	case VIDEO_FORMAT_I420:
+		return create_plane(canvas, 0, cx, cy, GS_R8) &&
+		       create_plane(canvas, 1, cx / 2, cy / 2, GS_R8) &&
+		       create_plane(canvas, 2, cx / 2, cy / 2, GS_R8);
+	case VIDEO_FORMAT_NV12:
+		return create_plane(canvas, 0, cx, cy, GS_R8) &&
+		       create_plane(canvas, 1, cx / 2, cy / 2, GS_R8G8);
+	case VIDEO_FORMAT_I444:
+		return create_plane(canvas, 0, cx, cy, GS_R8) &&
+		       create_plane(canvas, 1, cx, cy, GS_R8) &&
+		       create_plane(canvas, 2, cx, cy, GS_R8);
+	}
+
+	for (int i = 0; i < NUM_CANVAS_TEXTURES; i++) {
+		canvas->copy_surfaces[i][0] =
+			gs_stagesurface_create(cx, cy, GS_RGBA);
+		if (!canvas->copy_surfaces[i][0])
+			return false;
+	}
+
+	return true;
+}
+
+static void free_canvas_textures(struct obs_canvas *canvas)
+{
+	for (int i = 0; i < NUM_CANVAS_TEXTURES; i++) {
+		for (int c = 0; c < NUM_CHANNELS; c++) {
+			gs_stagesurface_destroy(canvas->copy_surfaces[i][c]);
+			canvas->copy_surfaces[i][c] = NULL;
+		}
+	}
+
+	for (int c = 0; c < NUM_CHANNELS; c++) {
+		gs_texture_destroy(canvas->convert_textures[c]);
+		canvas->convert_textures[c] = NULL;
+	}
+
+	gs_texture_destroy(canvas->output_texture);
+	gs_texture_destroy(canvas->render_texture);
+	canvas->output_texture = NULL;
+	canvas->render_texture = NULL;
+}
+
+static inline bool canvas_size_valid(uint32_t width, uint32_t height)
+{
+	return (width != 0 && height != 0 && width <= OBS_SIZE_MAX &&
+		height <= OBS_SIZE_MAX);
+}
+
+obs_canvas_t *obs_canvas_create(const char *name,
+				const struct obs_canvas_info *info)
+{
+	struct obs_core_video *video = &obs->video;
+	struct video_output_info vi;
+	struct obs_canvas *canvas;
+	bool success;
+
+	if (!video->video || !info)
+		return NULL;
+
+	if (!canvas_size_valid(info->base_width, info->base_height) ||
+	    !canvas_size_valid(info->output_width, info->output_height)) {
+		blog(LOG_ERROR, "obs_canvas_create: Invalid canvas size");
+		return NULL;
+	}
+
+	canvas = bzalloc(sizeof(struct obs_canvas));
+	canvas->name = bstrdup(name && *name ? name : "canvas");
+	canvas->info = *info;
+
+	/* align to multiple-of-two and SSE alignment sizes */
+	canvas->info.output_width &= 0xFFFFFFFC;
+	canvas->info.output_height &= 0xFFFFFFFE;
+	if (!canvas->info.fps_divisor)
+		canvas->info.fps_divisor = 1;
+
+	if (!set_canvas_conversion(canvas)) {
+		blog(LOG_ERROR,
+		     "obs_canvas_create: Unsupported output format "
+		     "for canvas '%s': %s",
+		     canvas->name,
+		     get_video_format_name(canvas->info.output_format));
+		bfree(canvas->name);
+		bfree(canvas);
+		return NULL;
+	}
+
+	set_canvas_matrix(canvas);
+
+	if (!obs_view_init(&canvas->view)) {
+		bfree(canvas->name);
+		bfree(canvas);
+		return NULL;
+	}
+
+	vi.name = canvas->name;
+	vi.format = canvas->info.output_format;
+	vi.fps_num = video->ovi.fps_num;
+	vi.fps_den = video->ovi.fps_den * canvas->info.fps_divisor;
+	vi.width = canvas->info.output_width;
+	vi.height = canvas->info.output_height;
+	vi.range = canvas->info.range;
+	vi.colorspace = canvas->info.colorspace;
+	vi.cache_size = 6;
+
+	if (video_output_open(&canvas->video, &vi) != VIDEO_OUTPUT_SUCCESS) {
+		blog(LOG_ERROR, "obs_canvas_create: Could not open video "
+				"output for canvas '%s'",
+		     canvas->name);
+		obs_view_free(&canvas->view);
+		bfree(canvas->name);
+		bfree(canvas);
+		return NULL;
+	}
+
+	canvas->interval = video_output_get_frame_time(canvas->video);
+
+	obs_enter_graphics();
+	success = init_canvas_textures(canvas);
+	if (!success)
+		free_canvas_textures(canvas);
+	obs_leave_graphics();
+
+	if (!success) {
+		blog(LOG_ERROR, "obs_canvas_create: Failed to create textures "
+				"for canvas '%s'",
+		     canvas->name);
+		video_output_close(canvas->video);
+		obs_view_free(&canvas->view);
+		bfree(canvas->name);
+		bfree(canvas);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&obs->data.canvases_mutex);
+	canvas->prev_next = &obs->data.first_canvas;
+	canvas->next = obs->data.first_canvas;
+	obs->data.first_canvas = canvas;
+	if (canvas->next)
+		canvas->next->prev_next = &canvas->next;
+	pthread_mutex_unlock(&obs->data.canvases_mutex);
+
+	blog(LOG_INFO,
+	     "canvas '%s' created: base %ux%u, output %ux%u, "
+	     "format %s, fps divisor %u",
+	     canvas->name, canvas->info.base_width, canvas->info.base_height,
+	     canvas->info.output_width, canvas->info.output_height,
+	     get_video_format_name(canvas->info.output_format),
+	     canvas->info.fps_divisor);
+
+	return canvas;
+}
+
+void obs_canvas_destroy(obs_canvas_t *canvas)
+{
+	if (!canvas)
+		return;
+
+	/* once unlinked the graphics thread can no longer be rendering it */
+	pthread_mutex_lock(&obs->data.canvases_mutex);
+	if (canvas->prev_next)
+		*canvas->prev_next = canvas->next;
+	if (canvas->next)
+		canvas->next->prev_next = canvas->prev_next;
+	pthread_mutex_unlock(&obs->data.canvases_mutex);
+
+	video_output_close(canvas->video);
+
+	obs_enter_graphics();
+	free_canvas_textures(canvas);
+	obs_leave_graphics();
+
+	obs_view_free(&canvas->view);
+
+	bfree(canvas->name);
+	bfree(canvas);
+}
+
+const char *obs_canvas_get_name(const obs_canvas_t *canvas)
+{
+	return canvas ? canvas->name : NULL;
+}
+
+bool obs_canvas_get_info(const obs_canvas_t *canvas,
+			 struct obs_canvas_info *info)
+{
+	if (!canvas || !info)
+		return false;
+
+	*info = canvas->info;
+	return true;
+}
+
+obs_view_t *obs_canvas_get_view(obs_canvas_t *canvas)
+{
+	return canvas ? &canvas->view : NULL;
+}
+
+video_t *obs_canvas_get_video(const obs_canvas_t *canvas)
+{
+	return canvas ? canvas->video : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* rendering (graphics thread) */
+
+static inline void set_canvas_render_size(uint32_t width, uint32_t height)
+{
+	gs_enable_depth_test(false);
+	gs_set_cull_mode(GS_NEITHER);
+
+	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+	gs_set_viewport(0, 0, width, height);
+}
+
+static inline gs_effect_t *get_canvas_scale_effect(struct obs_canvas *canvas)
+{
+	struct obs_core_video *video = &obs->video;
+	const struct obs_canvas_info *info = &canvas->info;
+	gs_effect_t *effect;
+
+	if (info->output_width == info->base_width &&
+	    info->output_height == info->base_height)
+		return video->default_effect;
+
+	if (info->output_width < (info->base_width / 2) &&
+	    info->output_height < (info->base_height / 2))
+		return video->bilinear_lowres_effect;
+
+	switch (info->scale_type) {
+	case OBS_SCALE_BILINEAR:
+		effect = video->default_effect;
+		break;
+	case OBS_SCALE_LANCZOS:
+		effect = video->lanczos_effect;
+		break;
+	case OBS_SCALE_AREA:
+		effect = video->area_effect;
+		break;
+	case OBS_SCALE_BICUBIC:
+	default:
+		effect = video->bicubic_effect;
+	}
+
+	return effect ? effect : video->default_effect;
+}
+
+static void render_canvas_texture(struct obs_canvas *canvas)
+{
+	struct vec4 clear_color;
+	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	gs_set_render_target(canvas->render_texture, NULL);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
+
+	set_canvas_render_size(canvas->info.base_width,
+			       canvas->info.base_height);
+
+	obs_view_render(&canvas->view);
+}
+
+static void render_canvas_output(struct obs_canvas *canvas)
+{
+	const struct obs_canvas_info *info = &canvas->info;
+	gs_effect_t *effect = get_canvas_scale_effect(canvas);
+	gs_technique_t *tech = gs_effect_get_technique(
+		effect, info->output_format == VIDEO_FORMAT_RGBA
+				? "DrawAlphaDivide"
+				: "Draw");
+
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_eparam_t *bres =
+		gs_effect_get_param_by_name(effect, "base_dimension");
+	gs_eparam_t *bres_i =
+		gs_effect_get_param_by_name(effect, "base_dimension_i");
+
+	gs_set_render_target(canvas->output_texture, NULL);
+	set_canvas_render_size(info->output_width, info->output_height);
+
+	if (bres) {
+		struct vec2 base;
+		vec2_set(&base, (float)info->base_width,
+			 (float)info->base_height);
+		gs_effect_set_vec2(bres, &base);
+	}
+
+	if (bres_i) {
+		struct vec2 base_i;
+		vec2_set(&base_i, 1.0f / (float)info->base_width,
+			 1.0f / (float)info->base_height);
+		gs_effect_set_vec2(bres_i, &base_i);
+	}
+
+	gs_effect_set_texture_srgb(image, canvas->render_texture);
+
+	gs_enable_framebuffer_srgb(true);
+	gs_enable_blending(false);
+	size_t passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(canvas->render_texture, 0, info->output_width,
+			       info->output_height);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+	gs_enable_blending(true);
+	gs_enable_framebuffer_srgb(false);
+}
+
+static void render_canvas_plane(gs_effect_t *effect, gs_texture_t *target,
+				const char *tech_name)
+{
+	gs_technique_t *tech = gs_effect_get_technique(effect, tech_name);
+
+	gs_set_render_target(target, NULL);
+	set_canvas_render_size(gs_texture_get_width(target),
+			       gs_texture_get_height(target));
+
+	size_t passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw(GS_TRIS, 0, 3);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+}
+
+static void render_canvas_convert(struct obs_canvas *canvas)
+{
+	gs_effect_t *effect = obs->video.conversion_effect;
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_eparam_t *width_i = gs_effect_get_param_by_name(effect, "width_i");
+	gs_eparam_t *color_vec[3] = {
+		gs_effect_get_param_by_name(effect, "color_vec0"),
+		gs_effect_get_param_by_name(effect, "color_vec1"),
+		gs_effect_get_param_by_name(effect, "color_vec2"),
+	};
+	const float *mat = canvas->color_matrix;
+	struct vec4 vec[3];
+
+	/* same row order as the main video conversion (Y, U, V) */
+	vec4_set(&vec[0], mat[4], mat[5], mat[6], mat[7]);
+	vec4_set(&vec[1], mat[0], mat[1], mat[2], mat[3]);
+	vec4_set(&vec[2], mat[8], mat[9], mat[10], mat[11]);
+
+	gs_enable_blending(false);
+
+	for (int c = 0; c < NUM_CHANNELS; c++) {
+		if (!canvas->convert_textures[c])
+			break;
+
+		gs_effect_set_texture(image, canvas->output_texture);
+		gs_effect_set_vec4(color_vec[c], &vec[c]);
+		if (c == 1 && !canvas->convert_textures[2])
+			gs_effect_set_vec4(color_vec[2], &vec[2]);
+		if (c > 0)
+			gs_effect_set_float(width_i,
+					    canvas->conversion_width_i);
+
+		render_canvas_plane(effect, canvas->convert_textures[c],
+				    canvas->conversion_techs[c]);
+	}
+
+	gs_enable_blending(true);
+}
+
+static void stage_canvas_texture(struct obs_canvas *canvas, int texture,
+				 uint64_t video_time)
+{
+	if (canvas->gpu_conversion) {
+		for (int c = 0; c < NUM_CHANNELS; c++) {
+			gs_stagesurf_t *copy =
+				canvas->copy_surfaces[texture][c];
+			if (copy)
+				gs_stage_texture(copy,
+						 canvas->convert_textures[c]);
+		}
+	} else {
+		gs_stage_texture(canvas->copy_surfaces[texture][0],
+				 canvas->output_texture);
+	}
+
+	canvas->textures_copied[texture] = true;
+	canvas->textures_ts[texture] = video_time;
+}
+
+static inline void copy_canvas_plane(uint8_t *out, uint32_t out_linesize,
+				     const uint8_t *in, uint32_t in_linesize,
+				     uint32_t row_size, uint32_t height)
+{
+	if (out_linesize == in_linesize) {
+		memcpy(out, in, (size_t)in_linesize * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(out, in, row_size);
+		out += out_linesize;
+		in += in_linesize;
+	}
+}
+
+static void output_canvas_texture(struct obs_canvas *canvas, int texture,
+				  int count)
+{
+	struct video_frame output;
+	uint8_t *data[NUM_CHANNELS] = {0};
+	uint32_t linesize[NUM_CHANNELS] = {0};
+	int mapped = 0;
+
+	for (; mapped < NUM_CHANNELS; mapped++) {
+		gs_stagesurf_t *surface =
+			canvas->copy_surfaces[texture][mapped];
+		if (!surface)
+			break;
+		if (!gs_stagesurface_map(surface, &data[mapped],
+					 &linesize[mapped]))
+			goto unmap;
+	}
+
+	if (!video_output_lock_frame(canvas->video, &output, count,
+				     canvas->textures_ts[texture]))
+		goto unmap;
+
+	for (int c = 0; c < mapped; c++) {
+		gs_stagesurf_t *surface = canvas->copy_surfaces[texture][c];
+		enum gs_color_format format =
+			gs_stagesurface_get_color_format(surface);
+		uint32_t width = gs_stagesurface_get_width(surface);
+		uint32_t height = gs_stagesurface_get_height(surface);
+		uint32_t row_size = width * gs_get_format_bpp(format) / 8;
+
+		copy_canvas_plane(output.data[c], output.linesize[c], data[c],
+				  linesize[c], row_size, height);
+	}
+
+	video_output_unlock_frame(canvas->video);
+
+unmap:
+	for (int c = 0; c < mapped; c++)
+		gs_stagesurface_unmap(canvas->copy_surfaces[texture][c]);
+
+	canvas->textures_copied[texture] = false;
+}
+
+static const char *render_canvas_name = "render_canvas";
+static void render_canvas(struct obs_canvas *canvas, uint64_t video_time,
+			  uint64_t interval)
+{
+	if (!video_output_active(canvas->video)) {
+		canvas->was_active = false;
+		return;
+	}
+
+	if (!canvas->was_active) {
+		memset(canvas->textures_copied, 0,
+		       sizeof(canvas->textures_copied));
+		canvas->next_time = 0;
+		canvas->was_active = true;
+	}
+
+	/* the fps divisor is applied on the main video's frame clock */
+	if (canvas->next_time && video_time + interval / 2 < canvas->next_time)
+		return;
+
+	int cur_texture = canvas->cur_texture;
+	int prev_texture = (cur_texture + 1) % NUM_CANVAS_TEXTURES;
+
+	profile_start(render_canvas_name);
+
+	render_canvas_texture(canvas);
+	render_canvas_output(canvas);
+	if (canvas->gpu_conversion)
+		render_canvas_convert(canvas);
+	stage_canvas_texture(canvas, cur_texture, video_time);
+
+	/* the previous frame lasts until this one, which is only known now */
+	if (canvas->textures_copied[prev_texture]) {
+		uint64_t duration =
+			video_time - canvas->textures_ts[prev_texture];
+		int count = (int)((duration + canvas->interval / 2) /
+				  canvas->interval);
+
+		output_canvas_texture(canvas, prev_texture,
+				      count > 0 ? count : 1);
+	}
+
+	canvas->cur_texture = prev_texture;
+	canvas->next_time = video_time + canvas->interval;
+
+	profile_end(render_canvas_name);
+}
+
+void obs_render_canvases(uint64_t video_time, uint64_t interval)
+{
+	struct obs_canvas *canvas;
+
+	pthread_mutex_lock(&obs->data.canvases_mutex);
+
+	canvas = obs->data.first_canvas;
+	if (!canvas) {
+		pthread_mutex_unlock(&obs->data.canvases_mutex);
+		return;
+	}
+
+	gs_enter_context(obs->video.graphics);
+	gs_begin_scene();
+
+	while (canvas) {
+		render_canvas(canvas, video_time, interval);
+		canvas = canvas->next;
+	}
+
+	gs_set_render_target(NULL, NULL);
+	gs_enable_blending(true);
+	gs_end_scene();
+	gs_leave_context();
+
+	pthread_mutex_unlock(&obs->data.canvases_mutex);
+}
@@ -0,0 +1,484 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+#include "media-io/video-scaler.h"
+
+struct encoder_group_level {
+	uint32_t width;
+	uint32_t height;
+
+	/* scales the previous level down to this one, NULL for level 0,
+	 * which is the output of the video conversion itself */
+	video_scaler_t *scaler;
+	struct video_frame frame;
+};
+
+struct obs_encoder_group {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_encoder *) encoders;
+	DARRAY(struct encoder_group_level) levels;
+
+	video_t *video;
+	struct video_scale_info info;
+	size_t num_connected;
+	bool video_connected;
+};
+
+obs_encoder_group_t *obs_encoder_group_create(void)
+{
+	struct obs_encoder_group *group;
+	pthread_mutexattr_t attr;
+
+	if (pthread_mutexattr_init(&attr) != 0)
+		return NULL;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return NULL;
+
+	group = bzalloc(sizeof(struct obs_encoder_group));
+
+	/* recursive: an encoder failing inline on the video thread will
+	 * disconnect itself from within receive_group_video */
+	if (pthread_mutex_init(&group->mutex, &attr) != 0) {
+		bfree(group);
+		return NULL;
+	}
+
+	return group;
+}
+
+static void free_levels(struct obs_encoder_group *group)
+{
+	for (size_t i = 0; i < group->levels.num; i++) {
+		struct encoder_group_level *level = &group->levels.array[i];
+
+		video_scaler_destroy(level->scaler);
+		video_frame_free(&level->frame);
+	}
+
+	da_free(group->levels);
+}
+
+static inline bool group_active(const struct obs_encoder_group *group)
+{
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		if (group->encoders.array[i]->group_active)
+			return true;
+	}
+
+	return false;
+}
+
+void obs_encoder_group_destroy(obs_encoder_group_t *group)
+{
+	if (!group)
+		return;
+
+	pthread_mutex_lock(&group->mutex);
+
+	if (group_active(group)) {
+		pthread_mutex_unlock(&group->mutex);
+		blog(LOG_WARNING, "obs_encoder_group_destroy: tried to destroy "
+				  "an encoder group while it's still active!");
+		return;
+	}
+
+	for (size_t i = 0; i < group->encoders.num; i++)
+		group->encoders.array[i]->group = NULL;
+
+	pthread_mutex_unlock(&group->mutex);
+
+	da_free(group->encoders);
+	free_levels(group);
+	pthread_mutex_destroy(&group->mutex);
+	bfree(group);
+}
+
+static inline int64_t get_keyint_sec(const struct obs_encoder *encoder)
+{
+	return obs_data_get_int(encoder->context.settings, "keyint_sec");
+}
+
+bool obs_encoder_group_add(obs_encoder_group_t *group, obs_encoder_t *encoder)
+{
+	bool success = false;
+
+	if (!obs_ptr_valid(group, "obs_encoder_group_add"))
+		return false;
+	if (!obs_encoder_valid(encoder, "obs_encoder_group_add"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING, "obs_encoder_group_add: "
+				  "encoder passed is not a video encoder");
+		return false;
+	}
+	if (obs_encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "obs_encoder_group_add: encoder '%s' is still active",
+		     encoder->context.name);
+		return false;
+	}
+	if (encoder->group) {
+		blog(LOG_WARNING,
+		     "obs_encoder_group_add: encoder '%s' is already in a "
+		     "group",
+		     encoder->context.name);
+		return false;
+	}
+
+	pthread_mutex_lock(&group->mutex);
+
+	if (group_active(group)) {
+		blog(LOG_WARNING, "obs_encoder_group_add: group is active");
+		goto unlock;
+	}
+
+	/* renditions can only switch at keyframes that line up */
+	if (group->encoders.num &&
+	    get_keyint_sec(group->encoders.array[0]) !=
+		    get_keyint_sec(encoder)) {
+		blog(LOG_WARNING,
+		     "obs_encoder_group_add: encoder '%s' has a different "
+		     "keyframe interval than the rest of the group",
+		     encoder->context.name);
+		goto unlock;
+	}
+
+	da_push_back(group->encoders, &encoder);
+	encoder->group = group;
+	success = true;
+
+unlock:
+	pthread_mutex_unlock(&group->mutex);
+	return success;
+}
+
+bool obs_encoder_group_remove(obs_encoder_group_t *group,
+			      obs_encoder_t *encoder)
+{
+	if (!obs_ptr_valid(group, "obs_encoder_group_remove"))
+		return false;
+	if (!obs_encoder_valid(encoder, "obs_encoder_group_remove"))
+		return false;
+	if (encoder->group != group)
+		return false;
+	if (obs_encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "obs_encoder_group_remove: encoder '%s' is still active",
+		     encoder->context.name);
+		return false;
+	}
+
+	encoder_group_remove(encoder);
+	return true;
+}
+
+void encoder_group_remove(struct obs_encoder *encoder)
+{
+	struct obs_encoder_group *group = encoder->group;
+
+	if (!group)
+		return;
+
+	pthread_mutex_lock(&group->mutex);
+	da_erase_item(group->encoders, &encoder);
+	encoder->group = NULL;
+	pthread_mutex_unlock(&group->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static size_t find_level(const struct obs_encoder_group *group,
+			 uint32_t width, uint32_t height)
+{
+	for (size_t i = 0; i < group->levels.num; i++) {
+		const struct encoder_group_level *level =
+			&group->levels.array[i];
+
+		if (level->width == width && level->height == height)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static void insert_level(struct obs_encoder_group *group, uint32_t width,
+			 uint32_t height)
+{
+	struct encoder_group_level level = {width, height};
+	uint64_t area = (uint64_t)width * height;
+	size_t idx = 0;
+
+	if (find_level(group, width, height) != DARRAY_INVALID)
+		return;
+
+	while (idx < group->levels.num) {
+		struct encoder_group_level *cur = &group->levels.array[idx];
+		if ((uint64_t)cur->width * cur->height < area)
+			break;
+		idx++;
+	}
+
+	da_insert(group->levels, idx, &level);
+}
+
+/* one level per distinct member size, largest first.  level 0 comes
+ * straight from the video conversion, and every other level is scaled from
+ * the one above it, which is far cheaper than scaling each rendition from
+ * the full size frame */
+static void build_levels(struct obs_encoder_group *group)
+{
+	free_levels(group);
+
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		struct obs_encoder *encoder = group->encoders.array[i];
+
+		if (encoder->group_connected)
+			insert_level(group, obs_encoder_get_width(encoder),
+				     obs_encoder_get_height(encoder));
+	}
+
+	group->info.width = group->levels.array[0].width;
+	group->info.height = group->levels.array[0].height;
+
+	for (size_t i = 1; i < group->levels.num; i++) {
+		struct encoder_group_level *prev = &group->levels.array[i - 1];
+		struct encoder_group_level *level = &group->levels.array[i];
+		struct video_scale_info src = group->info;
+		struct video_scale_info dst = group->info;
+		int ret;
+
+		src.width = prev->width;
+		src.height = prev->height;
+		dst.width = level->width;
+		dst.height = level->height;
+
+		ret = video_scaler_create(&level->scaler, &dst, &src,
+					  VIDEO_SCALE_FAST_BILINEAR);
+		if (ret != VIDEO_SCALER_SUCCESS) {
+			blog(LOG_ERROR,
+			     "encoder group: failed to create scaler for "
+			     "%" PRIu32 "x%" PRIu32 " level",
+			     level->width, level->height);
+			continue;
+		}
+
+		video_frame_init(&level->frame, dst.format, dst.width,
+				 dst.height);
+	}
+
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		struct obs_encoder *encoder = group->encoders.array[i];
+		uint32_t width = obs_encoder_get_width(encoder);
+		uint32_t height = obs_encoder_get_height(encoder);
+
+		if (encoder->group_connected)
+			encoder->group_level = find_level(group, width, height);
+	}
+}
+
+static inline bool all_members_active(const struct obs_encoder_group *group)
+{
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		if (!group->encoders.array[i]->group_active)
+			return false;
+	}
+
+	return true;
+}
+
+static const char *receive_group_video_name = "receive_group_video";
+static void receive_group_video(void *param, struct video_data *frame)
+{
+	struct obs_encoder_group *group = param;
+	const uint8_t *const *input;
+	const uint32_t *in_linesize;
+	size_t num_levels = 0;
+	bool ready = true;
+
+	profile_start(receive_group_video_name);
+	pthread_mutex_lock(&group->mutex);
+
+	/* every rendition has to take exactly the same frames to keep their
+	 * keyframes aligned, so a frame that isn't ready for one member
+	 * (waiting for paired audio, paused) is skipped for all of them.
+	 * each member still has to see every frame for its pause state */
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		struct obs_encoder *encoder = group->encoders.array[i];
+
+		if (!encoder->group_connected)
+			continue;
+		if (!encoder_video_frame_ready(encoder, frame->timestamp))
+			ready = false;
+		if (encoder->group_level + 1 > num_levels)
+			num_levels = encoder->group_level + 1;
+	}
+
+	if (!ready)
+		goto unlock;
+
+	/* only scale down as far as the smallest connected rendition */
+	input = (const uint8_t *const *)frame->data;
+	in_linesize = frame->linesize;
+
+	for (size_t i = 1; i < num_levels; i++) {
+		struct encoder_group_level *level = &group->levels.array[i];
+
+		if (!level->scaler ||
+		    !video_scaler_scale(level->scaler, level->frame.data,
+					level->frame.linesize, input,
+					in_linesize)) {
+			num_levels = i;
+			break;
+		}
+
+		input = (const uint8_t *const *)level->frame.data;
+		in_linesize = level->frame.linesize;
+	}
+
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		struct obs_encoder *encoder = group->encoders.array[i];
+		struct video_data level_frame = *frame;
+		struct encoder_group_level *level;
+
+		if (!encoder->group_connected)
+			continue;
+		if (encoder->group_level >= num_levels)
+			continue;
+
+		if (encoder->group_level > 0) {
+			level = &group->levels.array[encoder->group_level];
+
+			for (size_t j = 0; j < MAX_AV_PLANES; j++) {
+				level_frame.data[j] = level->frame.data[j];
+				level_frame.linesize[j] =
+					level->frame.linesize[j];
+			}
+		}
+
+		encoder_receive_video_frame(encoder, &level_frame);
+	}
+
+unlock:
+	pthread_mutex_unlock(&group->mutex);
+	profile_end(receive_group_video_name);
+}
+
+static inline bool can_share_video(const struct obs_encoder_group *group,
+				   const struct obs_encoder *encoder,
+				   const struct video_scale_info *info)
+{
+	if (!info)
+		return false;
+	if (!group->num_connected)
+		return true;
+
+	return group->video == encoder->media &&
+	       group->info.format == info->format &&
+	       group->info.colorspace == info->colorspace &&
+	       group->info.range == info->range;
+}
+
+/* info is NULL for members that are fed separately no matter what (texture
+ * encoders), which only need to be counted as started */
+bool encoder_group_connect(struct obs_encoder *encoder,
+			   const struct video_scale_info *info)
+{
+	struct obs_encoder_group *group = encoder->group;
+	bool connected;
+	bool start = false;
+
+	pthread_mutex_lock(&group->mutex);
+
+	encoder->group_active = true;
+	connected = can_share_video(group, encoder, info);
+
+	/* a member restarting while the rest of the group is still running
+	 * can only rejoin at one of the existing levels */
+	if (connected && group->video_connected) {
+		size_t level = find_level(group, info->width, info->height);
+
+		connected = level != DARRAY_INVALID;
+		if (connected)
+			encoder->group_level = level;
+	}
+
+	if (connected) {
+		if (!group->num_connected) {
+			group->video = encoder->media;
+			group->info = *info;
+		}
+
+		encoder->group_connected = true;
+		group->num_connected++;
+	}
+
+	/* don't take frames until every member is started, so that all
+	 * renditions begin on the same frame */
+	if (!group->video_connected && group->num_connected &&
+	    all_members_active(group)) {
+		build_levels(group);
+		group->video_connected = true;
+		start = true;
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+
+	/* connect outside of the group mutex: the video thread holds the
+	 * video input mutex while it locks the group mutex */
+	if (start)
+		start_raw_video(group->video, &group->info, receive_group_video,
+				group);
+
+	if (!connected && info)
+		blog(LOG_INFO,
+		     "encoder '%s': can't share its group's scaling, "
+		     "connecting separately",
+		     encoder->context.name);
+
+	return connected;
+}
+
+void encoder_group_disconnect(struct obs_encoder *encoder)
+{
+	struct obs_encoder_group *group = encoder->group;
+	bool stop = false;
+
+	pthread_mutex_lock(&group->mutex);
+
+	encoder->group_active = false;
+
+	if (encoder->group_connected) {
+		encoder->group_connected = false;
+
+		if (--group->num_connected == 0 && group->video_connected) {
+			group->video_connected = false;
+			stop = true;
+		}
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+
+	if (stop) {
+		stop_raw_video(group->video, receive_group_video, group);
+
+		pthread_mutex_lock(&group->mutex);
+		if (!group->video_connected)
+			free_levels(group);
+		pthread_mutex_unlock(&group->mutex);
+	}
+}
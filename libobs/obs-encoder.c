@@ -50,6 +50,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
+	pthread_mutex_init_value(&encoder->queue_mutex);
+	pthread_mutex_init_value(&encoder->stats_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -66,6 +68,10 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->pause.mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->stats_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&encoder->queue_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -91,6 +97,7 @@ create_encoder(const char *id, enum obs_encoder_type type, const char *name,
 
 	encoder = bzalloc(sizeof(struct obs_encoder));
 	encoder->mixer_idx = mixer_idx;
+	encoder->frame_rate_divisor = 1;
 
 	if (!ei) {
 		blog(LOG_ERROR, "Encoder ID '%s' not found", id);
@@ -143,6 +150,9 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static bool start_encode_thread(struct obs_encoder *encoder,
+				const struct video_scale_info *info);
+static void stop_encode_thread(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -190,12 +200,6 @@ static inline bool has_scaling(const struct obs_encoder *encoder)
 		video_height != encoder->scaled_height);
 }
 
-static inline bool gpu_encode_available(const struct obs_encoder *encoder)
-{
-	return (encoder->info.caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0 &&
-	       obs->video.using_nv12_tex;
-}
-
 static void add_connection(struct obs_encoder *encoder)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -209,16 +213,40 @@ static void add_connection(struct obs_encoder *encoder)
 		get_video_info(encoder, &info);
 
 		if (gpu_encode_available(encoder)) {
+			/* texture encoders can't be fed by the group, but
+			 * still have to count as started for it */
+			if (encoder->group)
+				encoder_group_connect(encoder, NULL);
 			start_gpu_encode(encoder);
 		} else {
-			start_raw_video(encoder->media, &info, receive_video,
-					encoder);
+			/* if the thread can't be created, frames are encoded
+			 * directly on the video thread as a fallback */
+			if (!start_encode_thread(encoder, &info))
+				blog(LOG_WARNING,
+				     "encoder '%s': failed to create encode "
+				     "thread",
+				     encoder->context.name);
+
+			/* group members are fed from the group's scaling
+			 * pyramid instead of their own video connection */
+			if (!encoder->group ||
+			    !encoder_group_connect(encoder, &info))
+				start_raw_video(encoder->media, &info,
+						receive_video, encoder);
 		}
 	}
 
 	set_encoder_active(encoder, true);
 }
 
+static inline void disconnect_raw_video(struct obs_encoder *encoder)
+{
+	if (!encoder->group_connected)
+		stop_raw_video(encoder->media, receive_video, encoder);
+	if (encoder->group)
+		encoder_group_disconnect(encoder);
+}
+
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -227,8 +255,22 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 	} else {
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
+			if (encoder->group)
+				encoder_group_disconnect(encoder);
+		} else if (encoder->encode_thread_active &&
+			   pthread_equal(pthread_self(),
+					 encoder->encode_thread)) {
+			/* encode error on the encode thread: stop taking
+			 * frames and wake up the video thread in case it's
+			 * waiting for a free slot, otherwise disconnecting
+			 * would deadlock.  the thread exits on its own and is
+			 * joined on the next start or on destroy */
+			os_atomic_set_bool(&encoder->encode_thread_stop, true);
+			os_sem_post(encoder->queue_slots);
+			disconnect_raw_video(encoder);
 		} else {
-			stop_raw_video(encoder->media, receive_video, encoder);
+			disconnect_raw_video(encoder);
+			stop_encode_thread(encoder);
 		}
 	}
 
@@ -266,6 +308,8 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		     encoder->context.name);
 
 		free_audio_buffers(encoder);
+		stop_encode_thread(encoder);
+		encoder_group_remove(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
@@ -274,11 +318,14 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
+		pthread_mutex_destroy(&encoder->queue_mutex);
+		pthread_mutex_destroy(&encoder->stats_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
 		if (encoder->last_error_message)
 			bfree(encoder->last_error_message);
+		video_output_close(encoder->fps_override);
 		bfree(encoder);
 	}
 }
@@ -579,6 +626,11 @@ static inline void obs_encoder_start_internal(
 		pause_reset(&encoder->pause);
 
 		encoder->cur_pts = 0;
+
+		pthread_mutex_lock(&encoder->stats_mutex);
+		memset(&encoder->stats, 0, sizeof(encoder->stats));
+		pthread_mutex_unlock(&encoder->stats_mutex);
+
 		add_connection(encoder);
 	}
 }
@@ -779,6 +831,16 @@ void obs_encoder_set_video(obs_encoder_t *encoder, video_t *video)
 	if (!video)
 		return;
 
+	video_output_close(encoder->fps_override);
+	encoder->fps_override = NULL;
+
+	if (encoder->frame_rate_divisor > 1) {
+		encoder->fps_override =
+			video_output_create_with_frame_rate_divisor(
+				video, encoder->frame_rate_divisor);
+		video = encoder->fps_override;
+	}
+
 	voi = video_output_get_info(video);
 
 	encoder->media = video;
@@ -786,6 +848,96 @@ void obs_encoder_set_video(obs_encoder_t *encoder, video_t *video)
 	encoder->timebase_den = voi->fps_num;
 }
 
+void obs_encoder_set_frame_rate_divisor(obs_encoder_t *encoder,
+					uint32_t frame_rate_divisor)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_frame_rate_divisor"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING,
+		     "obs_encoder_set_frame_rate_divisor: "
+		     "encoder '%s' is not a video encoder",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot set the frame rate divisor "
+		     "while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (frame_rate_divisor == 0) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot set frame rate divisor to 0",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->frame_rate_divisor = frame_rate_divisor;
+
+	/* re-derive the divided video output from the original one */
+	video_t *video = encoder->media;
+	if (encoder->fps_override)
+		video = video_output_get_parent(encoder->fps_override);
+	if (video)
+		obs_encoder_set_video(encoder, video);
+}
+
+bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+				 struct obs_encoder_queue_stats *stats)
+{
+	struct obs_encoder *enc = (struct obs_encoder *)encoder;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!encoder->encode_thread_active)
+		return false;
+
+	pthread_mutex_lock(&enc->queue_mutex);
+	stats->queued = (uint32_t)enc->queue_count;
+	stats->capacity = ENCODER_QUEUE_SIZE;
+	stats->max_queued = (uint32_t)enc->queue_max;
+	memcpy(stats->encode_time_hist, enc->encode_time_hist,
+	       sizeof(stats->encode_time_hist));
+	pthread_mutex_unlock(&enc->queue_mutex);
+	return true;
+}
+
+bool obs_encoder_get_stats(const obs_encoder_t *encoder,
+			   struct obs_encoder_stats *stats)
+{
+	struct obs_encoder *enc = (struct obs_encoder *)encoder;
+	bool success;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_stats"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO)
+		return false;
+	if (!obs_encoder_active(encoder))
+		return false;
+
+	pthread_mutex_lock(&enc->stats_mutex);
+	success = enc->stats.frames != 0;
+	if (success)
+		*stats = enc->stats;
+	pthread_mutex_unlock(&enc->stats_mutex);
+
+	return success;
+}
+
+uint32_t obs_encoder_get_frame_rate_divisor(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_frame_rate_divisor"))
+		return 0;
+
+	return encoder->frame_rate_divisor;
+}
+
 void obs_encoder_set_audio(obs_encoder_t *encoder, audio_t *audio)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_set_audio"))
@@ -957,6 +1109,62 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 	}
 }
 
+#define STATS_EMA_WEIGHT 16
+
+static inline double stats_ema(double avg, double val, uint64_t frames)
+{
+	if (frames == 1)
+		return val;
+	return avg + (val - avg) / STATS_EMA_WEIGHT;
+}
+
+void encoder_record_frame_stats(struct obs_encoder *encoder,
+				const struct encoder_packet *pkt,
+				uint64_t encode_ns)
+{
+	struct encoder_frame_stats frame_stats = {OBS_ENCODER_FRAME_UNKNOWN,
+						  -1};
+	struct obs_encoder_stats *stats = &encoder->stats;
+	double encode_ms = (double)encode_ns / 1000000.0;
+
+	if (!encoder->info.get_frame_stats ||
+	    !encoder->info.get_frame_stats(encoder->context.data,
+					   &frame_stats)) {
+		frame_stats.type = pkt->keyframe ? OBS_ENCODER_FRAME_I
+						 : OBS_ENCODER_FRAME_UNKNOWN;
+		frame_stats.qp = -1;
+	}
+
+	if (frame_stats.type < 0 ||
+	    frame_stats.type >= OBS_ENCODER_FRAME_TYPES)
+		frame_stats.type = OBS_ENCODER_FRAME_UNKNOWN;
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+
+	stats->frames++;
+	stats->total_bytes += pkt->size;
+	stats->frame_types[frame_stats.type]++;
+
+	if (frame_stats.qp < 0)
+		stats->avg_qp = -1.0;
+	else if (stats->avg_qp < 0.0)
+		stats->avg_qp = (double)frame_stats.qp;
+	else
+		stats->avg_qp = stats_ema(stats->avg_qp,
+					  (double)frame_stats.qp,
+					  stats->frames);
+
+	stats->avg_encode_ms =
+		stats_ema(stats->avg_encode_ms, encode_ms, stats->frames);
+
+	stats->last_type = frame_stats.type;
+	stats->last_qp = frame_stats.qp;
+	stats->last_size = pkt->size;
+	stats->last_encode_ms = encode_ms;
+
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
 static const char *do_encode_name = "do_encode";
 bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 {
@@ -969,15 +1177,21 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	struct encoder_packet pkt = {0};
 	bool received = false;
 	bool success;
+	uint64_t start;
 
 	pkt.timebase_num = encoder->timebase_num;
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
+	start = os_gettime_ns();
 	profile_start(encoder->profile_encoder_encode_name);
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 				       &received);
 	profile_end(encoder->profile_encoder_encode_name);
+
+	if (success && received && encoder->info.type == OBS_ENCODER_VIDEO)
+		encoder_record_frame_stats(encoder, &pkt,
+					   os_gettime_ns() - start);
 	send_off_encoder_packet(encoder, success, received, &pkt);
 
 	profile_end(do_encode_name);
@@ -1015,24 +1229,191 @@ bool video_pause_check(struct pause_data *pause, uint64_t timestamp)
 	return ignore_frame;
 }
 
-static const char *receive_video_name = "receive_video";
-static void receive_video(void *param, struct video_data *frame)
+static inline size_t encode_time_bucket(uint64_t ns)
 {
-	profile_start(receive_video_name);
+	uint64_t ms = ns / 1000000;
+	size_t bucket = 0;
 
+	while (ms && bucket < OBS_ENCODER_TIME_BUCKETS - 1) {
+		ms >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void *encode_thread(void *param)
+{
 	struct obs_encoder *encoder = param;
+
+	os_set_thread_name("libobs: encode thread");
+
+	/* waking up with an empty queue means the thread is being stopped;
+	 * anything queued before that is still encoded */
+	while (os_sem_wait(encoder->queue_frames) == 0) {
+		struct encoder_queued_frame *queued;
+		struct encoder_frame enc_frame;
+		uint64_t start;
+		bool success;
+
+		pthread_mutex_lock(&encoder->queue_mutex);
+		queued = encoder->queue_count
+				 ? &encoder->queue[encoder->queue_head]
+				 : NULL;
+		pthread_mutex_unlock(&encoder->queue_mutex);
+
+		if (!queued)
+			break;
+
+		memset(&enc_frame, 0, sizeof(struct encoder_frame));
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			enc_frame.data[i] = queued->frame.data[i];
+			enc_frame.linesize[i] = queued->frame.linesize[i];
+		}
+
+		enc_frame.frames = 1;
+		enc_frame.pts = queued->pts;
+
+		start = os_gettime_ns();
+		success = do_encode(encoder, &enc_frame);
+
+		pthread_mutex_lock(&encoder->queue_mutex);
+		if (++encoder->queue_head == ENCODER_QUEUE_SIZE)
+			encoder->queue_head = 0;
+		encoder->queue_count--;
+		encoder->encode_time_hist[encode_time_bucket(os_gettime_ns() -
+							     start)]++;
+		pthread_mutex_unlock(&encoder->queue_mutex);
+
+		os_sem_post(encoder->queue_slots);
+
+		if (!success)
+			break;
+	}
+
+	return NULL;
+}
+
+static void free_encode_queue(struct obs_encoder *encoder)
+{
+	os_sem_destroy(encoder->queue_frames);
+	os_sem_destroy(encoder->queue_slots);
+	encoder->queue_frames = NULL;
+	encoder->queue_slots = NULL;
+
+	for (size_t i = 0; i < ENCODER_QUEUE_SIZE; i++)
+		video_frame_free(&encoder->queue[i].frame);
+}
+
+static bool start_encode_thread(struct obs_encoder *encoder,
+				const struct video_scale_info *info)
+{
+	/* may still be around if the last session ended on an encode error */
+	stop_encode_thread(encoder);
+
+	for (size_t i = 0; i < ENCODER_QUEUE_SIZE; i++)
+		video_frame_init(&encoder->queue[i].frame, info->format,
+				 info->width, info->height);
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	encoder->queue_format = info->format;
+	encoder->queue_height = info->height;
+	encoder->queue_head = 0;
+	encoder->queue_count = 0;
+	encoder->queue_max = 0;
+	memset(encoder->encode_time_hist, 0, sizeof(encoder->encode_time_hist));
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	encoder->encode_thread_stop = false;
+
+	if (os_sem_init(&encoder->queue_frames, 0) != 0)
+		goto fail;
+	if (os_sem_init(&encoder->queue_slots, ENCODER_QUEUE_SIZE) != 0)
+		goto fail;
+	if (pthread_create(&encoder->encode_thread, NULL, encode_thread,
+			   encoder) != 0)
+		goto fail;
+
+	encoder->encode_thread_active = true;
+	return true;
+
+fail:
+	free_encode_queue(encoder);
+	return false;
+}
+
+static void stop_encode_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->encode_thread_active)
+		return;
+
+	os_atomic_set_bool(&encoder->encode_thread_stop, true);
+	os_sem_post(encoder->queue_frames);
+	pthread_join(encoder->encode_thread, NULL);
+
+	encoder->encode_thread_active = false;
+	free_encode_queue(encoder);
+}
+
+/* blocks while the queue is full, so an encoder that can't keep up still
+ * makes the video output skip frames the same way it did when it encoded
+ * on the video thread */
+static void queue_video_frame(struct obs_encoder *encoder,
+			      struct video_data *frame)
+{
+	struct encoder_queued_frame *queued;
+
+	if (os_atomic_load_bool(&encoder->encode_thread_stop))
+		return;
+	if (os_sem_wait(encoder->queue_slots) != 0)
+		return;
+	if (os_atomic_load_bool(&encoder->encode_thread_stop))
+		return;
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	queued = &encoder->queue[(encoder->queue_head + encoder->queue_count) %
+				 ENCODER_QUEUE_SIZE];
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	video_frame_copy(&queued->frame, (const struct video_frame *)frame,
+			 encoder->queue_format, encoder->queue_height);
+	queued->pts = encoder->cur_pts;
+	encoder->cur_pts += encoder->timebase_num;
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	if (++encoder->queue_count > encoder->queue_max)
+		encoder->queue_max = encoder->queue_count;
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	os_sem_post(encoder->queue_frames);
+}
+
+bool encoder_video_frame_ready(struct obs_encoder *encoder, uint64_t timestamp)
+{
 	struct obs_encoder *pair = encoder->paired_encoder;
-	struct encoder_frame enc_frame;
 
 	if (!encoder->first_received && pair) {
-		if (!pair->first_received ||
-		    pair->first_raw_ts > frame->timestamp) {
-			goto wait_for_audio;
+		if (!pair->first_received || pair->first_raw_ts > timestamp) {
+			return false;
 		}
 	}
 
-	if (video_pause_check(&encoder->pause, frame->timestamp))
-		goto wait_for_audio;
+	return !video_pause_check(&encoder->pause, timestamp);
+}
+
+void encoder_receive_video_frame(struct obs_encoder *encoder,
+				 struct video_data *frame)
+{
+	struct encoder_frame enc_frame;
+
+	if (!encoder->start_ts)
+		encoder->start_ts = frame->timestamp;
+
+	if (encoder->encode_thread_active) {
+		queue_video_frame(encoder, frame);
+		return;
+	}
 
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
@@ -1041,16 +1422,23 @@ static void receive_video(void *param, struct video_data *frame)
 		enc_frame.linesize[i] = frame->linesize[i];
 	}
 
-	if (!encoder->start_ts)
-		encoder->start_ts = frame->timestamp;
-
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
 	if (do_encode(encoder, &enc_frame))
 		encoder->cur_pts += encoder->timebase_num;
+}
+
+static const char *receive_video_name = "receive_video";
+static void receive_video(void *param, struct video_data *frame)
+{
+	profile_start(receive_video_name);
+
+	struct obs_encoder *encoder = param;
+
+	if (encoder_video_frame_ready(encoder, frame->timestamp))
+		encoder_receive_video_frame(encoder, frame);
 
-wait_for_audio:
 	profile_end(receive_video_name);
 }
 
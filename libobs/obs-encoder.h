@@ -40,6 +40,22 @@ enum obs_encoder_type {
 	OBS_ENCODER_VIDEO  /**< The encoder provides a video codec */
 };
 
+/** Picture type of an encoded video frame */
+enum obs_encoder_frame_type {
+	OBS_ENCODER_FRAME_UNKNOWN,
+	OBS_ENCODER_FRAME_I,
+	OBS_ENCODER_FRAME_P,
+	OBS_ENCODER_FRAME_B,
+};
+
+#define OBS_ENCODER_FRAME_TYPES 4
+
+/** Encoder statistics of an encoded video frame */
+struct encoder_frame_stats {
+	enum obs_encoder_frame_type type; /**< Picture type */
+	int qp; /**< Average quantizer of the frame, -1 if unknown */
+};
+
 /** Encoder output packet */
 struct encoder_packet {
 	uint8_t *data; /**< Packet data */
@@ -262,6 +278,16 @@ struct obs_encoder_info {
 			       uint64_t lock_key, uint64_t *next_key,
 			       struct encoder_packet *packet,
 			       bool *received_packet);
+
+	/**
+	 * Gets the picture type and quantizer of the packet last returned by
+	 * encode or encode_texture (optional, video encoders only)
+	 *
+	 * @param       data   Data associated with this encoder context
+	 * @param[out]  stats  Statistics of the encoded frame
+	 * @return             true if available, false otherwise
+	 */
+	bool (*get_frame_stats)(void *data, struct encoder_frame_stats *stats);
 };
 
 EXPORT void obs_register_encoder_s(const struct obs_encoder_info *info,
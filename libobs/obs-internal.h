@@ -32,13 +32,15 @@
 
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
+#include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
 
 #include <caption/caption.h>
 
-#define NUM_TEXTURES 2
+#define DEFAULT_READBACK_DEPTH 3
+#define MAX_READBACK_DEPTH 8
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -220,6 +222,41 @@ extern bool obs_display_init(struct obs_display *display,
 			     const struct gs_init_data *graphics_data);
 extern void obs_display_free(struct obs_display *display);
 
+/* ------------------------------------------------------------------------- */
+/* canvases */
+
+#define NUM_CANVAS_TEXTURES 2
+#define OBS_SIZE_MAX (32 * 1024)
+
+struct obs_canvas {
+	char *name;
+	struct obs_canvas_info info;
+	struct obs_view view;
+	video_t *video;
+
+	gs_texture_t *render_texture;
+	gs_texture_t *output_texture;
+	gs_texture_t *convert_textures[NUM_CHANNELS];
+	gs_stagesurf_t *copy_surfaces[NUM_CANVAS_TEXTURES][NUM_CHANNELS];
+	bool textures_copied[NUM_CANVAS_TEXTURES];
+	uint64_t textures_ts[NUM_CANVAS_TEXTURES];
+	int cur_texture;
+
+	bool gpu_conversion;
+	const char *conversion_techs[NUM_CHANNELS];
+	float conversion_width_i;
+	float color_matrix[16];
+
+	uint64_t interval;
+	uint64_t next_time;
+	bool was_active;
+
+	struct obs_canvas *next;
+	struct obs_canvas **prev_next;
+};
+
+extern void obs_render_canvases(uint64_t video_time, uint64_t interval);
+
 /* ------------------------------------------------------------------------- */
 /* core */
 
@@ -243,14 +280,29 @@ struct obs_task_info {
 	void *param;
 };
 
+enum obs_video_phase {
+	OBS_VIDEO_PHASE_TICK,
+	OBS_VIDEO_PHASE_RENDER,
+	OBS_VIDEO_PHASE_CONVERT,
+	OBS_VIDEO_PHASE_DOWNLOAD,
+	OBS_VIDEO_PHASE_OUTPUT,
+	OBS_VIDEO_PHASE_COUNT,
+};
+
+struct obs_readback_frame {
+	int texture;
+	int count;
+	struct video_data frame;
+};
+
 struct obs_core_video {
 	graphics_t *graphics;
-	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
+	gs_stagesurf_t *copy_surfaces[MAX_READBACK_DEPTH][NUM_CHANNELS];
 	gs_texture_t *render_texture;
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
-	bool textures_copied[NUM_TEXTURES];
+	bool textures_copied[MAX_READBACK_DEPTH];
 	bool texture_converted;
 	bool using_nv12_tex;
 	struct circlebuf vframe_info_buffer;
@@ -267,8 +319,27 @@ struct obs_core_video {
 	gs_effect_t *bilinear_lowres_effect;
 	gs_effect_t *premultiplied_alpha_effect;
 	gs_samplerstate_t *point_sampler;
-	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
 	int cur_texture;
+	int readback_depth;
+	uint32_t requested_readback_depth;
+
+	/* staged surfaces are mapped on the graphics thread once the gpu is
+	 * done with them, then copied to the video output on the download
+	 * thread and unmapped again on the graphics thread */
+	bool textures_mapped[MAX_READBACK_DEPTH];
+	volatile bool textures_downloaded[MAX_READBACK_DEPTH];
+	uint64_t textures_staged_ts[MAX_READBACK_DEPTH];
+	pthread_mutex_t download_mutex;
+	struct circlebuf download_queue;
+	os_sem_t *download_semaphore;
+	os_event_t *download_done;
+	pthread_t download_thread;
+	bool download_thread_initialized;
+	volatile bool download_stop;
+	uint64_t readback_frames;
+	uint64_t readback_latency_total;
+	uint64_t readback_latency_max;
+	uint64_t readback_stalls;
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -285,6 +356,11 @@ struct obs_core_video {
 	uint64_t video_frame_interval_ns;
 	uint64_t video_avg_frame_time_ns;
 	double video_fps;
+
+	/* moving averages of the cost of each phase of a frame, and how far
+	 * ahead of its timestamp the next frame is started */
+	uint64_t phase_time_ns[OBS_VIDEO_PHASE_COUNT];
+	uint64_t render_ahead_ns;
 	video_t *video;
 	pthread_t video_thread;
 	uint32_t total_frames;
@@ -322,12 +398,31 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+struct audio_render_params {
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t audio_size;
+	uint64_t start_ts;
+};
+
 struct obs_core_audio {
 	audio_t *audio;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* sources with no audio dependencies, rendered in parallel by the
+	 * render threads before the rest of the render order */
+	DARRAY(struct obs_source *) parallel_order;
+	DARRAY(pthread_t) render_threads;
+	os_sem_t *render_start_sem;
+	os_event_t *render_done_event;
+	struct audio_render_params render_params;
+	volatile long render_next;
+	volatile long render_threads_active;
+	volatile bool render_stop;
+
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
 	int buffering_wait_ticks;
@@ -349,9 +444,11 @@ struct obs_core_data {
 	struct obs_output *first_output;
 	struct obs_encoder *first_encoder;
 	struct obs_service *first_service;
+	struct obs_canvas *first_canvas;
 
 	pthread_mutex_t sources_mutex;
 	pthread_mutex_t displays_mutex;
+	pthread_mutex_t canvases_mutex;
 	pthread_mutex_t outputs_mutex;
 	pthread_mutex_t encoders_mutex;
 	pthread_mutex_t services_mutex;
@@ -360,6 +457,11 @@ struct obs_core_data {
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
+	/* weak references to all sources, owned by the graphics thread and
+	 * rebuilt from the source list when sources_changed is set */
+	DARRAY(obs_weak_source_t *) tick_sources;
+	volatile bool sources_changed;
+
 	struct obs_view main_view;
 
 	long long unnamed_index;
@@ -444,6 +546,8 @@ struct obs_graphics_context {
 	uint64_t frame_time_total_ns;
 	uint64_t fps_total_ns;
 	uint32_t fps_total_frames;
+	uint64_t frame_time_avg_ns;
+	uint64_t frame_time_dev_ns;
 #ifdef _WIN32
 	bool gpu_was_active;
 #endif
@@ -454,6 +558,8 @@ struct obs_graphics_context {
 
 extern void *obs_graphics_thread(void *param);
 extern bool obs_graphics_thread_loop(struct obs_graphics_context *context);
+extern void *obs_download_thread(void *param);
+extern void obs_unmap_readback_surfaces(struct obs_core_video *video);
 #ifdef __APPLE__
 extern void *obs_graphics_thread_autorelease(void *param);
 extern bool
@@ -465,6 +571,8 @@ extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
+extern bool obs_init_audio_render_threads(struct obs_core_audio *audio);
+extern void obs_free_audio_render_threads(struct obs_core_audio *audio);
 
 extern void
 start_raw_video(video_t *video, const struct video_scale_info *conversion,
@@ -563,6 +671,14 @@ struct async_frame {
 	bool used;
 };
 
+/* a frame from obs_source_output_video_external, whose planes belong to the
+ * caller until release is called */
+struct async_external_frame {
+	struct obs_source_frame *frame;
+	obs_source_frame_release_t release;
+	void *param;
+};
+
 enum audio_action_type {
 	AUDIO_ACTION_VOL,
 	AUDIO_ACTION_MUTE,
@@ -642,6 +758,7 @@ struct obs_source {
 	bool async_rendered;
 
 	/* audio */
+	const char *profile_audio_render_name;
 	bool audio_failed;
 	bool audio_pending;
 	bool pending_stop;
@@ -691,6 +808,7 @@ struct obs_source {
 	bool async_decoupled;
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
+	DARRAY(struct async_external_frame) async_external_frames;
 	DARRAY(struct obs_source_frame *) async_frames;
 	pthread_mutex_t async_mutex;
 	uint32_t async_width;
@@ -933,10 +1051,11 @@ struct obs_output {
 	bool received_audio;
 	volatile bool data_active;
 	volatile bool end_data_capture_thread_active;
-	int64_t video_offset;
+	uint32_t received_video_tracks;
+	int64_t video_offsets[MAX_OUTPUT_VIDEO_ENCODERS];
 	int64_t audio_offsets[MAX_AUDIO_MIXES];
 	int64_t highest_audio_ts;
-	int64_t highest_video_ts;
+	int64_t highest_video_ts[MAX_OUTPUT_VIDEO_ENCODERS];
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
@@ -962,7 +1081,7 @@ struct obs_output {
 	volatile bool paused;
 	video_t *video;
 	audio_t *audio;
-	obs_encoder_t *video_encoder;
+	obs_encoder_t *video_encoders[MAX_OUTPUT_VIDEO_ENCODERS];
 	obs_encoder_t *audio_encoders[MAX_AUDIO_MIXES];
 	obs_service_t *service;
 	size_t mixer_mask;
@@ -1051,6 +1170,13 @@ struct encoder_callback {
 	void *param;
 };
 
+#define ENCODER_QUEUE_SIZE 4
+
+struct encoder_queued_frame {
+	struct video_frame frame;
+	int64_t pts;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1073,6 +1199,12 @@ struct obs_encoder {
 	uint32_t scaled_height;
 	enum video_format preferred_format;
 
+	/* only every Nth frame of the video output is encoded; fps_override
+	 * is the divided video output that media points to when N > 1 */
+	uint32_t frame_rate_divisor;
+	uint32_t frame_rate_divisor_counter;
+	video_t *fps_override;
+
 	volatile bool active;
 	volatile bool paused;
 	bool initialized;
@@ -1114,10 +1246,51 @@ struct obs_encoder {
 
 	const char *profile_encoder_encode_name;
 	char *last_error_message;
+
+	/* raw video frames are copied into a small pool of frames and encoded
+	 * on a thread of the encoder's own, so that a slow encoder doesn't
+	 * hold up the video thread and the other encoders connected to it */
+	pthread_t encode_thread;
+	bool encode_thread_active;
+	volatile bool encode_thread_stop;
+	os_sem_t *queue_frames;
+	os_sem_t *queue_slots;
+	pthread_mutex_t queue_mutex;
+	struct encoder_queued_frame queue[ENCODER_QUEUE_SIZE];
+	enum video_format queue_format;
+	uint32_t queue_height;
+	size_t queue_head;
+	size_t queue_count;
+	size_t queue_max;
+	uint64_t encode_time_hist[OBS_ENCODER_TIME_BUCKETS];
+
+	pthread_mutex_t stats_mutex;
+	struct obs_encoder_stats stats;
+
+	/* encoder group (rendition ladder) this encoder belongs to, and the
+	 * level of the group's scaling pyramid it's fed from */
+	struct obs_encoder_group *group;
+	size_t group_level;
+	bool group_active;
+	bool group_connected;
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
 
+extern void encoder_record_frame_stats(struct obs_encoder *encoder,
+				      const struct encoder_packet *pkt,
+				      uint64_t encode_ns);
+
+extern bool encoder_video_frame_ready(struct obs_encoder *encoder,
+				      uint64_t timestamp);
+extern void encoder_receive_video_frame(struct obs_encoder *encoder,
+					struct video_data *frame);
+
+extern bool encoder_group_connect(struct obs_encoder *encoder,
+				  const struct video_scale_info *info);
+extern void encoder_group_disconnect(struct obs_encoder *encoder);
+extern void encoder_group_remove(struct obs_encoder *encoder);
+
 extern bool obs_encoder_initialize(obs_encoder_t *encoder);
 extern void obs_encoder_shutdown(obs_encoder_t *encoder);
 
@@ -1135,6 +1308,7 @@ extern void obs_encoder_add_output(struct obs_encoder *encoder,
 extern void obs_encoder_remove_output(struct obs_encoder *encoder,
 				      struct obs_output *output);
 
+extern bool gpu_encode_available(const struct obs_encoder *encoder);
 extern bool start_gpu_encode(obs_encoder_t *encoder);
 extern void stop_gpu_encode(obs_encoder_t *encoder);
 
@@ -203,9 +203,11 @@ void obs_output_destroy(obs_output_t *output)
 
 		free_packets(output);
 
-		if (output->video_encoder) {
-			obs_encoder_remove_output(output->video_encoder,
-						  output);
+		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+			if (output->video_encoders[i]) {
+				obs_encoder_remove_output(
+					output->video_encoders[i], output);
+			}
 		}
 
 		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
@@ -569,7 +571,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 	uint64_t closest_v_ts;
 	bool success = false;
 
-	venc = output->video_encoder;
+	venc = output->video_encoders[0];
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 		aenc[i] = output->audio_encoders[i];
 
@@ -791,8 +793,11 @@ void obs_output_remove_encoder(struct obs_output *output,
 	if (!obs_output_valid(output, "obs_output_remove_encoder"))
 		return;
 
-	if (output->video_encoder == encoder) {
-		output->video_encoder = NULL;
+	if (encoder && encoder->info.type == OBS_ENCODER_VIDEO) {
+		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+			if (output->video_encoders[i] == encoder)
+				output->video_encoders[i] = NULL;
+		}
 	} else {
 		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
 			if (output->audio_encoders[i] == encoder)
@@ -801,37 +806,53 @@ void obs_output_remove_encoder(struct obs_output *output,
 	}
 }
 
-void obs_output_set_video_encoder(obs_output_t *output, obs_encoder_t *encoder)
+void obs_output_set_video_encoder2(obs_output_t *output, obs_encoder_t *encoder,
+				   size_t idx)
 {
-	if (!obs_output_valid(output, "obs_output_set_video_encoder"))
+	if (!obs_output_valid(output, "obs_output_set_video_encoder2"))
 		return;
 	if (encoder && encoder->info.type != OBS_ENCODER_VIDEO) {
-		blog(LOG_WARNING, "obs_output_set_video_encoder: "
+		blog(LOG_WARNING, "obs_output_set_video_encoder2: "
 				  "encoder passed is not a video encoder");
 		return;
 	}
 	if (active(output)) {
 		blog(LOG_WARNING,
-		     "%s: tried to set video encoder on output \"%s\" "
+		     "%s: tried to set video encoder %d on output \"%s\" "
 		     "while the output is still active!",
-		     __FUNCTION__, output->context.name);
+		     __FUNCTION__, (int)idx, output->context.name);
 		return;
 	}
 
-	if (output->video_encoder == encoder)
+	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK_VIDEO) != 0) {
+		if (idx >= MAX_OUTPUT_VIDEO_ENCODERS) {
+			return;
+		}
+	} else {
+		if (idx > 0) {
+			return;
+		}
+	}
+
+	if (output->video_encoders[idx] == encoder)
 		return;
 
-	obs_encoder_remove_output(output->video_encoder, output);
+	obs_encoder_remove_output(output->video_encoders[idx], output);
 	obs_encoder_add_output(encoder, output);
-	output->video_encoder = encoder;
+	output->video_encoders[idx] = encoder;
 
 	/* set the preferred resolution on the encoder */
-	if (output->scaled_width && output->scaled_height)
-		obs_encoder_set_scaled_size(output->video_encoder,
+	if (idx == 0 && output->scaled_width && output->scaled_height)
+		obs_encoder_set_scaled_size(output->video_encoders[0],
 					    output->scaled_width,
 					    output->scaled_height);
 }
 
+void obs_output_set_video_encoder(obs_output_t *output, obs_encoder_t *encoder)
+{
+	obs_output_set_video_encoder2(output, encoder, 0);
+}
+
 void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder,
 				  size_t idx)
 {
@@ -868,11 +889,28 @@ void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder,
 	output->audio_encoders[idx] = encoder;
 }
 
+obs_encoder_t *obs_output_get_video_encoder2(const obs_output_t *output,
+					    size_t idx)
+{
+	if (!obs_output_valid(output, "obs_output_get_video_encoder2"))
+		return NULL;
+
+	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK_VIDEO) != 0) {
+		if (idx >= MAX_OUTPUT_VIDEO_ENCODERS) {
+			return NULL;
+		}
+	} else {
+		if (idx > 0) {
+			return NULL;
+		}
+	}
+
+	return output->video_encoders[idx];
+}
+
 obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output)
 {
-	return obs_output_valid(output, "obs_output_get_video_encoder")
-		       ? output->video_encoder
-		       : NULL;
+	return obs_output_get_video_encoder2(output, 0);
 }
 
 obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
@@ -975,8 +1013,8 @@ void obs_output_set_preferred_size(obs_output_t *output, uint32_t width,
 	output->scaled_height = height;
 
 	if (output->info.flags & OBS_OUTPUT_ENCODED) {
-		if (output->video_encoder)
-			obs_encoder_set_scaled_size(output->video_encoder,
+		if (output->video_encoders[0])
+			obs_encoder_set_scaled_size(output->video_encoders[0],
 						    width, height);
 	}
 }
@@ -989,7 +1027,7 @@ uint32_t obs_output_get_width(const obs_output_t *output)
 		return 0;
 
 	if (output->info.flags & OBS_OUTPUT_ENCODED)
-		return obs_encoder_get_width(output->video_encoder);
+		return obs_encoder_get_width(output->video_encoders[0]);
 	else
 		return output->scaled_width != 0
 			       ? output->scaled_width
@@ -1004,7 +1042,7 @@ uint32_t obs_output_get_height(const obs_output_t *output)
 		return 0;
 
 	if (output->info.flags & OBS_OUTPUT_ENCODED)
-		return obs_encoder_get_height(output->video_encoder);
+		return obs_encoder_get_height(output->video_encoders[0]);
 	else
 		return output->scaled_height != 0
 			       ? output->scaled_height
@@ -1053,6 +1091,24 @@ static inline size_t num_audio_mixes(const struct obs_output *output)
 	return mix_count;
 }
 
+static inline size_t num_video_tracks(const struct obs_output *output)
+{
+	size_t track_count = 1;
+
+	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK_VIDEO) != 0) {
+		track_count = 0;
+
+		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+			if (!output->video_encoders[i])
+				break;
+
+			track_count++;
+		}
+	}
+
+	return track_count;
+}
+
 static inline bool audio_valid(const struct obs_output *output, bool encoded)
 {
 	if (encoded) {
@@ -1079,7 +1135,7 @@ static bool can_begin_data_capture(const struct obs_output *output,
 {
 	if (has_video) {
 		if (encoded) {
-			if (!output->video_encoder)
+			if (!output->video_encoders[0])
 				return false;
 		} else {
 			if (!output->video)
@@ -1147,6 +1203,16 @@ get_audio_conversion(struct obs_output *output)
 static size_t get_track_index(const struct obs_output *output,
 			      struct encoder_packet *pkt)
 {
+	if (pkt->type == OBS_ENCODER_VIDEO) {
+		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+			if (pkt->encoder == output->video_encoders[i])
+				return i;
+		}
+
+		assert(false);
+		return 0;
+	}
+
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
 		struct obs_encoder *encoder = output->audio_encoders[i];
 
@@ -1162,7 +1228,12 @@ static inline void check_received(struct obs_output *output,
 				  struct encoder_packet *out)
 {
 	if (out->type == OBS_ENCODER_VIDEO) {
-		if (!output->received_video)
+		uint32_t all_tracks = (1U << num_video_tracks(output)) - 1;
+
+		/* with multiple renditions, video only counts as received
+		 * once every track has delivered its first keyframe */
+		output->received_video_tracks |= 1U << out->track_idx;
+		if ((output->received_video_tracks & all_tracks) == all_tracks)
 			output->received_video = true;
 	} else {
 		if (!output->received_audio)
@@ -1180,7 +1251,7 @@ static inline void apply_interleaved_packet_offset(struct obs_output *output,
 	 * current dts as offset and subtract that value from the dts/pts
 	 * of the output packet. */
 	offset = (out->type == OBS_ENCODER_VIDEO)
-			 ? output->video_offset
+			 ? output->video_offsets[out->track_idx]
 			 : output->audio_offsets[out->track_idx];
 
 	out->dts -= offset;
@@ -1200,8 +1271,14 @@ static inline bool has_higher_opposing_ts(struct obs_output *output,
 {
 	if (packet->type == OBS_ENCODER_VIDEO)
 		return output->highest_audio_ts > packet->dts_usec;
-	else
-		return output->highest_video_ts > packet->dts_usec;
+
+	/* audio has to wait for every video track */
+	for (size_t i = 0; i < num_video_tracks(output); i++) {
+		if (output->highest_video_ts[i] <= packet->dts_usec)
+			return false;
+	}
+
+	return true;
 }
 
 static const uint8_t nal_start[4] = {0, 0, 0, 1};
@@ -1354,8 +1431,9 @@ static inline void set_higher_ts(struct obs_output *output,
 				 struct encoder_packet *packet)
 {
 	if (packet->type == OBS_ENCODER_VIDEO) {
-		if (output->highest_video_ts < packet->dts_usec)
-			output->highest_video_ts = packet->dts_usec;
+		int64_t *highest = &output->highest_video_ts[packet->track_idx];
+		if (*highest < packet->dts_usec)
+			*highest = packet->dts_usec;
 	} else {
 		if (output->highest_audio_ts < packet->dts_usec)
 			output->highest_audio_ts = packet->dts_usec;
@@ -1364,10 +1442,10 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
+		       size_t track_idx);
 static int find_first_packet_type_idx(struct obs_output *output,
 				      enum obs_encoder_type type,
-				      size_t audio_idx);
+				      size_t track_idx);
 
 /* gets the point where audio and video are closest together */
 static size_t get_interleaved_start_idx(struct obs_output *output)
@@ -1383,8 +1461,10 @@ static size_t get_interleaved_start_idx(struct obs_output *output)
 			&output->interleaved_packets.array[i];
 		int64_t diff;
 
+		/* never start past the first packet of any video track, it
+		 * is that track's starting keyframe */
 		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
+			if (video_idx == DARRAY_INVALID)
 				video_idx = i;
 			continue;
 		}
@@ -1401,6 +1481,7 @@ static size_t get_interleaved_start_idx(struct obs_output *output)
 
 static int prune_premature_packets(struct obs_output *output)
 {
+	size_t video_tracks = num_video_tracks(output);
 	size_t audio_mixes = num_audio_mixes(output);
 	struct encoder_packet *video;
 	int video_idx;
@@ -1412,6 +1493,7 @@ static int prune_premature_packets(struct obs_output *output)
 	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
 	if (video_idx == -1) {
 		output->received_video = false;
+		output->received_video_tracks &= ~1U;
 		return -1;
 	}
 
@@ -1419,6 +1501,15 @@ static int prune_premature_packets(struct obs_output *output)
 	video = &output->interleaved_packets.array[video_idx];
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
+	/* pruning drops the first packet of every video track, so the
+	 * tracks then wait for their next keyframes together */
+	for (size_t i = 1; i < video_tracks; i++) {
+		int idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO,
+						     i);
+		if (idx > max_idx)
+			max_idx = idx;
+	}
+
 	for (size_t i = 0; i < audio_mixes; i++) {
 		struct encoder_packet *audio;
 		int audio_idx;
@@ -1453,6 +1544,44 @@ static void discard_to_idx(struct obs_output *output, size_t idx)
 	da_erase_range(output->interleaved_packets, 0, idx);
 }
 
+static void discard_video_track(struct obs_output *output, size_t track_idx)
+{
+	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
+		struct encoder_packet *packet =
+			&output->interleaved_packets.array[i - 1];
+
+		if (packet->type == OBS_ENCODER_VIDEO &&
+		    packet->track_idx == track_idx) {
+			obs_encoder_packet_release(packet);
+			da_erase(output->interleaved_packets, i - 1);
+		}
+	}
+}
+
+/* a video track that no longer starts on a keyframe after pruning has its
+ * packets dropped and waits for its next keyframe, returns false if any
+ * track has to wait */
+static bool video_tracks_start_on_keyframes(struct obs_output *output)
+{
+	size_t video_tracks = num_video_tracks(output);
+	bool ready = true;
+
+	for (size_t i = 0; i < video_tracks; i++) {
+		struct encoder_packet *first =
+			find_first_packet_type(output, OBS_ENCODER_VIDEO, i);
+
+		if (first && first->keyframe)
+			continue;
+
+		discard_video_track(output, i);
+		output->received_video_tracks &= ~(1U << i);
+		output->received_video = false;
+		ready = false;
+	}
+
+	return ready;
+}
+
 #define DEBUG_STARTING_PACKETS 0
 
 static bool prune_interleaved_packets(struct obs_output *output)
@@ -1483,20 +1612,22 @@ static bool prune_interleaved_packets(struct obs_output *output)
 	if (start_idx)
 		discard_to_idx(output, start_idx);
 
+	if (num_video_tracks(output) > 1)
+		return video_tracks_start_on_keyframes(output);
+
 	return true;
 }
 
 static int find_first_packet_type_idx(struct obs_output *output,
 				      enum obs_encoder_type type,
-				      size_t audio_idx)
+				      size_t track_idx)
 {
 	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
 		struct encoder_packet *packet =
 			&output->interleaved_packets.array[i];
 
 		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
+			if (packet->track_idx != track_idx) {
 				continue;
 			}
 
@@ -1509,15 +1640,14 @@ static int find_first_packet_type_idx(struct obs_output *output,
 
 static int find_last_packet_type_idx(struct obs_output *output,
 				     enum obs_encoder_type type,
-				     size_t audio_idx)
+				     size_t track_idx)
 {
 	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
 		struct encoder_packet *packet =
 			&output->interleaved_packets.array[i - 1];
 
 		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
+			if (packet->track_idx != track_idx) {
 				continue;
 			}
 
@@ -1530,28 +1660,37 @@ static int find_last_packet_type_idx(struct obs_output *output,
 
 static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
+		       size_t track_idx)
 {
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
+	int idx = find_first_packet_type_idx(output, type, track_idx);
 	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
 }
 
 static inline struct encoder_packet *
 find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
+		      size_t track_idx)
 {
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
+	int idx = find_last_packet_type_idx(output, type, track_idx);
 	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
 }
 
 static bool get_audio_and_video_packets(struct obs_output *output,
 					struct encoder_packet **video,
 					struct encoder_packet **audio,
+					size_t video_tracks,
 					size_t audio_mixes)
 {
-	*video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	if (!*video)
-		output->received_video = false;
+	bool have_video = true;
+
+	for (size_t i = 0; i < video_tracks; i++) {
+		video[i] = find_first_packet_type(output, OBS_ENCODER_VIDEO, i);
+		if (!video[i]) {
+			output->received_video = false;
+			output->received_video_tracks = 0;
+			have_video = false;
+			break;
+		}
+	}
 
 	for (size_t i = 0; i < audio_mixes; i++) {
 		audio[i] = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
@@ -1561,22 +1700,33 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 		}
 	}
 
-	if (!*video) {
-		return false;
-	}
+	return have_video;
+}
 
-	return true;
+/* converts a timestamp in the timebase of one packet to that of another */
+static inline int64_t convert_packet_timebase(int64_t ts,
+					      const struct encoder_packet *from,
+					      const struct encoder_packet *to)
+{
+	if (from->timebase_num == to->timebase_num &&
+	    from->timebase_den == to->timebase_den)
+		return ts;
+
+	return ts * from->timebase_num * to->timebase_den /
+	       ((int64_t)from->timebase_den * to->timebase_num);
 }
 
 static bool initialize_interleaved_packets(struct obs_output *output)
 {
-	struct encoder_packet *video;
+	struct encoder_packet *video[MAX_OUTPUT_VIDEO_ENCODERS];
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
+	size_t video_tracks = num_video_tracks(output);
 	size_t audio_mixes = num_audio_mixes(output);
 	size_t start_idx;
 
-	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
+	if (!get_audio_and_video_packets(output, video, audio, video_tracks,
+					 audio_mixes))
 		return false;
 
 	for (size_t i = 0; i < audio_mixes; i++)
@@ -1585,7 +1735,7 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 
 	/* ensure that there is audio past the first video packet */
 	for (size_t i = 0; i < audio_mixes; i++) {
-		if (last_audio[i]->dts_usec < video->dts_usec) {
+		if (last_audio[i]->dts_usec < video[0]->dts_usec) {
 			output->received_audio = false;
 			return false;
 		}
@@ -1595,18 +1745,22 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	start_idx = get_interleaved_start_idx(output);
 	if (start_idx) {
 		discard_to_idx(output, start_idx);
-		if (!get_audio_and_video_packets(output, &video, audio,
-						 audio_mixes))
+		if (!get_audio_and_video_packets(output, video, audio,
+						 video_tracks, audio_mixes))
 			return false;
 	}
 
-	/* get new offsets */
-	output->video_offset = video->pts;
+	/* get new offsets.  every video track shares track 0's zero point so
+	 * the renditions stay in sync with each other */
+	for (size_t i = 0; i < video_tracks; i++)
+		output->video_offsets[i] =
+			convert_packet_timebase(video[0]->pts, video[0],
+						video[i]);
 	for (size_t i = 0; i < audio_mixes; i++)
 		output->audio_offsets[i] = audio[i]->dts;
 
 #if DEBUG_STARTING_PACKETS == 1
-	int64_t v = video->dts_usec;
+	int64_t v = video[0]->dts_usec;
 	int64_t a = audio[0]->dts_usec;
 	int64_t diff = v - a;
 
@@ -1618,7 +1772,8 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 
 	/* subtract offsets from highest TS offset variables */
 	output->highest_audio_ts -= audio[0]->dts_usec;
-	output->highest_video_ts -= video->dts_usec;
+	for (size_t i = 0; i < video_tracks; i++)
+		output->highest_video_ts[i] -= video[0]->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
 	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
@@ -1663,6 +1818,17 @@ static void resort_interleaved_packets(struct obs_output *output)
 	da_free(old_array);
 }
 
+/* outputs with a single video track go by received_video alone, like they
+ * always have */
+static inline bool video_track_received(const struct obs_output *output,
+					size_t track_idx)
+{
+	if (num_video_tracks(output) == 1)
+		return output->received_video;
+
+	return (output->received_video_tracks & (1U << track_idx)) != 0;
+}
+
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
@@ -1674,6 +1840,10 @@ static void discard_unused_audio_packets(struct obs_output *output,
 
 		if (p->dts_usec >= dts_usec)
 			break;
+
+		/* other video tracks may already hold their keyframes */
+		if (p->type == OBS_ENCODER_VIDEO && num_video_tracks(output) > 1)
+			break;
 	}
 
 	if (idx)
@@ -1689,14 +1859,13 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (!active(output))
 		return;
 
-	if (packet->type == OBS_ENCODER_AUDIO)
-		packet->track_idx = get_track_index(output, packet);
+	packet->track_idx = get_track_index(output, packet);
 
 	pthread_mutex_lock(&output->interleaved_mutex);
 
 	/* if first video frame is not a keyframe, discard until received */
-	if (!output->received_video && packet->type == OBS_ENCODER_VIDEO &&
-	    !packet->keyframe) {
+	if (packet->type == OBS_ENCODER_VIDEO && !packet->keyframe &&
+	    !video_track_received(output, packet->track_idx)) {
 		discard_unused_audio_packets(output, packet->dts_usec);
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
@@ -1743,12 +1912,11 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 	struct obs_output *output = param;
 
 	if (data_active(output)) {
-		if (packet->type == OBS_ENCODER_AUDIO)
-			packet->track_idx = get_track_index(output, packet);
+		packet->track_idx = get_track_index(output, packet);
 
 		output->info.encoded_packet(output->context.data, packet);
 
-		if (packet->type == OBS_ENCODER_VIDEO)
+		if (packet->type == OBS_ENCODER_VIDEO && packet->track_idx == 0)
 			output->total_frames++;
 	}
 
@@ -1863,6 +2031,17 @@ static void default_raw_audio_callback(void *param, size_t mix_idx,
 	}
 }
 
+static inline void start_video_encoders(struct obs_output *output,
+					encoded_callback_t encoded_callback)
+{
+	size_t num_tracks = num_video_tracks(output);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		obs_encoder_start(output->video_encoders[i], encoded_callback,
+				  output);
+	}
+}
+
 static inline void start_audio_encoders(struct obs_output *output,
 					encoded_callback_t encoded_callback)
 {
@@ -1896,9 +2075,13 @@ static void reset_packet_data(obs_output_t *output)
 {
 	output->received_audio = false;
 	output->received_video = false;
+	output->received_video_tracks = 0;
 	output->highest_audio_ts = 0;
-	output->highest_video_ts = 0;
-	output->video_offset = 0;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		output->highest_video_ts[i] = 0;
+		output->video_offsets[i] = 0;
+	}
 
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 		output->audio_offsets[i] = 0;
@@ -1943,8 +2126,7 @@ static void hook_data_capture(struct obs_output *output, bool encoded,
 		if (has_audio)
 			start_audio_encoders(output, encoded_callback);
 		if (has_video)
-			obs_encoder_start(output->video_encoder,
-					  encoded_callback, output);
+			start_video_encoders(output, encoded_callback);
 	} else {
 		if (has_video)
 			start_raw_video(output->video,
@@ -2029,6 +2211,22 @@ bool obs_output_can_begin_data_capture(const obs_output_t *output,
 				      has_service);
 }
 
+static inline bool initialize_video_encoders(obs_output_t *output)
+{
+	size_t num_tracks = num_video_tracks(output);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (!obs_encoder_initialize(output->video_encoders[i])) {
+			obs_output_set_last_error(
+				output, obs_encoder_get_last_error(
+						output->video_encoders[i]));
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static inline bool initialize_audio_encoders(obs_output_t *output,
 					     size_t num_mixes)
 {
@@ -2059,7 +2257,7 @@ static inline obs_encoder_t *find_inactive_audio_encoder(obs_output_t *output,
 
 static inline void pair_encoders(obs_output_t *output, size_t num_mixes)
 {
-	struct obs_encoder *video = output->video_encoder;
+	struct obs_encoder *video = output->video_encoders[0];
 	struct obs_encoder *audio =
 		find_inactive_audio_encoder(output, num_mixes);
 
@@ -2096,12 +2294,8 @@ bool obs_output_initialize_encoders(obs_output_t *output, uint32_t flags)
 
 	if (!encoded)
 		return false;
-	if (has_video && !obs_encoder_initialize(output->video_encoder)) {
-		obs_output_set_last_error(
-			output,
-			obs_encoder_get_last_error(output->video_encoder));
+	if (has_video && !initialize_video_encoders(output))
 		return false;
-	}
 	if (has_audio && !initialize_audio_encoders(output, num_mixes))
 		return false;
 
@@ -2217,6 +2411,17 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 	return true;
 }
 
+static inline void stop_video_encoders(obs_output_t *output,
+				       encoded_callback_t encoded_callback)
+{
+	size_t num_tracks = num_video_tracks(output);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		obs_encoder_stop(output->video_encoders[i], encoded_callback,
+				 output);
+	}
+}
+
 static inline void stop_audio_encoders(obs_output_t *output,
 				       encoded_callback_t encoded_callback)
 {
@@ -2262,8 +2467,7 @@ static void *end_data_capture_thread(void *data)
 						   : default_encoded_callback;
 
 		if (has_video)
-			obs_encoder_stop(output->video_encoder,
-					 encoded_callback, output);
+			stop_video_encoders(output, encoded_callback);
 		if (has_audio)
 			stop_audio_encoders(output, encoded_callback);
 	} else {
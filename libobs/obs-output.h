@@ -28,6 +28,9 @@ extern "C" {
 #define OBS_OUTPUT_SERVICE (1 << 3)
 #define OBS_OUTPUT_MULTI_TRACK (1 << 4)
 #define OBS_OUTPUT_CAN_PAUSE (1 << 5)
+#define OBS_OUTPUT_MULTI_TRACK_VIDEO (1 << 6)
+
+#define MAX_OUTPUT_VIDEO_ENCODERS 6
 
 struct encoder_packet;
 
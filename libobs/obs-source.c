@@ -241,6 +241,7 @@ static void obs_source_init_finalize(struct obs_source *source)
 
 	obs_context_data_insert(&source->context, &obs->data.sources_mutex,
 				&obs->data.first_source);
+	os_atomic_set_bool(&obs->data.sources_changed, true);
 }
 
 static bool obs_source_hotkey_mute(void *data, obs_hotkey_pair_id id,
@@ -603,10 +604,41 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
-static inline void obs_source_frame_decref(struct obs_source_frame *frame)
+static size_t find_external_frame(const struct obs_source *source,
+				  const struct obs_source_frame *frame)
 {
-	if (os_atomic_dec_long(&frame->refs) == 0)
+	for (size_t i = 0; i < source->async_external_frames.num; i++) {
+		if (source->async_external_frames.array[i].frame == frame)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+/* call with async_mutex held.  frees a frame once its last reference is
+ * gone, handing external planes back to their owner instead */
+static void destroy_async_frame(struct obs_source *source,
+				struct obs_source_frame *frame)
+{
+	size_t idx = find_external_frame(source, frame);
+
+	if (idx != DARRAY_INVALID) {
+		struct async_external_frame ext =
+			source->async_external_frames.array[idx];
+
+		da_erase(source->async_external_frames, idx);
+		bfree(frame);
+		ext.release(ext.param);
+	} else {
 		obs_source_frame_destroy(frame);
+	}
+}
+
+static inline void obs_source_frame_decref(struct obs_source *source,
+					   struct obs_source_frame *frame)
+{
+	if (os_atomic_dec_long(&frame->refs) == 0)
+		destroy_async_frame(source, frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -638,6 +670,7 @@ void obs_source_destroy(struct obs_source *source)
 		obs_source_filter_remove(source, source->filters.array[0]);
 
 	obs_context_data_remove(&source->context);
+	os_atomic_set_bool(&obs->data.sources_changed, true);
 
 	blog(LOG_DEBUG, "%ssource '%s' destroyed",
 	     source->context.private ? "private " : "", source->context.name);
@@ -656,7 +689,8 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
 	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+					source->async_cache.array[i].frame);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -688,6 +722,7 @@ void obs_source_destroy(struct obs_source *source)
 	da_free(source->audio_cb_list);
 	da_free(source->caption_cb_list);
 	da_free(source->async_cache);
+	da_free(source->async_external_frames);
 	da_free(source->async_frames);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
@@ -2786,21 +2821,24 @@ void obs_source_frame_copy(struct obs_source_frame *dst,
 }
 
 static inline bool async_texture_changed(struct obs_source *source,
-					 const struct obs_source_frame *frame)
+					 enum video_format format,
+					 bool full_range, uint32_t width,
+					 uint32_t height)
 {
 	enum convert_type prev, cur;
 	prev = get_convert_type(source->async_cache_format,
 				source->async_cache_full_range);
-	cur = get_convert_type(frame->format, frame->full_range);
+	cur = get_convert_type(format, full_range);
 
-	return source->async_cache_width != frame->width ||
-	       source->async_cache_height != frame->height || prev != cur;
+	return source->async_cache_width != width ||
+	       source->async_cache_height != height || prev != cur;
 }
 
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+					source->async_cache.array[i].frame);
 
 	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
@@ -2818,38 +2856,55 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				destroy_async_frame(source, af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
 	}
 }
 
+static bool async_cache_contains(const struct obs_source *source,
+				 const struct obs_source_frame *frame)
+{
+	for (size_t i = 0; i < source->async_cache.num; i++) {
+		if (source->async_cache.array[i].frame == frame)
+			return true;
+	}
+
+	return false;
+}
+
 #define MAX_ASYNC_FRAMES 30
-//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+
+/* drops every queued frame but keeps their allocations for reuse */
+static void drop_async_frames(struct obs_source *source)
 {
-	struct obs_source_frame *new_frame = NULL;
+	for (size_t i = 0; i < source->async_frames.num; i++)
+		remove_async_frame(source, source->async_frames.array[i]);
 
-	pthread_mutex_lock(&source->async_mutex);
+	da_resize(source->async_frames, 0);
+	source->last_frame_ts = 0;
+}
 
-	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
-		free_async_cache(source);
-		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
-	}
+/* call with async_mutex held.  returns a cache frame with an extra reference
+ * for the caller, and resets the cache if the frame size or format changed */
+static struct obs_source_frame *
+get_cache_frame(struct obs_source *source, enum video_format format,
+		bool full_range, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *new_frame = NULL;
 
-	if (async_texture_changed(source, frame)) {
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES)
+		drop_async_frames(source);
+
+	if (async_texture_changed(source, format, full_range, width, height)) {
 		free_async_cache(source);
-		source->async_cache_width = frame->width;
-		source->async_cache_height = frame->height;
+		source->async_cache_width = width;
+		source->async_cache_height = height;
 	}
 
-	const enum video_format format = frame->format;
 	source->async_cache_format = format;
-	source->async_cache_full_range = frame->full_range;
+	source->async_cache_full_range = full_range;
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
@@ -2867,8 +2922,7 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
+		new_frame = obs_source_frame_create(format, width, height);
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -2878,7 +2932,18 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	}
 
 	os_atomic_inc_long(&new_frame->refs);
+	return new_frame;
+}
+
+//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
+static inline struct obs_source_frame *
+cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame;
 
+	pthread_mutex_lock(&source->async_mutex);
+	new_frame = get_cache_frame(source, frame->format, frame->full_range,
+				    frame->width, frame->height);
 	pthread_mutex_unlock(&source->async_mutex);
 
 	copy_frame_data(new_frame, frame);
@@ -2886,6 +2951,20 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	return new_frame;
 }
 
+/* hands the caller's reference on a cache frame over to the frame queue */
+static void queue_cache_frame(struct obs_source *source,
+			      struct obs_source_frame *output)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (os_atomic_dec_long(&output->refs) == 0) {
+		obs_source_frame_destroy(output);
+	} else {
+		da_push_back(source->async_frames, &output);
+		source->async_active = true;
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 static void
 obs_source_output_video_internal(obs_source_t *source,
 				 const struct obs_source_frame *frame)
@@ -2899,19 +2978,7 @@ obs_source_output_video_internal(obs_source_t *source,
 	}
 
 	struct obs_source_frame *output = cache_video(source, frame);
-
-	/* ------------------------------------------- */
-	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
-	}
-	pthread_mutex_unlock(&source->async_mutex);
+	queue_cache_frame(source, output);
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -2963,6 +3030,123 @@ void obs_source_output_video2(obs_source_t *source,
 	obs_source_output_video_internal(source, &new_frame);
 }
 
+struct obs_source_frame *obs_source_alloc_frame(obs_source_t *source,
+					       enum video_format format,
+					       uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+
+	if (!obs_source_valid(source, "obs_source_alloc_frame"))
+		return NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+	frame = get_cache_frame(source, format,
+				source->async_cache_full_range, width, height);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	frame->timestamp = 0;
+	frame->flip = false;
+	return frame;
+}
+
+void obs_source_output_frame(obs_source_t *source,
+			     struct obs_source_frame *frame)
+{
+	if (!obs_source_valid(source, "obs_source_output_frame"))
+		return;
+	if (!obs_ptr_valid(frame, "obs_source_output_frame"))
+		return;
+
+	if (!format_is_yuv(frame->format))
+		frame->full_range = true;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	/* the frame was allocated for the cache's previous range, and the
+	 * cache may have been reset for another size since, so reset it like
+	 * get_cache_frame would and make sure this frame is part of it */
+	if (async_texture_changed(source, frame->format, frame->full_range,
+				  frame->width, frame->height)) {
+		free_async_cache(source);
+		source->async_cache_width = frame->width;
+		source->async_cache_height = frame->height;
+	}
+
+	source->async_cache_format = frame->format;
+	source->async_cache_full_range = frame->full_range;
+
+	if (!async_cache_contains(source, frame)) {
+		struct async_frame af;
+
+		af.frame = frame;
+		af.used = true;
+		af.unused_count = 0;
+		os_atomic_inc_long(&frame->refs);
+
+		da_push_back(source->async_cache, &af);
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	queue_cache_frame(source, frame);
+}
+
+void obs_source_output_video_external(obs_source_t *source,
+				      const struct obs_source_frame *frame,
+				      obs_source_frame_release_t release,
+				      void *param)
+{
+	struct obs_source_frame *output;
+	struct async_external_frame ext;
+	struct async_frame af;
+
+	if (!obs_source_valid(source, "obs_source_output_video_external"))
+		return;
+	if (!obs_ptr_valid(frame, "obs_source_output_video_external") ||
+	    !obs_ptr_valid(release, "obs_source_output_video_external"))
+		return;
+
+	output = bmalloc(sizeof(*output));
+	*output = *frame;
+	output->full_range =
+		format_is_yuv(frame->format) ? frame->full_range : true;
+	output->prev_frame = false;
+	output->refs = 1;
+
+	ext.frame = output;
+	ext.release = release;
+	ext.param = param;
+
+	/* external frames are kept in the cache while they are in use so the
+	 * existing frame lifetime rules apply, but are released rather than
+	 * reused once libobs is done with them */
+	af.frame = output;
+	af.used = true;
+	af.unused_count = 0;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES)
+		drop_async_frames(source);
+
+	if (async_texture_changed(source, output->format, output->full_range,
+				  output->width, output->height)) {
+		free_async_cache(source);
+		source->async_cache_width = output->width;
+		source->async_cache_height = output->height;
+	}
+
+	source->async_cache_format = output->format;
+	source->async_cache_full_range = output->full_range;
+
+	da_push_back(source->async_cache, &af);
+	da_push_back(source->async_external_frames, &ext);
+	da_push_back(source->async_frames, &output);
+	source->async_active = true;
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 {
 	if (source)
@@ -3415,7 +3599,13 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			if (find_external_frame(source, frame) !=
+			    DARRAY_INVALID) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(source, frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -3571,7 +3761,7 @@ void obs_source_release_frame(obs_source_t *source,
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			destroy_async_frame(source, frame);
 		else
 			remove_async_frame(source, frame);
 
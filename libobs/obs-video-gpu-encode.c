@@ -72,6 +72,7 @@ static void *gpu_encode_thread(void *unused)
 			struct encoder_packet pkt = {0};
 			bool received = false;
 			bool success;
+			uint64_t start;
 
 			obs_encoder_t *encoder = encoders.array[i];
 			struct obs_encoder *pair = encoder->paired_encoder;
@@ -90,6 +91,15 @@ static void *gpu_encode_thread(void *unused)
 			if (video_pause_check(&encoder->pause, timestamp))
 				continue;
 
+			/* frames skipped by the divisor are never handed to
+			 * the encoder */
+			bool skip = encoder->frame_rate_divisor_counter != 0;
+			if (++encoder->frame_rate_divisor_counter ==
+			    encoder->frame_rate_divisor)
+				encoder->frame_rate_divisor_counter = 0;
+			if (skip)
+				continue;
+
 			if (!encoder->start_ts)
 				encoder->start_ts = timestamp;
 
@@ -98,10 +108,14 @@ static void *gpu_encode_thread(void *unused)
 			else
 				next_key++;
 
+			start = os_gettime_ns();
 			success = encoder->info.encode_texture(
 				encoder->context.data, tf.handle,
 				encoder->cur_pts, lock_key, &next_key, &pkt,
 				&received);
+			if (success && received)
+				encoder_record_frame_stats(
+					encoder, &pkt, os_gettime_ns() - start);
 			send_off_encoder_packet(encoder, success, received,
 						&pkt);
 
@@ -29,10 +29,41 @@
 #include <windows.h>
 #endif
 
+/* rebuilds the graphics thread's array of sources to tick after sources have
+ * been created or destroyed.  the source list lock is only tried, so if it's
+ * busy the old array is used for another frame instead of stalling. */
+static void update_tick_sources(struct obs_core_data *data)
+{
+	DARRAY(obs_weak_source_t *) new_sources;
+	struct obs_source *source;
+
+	if (!os_atomic_load_bool(&data->sources_changed))
+		return;
+	if (pthread_mutex_trylock(&data->sources_mutex) != 0)
+		return;
+
+	os_atomic_set_bool(&data->sources_changed, false);
+
+	da_init(new_sources);
+	da_reserve(new_sources, data->tick_sources.num);
+
+	source = data->first_source;
+	while (source) {
+		obs_weak_source_t *weak = obs_source_get_weak_source(source);
+		da_push_back(new_sources, &weak);
+		source = (struct obs_source *)source->context.next;
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	for (size_t i = 0; i < data->tick_sources.num; i++)
+		obs_weak_source_release(data->tick_sources.array[i]);
+	da_move(data->tick_sources, new_sources);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
-	struct obs_source *source;
 	uint64_t delta_time;
 	float seconds;
 
@@ -59,21 +90,18 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	/* ------------------------------------- */
 	/* call the tick function of each source */
 
-	pthread_mutex_lock(&data->sources_mutex);
+	update_tick_sources(data);
 
-	source = data->first_source;
-	while (source) {
-		struct obs_source *cur_source = obs_source_get_ref(source);
-		source = (struct obs_source *)source->context.next;
+	for (size_t i = 0; i < data->tick_sources.num; i++) {
+		obs_weak_source_t *weak = data->tick_sources.array[i];
+		struct obs_source *source = obs_weak_source_get_source(weak);
 
-		if (cur_source) {
-			obs_source_video_tick(cur_source, seconds);
-			obs_source_release(cur_source);
+		if (source) {
+			obs_source_video_tick(source, seconds);
+			obs_source_release(source);
 		}
 	}
 
-	pthread_mutex_unlock(&data->sources_mutex);
-
 	return cur_time;
 }
 
@@ -112,16 +140,51 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+/* moving average over roughly the last 16 frames */
+static inline void update_phase_time(struct obs_core_video *video,
+				     enum obs_video_phase phase,
+				     uint64_t start_ns)
+{
+	uint64_t cost = os_gettime_ns() - start_ns;
+	uint64_t *avg = &video->phase_time_ns[phase];
+
+	*avg = *avg - *avg / 16 + cost / 16;
+}
+
+static inline void unmap_readback_texture(struct obs_core_video *video,
+					  int texture)
 {
 	for (int c = 0; c < NUM_CHANNELS; ++c) {
-		if (video->mapped_surfaces[c]) {
-			gs_stagesurface_unmap(video->mapped_surfaces[c]);
-			video->mapped_surfaces[c] = NULL;
-		}
+		gs_stagesurf_t *surface = video->copy_surfaces[texture][c];
+		if (surface)
+			gs_stagesurface_unmap(surface);
+	}
+
+	video->textures_mapped[texture] = false;
+	video->textures_copied[texture] = false;
+	os_atomic_set_bool(&video->textures_downloaded[texture], false);
+}
+
+/* unmaps the surfaces the download thread is done with */
+static inline void unmap_downloaded_textures(struct obs_core_video *video)
+{
+	for (int i = 0; i < video->readback_depth; i++) {
+		if (video->textures_mapped[i] &&
+		    os_atomic_load_bool(&video->textures_downloaded[i]))
+			unmap_readback_texture(video, i);
+	}
+}
+
+void obs_unmap_readback_surfaces(struct obs_core_video *video)
+{
+	for (int i = 0; i < video->readback_depth; i++) {
+		if (video->textures_mapped[i])
+			unmap_readback_texture(video, i);
 	}
 }
 
+static bool queue_readback_texture(struct obs_core_video *video, int texture);
+
 static const char *render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video *video)
 {
@@ -361,7 +424,21 @@ static inline void stage_output_texture(struct obs_core_video *video,
 {
 	profile_start(stage_output_texture_name);
 
-	unmap_last_surface(video);
+	/* the ring is full: the oldest frame has to be read back before its
+	 * surfaces can be reused, even if that means waiting on the gpu or on
+	 * the download thread */
+	if (video->textures_copied[cur_texture] &&
+	    !video->textures_mapped[cur_texture]) {
+		video->readback_stalls++;
+		queue_readback_texture(video, cur_texture);
+	}
+
+	while (video->textures_mapped[cur_texture] &&
+	       !os_atomic_load_bool(&video->textures_downloaded[cur_texture]))
+		os_event_wait(video->download_done);
+
+	if (video->textures_mapped[cur_texture])
+		unmap_readback_texture(video, cur_texture);
 
 	if (!video->gpu_conversion) {
 		gs_stagesurf_t *copy = video->copy_surfaces[cur_texture][0];
@@ -381,6 +458,9 @@ static inline void stage_output_texture(struct obs_core_video *video,
 		video->textures_copied[cur_texture] = true;
 	}
 
+	if (video->textures_copied[cur_texture])
+		video->textures_staged_ts[cur_texture] = os_gettime_ns();
+
 	profile_end(stage_output_texture_name);
 }
 
@@ -480,6 +560,8 @@ end:
 static inline void render_video(struct obs_core_video *video, bool raw_active,
 				const bool gpu_active, int cur_texture)
 {
+	uint64_t start = os_gettime_ns();
+
 	gs_begin_scene();
 
 	gs_enable_depth_test(false);
@@ -490,6 +572,9 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 	if (raw_active || gpu_active) {
 		gs_texture_t *texture = render_output_texture(video);
 
+		update_phase_time(video, OBS_VIDEO_PHASE_RENDER, start);
+		start = os_gettime_ns();
+
 #ifdef _WIN32
 		if (gpu_active)
 			gs_flush();
@@ -507,6 +592,10 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 
 		if (raw_active)
 			stage_output_texture(video, cur_texture);
+
+		update_phase_time(video, OBS_VIDEO_PHASE_CONVERT, start);
+	} else {
+		update_phase_time(video, OBS_VIDEO_PHASE_RENDER, start);
 	}
 
 	gs_set_render_target(NULL, NULL);
@@ -515,26 +604,79 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 	gs_end_scene();
 }
 
-static inline bool download_frame(struct obs_core_video *video,
-				  int prev_texture, struct video_data *frame)
+static inline bool readback_texture_ready(struct obs_core_video *video,
+					  int texture)
 {
-	if (!video->textures_copied[prev_texture])
-		return false;
-
 	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
 		gs_stagesurf_t *surface =
-			video->copy_surfaces[prev_texture][channel];
-		if (surface) {
-			if (!gs_stagesurface_map(surface, &frame->data[channel],
-						 &frame->linesize[channel]))
-				return false;
+			video->copy_surfaces[texture][channel];
+		if (surface && !gs_stagesurface_ready(surface))
+			return false;
+	}
+
+	return true;
+}
+
+/* maps a staged texture and hands it to the download thread */
+static bool queue_readback_texture(struct obs_core_video *video, int texture)
+{
+	struct obs_readback_frame rf = {.texture = texture};
+	struct obs_vframe_info vframe_info = {0};
 
-			video->mapped_surfaces[channel] = surface;
+	if (video->vframe_info_buffer.size)
+		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
+				    sizeof(vframe_info));
+
+	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
+		gs_stagesurf_t *surface =
+			video->copy_surfaces[texture][channel];
+		if (!surface)
+			continue;
+
+		if (!gs_stagesurface_map(surface, &rf.frame.data[channel],
+					 &rf.frame.linesize[channel])) {
+			for (int c = 0; c < channel; ++c) {
+				if (video->copy_surfaces[texture][c])
+					gs_stagesurface_unmap(
+						video->copy_surfaces[texture]
+								    [c]);
+			}
+			video->textures_copied[texture] = false;
+			return false;
 		}
 	}
+
+	rf.frame.timestamp = vframe_info.timestamp;
+	rf.count = vframe_info.count;
+
+	video->textures_mapped[texture] = true;
+
+	pthread_mutex_lock(&video->download_mutex);
+	circlebuf_push_back(&video->download_queue, &rf, sizeof(rf));
+	pthread_mutex_unlock(&video->download_mutex);
+
+	os_sem_post(video->download_semaphore);
 	return true;
 }
 
+/* hands every staged texture the gpu has finished to the download thread,
+ * oldest first so frames stay in order */
+static inline void download_frames(struct obs_core_video *video,
+				   int cur_texture)
+{
+	for (int i = 1; i <= video->readback_depth; i++) {
+		int texture = (cur_texture + i) % video->readback_depth;
+
+		if (!video->textures_copied[texture] ||
+		    video->textures_mapped[texture])
+			continue;
+		if (!readback_texture_ready(video, texture))
+			break;
+		if (!queue_readback_texture(video, texture))
+			break;
+	}
+}
+
 static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
 					      uint32_t linesize_input,
 					      uint32_t linesize_output,
@@ -716,13 +858,28 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
+	uint64_t lead = video->render_ahead_ns;
+	uint64_t now = 0;
+	bool on_time;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	/* wake up early enough for the predicted frame cost to finish by the
+	 * frame's deadline rather than starting the frame at the deadline.
+	 * the frame is still stamped with the deadline t, even though it is
+	 * rendered up to lead (at most half an interval) before it, so that
+	 * frame timestamps stay evenly spaced */
+	on_time = os_sleepto_ns(t - lead);
+	if (!on_time) {
+		/* missed the early wakeup, but can still make the deadline */
+		now = os_gettime_ns();
+		on_time = now <= t;
+	}
+
+	if (on_time) {
 		*p_time = t;
 		count = 1;
 	} else {
-		count = (int)((os_gettime_ns() - cur_time) / interval_ns);
+		count = (int)((now - cur_time) / interval_ns);
 		*p_time = cur_time + interval_ns * count;
 	}
 
@@ -740,25 +897,71 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 				    &vframe_info, sizeof(vframe_info));
 }
 
+static const char *download_thread_name = "obs_download_thread";
+static const char *output_video_data_name = "output_video_data";
+void *obs_download_thread(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+
+	UNUSED_PARAMETER(param);
+
+	os_set_thread_name("libobs: download thread");
+
+	const char *profile_name = profile_store_name(
+		obs_get_profiler_name_store(), "%s", download_thread_name);
+	profile_register_root(profile_name, 0);
+
+	while (os_sem_wait(video->download_semaphore) == 0) {
+		struct obs_readback_frame rf;
+
+		if (os_atomic_load_bool(&video->download_stop))
+			break;
+
+		pthread_mutex_lock(&video->download_mutex);
+		circlebuf_pop_front(&video->download_queue, &rf, sizeof(rf));
+		pthread_mutex_unlock(&video->download_mutex);
+
+		uint64_t start = os_gettime_ns();
+
+		profile_start(profile_name);
+		profile_start(output_video_data_name);
+		output_video_data(video, &rf.frame, rf.count);
+		profile_end(output_video_data_name);
+		profile_end(profile_name);
+
+		update_phase_time(video, OBS_VIDEO_PHASE_OUTPUT, start);
+
+		uint64_t latency = os_gettime_ns() -
+				   video->textures_staged_ts[rf.texture];
+		video->readback_frames++;
+		video->readback_latency_total += latency;
+		if (latency > video->readback_latency_max)
+			video->readback_latency_max = latency;
+
+		os_atomic_set_bool(&video->textures_downloaded[rf.texture],
+				   true);
+		os_event_signal(video->download_done);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
 static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
 static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
-static const char *output_frame_output_video_data_name = "output_video_data";
 static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-					    : cur_texture - 1;
-	struct video_data frame;
-	bool frame_ready = 0;
-
-	memset(&frame, 0, sizeof(struct video_data));
 
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	unmap_downloaded_textures(video);
+
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 			      output_frame_render_video_name);
@@ -766,31 +969,24 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	GS_DEBUG_MARKER_END();
 	profile_end(output_frame_render_video_name);
 
-	if (raw_active) {
-		profile_start(output_frame_download_frame_name);
-		frame_ready = download_frame(video, prev_texture, &frame);
-		profile_end(output_frame_download_frame_name);
-	}
-
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
 
-	gs_leave_context();
-	profile_end(output_frame_gs_context_name);
+	if (raw_active) {
+		uint64_t start = os_gettime_ns();
 
-	if (raw_active && frame_ready) {
-		struct obs_vframe_info vframe_info;
-		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
-				    sizeof(vframe_info));
+		profile_start(output_frame_download_frame_name);
+		download_frames(video, cur_texture);
+		profile_end(output_frame_download_frame_name);
 
-		frame.timestamp = vframe_info.timestamp;
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
-		profile_end(output_frame_output_video_data_name);
+		update_phase_time(video, OBS_VIDEO_PHASE_DOWNLOAD, start);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	gs_leave_context();
+	profile_end(output_frame_gs_context_name);
+
+	if (++video->cur_texture == video->readback_depth)
 		video->cur_texture = 0;
 }
 
@@ -808,7 +1004,12 @@ static void clear_base_frame_data(void)
 static void clear_raw_frame_data(void)
 {
 	struct obs_core_video *video = &obs->video;
-	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+
+	/* mapped textures are still owned by the download thread */
+	for (int i = 0; i < video->readback_depth; i++) {
+		if (!video->textures_mapped[i])
+			video->textures_copied[i] = false;
+	}
 	circlebuf_free(&video->vframe_info_buffer);
 }
 
@@ -920,9 +1121,39 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 
 #endif // #ifdef _WIN32
 
+/* predicts the cost of the next frame from a moving average and mean
+ * deviation of recent frame times, and starts the next frame that much
+ * before its deadline.  the lead is capped at half an interval so that a
+ * single slow frame can't make the loop spin. */
+static void update_render_ahead(struct obs_graphics_context *context,
+				uint64_t frame_time_ns)
+{
+	uint64_t avg = context->frame_time_avg_ns;
+	uint64_t dev = context->frame_time_dev_ns;
+	uint64_t diff = frame_time_ns > avg ? frame_time_ns - avg
+					    : avg - frame_time_ns;
+	uint64_t predicted;
+	uint64_t lead = 0;
+
+	avg = avg - avg / 8 + frame_time_ns / 8;
+	dev = dev - dev / 4 + diff / 4;
+
+	predicted = avg + dev * 2;
+	if (predicted < context->interval) {
+		lead = predicted;
+		if (lead > context->interval / 2)
+			lead = context->interval / 2;
+	}
+
+	context->frame_time_avg_ns = avg;
+	context->frame_time_dev_ns = dev;
+	obs->video.render_ahead_ns = lead;
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
+static const char *render_canvases_name = "render_canvases";
 bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 {
 	/* defer loop break to clean up sources */
@@ -958,11 +1189,15 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	gs_begin_frame();
 	gs_leave_context();
 
+	uint64_t tick_start = os_gettime_ns();
+
 	profile_start(tick_sources_name);
 	context->last_time =
 		tick_sources(obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
 
+	update_phase_time(&obs->video, OBS_VIDEO_PHASE_TICK, tick_start);
+
 	execute_graphics_tasks();
 
 #ifdef _WIN32
@@ -977,6 +1212,10 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	output_frame(raw_active, gpu_active);
 	profile_end(output_frame_name);
 
+	profile_start(render_canvases_name);
+	obs_render_canvases(obs->video.video_time, context->interval);
+	profile_end(render_canvases_name);
+
 	profile_start(render_displays_name);
 	render_displays();
 	profile_end(render_displays_name);
@@ -987,6 +1226,8 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	profile_reenable_thread();
 
+	update_render_ahead(context, frame_time_ns);
+
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
 		    context->interval);
 
@@ -1039,6 +1280,8 @@ void *obs_graphics_thread(void *param)
 	context.fps_total_ns = 0;
 	context.fps_total_frames = 0;
 	context.last_time = 0;
+	context.frame_time_avg_ns = 0;
+	context.frame_time_dev_ns = 0;
 #ifdef _WIN32
 	context.gpu_was_active = false;
 #endif
@@ -202,8 +202,18 @@ static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
 static bool obs_init_textures(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
+	uint32_t depth = video->requested_readback_depth;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	if (!depth)
+		depth = DEFAULT_READBACK_DEPTH;
+	else if (depth < 2)
+		depth = 2;
+	else if (depth > MAX_READBACK_DEPTH)
+		depth = MAX_READBACK_DEPTH;
+
+	video->readback_depth = (int)depth;
+
+	for (int i = 0; i < video->readback_depth; i++) {
 #ifdef _WIN32
 		if (video->using_nv12_tex) {
 			video->copy_surfaces[i][0] =
@@ -428,6 +438,20 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->download_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
+	if (os_sem_init(&video->download_semaphore, 0) != 0)
+		return OBS_VIDEO_FAIL;
+	if (os_event_init(&video->download_done, OS_EVENT_TYPE_AUTO) != 0)
+		return OBS_VIDEO_FAIL;
+
+	video->download_stop = false;
+	errorcode = pthread_create(&video->download_thread, NULL,
+				   obs_download_thread, obs);
+	if (errorcode != 0)
+		return OBS_VIDEO_FAIL;
+
+	video->download_thread_initialized = true;
 
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
@@ -456,6 +480,33 @@ static void stop_video(void)
 			video->thread_initialized = false;
 		}
 	}
+
+	if (video->download_thread_initialized) {
+		os_atomic_set_bool(&video->download_stop, true);
+		os_sem_post(video->download_semaphore);
+		pthread_join(video->download_thread, &thread_retval);
+		video->download_thread_initialized = false;
+	}
+}
+
+static void log_readback_stats(struct obs_core_video *video)
+{
+	if (!video->readback_frames)
+		return;
+
+	blog(LOG_INFO,
+	     "Video readback: depth %d, %" PRIu64 " frames, "
+	     "latency avg %.2f ms / max %.2f ms, %" PRIu64 " stalls",
+	     video->readback_depth, video->readback_frames,
+	     (double)video->readback_latency_total /
+		     (double)video->readback_frames / 1000000.0,
+	     (double)video->readback_latency_max / 1000000.0,
+	     video->readback_stalls);
+
+	video->readback_frames = 0;
+	video->readback_latency_total = 0;
+	video->readback_latency_max = 0;
+	video->readback_stalls = 0;
 }
 
 static void obs_free_video(void)
@@ -471,15 +522,9 @@ static void obs_free_video(void)
 
 		gs_enter_context(video->graphics);
 
-		for (size_t c = 0; c < NUM_CHANNELS; c++) {
-			if (video->mapped_surfaces[c]) {
-				gs_stagesurface_unmap(
-					video->mapped_surfaces[c]);
-				video->mapped_surfaces[c] = NULL;
-			}
-		}
+		obs_unmap_readback_surfaces(video);
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_READBACK_DEPTH; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -498,7 +543,7 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_READBACK_DEPTH; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -530,6 +575,16 @@ static void obs_free_video(void)
 		pthread_mutex_init_value(&video->task_mutex);
 		circlebuf_free(&video->tasks);
 
+		log_readback_stats(video);
+
+		pthread_mutex_destroy(&video->download_mutex);
+		pthread_mutex_init_value(&video->download_mutex);
+		circlebuf_free(&video->download_queue);
+		os_sem_destroy(video->download_semaphore);
+		os_event_destroy(video->download_done);
+		video->download_semaphore = NULL;
+		video->download_done = NULL;
+
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
 	}
@@ -586,6 +641,9 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	if (!obs_init_audio_render_threads(audio))
+		return false;
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -603,6 +661,8 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_free_audio_render_threads(audio);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
@@ -623,6 +683,7 @@ static bool obs_init_data(void)
 	assert(data != NULL);
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
+	pthread_mutex_init_value(&obs->data.canvases_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
@@ -635,6 +696,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->displays_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->canvases_mutex, &attr) != 0)
+		goto fail;
 	if (pthread_mutex_init(&data->outputs_mutex, &attr) != 0)
 		goto fail;
 	if (pthread_mutex_init(&data->encoders_mutex, &attr) != 0)
@@ -688,6 +751,7 @@ static void obs_free_data(void)
 
 	blog(LOG_INFO, "Freeing OBS context data");
 
+	FREE_OBS_LINKED_LIST(canvas);
 	FREE_OBS_LINKED_LIST(source);
 	FREE_OBS_LINKED_LIST(output);
 	FREE_OBS_LINKED_LIST(encoder);
@@ -697,12 +761,16 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->audio_sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
+	pthread_mutex_destroy(&data->canvases_mutex);
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
+	for (size_t i = 0; i < data->tick_sources.num; i++)
+		obs_weak_source_release(data->tick_sources.array[i]);
+	da_free(data->tick_sources);
 	obs_data_release(data->private_data);
 }
 
@@ -853,6 +921,7 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
 	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
+	pthread_mutex_init_value(&obs->video.download_mutex);
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -1103,7 +1172,6 @@ const char *obs_get_locale(void)
 }
 
 #define OBS_SIZE_MIN 2
-#define OBS_SIZE_MAX (32 * 1024)
 
 static inline bool size_valid(uint32_t width, uint32_t height)
 {
@@ -1185,6 +1253,14 @@ int obs_reset_video(struct obs_video_info *ovi)
 	return obs_init_video(ovi);
 }
 
+void obs_set_video_readback_depth(uint32_t depth)
+{
+	if (!obs)
+		return;
+
+	obs->video.requested_readback_depth = depth;
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
 {
 	struct audio_output_info ai;
@@ -2194,6 +2270,23 @@ uint64_t obs_get_frame_interval_ns(void)
 	return obs->video.video_frame_interval_ns;
 }
 
+bool obs_get_video_phase_times(struct obs_video_phase_times *times)
+{
+	struct obs_core_video *video;
+
+	if (!obs || !obs->video.graphics || !times)
+		return false;
+
+	video = &obs->video;
+	times->tick_ns = video->phase_time_ns[OBS_VIDEO_PHASE_TICK];
+	times->render_ns = video->phase_time_ns[OBS_VIDEO_PHASE_RENDER];
+	times->convert_ns = video->phase_time_ns[OBS_VIDEO_PHASE_CONVERT];
+	times->download_ns = video->phase_time_ns[OBS_VIDEO_PHASE_DOWNLOAD];
+	times->output_ns = video->phase_time_ns[OBS_VIDEO_PHASE_OUTPUT];
+	times->render_ahead_ns = video->render_ahead_ns;
+	return true;
+}
+
 enum obs_obj_type obs_obj_get_type(void *obj)
 {
 	struct obs_context_data *context = obj;
@@ -2339,12 +2432,22 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+static inline bool is_main_video(video_t *v)
+{
+	while (video_output_get_parent(v))
+		v = video_output_get_parent(v);
+	return v == obs->video.video;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
 {
 	struct obs_core_video *video = &obs->video;
-	os_atomic_inc_long(&video->raw_active);
+
+	/* canvases read back their own frames */
+	if (is_main_video(v))
+		os_atomic_inc_long(&video->raw_active);
 	video_output_connect(v, conversion, callback, param);
 }
 
@@ -2353,7 +2456,9 @@ void stop_raw_video(video_t *v,
 		    void *param)
 {
 	struct obs_core_video *video = &obs->video;
-	os_atomic_dec_long(&video->raw_active);
+
+	if (is_main_video(v))
+		os_atomic_dec_long(&video->raw_active);
 	video_output_disconnect(v, callback, param);
 }
 
@@ -2400,6 +2505,15 @@ extern bool init_gpu_encoding(struct obs_core_video *video);
 extern void stop_gpu_encoding_thread(struct obs_core_video *video);
 extern void free_gpu_encoding(struct obs_core_video *video);
 
+/* the GPU encode thread only has the textures of the main mix, encoders
+ * of a canvas get raw frames instead */
+bool gpu_encode_available(const struct obs_encoder *encoder)
+{
+	return (encoder->info.caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0 &&
+	       obs->video.using_nv12_tex && encoder->media &&
+	       is_main_video(encoder->media);
+}
+
 bool start_gpu_encode(obs_encoder_t *encoder)
 {
 	struct obs_core_video *video = &obs->video;
@@ -2410,10 +2524,12 @@ bool start_gpu_encode(obs_encoder_t *encoder)
 
 	if (!video->gpu_encoders.num)
 		success = init_gpu_encoding(video);
-	if (success)
+	if (success) {
+		encoder->frame_rate_divisor_counter = 0;
 		da_push_back(video->gpu_encoders, &encoder);
-	else
+	} else {
 		free_gpu_encoding(video);
+	}
 
 	pthread_mutex_unlock(&video->gpu_encoder_mutex);
 	obs_leave_graphics();
@@ -41,6 +41,7 @@ struct matrix4;
 /* opaque types */
 struct obs_display;
 struct obs_view;
+struct obs_canvas;
 struct obs_source;
 struct obs_scene;
 struct obs_scene_item;
@@ -53,11 +54,13 @@ struct obs_volmeter;
 
 typedef struct obs_display obs_display_t;
 typedef struct obs_view obs_view_t;
+typedef struct obs_canvas obs_canvas_t;
 typedef struct obs_source obs_source_t;
 typedef struct obs_scene obs_scene_t;
 typedef struct obs_scene_item obs_sceneitem_t;
 typedef struct obs_output obs_output_t;
 typedef struct obs_encoder obs_encoder_t;
+typedef struct obs_encoder_group obs_encoder_group_t;
 typedef struct obs_service obs_service_t;
 typedef struct obs_module obs_module_t;
 typedef struct obs_fader obs_fader_t;
@@ -180,6 +183,40 @@ struct obs_video_info {
 	enum obs_scale_type scale_type; /**< How to scale if scaling */
 };
 
+/**
+ * Canvas initialization structure
+ */
+struct obs_canvas_info {
+	uint32_t base_width;  /**< Base compositing width */
+	uint32_t base_height; /**< Base compositing height */
+
+	uint32_t output_width;           /**< Output width */
+	uint32_t output_height;          /**< Output height */
+	enum video_format output_format; /**< Output format */
+
+	enum video_colorspace colorspace; /**< YUV type (if YUV) */
+	enum video_range_type range;      /**< YUV range (if YUV) */
+
+	enum obs_scale_type scale_type; /**< How to scale if scaling */
+
+	/** Render every Nth frame of the main video (0 or 1: every frame) */
+	uint32_t fps_divisor;
+};
+
+/**
+ * Moving averages of the time spent in each phase of a video frame
+ */
+struct obs_video_phase_times {
+	uint64_t tick_ns;     /**< Ticking sources */
+	uint64_t render_ns;   /**< Rendering the main and output textures */
+	uint64_t convert_ns;  /**< Color conversion and staging */
+	uint64_t download_ns; /**< Mapping staged frames */
+	uint64_t output_ns;   /**< Copying frames to raw outputs */
+
+	/** How far ahead of the frame deadline rendering currently starts */
+	uint64_t render_ahead_ns;
+};
+
 /**
  * Audio initialization structure
  */
@@ -383,6 +420,12 @@ EXPORT profiler_name_store_t *obs_get_profiler_name_store(void);
  */
 EXPORT int obs_reset_video(struct obs_video_info *ovi);
 
+/**
+ * Sets the number of staging surfaces used for reading frames back from the
+ * GPU (2-8, 0 for the default).  Takes effect on the next obs_reset_video.
+ */
+EXPORT void obs_set_video_readback_depth(uint32_t depth);
+
 /**
  * Sets base audio output format/channels/samples/etc
  *
@@ -760,6 +803,7 @@ EXPORT uint64_t obs_get_video_frame_time(void);
 EXPORT double obs_get_active_fps(void);
 EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint64_t obs_get_frame_interval_ns(void);
+EXPORT bool obs_get_video_phase_times(struct obs_video_phase_times *times);
 
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
@@ -807,6 +851,41 @@ EXPORT obs_source_t *obs_view_get_source(obs_view_t *view, uint32_t channel);
 /** Renders the sources of this view context */
 EXPORT void obs_view_render(obs_view_t *view);
 
+/* ------------------------------------------------------------------------- */
+/* Canvas context */
+
+/**
+ * Creates a canvas: an additional video mix with its own resolution, frame
+ * rate divisor, output format and view.
+ *
+ *   Canvases are rendered on the graphics thread after the main video, from
+ * the same source ticks and async frame uploads.  Outputs and encoders use
+ * the canvas through the video_t returned by obs_canvas_get_video.
+ *
+ *   Supported output formats are I420, NV12, I444 and RGBA.
+ */
+EXPORT obs_canvas_t *obs_canvas_create(const char *name,
+				       const struct obs_canvas_info *info);
+
+/**
+ * Destroys a canvas.  Outputs and encoders using its video must be stopped
+ * first.
+ */
+EXPORT void obs_canvas_destroy(obs_canvas_t *canvas);
+
+/** Gets the name of a canvas */
+EXPORT const char *obs_canvas_get_name(const obs_canvas_t *canvas);
+
+/** Gets the settings of a canvas, returns false if canvas is NULL */
+EXPORT bool obs_canvas_get_info(const obs_canvas_t *canvas,
+				struct obs_canvas_info *info);
+
+/** Gets the view whose sources are rendered into the canvas */
+EXPORT obs_view_t *obs_canvas_get_view(obs_canvas_t *canvas);
+
+/** Gets the video output of a canvas */
+EXPORT video_t *obs_canvas_get_video(const obs_canvas_t *canvas);
+
 /* ------------------------------------------------------------------------- */
 /* Display context */
 
@@ -1258,6 +1337,41 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+/**
+ * Gets a frame from the source's frame pool to be filled by the caller and
+ * passed to obs_source_output_frame, which avoids the copy made by
+ * obs_source_output_video.  A frame that ends up not being output must be
+ * returned with obs_source_release_frame.
+ */
+EXPORT struct obs_source_frame *
+obs_source_alloc_frame(obs_source_t *source, enum video_format format,
+		       uint32_t width, uint32_t height);
+
+/**
+ * Outputs a frame from obs_source_alloc_frame and takes ownership of it.
+ *
+ * NOTE: Non-YUV formats will always be treated as full range with this
+ * function, like with obs_source_output_video.
+ */
+EXPORT void obs_source_output_frame(obs_source_t *source,
+				    struct obs_source_frame *frame);
+
+typedef void (*obs_source_frame_release_t)(void *param);
+
+/**
+ * Outputs asynchronous video data that is owned by the caller without copying
+ * it.  The planes must stay valid until release is called with param, which
+ * happens once libobs no longer uses the frame.  release may be called from
+ * any thread, including the calling one, and must not call back into the
+ * source.
+ *
+ * NOTE: Non-YUV formats will always be treated as full range with this
+ * function, like with obs_source_output_video.
+ */
+EXPORT void obs_source_output_video_external(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	obs_source_frame_release_t release, void *param);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -1947,9 +2061,22 @@ EXPORT void obs_output_set_video_encoder(obs_output_t *output,
 EXPORT void obs_output_set_audio_encoder(obs_output_t *output,
 					 obs_encoder_t *encoder, size_t idx);
 
+/**
+ * Sets the video encoder of a specific video track (rendition)
+ *
+ * Only outputs with the OBS_OUTPUT_MULTI_TRACK_VIDEO flag accept an idx
+ * other than 0.  Tracks must be assigned contiguously starting at 0.
+ */
+EXPORT void obs_output_set_video_encoder2(obs_output_t *output,
+					  obs_encoder_t *encoder, size_t idx);
+
 /** Returns the current video encoder associated with this output */
 EXPORT obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output);
 
+/** Returns the video encoder of a specific video track of this output */
+EXPORT obs_encoder_t *
+obs_output_get_video_encoder2(const obs_output_t *output, size_t idx);
+
 /**
  * Returns the current audio encoder associated with this output
  *
@@ -2141,6 +2268,103 @@ EXPORT enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 					uint32_t height);
 
+/**
+ * Sets a frame rate divisor for a video encoder: only every Nth frame of its
+ * video output is converted and encoded, and obs_encoder_video returns a
+ * video_t reporting the divided frame rate.  If the encoder is active, this
+ * function will trigger a warning, and do nothing.
+ */
+EXPORT void obs_encoder_set_frame_rate_divisor(obs_encoder_t *encoder,
+					       uint32_t divisor);
+
+/** For video encoders, returns the frame rate divisor (1 if not set) */
+EXPORT uint32_t
+obs_encoder_get_frame_rate_divisor(const obs_encoder_t *encoder);
+
+#define OBS_ENCODER_TIME_BUCKETS 8
+
+/** Statistics of a raw video encoder's frame queue and encode thread */
+struct obs_encoder_queue_stats {
+	uint32_t queued;     /**< Frames currently waiting to be encoded */
+	uint32_t capacity;   /**< Maximum number of queued frames */
+	uint32_t max_queued; /**< Highest queue depth since starting */
+
+	/**
+	 * Number of frames by encode time: bucket 0 counts frames that took
+	 * less than 1ms, bucket N frames that took 2^(N-1) to 2^N ms, and the
+	 * last bucket everything longer
+	 */
+	uint64_t encode_time_hist[OBS_ENCODER_TIME_BUCKETS];
+};
+
+/**
+ * For raw video encoders, gets the statistics of the frame queue feeding the
+ * encoder's encode thread.  Returns false if the encoder doesn't encode on
+ * its own thread (audio encoders, texture encoders, or not started).
+ */
+EXPORT bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+					struct obs_encoder_queue_stats *stats);
+
+/* ------------------------------------------------------------------------- */
+/* Encoder groups */
+
+/**
+ * Creates an encoder group.  Video encoders in a group share one conversion
+ * of their video output: the largest member size is converted once, and
+ * every smaller size is scaled from the next larger one rather than from
+ * the full-size frame.  Members only start receiving frames once every
+ * member has been started, and skip the same frames, so renditions start
+ * on the same frame and keyframes stay aligned when the members use the
+ * same keyframe interval.
+ */
+EXPORT obs_encoder_group_t *obs_encoder_group_create(void);
+
+/**
+ * Destroys an encoder group.  Fails with a warning if any member is still
+ * active.  Members are removed from the group but not released.
+ */
+EXPORT void obs_encoder_group_destroy(obs_encoder_group_t *group);
+
+/**
+ * Adds an inactive video encoder to a group.  Returns false if the encoder
+ * is active, already in a group, or its keyframe interval ("keyint_sec")
+ * differs from the other members.
+ */
+EXPORT bool obs_encoder_group_add(obs_encoder_group_t *group,
+				  obs_encoder_t *encoder);
+
+/** Removes an inactive video encoder from its group */
+EXPORT bool obs_encoder_group_remove(obs_encoder_group_t *group,
+				     obs_encoder_t *encoder);
+
+/** Telemetry of a video encoder */
+struct obs_encoder_stats {
+	uint64_t frames;      /**< Frames encoded since starting */
+	uint64_t total_bytes; /**< Bytes encoded since starting */
+
+	/** Number of frames of each obs_encoder_frame_type */
+	uint64_t frame_types[OBS_ENCODER_FRAME_TYPES];
+
+	double avg_qp;        /**< Moving average quantizer, -1 if unknown */
+	double avg_encode_ms; /**< Moving average encode time per frame */
+
+	/** Type, quantizer (-1 if unknown), size and encode time of the last
+	 * frame */
+	enum obs_encoder_frame_type last_type;
+	int last_qp;
+	size_t last_size;
+	double last_encode_ms;
+};
+
+/**
+ * For video encoders, gets per-frame telemetry: encode time and size are
+ * measured for every encoder, frame type and quantizer are only available
+ * if the encoder implements get_frame_stats.  Returns false if the encoder
+ * isn't active or hasn't output a frame yet.
+ */
+EXPORT bool obs_encoder_get_stats(const obs_encoder_t *encoder,
+				  struct obs_encoder_stats *stats);
+
 /** For video encoders, returns true if pre-encode scaling is enabled */
 EXPORT bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder);
 
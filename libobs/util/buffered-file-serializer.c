@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WIN32
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+#include "buffered-file-serializer.h"
+#include "circlebuf.h"
+#include "darray.h"
+#include "platform.h"
+#include "threading.h"
+#include "base.h"
+#include "bmem.h"
+
+/* alignment and size granularity required for direct I/O */
+#define DIRECT_IO_ALIGNMENT 4096
+
+struct chunk {
+	uint8_t *data;
+	size_t size;
+};
+
+struct buffered_file {
+#ifdef _WIN32
+	FILE *file;
+#else
+	int fd;
+#endif
+	bool direct_io;
+	uint64_t prealloc_size;
+	uint64_t allocated;
+
+	size_t chunk_size;
+	size_t max_chunks;
+	size_t num_chunks;
+	DARRAY(uint8_t *) free_chunks;
+	struct circlebuf queue;
+	struct chunk cur;
+
+	/* logical position/size; file_pos is only touched by the writer
+	 * thread, or by the caller while the writer is idle */
+	int64_t pos;
+	int64_t size;
+	int64_t file_pos;
+
+	pthread_mutex_t mutex;
+	os_sem_t *write_sem;
+	os_event_t *idle_event;
+	pthread_t thread;
+	bool writing;
+	bool stop;
+
+	struct buffered_file_serializer_stats stats;
+};
+
+/* ------------------------------------------------------------------------- */
+/* platform file access                                                      */
+
+static inline uint8_t *chunk_alloc(size_t size)
+{
+#ifdef _WIN32
+	return bmalloc(size);
+#else
+	void *ptr;
+	if (posix_memalign(&ptr, DIRECT_IO_ALIGNMENT, size) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+static inline void chunk_free(uint8_t *data)
+{
+#ifdef _WIN32
+	bfree(data);
+#else
+	free(data);
+#endif
+}
+
+#ifdef _WIN32
+static bool file_open(struct buffered_file *bf, const char *path)
+{
+	bf->file = os_fopen(path, "wb");
+	if (!bf->file)
+		return false;
+
+	setvbuf(bf->file, NULL, _IONBF, 0);
+	bf->direct_io = false;
+	bf->prealloc_size = 0;
+	return true;
+}
+
+static void file_close(struct buffered_file *bf)
+{
+	fclose(bf->file);
+}
+
+static bool file_write(struct buffered_file *bf, const uint8_t *data,
+		       size_t size)
+{
+	return fwrite(data, 1, size, bf->file) == size;
+}
+
+static bool file_seek(struct buffered_file *bf, int64_t offset)
+{
+	return os_fseeki64(bf->file, offset, SEEK_SET) == 0;
+}
+
+static inline void file_disable_direct_io(struct buffered_file *bf)
+{
+	UNUSED_PARAMETER(bf);
+}
+
+static inline void file_preallocate(struct buffered_file *bf, size_t size)
+{
+	UNUSED_PARAMETER(bf);
+	UNUSED_PARAMETER(size);
+}
+#else
+static bool file_open(struct buffered_file *bf, const char *path)
+{
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_CLOEXEC
+	flags |= O_CLOEXEC;
+#endif
+#ifdef O_DIRECT
+	if (bf->direct_io) {
+		bf->fd = open(path, flags | O_DIRECT, 0644);
+		if (bf->fd != -1)
+			return true;
+		if (errno != EINVAL)
+			return false;
+
+		blog(LOG_INFO, "buffered_file_serializer: Direct I/O not "
+			       "supported for '%s'",
+		     path);
+		bf->direct_io = false;
+	}
+#endif
+
+	bf->fd = open(path, flags, 0644);
+	if (bf->fd == -1)
+		return false;
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+	if (bf->direct_io)
+		fcntl(bf->fd, F_NOCACHE, 1);
+#else
+	bf->direct_io = false;
+#endif
+	return true;
+}
+
+static void file_close(struct buffered_file *bf)
+{
+	/* releases space preallocated beyond the end of the file */
+	if (bf->allocated > (uint64_t)bf->size)
+		(void)ftruncate(bf->fd, bf->size);
+
+	close(bf->fd);
+}
+
+static bool file_write(struct buffered_file *bf, const uint8_t *data,
+		       size_t size)
+{
+	while (size) {
+		ssize_t ret = write(bf->fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static bool file_seek(struct buffered_file *bf, int64_t offset)
+{
+	return lseek(bf->fd, (off_t)offset, SEEK_SET) != (off_t)-1;
+}
+
+/* partial chunks and unaligned offsets can't be written with direct I/O,
+ * so it's turned off before the first partial chunk is written and on
+ * every seek */
+static void file_disable_direct_io(struct buffered_file *bf)
+{
+	if (!bf->direct_io)
+		return;
+
+#ifdef O_DIRECT
+	int flags = fcntl(bf->fd, F_GETFL);
+	if (flags != -1)
+		fcntl(bf->fd, F_SETFL, flags & ~O_DIRECT);
+#elif defined(F_NOCACHE)
+	fcntl(bf->fd, F_NOCACHE, 0);
+#endif
+	bf->direct_io = false;
+}
+
+static void file_preallocate(struct buffered_file *bf, size_t size)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+	uint64_t end = (uint64_t)bf->file_pos + size;
+
+	if (!bf->prealloc_size || end <= bf->allocated)
+		return;
+
+	if (bf->allocated < (uint64_t)bf->file_pos)
+		bf->allocated = (uint64_t)bf->file_pos;
+
+	if (fallocate(bf->fd, FALLOC_FL_KEEP_SIZE, (off_t)bf->allocated,
+		      (off_t)bf->prealloc_size) == 0) {
+		bf->allocated += bf->prealloc_size;
+	} else {
+		/* not supported by the file system, don't try again */
+		bf->prealloc_size = 0;
+	}
+#else
+	UNUSED_PARAMETER(bf);
+	UNUSED_PARAMETER(size);
+#endif
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* writer thread                                                             */
+
+static void *buffered_file_thread(void *param)
+{
+	struct buffered_file *bf = param;
+
+	os_set_thread_name("buffered file writer");
+
+	for (;;) {
+		struct chunk chunk;
+		bool error;
+		uint64_t start;
+		uint64_t elapsed;
+
+		os_sem_wait(bf->write_sem);
+
+		pthread_mutex_lock(&bf->mutex);
+		if (!bf->queue.size) {
+			bool stop = bf->stop;
+			pthread_mutex_unlock(&bf->mutex);
+
+			if (stop)
+				break;
+			continue;
+		}
+
+		circlebuf_pop_front(&bf->queue, &chunk, sizeof(chunk));
+		bf->writing = true;
+		error = bf->stats.error;
+		pthread_mutex_unlock(&bf->mutex);
+
+		start = os_gettime_ns();
+
+		if (!error) {
+			file_preallocate(bf, chunk.size);
+			error = !file_write(bf, chunk.data, chunk.size);
+			if (!error)
+				bf->file_pos += (int64_t)chunk.size;
+			else
+				blog(LOG_WARNING, "buffered_file_serializer: "
+						  "Failed to write to file");
+		}
+
+		elapsed = os_gettime_ns() - start;
+
+		pthread_mutex_lock(&bf->mutex);
+		if (error)
+			bf->stats.error = true;
+		else
+			bf->stats.bytes_written += chunk.size;
+		if (elapsed > bf->stats.max_write_ns)
+			bf->stats.max_write_ns = elapsed;
+		bf->stats.buffered -= chunk.size;
+		bf->writing = false;
+		da_push_back(bf->free_chunks, &chunk.data);
+		pthread_mutex_unlock(&bf->mutex);
+
+		os_event_signal(bf->idle_event);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* serializer callbacks                                                      */
+
+static bool acquire_chunk(struct buffered_file *bf)
+{
+	uint8_t *data = NULL;
+
+	pthread_mutex_lock(&bf->mutex);
+
+	if (bf->stats.error) {
+		pthread_mutex_unlock(&bf->mutex);
+		return false;
+	}
+
+	if (!bf->free_chunks.num && bf->num_chunks < bf->max_chunks) {
+		data = chunk_alloc(bf->chunk_size);
+		if (data)
+			bf->num_chunks++;
+	}
+
+	if (!data && !bf->free_chunks.num && !bf->stats.error) {
+		uint64_t start = os_gettime_ns();
+
+		while (!bf->free_chunks.num && !bf->stats.error) {
+			pthread_mutex_unlock(&bf->mutex);
+			os_event_wait(bf->idle_event);
+			pthread_mutex_lock(&bf->mutex);
+		}
+
+		bf->stats.stalls++;
+		bf->stats.stall_ns += os_gettime_ns() - start;
+	}
+
+	if (!data && bf->free_chunks.num && !bf->stats.error) {
+		data = bf->free_chunks.array[bf->free_chunks.num - 1];
+		da_pop_back(bf->free_chunks);
+	}
+
+	pthread_mutex_unlock(&bf->mutex);
+
+	bf->cur.data = data;
+	bf->cur.size = 0;
+	return data != NULL;
+}
+
+static void submit_chunk(struct buffered_file *bf)
+{
+	pthread_mutex_lock(&bf->mutex);
+	circlebuf_push_back(&bf->queue, &bf->cur, sizeof(bf->cur));
+	bf->stats.buffered += bf->cur.size;
+	if (bf->stats.buffered > bf->stats.max_buffered)
+		bf->stats.max_buffered = bf->stats.buffered;
+	pthread_mutex_unlock(&bf->mutex);
+
+	os_sem_post(bf->write_sem);
+	bf->cur.data = NULL;
+	bf->cur.size = 0;
+}
+
+static void wait_idle(struct buffered_file *bf)
+{
+	pthread_mutex_lock(&bf->mutex);
+	while (bf->queue.size || bf->writing) {
+		pthread_mutex_unlock(&bf->mutex);
+		os_event_wait(bf->idle_event);
+		pthread_mutex_lock(&bf->mutex);
+	}
+	pthread_mutex_unlock(&bf->mutex);
+}
+
+/* writes everything buffered so far, including a partially filled chunk,
+ * and leaves direct I/O off for whatever is written afterwards */
+static void flush_all(struct buffered_file *bf)
+{
+	wait_idle(bf);
+	file_disable_direct_io(bf);
+
+	if (!bf->cur.data)
+		return;
+
+	if (bf->cur.size) {
+		submit_chunk(bf);
+		wait_idle(bf);
+	} else {
+		pthread_mutex_lock(&bf->mutex);
+		da_push_back(bf->free_chunks, &bf->cur.data);
+		pthread_mutex_unlock(&bf->mutex);
+		bf->cur.data = NULL;
+	}
+}
+
+static size_t buffered_file_write(void *sdata, const void *data, size_t size)
+{
+	struct buffered_file *bf = sdata;
+	const uint8_t *in = data;
+	size_t written = 0;
+
+	while (written < size) {
+		size_t avail;
+
+		if (!bf->cur.data && !acquire_chunk(bf))
+			break;
+
+		avail = bf->chunk_size - bf->cur.size;
+		if (avail > size - written)
+			avail = size - written;
+
+		memcpy(bf->cur.data + bf->cur.size, in + written, avail);
+		bf->cur.size += avail;
+		written += avail;
+
+		if (bf->cur.size == bf->chunk_size)
+			submit_chunk(bf);
+	}
+
+	bf->pos += (int64_t)written;
+	if (bf->pos > bf->size)
+		bf->size = bf->pos;
+	return written;
+}
+
+static int64_t buffered_file_seek(void *sdata, int64_t offset,
+				  enum serialize_seek_type seek_type)
+{
+	struct buffered_file *bf = sdata;
+	int64_t pos = offset;
+
+	switch (seek_type) {
+	case SERIALIZE_SEEK_START:
+		break;
+	case SERIALIZE_SEEK_CURRENT:
+		pos += bf->pos;
+		break;
+	case SERIALIZE_SEEK_END:
+		pos += bf->size;
+		break;
+	}
+
+	if (pos < 0)
+		return -1;
+
+	flush_all(bf);
+
+	if (bf->stats.error || !file_seek(bf, pos))
+		return -1;
+
+	bf->file_pos = pos;
+	bf->pos = pos;
+	return pos;
+}
+
+static int64_t buffered_file_get_pos(void *sdata)
+{
+	struct buffered_file *bf = sdata;
+	return bf->pos;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void buffered_file_destroy(struct buffered_file *bf)
+{
+	for (size_t i = 0; i < bf->free_chunks.num; i++)
+		chunk_free(bf->free_chunks.array[i]);
+
+	da_free(bf->free_chunks);
+	circlebuf_free(&bf->queue);
+	os_event_destroy(bf->idle_event);
+	os_sem_destroy(bf->write_sem);
+	pthread_mutex_destroy(&bf->mutex);
+	bfree(bf);
+}
+
+static inline size_t align_size(size_t size)
+{
+	const size_t mask = DIRECT_IO_ALIGNMENT - 1;
+	return (size + mask) & ~mask;
+}
+
+bool buffered_file_serializer_init(
+	struct serializer *s, const char *path,
+	const struct buffered_file_serializer_options *opts)
+{
+	struct buffered_file *bf = bzalloc(sizeof(*bf));
+	size_t buffer_size = BUFFERED_FILE_DEFAULT_BUFFER_SIZE;
+
+	bf->chunk_size = BUFFERED_FILE_DEFAULT_CHUNK_SIZE;
+
+	if (opts) {
+		if (opts->buffer_size)
+			buffer_size = opts->buffer_size;
+		if (opts->chunk_size)
+			bf->chunk_size = align_size(opts->chunk_size);
+		bf->direct_io = opts->direct_io;
+		bf->prealloc_size = opts->prealloc_size;
+	}
+
+	bf->max_chunks = (buffer_size + bf->chunk_size - 1) / bf->chunk_size;
+	if (bf->max_chunks < 2)
+		bf->max_chunks = 2;
+
+	if (pthread_mutex_init(&bf->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&bf->write_sem, 0) != 0)
+		goto fail_sem;
+	if (os_event_init(&bf->idle_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+	if (!file_open(bf, path))
+		goto fail_open;
+	if (pthread_create(&bf->thread, NULL, buffered_file_thread, bf) != 0)
+		goto fail_thread;
+
+	s->data = bf;
+	s->read = NULL;
+	s->write = buffered_file_write;
+	s->seek = buffered_file_seek;
+	s->get_pos = buffered_file_get_pos;
+	return true;
+
+fail_thread:
+	file_close(bf);
+fail_open:
+	os_event_destroy(bf->idle_event);
+fail_event:
+	os_sem_destroy(bf->write_sem);
+fail_sem:
+	pthread_mutex_destroy(&bf->mutex);
+fail_mutex:
+	bfree(bf);
+	return false;
+}
+
+void buffered_file_serializer_get_stats(
+	struct serializer *s, struct buffered_file_serializer_stats *stats)
+{
+	struct buffered_file *bf = s->data;
+
+	pthread_mutex_lock(&bf->mutex);
+	*stats = bf->stats;
+	pthread_mutex_unlock(&bf->mutex);
+}
+
+bool buffered_file_serializer_free(struct serializer *s)
+{
+	struct buffered_file *bf = s->data;
+	bool success;
+
+	if (!bf)
+		return false;
+
+	flush_all(bf);
+
+	pthread_mutex_lock(&bf->mutex);
+	bf->stop = true;
+	pthread_mutex_unlock(&bf->mutex);
+
+	os_sem_post(bf->write_sem);
+	pthread_join(bf->thread, NULL);
+
+	success = !bf->stats.error;
+	file_close(bf);
+	buffered_file_destroy(bf);
+
+	s->data = NULL;
+	return success;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "serializer.h"
+
+/*
+ *   Output file serializer that copies data into large buffers and writes
+ * them to disk on a separate thread, so a slow disk only stalls the caller
+ * once all buffers are full.  Seeking waits for all buffered data to be
+ * written first, so it should be kept to headers/trailers.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUFFERED_FILE_DEFAULT_BUFFER_SIZE (32 * 1024 * 1024)
+#define BUFFERED_FILE_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+struct buffered_file_serializer_options {
+	/** Maximum amount of data to buffer, 0 for the default */
+	size_t buffer_size;
+
+	/** Size of each write to disk, 0 for the default */
+	size_t chunk_size;
+
+	/** Bypass the OS page cache (O_DIRECT/F_NOCACHE) where supported */
+	bool direct_io;
+
+	/** Preallocate disk space in steps of this many bytes (Linux only),
+	 * 0 to disable */
+	uint64_t prealloc_size;
+};
+
+struct buffered_file_serializer_stats {
+	uint64_t bytes_written; /**< Bytes written to disk so far */
+	size_t buffered;        /**< Bytes waiting to be written */
+	size_t max_buffered;    /**< Highest value of buffered */
+
+	uint64_t stalls;       /**< Writes that waited for a free buffer */
+	uint64_t stall_ns;     /**< Total time spent waiting */
+	uint64_t max_write_ns; /**< Longest single write to disk */
+
+	bool error; /**< A write to disk failed, no more data is accepted */
+};
+
+/**
+ * Opens a file for writing.  opts can be NULL to use the defaults.
+ */
+EXPORT bool buffered_file_serializer_init(
+	struct serializer *s, const char *path,
+	const struct buffered_file_serializer_options *opts);
+
+EXPORT void buffered_file_serializer_get_stats(
+	struct serializer *s, struct buffered_file_serializer_stats *stats);
+
+/**
+ * Writes any buffered data and closes the file.  Returns false if any of
+ * the data could not be written.
+ */
+EXPORT bool buffered_file_serializer_free(struct serializer *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,12 +20,15 @@
 
 #include "pipewire.h"
 
+#include <util/darray.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 
 #include <gio/gio.h>
 #include <gio/gunixfdlist.h>
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <glad/glad.h>
 #include <linux/dma-buf.h>
 #include <spa/param/video/format-utils.h>
@@ -40,6 +43,16 @@
 	(sizeof(struct spa_meta_cursor) + sizeof(struct spa_meta_bitmap) + \
 	 width * height * 4)
 
+/* Damage regions passed along with memory buffers */
+#define MAX_DAMAGE_REGIONS 16
+
+/* Producers rarely use more than a handful of buffers, anything above this
+ * is evicted oldest first */
+#define MAX_DMABUF_TEXTURES 16
+
+/* Re-sync the capture clock offset when it drifts further than this */
+#define CLOCK_RESYNC_NS 1000000000LL
+
 #define fourcc_code(a, b, c, d)                                \
 	((__u32)(a) | ((__u32)(b) << 8) | ((__u32)(c) << 16) | \
 	 ((__u32)(d) << 24))
@@ -57,6 +70,14 @@
 	fourcc_code('A', 'B', '2', \
 		    '4') /* [31:0] A:B:G:R 8:8:8:8 little endian */
 
+struct dmabuf_texture {
+	int64_t fd;
+	uint32_t offset;
+	uint32_t stride;
+	uint64_t modifier;
+	gs_texture_t *texture;
+};
+
 struct _obs_pipewire_data {
 	GDBusConnection *connection;
 	GDBusProxy *proxy;
@@ -73,7 +94,36 @@ struct _obs_pipewire_data {
 	obs_source_t *source;
 	obs_data_t *settings;
 
+	/* displayed texture, owned by either dmabuf_textures or mem_texture */
 	gs_texture_t *texture;
+	gs_texture_t *mem_texture;
+	DARRAY(struct dmabuf_texture) dmabuf_textures;
+	bool flush_dmabuf_textures;
+
+	/* the newest buffer waits for the next render, the displayed buffer
+	 * is held until it is replaced so the producer can't overwrite it */
+	struct pw_buffer *pending_buffer;
+	struct pw_buffer *current_buffer;
+	uint64_t pending_ts;
+
+	/* set when a buffer was skipped, its damage is missing from
+	 * mem_texture so the next memory buffer is uploaded in full */
+	bool damage_lost;
+
+	struct {
+		bool valid;
+		int64_t offset;
+	} clock;
+
+	struct {
+		uint64_t frames;
+		uint64_t dropped;
+		uint64_t imports;
+		uint64_t reused;
+		uint64_t latency_total;
+		uint64_t latency_max;
+		uint64_t timed_frames;
+	} stats;
 
 	struct pw_thread_loop *thread_loop;
 	struct pw_context *context;
@@ -223,6 +273,44 @@ static void dbus_call_data_free(struct dbus_call_data *call)
 	bfree(call);
 }
 
+static void destroy_dmabuf_textures(obs_pipewire_data *obs_pw)
+{
+	for (size_t i = 0; i < obs_pw->dmabuf_textures.num; i++) {
+		gs_texture_t *texture =
+			obs_pw->dmabuf_textures.array[i].texture;
+
+		if (obs_pw->texture == texture)
+			obs_pw->texture = NULL;
+		gs_texture_destroy(texture);
+	}
+
+	obs_pw->dmabuf_textures.num = 0;
+}
+
+static void log_stats(obs_pipewire_data *obs_pw)
+{
+	if (!obs_pw->stats.frames)
+		return;
+
+	blog(LOG_INFO,
+	     "[pipewire] %" PRIu64 " frames, %" PRIu64
+	     " replaced before rendering, %" PRIu64 " DMA-BUF imports, %" PRIu64
+	     " reused",
+	     obs_pw->stats.frames, obs_pw->stats.dropped,
+	     obs_pw->stats.imports, obs_pw->stats.reused);
+
+	if (obs_pw->stats.timed_frames) {
+		blog(LOG_INFO,
+		     "[pipewire] capture to render latency: %.2fms avg, "
+		     "%.2fms max",
+		     (double)obs_pw->stats.latency_total /
+			     (double)obs_pw->stats.timed_frames / 1000000.0,
+		     (double)obs_pw->stats.latency_max / 1000000.0);
+	}
+
+	memset(&obs_pw->stats, 0, sizeof(obs_pw->stats));
+}
+
 static void teardown_pipewire(obs_pipewire_data *obs_pw)
 {
 	if (obs_pw->thread_loop) {
@@ -230,12 +318,32 @@ static void teardown_pipewire(obs_pipewire_data *obs_pw)
 		pw_thread_loop_stop(obs_pw->thread_loop);
 	}
 
+	/* update_texture uses the loop and the stream on the graphics thread,
+	 * so they are only destroyed while holding the graphics lock */
+	obs_enter_graphics();
+
 	if (obs_pw->stream)
 		pw_stream_disconnect(obs_pw->stream);
 	g_clear_pointer(&obs_pw->stream, pw_stream_destroy);
 	g_clear_pointer(&obs_pw->context, pw_context_destroy);
 	g_clear_pointer(&obs_pw->thread_loop, pw_thread_loop_destroy);
 
+	/* buffers were freed with the stream */
+	obs_pw->pending_buffer = NULL;
+	obs_pw->current_buffer = NULL;
+	obs_pw->clock.valid = false;
+	obs_pw->damage_lost = false;
+
+	destroy_dmabuf_textures(obs_pw);
+	g_clear_pointer(&obs_pw->mem_texture, gs_texture_destroy);
+	obs_pw->texture = NULL;
+	obs_leave_graphics();
+
+	da_free(obs_pw->dmabuf_textures);
+	obs_pw->flush_dmabuf_textures = false;
+
+	log_stats(obs_pw);
+
 	if (obs_pw->pipewire_fd > 0) {
 		close(obs_pw->pipewire_fd);
 		obs_pw->pipewire_fd = 0;
@@ -258,7 +366,6 @@ static void destroy_session(obs_pipewire_data *obs_pw)
 
 	g_clear_pointer(&obs_pw->sender_name, bfree);
 	g_clear_pointer(&obs_pw->cursor.texture, gs_texture_destroy);
-	g_clear_pointer(&obs_pw->texture, gs_texture_destroy);
 	g_cancellable_cancel(obs_pw->cancellable);
 	g_clear_object(&obs_pw->cancellable);
 	g_clear_object(&obs_pw->connection);
@@ -344,54 +451,193 @@ static void swap_texture_red_blue(gs_texture_t *texture)
 
 /* ------------------------------------------------- */
 
-static void on_process_cb(void *user_data)
+static gs_texture_t *import_dmabuf_texture(obs_pipewire_data *obs_pw,
+					  const struct spa_data *data,
+					  uint32_t drm_format)
 {
-	obs_pipewire_data *obs_pw = user_data;
-	struct spa_meta_cursor *cursor;
-	uint32_t drm_format;
+	struct dmabuf_texture *entry;
+	uint32_t offsets[1];
+	uint32_t strides[1];
+	uint64_t modifiers[1];
+	int fds[1];
+
+	for (size_t i = 0; i < obs_pw->dmabuf_textures.num; i++) {
+		entry = obs_pw->dmabuf_textures.array + i;
+
+		if (entry->fd == data->fd &&
+		    entry->offset == data->chunk->offset &&
+		    entry->stride == (uint32_t)data->chunk->stride &&
+		    entry->modifier == obs_pw->format.info.raw.modifier) {
+			obs_pw->stats.reused++;
+			return entry->texture;
+		}
+	}
+
+	blog(LOG_DEBUG,
+	     "[pipewire] DMA-BUF info: fd:%ld, stride:%d, offset:%u, size:%dx%d",
+	     data->fd, data->chunk->stride, data->chunk->offset,
+	     obs_pw->format.info.raw.size.width,
+	     obs_pw->format.info.raw.size.height);
+
+	fds[0] = data->fd;
+	offsets[0] = data->chunk->offset;
+	strides[0] = data->chunk->stride;
+	modifiers[0] = obs_pw->format.info.raw.modifier;
+
+	gs_texture_t *texture = gs_texture_create_from_dmabuf(
+		obs_pw->format.info.raw.size.width,
+		obs_pw->format.info.raw.size.height, drm_format, GS_BGRX, 1,
+		fds, strides, offsets, modifiers);
+	if (!texture)
+		return NULL;
+
+	if (obs_pw->dmabuf_textures.num >= MAX_DMABUF_TEXTURES) {
+		entry = obs_pw->dmabuf_textures.array;
+		if (obs_pw->texture == entry->texture)
+			obs_pw->texture = NULL;
+		gs_texture_destroy(entry->texture);
+		da_erase(obs_pw->dmabuf_textures, 0);
+	}
+
+	entry = da_push_back_new(obs_pw->dmabuf_textures);
+	entry->fd = data->fd;
+	entry->offset = data->chunk->offset;
+	entry->stride = data->chunk->stride;
+	entry->modifier = obs_pw->format.info.raw.modifier;
+	entry->texture = texture;
+
+	obs_pw->stats.imports++;
+	return texture;
+}
+
+static inline void copy_rows(uint8_t *dst, uint32_t dst_linesize,
+			     const uint8_t *src, uint32_t src_linesize,
+			     uint32_t x, uint32_t y, uint32_t width,
+			     uint32_t height)
+{
+	dst += y * dst_linesize + x * 4;
+	src += y * src_linesize + x * 4;
+
+	for (uint32_t row = 0; row < height; row++) {
+		memcpy(dst, src, width * 4);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+/* Uploads a memory buffer, limited to the damaged regions if the producer
+ * sent any and the texture holds the frame right before this one */
+static bool upload_mem_buffer(obs_pipewire_data *obs_pw,
+			      struct spa_buffer *buffer)
+{
+	const uint32_t width = obs_pw->format.info.raw.size.width;
+	const uint32_t height = obs_pw->format.info.raw.size.height;
+	struct spa_data *data = &buffer->datas[0];
+	struct spa_region damage[MAX_DAMAGE_REGIONS];
 	struct spa_meta_region *region;
-	struct spa_buffer *buffer;
-	struct pw_buffer *b;
+	enum gs_color_format obs_format;
 	bool swap_red_blue = false;
-	bool has_buffer;
+	uint32_t num_damage = 0;
+	uint32_t src_linesize;
+	uint32_t linesize;
+	const uint8_t *src;
+	uint8_t *dst;
+
+	if (!spa_pixel_format_to_obs_format(obs_pw->format.info.raw.format,
+					    &obs_format, &swap_red_blue)) {
+		blog(LOG_ERROR, "[pipewire] unsupported DMA buffer format: %d",
+		     obs_pw->format.info.raw.format);
+		return false;
+	}
 
-	/* Find the most recent buffer */
-	b = NULL;
-	while (true) {
-		struct pw_buffer *aux =
-			pw_stream_dequeue_buffer(obs_pw->stream);
-		if (!aux)
-			break;
-		if (b)
-			pw_stream_queue_buffer(obs_pw->stream, b);
-		b = aux;
+	if (!obs_pw->mem_texture ||
+	    gs_texture_get_width(obs_pw->mem_texture) != width ||
+	    gs_texture_get_height(obs_pw->mem_texture) != height ||
+	    gs_texture_get_color_format(obs_pw->mem_texture) != obs_format) {
+		g_clear_pointer(&obs_pw->mem_texture, gs_texture_destroy);
+		obs_pw->mem_texture = gs_texture_create(
+			width, height, obs_format, 1, NULL, GS_DYNAMIC);
+		if (!obs_pw->mem_texture)
+			return false;
+
+		if (swap_red_blue)
+			swap_texture_red_blue(obs_pw->mem_texture);
+	} else if (!obs_pw->damage_lost &&
+		   obs_pw->texture == obs_pw->mem_texture) {
+		struct spa_meta *meta =
+			spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+
+		if (meta) {
+			spa_meta_for_each(region, meta)
+			{
+				if (!spa_meta_region_is_valid(region) ||
+				    num_damage == MAX_DAMAGE_REGIONS)
+					break;
+				damage[num_damage++] = region->region;
+			}
+		}
+
+		/* more regions than fit the meta means the list is partial */
+		if (num_damage == MAX_DAMAGE_REGIONS)
+			num_damage = 0;
 	}
 
-	if (!b) {
-		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
-		return;
+	if (!gs_texture_map(obs_pw->mem_texture, &dst, &linesize))
+		return false;
+
+	src = SPA_MEMBER(data->data, data->chunk->offset, const uint8_t);
+	src_linesize = data->chunk->stride ? (uint32_t)data->chunk->stride
+					   : width * 4;
+
+	if (!num_damage)
+		copy_rows(dst, linesize, src, src_linesize, 0, 0, width,
+			  height);
+
+	/* the upload buffer keeps the previous frame between maps */
+	for (uint32_t i = 0; i < num_damage; i++) {
+		int64_t x1 =
+			SPA_CLAMP(damage[i].position.x, 0, (int64_t)width);
+		int64_t y1 =
+			SPA_CLAMP(damage[i].position.y, 0, (int64_t)height);
+		int64_t x2 = SPA_CLAMP((int64_t)damage[i].position.x +
+					       damage[i].size.width,
+				       0, (int64_t)width);
+		int64_t y2 = SPA_CLAMP((int64_t)damage[i].position.y +
+					       damage[i].size.height,
+				       0, (int64_t)height);
+
+		if (x1 < x2 && y1 < y2)
+			copy_rows(dst, linesize, src, src_linesize,
+				  (uint32_t)x1, (uint32_t)y1,
+				  (uint32_t)(x2 - x1), (uint32_t)(y2 - y1));
 	}
 
-	buffer = b->buffer;
-	has_buffer = buffer->datas[0].chunk->size != 0;
+	gs_texture_unmap(obs_pw->mem_texture);
+	obs_pw->texture = obs_pw->mem_texture;
+	obs_pw->damage_lost = false;
+	return true;
+}
 
-	obs_enter_graphics();
+/* Reads a buffer into the displayed texture and metadata
+ *
+ * Returns true if the texture now references the buffer's memory, in which
+ * case the buffer has to be held until the texture is replaced. */
+static bool process_buffer(obs_pipewire_data *obs_pw, struct spa_buffer *buffer)
+{
+	struct spa_meta_cursor *cursor;
+	uint32_t drm_format;
+	struct spa_meta_region *region;
+	bool swap_red_blue = false;
+	bool has_buffer;
+	bool hold = false;
+
+	has_buffer = buffer->datas[0].chunk->size != 0;
 
 	if (!has_buffer)
 		goto read_metadata;
 
 	if (buffer->datas[0].type == SPA_DATA_DmaBuf) {
-		uint32_t offsets[1];
-		uint32_t strides[1];
-		uint64_t modifiers[1];
-		int fds[1];
-
-		blog(LOG_DEBUG,
-		     "[pipewire] DMA-BUF info: fd:%ld, stride:%d, offset:%u, size:%dx%d",
-		     buffer->datas[0].fd, buffer->datas[0].chunk->stride,
-		     buffer->datas[0].chunk->offset,
-		     obs_pw->format.info.raw.size.width,
-		     obs_pw->format.info.raw.size.height);
+		gs_texture_t *texture;
 
 		if (!spa_pixel_format_to_drm_format(
 			    obs_pw->format.info.raw.format, &drm_format)) {
@@ -401,39 +647,20 @@ static void on_process_cb(void *user_data)
 			goto read_metadata;
 		}
 
-		fds[0] = buffer->datas[0].fd;
-		offsets[0] = buffer->datas[0].chunk->offset;
-		strides[0] = buffer->datas[0].chunk->stride;
-		modifiers[0] = obs_pw->format.info.raw.modifier;
+		texture = import_dmabuf_texture(obs_pw, &buffer->datas[0],
+						drm_format);
+		if (!texture)
+			goto read_metadata;
 
-		g_clear_pointer(&obs_pw->texture, gs_texture_destroy);
-		obs_pw->texture = gs_texture_create_from_dmabuf(
-			obs_pw->format.info.raw.size.width,
-			obs_pw->format.info.raw.size.height, drm_format,
-			GS_BGRX, 1, fds, strides, offsets, modifiers);
+		obs_pw->texture = texture;
+		hold = true;
 	} else {
 		blog(LOG_DEBUG, "[pipewire] Buffer has memory texture");
-		enum gs_color_format obs_format;
 
-		if (!spa_pixel_format_to_obs_format(
-			    obs_pw->format.info.raw.format, &obs_format,
-			    &swap_red_blue)) {
-			blog(LOG_ERROR,
-			     "[pipewire] unsupported DMA buffer format: %d",
-			     obs_pw->format.info.raw.format);
+		if (!upload_mem_buffer(obs_pw, buffer))
 			goto read_metadata;
-		}
-
-		g_clear_pointer(&obs_pw->texture, gs_texture_destroy);
-		obs_pw->texture = gs_texture_create(
-			obs_pw->format.info.raw.size.width,
-			obs_pw->format.info.raw.size.height, obs_format, 1,
-			(const uint8_t **)&buffer->datas[0].data, GS_DYNAMIC);
 	}
 
-	if (swap_red_blue)
-		swap_texture_red_blue(obs_pw->texture);
-
 	/* Video Crop */
 	region = spa_buffer_find_meta_data(buffer, SPA_META_VideoCrop,
 					   sizeof(*region));
@@ -493,9 +720,156 @@ read_metadata:
 		obs_pw->cursor.y = cursor->position.y;
 	}
 
-	pw_stream_queue_buffer(obs_pw->stream, b);
+	return hold;
+}
 
-	obs_leave_graphics();
+/* Maps the producer's presentation timestamp onto the obs clock
+ *
+ * The offset between both clocks is estimated as the smallest observed
+ * delivery delay, so it converges on the actual offset plus the minimum
+ * latency. Returns 0 if the buffer has no timestamp. */
+static uint64_t map_buffer_timestamp(obs_pipewire_data *obs_pw,
+				     struct spa_buffer *buffer)
+{
+	struct spa_meta_header *header;
+	int64_t offset;
+
+	header = spa_buffer_find_meta_data(buffer, SPA_META_Header,
+					   sizeof(*header));
+	if (!header || header->pts <= 0)
+		return 0;
+
+	offset = (int64_t)os_gettime_ns() - header->pts;
+	if (!obs_pw->clock.valid || offset < obs_pw->clock.offset ||
+	    offset - obs_pw->clock.offset > CLOCK_RESYNC_NS) {
+		obs_pw->clock.offset = offset;
+		obs_pw->clock.valid = true;
+	}
+
+	return (uint64_t)(header->pts + obs_pw->clock.offset);
+}
+
+/* Runs on the PipeWire thread; only picks the newest buffer, it is imported
+ * on the graphics thread when the next frame is rendered */
+static void on_process_cb(void *user_data)
+{
+	obs_pipewire_data *obs_pw = user_data;
+	struct pw_buffer *b;
+
+	/* Find the most recent buffer */
+	b = NULL;
+	while (true) {
+		struct pw_buffer *aux =
+			pw_stream_dequeue_buffer(obs_pw->stream);
+		if (!aux)
+			break;
+		if (b) {
+			pw_stream_queue_buffer(obs_pw->stream, b);
+			obs_pw->damage_lost = true;
+		}
+		b = aux;
+	}
+
+	if (!b) {
+		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
+		return;
+	}
+
+	if (obs_pw->pending_buffer) {
+		pw_stream_queue_buffer(obs_pw->stream, obs_pw->pending_buffer);
+		obs_pw->stats.dropped++;
+		obs_pw->damage_lost = true;
+	}
+
+	obs_pw->pending_buffer = b;
+	obs_pw->pending_ts = map_buffer_timestamp(obs_pw, b->buffer);
+	obs_pw->stats.frames++;
+}
+
+static void on_remove_buffer_cb(void *user_data, struct pw_buffer *buffer)
+{
+	obs_pipewire_data *obs_pw = user_data;
+	struct spa_data *data = &buffer->buffer->datas[0];
+
+	if (obs_pw->pending_buffer == buffer)
+		obs_pw->pending_buffer = NULL;
+	if (obs_pw->current_buffer == buffer)
+		obs_pw->current_buffer = NULL;
+
+	/* the fd can be reused by a new buffer, so textures imported from it
+	 * are dropped. can't enter graphics here since the graphics thread
+	 * may be waiting on the loop lock, so they are destroyed on the next
+	 * render */
+	if (data->type == SPA_DATA_DmaBuf) {
+		for (size_t i = 0; i < obs_pw->dmabuf_textures.num; i++) {
+			if (obs_pw->dmabuf_textures.array[i].fd == data->fd) {
+				obs_pw->dmabuf_textures.array[i].fd = -1;
+				obs_pw->flush_dmabuf_textures = true;
+			}
+		}
+	}
+}
+
+/* Imports the pending buffer, called from the graphics thread */
+static void update_texture(obs_pipewire_data *obs_pw)
+{
+	struct pw_buffer *b;
+
+	if (!obs_pw->thread_loop)
+		return;
+
+	pw_thread_loop_lock(obs_pw->thread_loop);
+
+	if (obs_pw->flush_dmabuf_textures) {
+		for (size_t i = obs_pw->dmabuf_textures.num; i > 0; i--) {
+			struct dmabuf_texture *entry =
+				obs_pw->dmabuf_textures.array + i - 1;
+
+			if (entry->fd != -1)
+				continue;
+			if (obs_pw->texture == entry->texture)
+				obs_pw->texture = NULL;
+			gs_texture_destroy(entry->texture);
+			da_erase(obs_pw->dmabuf_textures, i - 1);
+		}
+		obs_pw->flush_dmabuf_textures = false;
+	}
+
+	b = obs_pw->pending_buffer;
+	obs_pw->pending_buffer = NULL;
+
+	if (b && obs_pw->stream) {
+		if (obs_pw->pending_ts) {
+			uint64_t now = os_gettime_ns();
+			uint64_t latency = now > obs_pw->pending_ts
+						   ? now - obs_pw->pending_ts
+						   : 0;
+
+			obs_pw->stats.latency_total += latency;
+			if (latency > obs_pw->stats.latency_max)
+				obs_pw->stats.latency_max = latency;
+			obs_pw->stats.timed_frames++;
+		}
+
+		if (process_buffer(obs_pw, b->buffer)) {
+			if (obs_pw->current_buffer)
+				pw_stream_queue_buffer(obs_pw->stream,
+						       obs_pw->current_buffer);
+			obs_pw->current_buffer = b;
+		} else {
+			/* the texture no longer references the held buffer
+			 * if this was a memory upload */
+			if (obs_pw->current_buffer &&
+			    obs_pw->texture == obs_pw->mem_texture) {
+				pw_stream_queue_buffer(obs_pw->stream,
+						       obs_pw->current_buffer);
+				obs_pw->current_buffer = NULL;
+			}
+			pw_stream_queue_buffer(obs_pw->stream, b);
+		}
+	}
+
+	pw_thread_loop_unlock(obs_pw->thread_loop);
 }
 
 static void on_param_changed_cb(void *user_data, uint32_t id,
@@ -503,7 +877,7 @@ static void on_param_changed_cb(void *user_data, uint32_t id,
 {
 	obs_pipewire_data *obs_pw = user_data;
 	struct spa_pod_builder pod_builder;
-	const struct spa_pod *params[3];
+	const struct spa_pod *params[5];
 	uint8_t params_buffer[1024];
 	int result;
 
@@ -521,6 +895,11 @@ static void on_param_changed_cb(void *user_data, uint32_t id,
 
 	spa_format_video_raw_parse(param, &obs_pw->format.info.raw);
 
+	/* imports depend on the negotiated format and modifier */
+	for (size_t i = 0; i < obs_pw->dmabuf_textures.num; i++)
+		obs_pw->dmabuf_textures.array[i].fd = -1;
+	obs_pw->flush_dmabuf_textures = true;
+
 	blog(LOG_DEBUG, "[pipewire] Negotiated format:");
 
 	blog(LOG_DEBUG, "[pipewire]     Format: %d (%s)",
@@ -554,13 +933,32 @@ static void on_param_changed_cb(void *user_data, uint32_t id,
 					 CURSOR_META_SIZE(1, 1),
 					 CURSOR_META_SIZE(1024, 1024)));
 
-	/* Buffer options */
+	/* Damage, used to only upload changed areas of memory buffers */
 	params[2] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+		SPA_PARAM_META_size,
+		SPA_POD_CHOICE_RANGE_Int(
+			sizeof(struct spa_meta_region) * MAX_DAMAGE_REGIONS,
+			sizeof(struct spa_meta_region) * 1,
+			sizeof(struct spa_meta_region) * MAX_DAMAGE_REGIONS));
+
+	/* Presentation timestamps */
+	params[3] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+		SPA_PARAM_META_size,
+		SPA_POD_Int(sizeof(struct spa_meta_header)));
+
+	/* Buffer options. One buffer waits to be rendered and one is
+	 * displayed, so ask for enough to keep the producer going */
+	params[4] = spa_pod_builder_add_object(
 		&pod_builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+		SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(4, 3, 16),
 		SPA_PARAM_BUFFERS_dataType,
 		SPA_POD_Int((1 << SPA_DATA_MemPtr) | (1 << SPA_DATA_DmaBuf)));
 
-	pw_stream_update_params(obs_pw->stream, params, 3);
+	pw_stream_update_params(obs_pw->stream, params, 5);
 
 	obs_pw->negotiated = true;
 }
@@ -582,6 +980,7 @@ static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = on_state_changed_cb,
 	.param_changed = on_param_changed_cb,
+	.remove_buffer = on_remove_buffer_cb,
 	.process = on_process_cb,
 };
 
@@ -1217,6 +1616,8 @@ void obs_pipewire_video_render(obs_pipewire_data *obs_pw, gs_effect_t *effect)
 {
 	gs_eparam_t *image;
 
+	update_texture(obs_pw);
+
 	if (!obs_pw->texture)
 		return;
 
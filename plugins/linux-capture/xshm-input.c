@@ -18,13 +18,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
 
 #include <obs-module.h>
+#include <util/darray.h>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -32,6 +36,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* damage regions with more rectangles than this are captured as their
+ * bounding box, and pending updates are merged into a full frame update */
+#define XSHM_MAX_RECTS 64
+
 struct xshm_data {
 	obs_source_t *source;
 
@@ -63,6 +71,31 @@ struct xshm_data {
 	bool use_xinerama;
 	bool use_randr;
 	bool advanced;
+
+	/* capture thread */
+	pthread_t thread;
+	os_event_t *stop_event;
+	bool thread_active;
+	bool use_damage;
+	uint8_t damage_event;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t region;
+	DARRAY(xcb_rectangle_t) rects;
+
+	/* captured image and the parts not yet uploaded, shared with the
+	 * graphics thread */
+	pthread_mutex_t frame_mutex;
+	uint8_t *frame;
+	DARRAY(xcb_rectangle_t) pending;
+	bool pending_full;
+	uint64_t pending_ts;
+
+	/* stats */
+	uint64_t captures;
+	uint64_t damaged_pixels;
+	uint64_t updates;
+	uint64_t latency_total;
+	uint64_t latency_max;
 };
 
 /**
@@ -101,6 +134,45 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	return ok;
 }
 
+/**
+ * Set up damage tracking for the root window
+ *
+ * Without the damage extension every frame is captured in full.
+ */
+static bool xshm_init_damage(struct xshm_data *data)
+{
+	const xcb_query_extension_reply_t *ext;
+	xcb_damage_query_version_cookie_t dmg_c;
+	xcb_xfixes_query_version_cookie_t xfix_c;
+
+	ext = xcb_get_extension_data(data->xcb, &xcb_damage_id);
+	if (!ext->present ||
+	    !xcb_get_extension_data(data->xcb, &xcb_xfixes_id)->present) {
+		blog(LOG_INFO, "Missing Damage extension, capturing full frames");
+		return false;
+	}
+
+	data->damage_event = ext->first_event;
+
+	dmg_c = xcb_damage_query_version_unchecked(data->xcb,
+						   XCB_DAMAGE_MAJOR_VERSION,
+						   XCB_DAMAGE_MINOR_VERSION);
+	xfix_c = xcb_xfixes_query_version_unchecked(data->xcb,
+						    XCB_XFIXES_MAJOR_VERSION,
+						    XCB_XFIXES_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, dmg_c, NULL));
+	free(xcb_xfixes_query_version_reply(data->xcb, xfix_c, NULL));
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			  XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->region, 0, NULL);
+
+	return true;
+}
+
 /**
  * Update the capture
  *
@@ -174,6 +246,286 @@ static int_fast32_t xshm_update_geometry(struct xshm_data *data)
 	return 1;
 }
 
+/**
+ * Read pending damage events and fill the rectangle list with the damaged
+ * parts of the capture area, in capture coordinates
+ *
+ * @return true if anything has to be captured
+ */
+static bool xshm_collect_damage(struct xshm_data *data, bool full)
+{
+	xcb_generic_event_t *ev;
+	xcb_xfixes_fetch_region_reply_t *reg_r;
+	xcb_rectangle_t *r;
+	int count;
+	bool damaged = false;
+
+	data->rects.num = 0;
+
+	while ((ev = xcb_poll_for_event(data->xcb)) != NULL) {
+		if ((ev->response_type & ~0x80) ==
+		    data->damage_event + XCB_DAMAGE_NOTIFY)
+			damaged = true;
+		free(ev);
+	}
+
+	if (full || !data->use_damage) {
+		xcb_rectangle_t all = {0, 0, data->adj_width, data->adj_height};
+		da_push_back(data->rects, &all);
+
+		if (data->use_damage)
+			xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+					    XCB_NONE);
+		return true;
+	}
+
+	if (!damaged)
+		return false;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE, data->region);
+	reg_r = xcb_xfixes_fetch_region_reply(
+		data->xcb, xcb_xfixes_fetch_region(data->xcb, data->region),
+		NULL);
+	if (!reg_r)
+		return false;
+
+	r = xcb_xfixes_fetch_region_rectangles(reg_r);
+	count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	int_fast32_t min_x = data->adj_width, min_y = data->adj_height;
+	int_fast32_t max_x = 0, max_y = 0;
+
+	for (int i = 0; i < count; ++i) {
+		int_fast32_t x1 = r[i].x - data->adj_x_org;
+		int_fast32_t y1 = r[i].y - data->adj_y_org;
+		int_fast32_t x2 = x1 + r[i].width;
+		int_fast32_t y2 = y1 + r[i].height;
+
+		x1 = x1 < 0 ? 0 : x1;
+		y1 = y1 < 0 ? 0 : y1;
+		x2 = x2 > data->adj_width ? data->adj_width : x2;
+		y2 = y2 > data->adj_height ? data->adj_height : y2;
+		if (x1 >= x2 || y1 >= y2)
+			continue;
+
+		xcb_rectangle_t clipped = {x1, y1, x2 - x1, y2 - y1};
+		da_push_back(data->rects, &clipped);
+
+		min_x = x1 < min_x ? x1 : min_x;
+		min_y = y1 < min_y ? y1 : min_y;
+		max_x = x2 > max_x ? x2 : max_x;
+		max_y = y2 > max_y ? y2 : max_y;
+	}
+
+	free(reg_r);
+
+	if (data->rects.num > XSHM_MAX_RECTS) {
+		xcb_rectangle_t bounds = {min_x, min_y, max_x - min_x,
+					  max_y - min_y};
+		data->rects.num = 0;
+		da_push_back(data->rects, &bounds);
+	}
+
+	return data->rects.num > 0;
+}
+
+/**
+ * Fetch the rectangles in the list and copy them into the shared frame
+ *
+ * The rectangles are fetched into consecutive parts of the shm segment, the
+ * damage region never overlaps itself so they always fit.
+ */
+static void xshm_capture_rects(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t cookies[XSHM_MAX_RECTS];
+	uint32_t offsets[XSHM_MAX_RECTS];
+	uint64_t ts = os_gettime_ns();
+	const size_t frame_linesize = data->adj_width * 4;
+	uint64_t pixels = 0;
+	uint32_t offset = 0;
+	bool ok = true;
+
+	for (size_t i = 0; i < data->rects.num; ++i) {
+		xcb_rectangle_t *r = data->rects.array + i;
+
+		offsets[i] = offset;
+		cookies[i] = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root,
+			data->adj_x_org + r->x, data->adj_y_org + r->y,
+			r->width, r->height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+			data->xshm->seg, offset);
+		offset += r->width * r->height * 4;
+	}
+
+	for (size_t i = 0; i < data->rects.num; ++i) {
+		xcb_shm_get_image_reply_t *img_r;
+
+		img_r = xcb_shm_get_image_reply(data->xcb, cookies[i], NULL);
+		if (!img_r)
+			ok = false;
+		free(img_r);
+	}
+
+	if (!ok)
+		return;
+
+	pthread_mutex_lock(&data->frame_mutex);
+
+	for (size_t i = 0; i < data->rects.num; ++i) {
+		xcb_rectangle_t *r = data->rects.array + i;
+		const size_t linesize = r->width * 4;
+		const uint8_t *src = data->xshm->data + offsets[i];
+		uint8_t *dst =
+			data->frame + r->y * frame_linesize + r->x * 4;
+
+		for (uint16_t y = 0; y < r->height; ++y) {
+			memcpy(dst, src, linesize);
+			src += linesize;
+			dst += frame_linesize;
+		}
+
+		if (data->pending.num < XSHM_MAX_RECTS)
+			da_push_back(data->pending, r);
+		else
+			data->pending_full = true;
+
+		pixels += r->width * r->height;
+	}
+
+	if (!data->pending_ts)
+		data->pending_ts = ts;
+
+	data->captures++;
+	data->damaged_pixels += pixels;
+
+	pthread_mutex_unlock(&data->frame_mutex);
+}
+
+/**
+ * Capture thread
+ *
+ * Captures the damaged parts of the screen once per frame interval so the
+ * graphics thread only has to upload them.
+ */
+static void *xshm_capture_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	struct obs_video_info ovi;
+	uint64_t interval = 1000000000ULL / 30;
+	uint64_t next;
+	bool full = true;
+
+	os_set_thread_name("xshm: capture");
+
+	if (obs_get_video_info(&ovi))
+		interval = util_mul_div64(1000000000ULL, ovi.fps_den,
+					  ovi.fps_num);
+
+	next = os_gettime_ns();
+
+	while (os_event_try(data->stop_event) == EAGAIN) {
+		uint64_t now;
+
+		os_sleepto_ns(next);
+		now = os_gettime_ns();
+		next += interval;
+		if (next < now)
+			next = now + interval;
+
+		/* damage is not tracked while hidden, refresh everything
+		 * once the source is showing again */
+		if (!obs_source_showing(data->source)) {
+			full = true;
+			continue;
+		}
+
+		if (!xshm_collect_damage(data, full))
+			continue;
+
+		xshm_capture_rects(data);
+		full = false;
+	}
+
+	return NULL;
+}
+
+/**
+ * Upload the captured parts of the frame to the texture
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload_frame(struct xshm_data *data)
+{
+	const size_t frame_linesize = data->adj_width * 4;
+	uint8_t *ptr;
+	uint32_t linesize;
+
+	pthread_mutex_lock(&data->frame_mutex);
+
+	if (!data->texture || !data->frame)
+		goto unlock;
+	if (!data->pending_full && !data->pending.num)
+		goto unlock;
+
+	/* the texture's upload buffer keeps its contents between maps, so only
+	 * the changed parts need to be written */
+	if (gs_texture_map(data->texture, &ptr, &linesize)) {
+		if (data->pending_full) {
+			data->pending.num = 0;
+			xcb_rectangle_t all = {0, 0, data->adj_width,
+					       data->adj_height};
+			da_push_back(data->pending, &all);
+		}
+
+		for (size_t i = 0; i < data->pending.num; ++i) {
+			xcb_rectangle_t *r = data->pending.array + i;
+			const uint8_t *src = data->frame +
+					     r->y * frame_linesize + r->x * 4;
+			uint8_t *dst = ptr + r->y * linesize + r->x * 4;
+
+			for (uint16_t y = 0; y < r->height; ++y) {
+				memcpy(dst, src, r->width * 4);
+				src += frame_linesize;
+				dst += linesize;
+			}
+		}
+
+		gs_texture_unmap(data->texture);
+	}
+
+	uint64_t latency = os_gettime_ns() - data->pending_ts;
+	data->latency_total += latency;
+	if (latency > data->latency_max)
+		data->latency_max = latency;
+	data->updates++;
+
+	data->pending.num = 0;
+	data->pending_full = false;
+	data->pending_ts = 0;
+
+unlock:
+	pthread_mutex_unlock(&data->frame_mutex);
+}
+
+static void xshm_log_stats(struct xshm_data *data)
+{
+	const double area = (double)data->adj_width * data->adj_height;
+
+	if (!data->captures || !data->updates)
+		return;
+
+	double damaged = (double)data->damaged_pixels /
+			 (area * (double)data->captures);
+	double latency = (double)data->latency_total / (double)data->updates;
+
+	blog(LOG_INFO,
+	     "Capture stats: %" PRIu64 " captures, %" PRIu64
+	     " texture updates, %.1f%% of the screen damaged on average, "
+	     "latency %.2fms avg / %.2fms max",
+	     data->captures, data->updates, damaged * 100.0,
+	     latency / 1000000.0, (double)data->latency_max / 1000000.0);
+}
+
 /**
  * Returns the name of the plugin
  */
@@ -188,6 +540,19 @@ static const char *xshm_getname(void *unused)
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->thread, NULL);
+		data->thread_active = false;
+	}
+
+	if (data->stop_event) {
+		os_event_destroy(data->stop_event);
+		data->stop_event = NULL;
+	}
+
+	xshm_log_stats(data);
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -206,11 +571,32 @@ static void xshm_capture_stop(struct xshm_data *data)
 		data->xshm = NULL;
 	}
 
+	if (data->use_damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		xcb_xfixes_destroy_region(data->xcb, data->region);
+		data->use_damage = false;
+	}
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
 	}
 
+	pthread_mutex_lock(&data->frame_mutex);
+	bfree(data->frame);
+	data->frame = NULL;
+	da_free(data->pending);
+	data->pending_full = false;
+	data->pending_ts = 0;
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	da_free(data->rects);
+	data->captures = 0;
+	data->damaged_pixels = 0;
+	data->updates = 0;
+	data->latency_total = 0;
+	data->latency_max = 0;
+
 	if (data->server) {
 		bfree(data->server);
 		data->server = NULL;
@@ -258,6 +644,18 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	data->use_damage = xshm_init_damage(data);
+	data->frame = bzalloc(data->adj_width * data->adj_height * 4);
+
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->thread, NULL, xshm_capture_thread, data) !=
+	    0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+	data->thread_active = true;
+
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -450,6 +848,7 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	pthread_mutex_destroy(&data->frame_mutex);
 	bfree(data);
 }
 
@@ -460,6 +859,7 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
+	pthread_mutex_init(&data->frame_mutex, NULL);
 
 	xshm_update(data, settings);
 
@@ -479,34 +879,19 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
 	xcb_xfixes_get_cursor_image_cookie_t cur_c;
 	xcb_xfixes_get_cursor_image_reply_t *cur_r;
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->adj_x_org, data->adj_y_org,
-					    data->adj_width, data->adj_height,
-					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
 	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
-
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
 	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
 
-	if (!img_r)
-		goto exit;
-
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->adj_width * 4, false);
+	xshm_upload_frame(data);
 	xcb_xcursor_update(data->cursor, cur_r);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
 	free(cur_r);
 }
 
@@ -0,0 +1,469 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include <libavcodec/avcodec.h>
+
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+#include <media-io/video-io.h>
+#include <obs-avc.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
+
+#define MAX_DECODE_THREADS 4
+#define JOBS_PER_THREAD 2
+
+enum job_state {
+	JOB_FREE,
+	JOB_QUEUED,
+	JOB_DECODING,
+	JOB_DONE,
+};
+
+struct decode_job {
+	enum job_state state;
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	uint64_t timestamp;
+	uint64_t queued_ns;
+	bool flush;
+	AVFrame *frame;
+};
+
+struct decode_worker {
+	struct v4l2_decoder *dec;
+	AVCodecContext *ctx;
+	AVPacket *packet;
+	pthread_t thread;
+	bool thread_created;
+};
+
+struct v4l2_decoder {
+	obs_source_t *source;
+	char *name;
+	enum video_range_type color_range;
+	bool h264;
+
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	/* jobs are used as a ring in capture order.  a slot is only reused
+	 * once its frame has been output, so frames can finish decoding out
+	 * of order but are always output in order */
+	struct decode_job *jobs;
+	size_t num_jobs;
+	uint64_t push_seq;
+	uint64_t decode_seq;
+	uint64_t out_seq;
+
+	/* H.264 frames reference earlier ones, so after a drop everything up
+	 * to the next keyframe is dropped too */
+	bool wait_keyframe;
+
+	struct decode_worker *workers;
+	size_t num_workers;
+
+	/* statistics */
+	uint64_t decoded;
+	uint64_t dropped;
+	uint64_t errors;
+	uint64_t latency_total_ns;
+	uint64_t latency_max_ns;
+	bool unsupported_logged;
+};
+
+static enum video_format convert_pixel_format(int format)
+{
+	switch (format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_NV12:
+		return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:
+		return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_GRAY8:
+		return VIDEO_FORMAT_Y800;
+	}
+
+	return VIDEO_FORMAT_NONE;
+}
+
+static inline bool is_full_range(const struct v4l2_decoder *dec,
+				 const AVFrame *frame)
+{
+	if (dec->color_range != VIDEO_RANGE_DEFAULT)
+		return dec->color_range == VIDEO_RANGE_FULL;
+
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	}
+
+	return frame->color_range == AVCOL_RANGE_JPEG;
+}
+
+static void release_frame(void *param)
+{
+	AVFrame *frame = param;
+	av_frame_free(&frame);
+}
+
+/* hands the decoded frame to libobs without copying it, the AVFrame
+ * reference keeps the decoder's buffer alive until libobs releases it */
+static void output_frame(struct v4l2_decoder *dec, AVFrame *frame,
+			 uint64_t timestamp)
+{
+	struct obs_source_frame out = {0};
+	enum video_format format = convert_pixel_format(frame->format);
+	enum video_colorspace cs;
+	bool full_range;
+
+	if (format == VIDEO_FORMAT_NONE) {
+		if (!dec->unsupported_logged) {
+			blog(LOG_ERROR, "%s: unsupported decoded format %d",
+			     dec->name, frame->format);
+			dec->unsupported_logged = true;
+		}
+		av_frame_free(&frame);
+		return;
+	}
+
+	full_range = is_full_range(dec, frame);
+	cs = frame->colorspace == AVCOL_SPC_BT709 ? VIDEO_CS_709
+						  : VIDEO_CS_601;
+	video_format_get_parameters(cs,
+				    full_range ? VIDEO_RANGE_FULL
+					       : VIDEO_RANGE_PARTIAL,
+				    out.color_matrix, out.color_range_min,
+				    out.color_range_max);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out.data[i] = frame->data[i];
+		out.linesize[i] = frame->linesize[i];
+	}
+
+	out.width = frame->width;
+	out.height = frame->height;
+	out.timestamp = timestamp;
+	out.format = format;
+	out.full_range = full_range;
+
+	obs_source_output_video_external(dec->source, &out, release_frame,
+					 frame);
+}
+
+/* call with mutex held */
+static void output_done_jobs(struct v4l2_decoder *dec)
+{
+	while (dec->out_seq < dec->decode_seq) {
+		struct decode_job *job =
+			&dec->jobs[dec->out_seq % dec->num_jobs];
+
+		if (job->state != JOB_DONE)
+			break;
+
+		if (job->frame)
+			output_frame(dec, job->frame, job->timestamp);
+
+		job->frame = NULL;
+		job->state = JOB_FREE;
+		dec->out_seq++;
+	}
+}
+
+/* returns false on decode errors.  *out is set to NULL when the decoder
+ * needs more data before it can output a picture, like at the start of an
+ * H.264 stream */
+static bool decode_job(struct decode_worker *w, struct decode_job *job,
+		       AVFrame **out)
+{
+	AVFrame *frame = NULL;
+	int ret;
+
+	if (job->flush)
+		avcodec_flush_buffers(w->ctx);
+
+	w->packet->data = job->data;
+	w->packet->size = (int)job->size;
+
+	*out = NULL;
+
+	ret = avcodec_send_packet(w->ctx, w->packet);
+	if (ret < 0)
+		return false;
+
+	/* a capture frame decodes to at most one picture, keep the newest if
+	 * the decoder ever returns more */
+	for (;;) {
+		AVFrame *next = av_frame_alloc();
+
+		ret = avcodec_receive_frame(w->ctx, next);
+		if (ret < 0) {
+			av_frame_free(&next);
+			break;
+		}
+
+		av_frame_free(&frame);
+		frame = next;
+	}
+
+	*out = frame;
+	return frame || ret == AVERROR(EAGAIN);
+}
+
+static void *decode_thread(void *param)
+{
+	struct decode_worker *w = param;
+	struct v4l2_decoder *dec = w->dec;
+
+	os_set_thread_name("v4l2: decode");
+
+	while (os_sem_wait(dec->sem) == 0) {
+		struct decode_job *job;
+		AVFrame *frame;
+		bool success;
+
+		if (os_atomic_load_bool(&dec->stop))
+			break;
+
+		pthread_mutex_lock(&dec->mutex);
+		job = &dec->jobs[dec->decode_seq++ % dec->num_jobs];
+		job->state = JOB_DECODING;
+		pthread_mutex_unlock(&dec->mutex);
+
+		success = decode_job(w, job, &frame);
+
+		pthread_mutex_lock(&dec->mutex);
+		if (frame) {
+			uint64_t latency = os_gettime_ns() - job->queued_ns;
+
+			dec->decoded++;
+			dec->latency_total_ns += latency;
+			if (latency > dec->latency_max_ns)
+				dec->latency_max_ns = latency;
+		} else if (!success) {
+			dec->errors++;
+		}
+
+		job->frame = frame;
+		job->state = JOB_DONE;
+		output_done_jobs(dec);
+		pthread_mutex_unlock(&dec->mutex);
+	}
+
+	return NULL;
+}
+
+static bool init_worker(struct v4l2_decoder *dec, struct decode_worker *w,
+			const AVCodec *codec, bool h264)
+{
+	int ret;
+
+	w->dec = dec;
+	w->ctx = avcodec_alloc_context3(codec);
+	w->packet = av_packet_alloc();
+	if (!w->ctx || !w->packet)
+		return false;
+
+	if (h264) {
+		/* frames depend on each other, so parallelize within a
+		 * frame instead of adding frame-threading latency */
+		w->ctx->thread_count = 0;
+		w->ctx->thread_type = FF_THREAD_SLICE;
+	} else {
+		w->ctx->thread_count = 1;
+	}
+	w->ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+	ret = avcodec_open2(w->ctx, codec, NULL);
+	if (ret < 0) {
+		blog(LOG_ERROR, "%s: failed to open decoder: %s", dec->name,
+		     av_err2str(ret));
+		return false;
+	}
+
+	if (pthread_create(&w->thread, NULL, decode_thread, w) != 0)
+		return false;
+
+	w->thread_created = true;
+	return true;
+}
+
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 const char *name,
+					 uint_fast32_t pixelformat,
+					 enum video_range_type color_range)
+{
+	struct v4l2_decoder *dec;
+	const AVCodec *codec;
+	bool h264 = pixelformat == V4L2_PIX_FMT_H264;
+
+	codec = avcodec_find_decoder(h264 ? AV_CODEC_ID_H264
+					  : AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		blog(LOG_ERROR, "%s: no %s decoder available", name,
+		     h264 ? "H.264" : "MJPEG");
+		return NULL;
+	}
+
+	dec = bzalloc(sizeof(*dec));
+	dec->source = source;
+	dec->name = bstrdup(name);
+	dec->color_range = color_range;
+	dec->h264 = h264;
+
+	if (h264) {
+		dec->num_workers = 1;
+	} else {
+		dec->num_workers = os_get_logical_cores() / 2;
+		if (dec->num_workers < 1)
+			dec->num_workers = 1;
+		if (dec->num_workers > MAX_DECODE_THREADS)
+			dec->num_workers = MAX_DECODE_THREADS;
+	}
+	dec->num_jobs = dec->num_workers * JOBS_PER_THREAD;
+
+	pthread_mutex_init_value(&dec->mutex);
+	if (pthread_mutex_init(&dec->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&dec->sem, 0) != 0)
+		goto fail;
+
+	dec->jobs = bzalloc(dec->num_jobs * sizeof(*dec->jobs));
+	dec->workers = bzalloc(dec->num_workers * sizeof(*dec->workers));
+
+	for (size_t i = 0; i < dec->num_workers; i++) {
+		if (!init_worker(dec, &dec->workers[i], codec, h264))
+			goto fail;
+	}
+
+	blog(LOG_INFO, "%s: decoding %s on %zu thread(s)", name,
+	     h264 ? "H.264" : "MJPEG", dec->num_workers);
+	return dec;
+
+fail:
+	blog(LOG_ERROR, "%s: failed to create decoder", name);
+	v4l2_decoder_destroy(dec);
+	return NULL;
+}
+
+void v4l2_decoder_destroy(struct v4l2_decoder *dec)
+{
+	if (!dec)
+		return;
+
+	os_atomic_set_bool(&dec->stop, true);
+	for (size_t i = 0; i < dec->num_workers; i++)
+		os_sem_post(dec->sem);
+
+	for (size_t i = 0; i < dec->num_workers; i++) {
+		struct decode_worker *w = &dec->workers[i];
+
+		if (w->thread_created)
+			pthread_join(w->thread, NULL);
+		avcodec_free_context(&w->ctx);
+		av_packet_free(&w->packet);
+	}
+
+	for (size_t i = 0; i < dec->num_jobs; i++) {
+		av_frame_free(&dec->jobs[i].frame);
+		bfree(dec->jobs[i].data);
+	}
+
+	if (dec->decoded || dec->dropped || dec->errors) {
+		double avg = dec->decoded ? (double)dec->latency_total_ns /
+						    (double)dec->decoded /
+						    1000000.0
+					  : 0.0;
+
+		blog(LOG_INFO,
+		     "%s: decoded %" PRIu64 " frames, latency avg %.2f ms, "
+		     "max %.2f ms, %" PRIu64 " dropped, %" PRIu64 " errors",
+		     dec->name, dec->decoded, avg,
+		     (double)dec->latency_max_ns / 1000000.0, dec->dropped,
+		     dec->errors);
+	}
+
+	os_sem_destroy(dec->sem);
+	pthread_mutex_destroy(&dec->mutex);
+	bfree(dec->workers);
+	bfree(dec->jobs);
+	bfree(dec->name);
+	bfree(dec);
+}
+
+bool v4l2_decoder_push(struct v4l2_decoder *dec, const uint8_t *data,
+		       size_t size, uint64_t timestamp)
+{
+	struct decode_job *job;
+
+	pthread_mutex_lock(&dec->mutex);
+	if (dec->wait_keyframe && !obs_avc_keyframe(data, size)) {
+		dec->dropped++;
+		pthread_mutex_unlock(&dec->mutex);
+		return false;
+	}
+
+	job = &dec->jobs[dec->push_seq % dec->num_jobs];
+	if (job->state != JOB_FREE) {
+		dec->dropped++;
+		dec->wait_keyframe = dec->h264;
+		pthread_mutex_unlock(&dec->mutex);
+		return false;
+	}
+
+	/* workers only see the job once the semaphore is posted, so the
+	 * copy can happen outside of the lock.  the decoder is flushed
+	 * before the keyframe that follows a drop so it doesn't keep
+	 * referencing pictures from before the gap */
+	job->state = JOB_QUEUED;
+	job->flush = dec->wait_keyframe;
+	dec->wait_keyframe = false;
+	dec->push_seq++;
+	pthread_mutex_unlock(&dec->mutex);
+
+	if (job->capacity < size + AV_INPUT_BUFFER_PADDING_SIZE) {
+		job->capacity = size + AV_INPUT_BUFFER_PADDING_SIZE;
+		bfree(job->data);
+		job->data = bmalloc(job->capacity);
+	}
+
+	memcpy(job->data, data, size);
+	memset(job->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	job->size = size;
+	job->timestamp = timestamp;
+	job->queued_ns = os_gettime_ns();
+
+	os_sem_post(dec->sem);
+	return true;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <linux/videodev2.h>
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decoder for compressed capture formats.
+ *
+ * Frames are decoded on a pool of worker threads and output to the source in
+ * capture order.  MJPEG frames are independent and are spread over all
+ * workers, H.264 is decoded by a single worker.
+ */
+struct v4l2_decoder;
+
+/**
+ * Check if a pixelformat is compressed and needs a decoder
+ *
+ * @param pixelformat v4l2 format id
+ *
+ * @return true if the format can be decoded
+ */
+static inline bool v4l2_is_compressed_format(uint_fast32_t pixelformat)
+{
+#if HAVE_V4L2_DECODER
+	switch (pixelformat) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:
+	case V4L2_PIX_FMT_H264:
+		return true;
+	}
+#else
+	UNUSED_PARAMETER(pixelformat);
+#endif
+	return false;
+}
+
+#if HAVE_V4L2_DECODER
+
+/**
+ * Create a decoder
+ *
+ * @param source the source to output decoded frames to
+ * @param name device name used for logging
+ * @param pixelformat compressed v4l2 format id
+ * @param color_range range to output, VIDEO_RANGE_DEFAULT to use the range
+ *        reported by the stream
+ *
+ * @return the decoder or NULL on failure
+ */
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 const char *name,
+					 uint_fast32_t pixelformat,
+					 enum video_range_type color_range);
+
+/**
+ * Destroy a decoder
+ *
+ * Waits for pending frames and logs decode statistics.
+ *
+ * @param dec the decoder
+ */
+void v4l2_decoder_destroy(struct v4l2_decoder *dec);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied, so the capture buffer can be requeued right away.
+ * Frames are dropped when all workers are busy.  For H.264, every frame up
+ * to the next keyframe is dropped as well, since they reference the
+ * dropped one.
+ *
+ * @param dec the decoder
+ * @param data compressed frame data
+ * @param size size of the data in bytes
+ * @param timestamp frame timestamp in nanoseconds
+ *
+ * @return false if the frame was dropped
+ */
+bool v4l2_decoder_push(struct v4l2_decoder *dec, const uint8_t *data,
+		       size_t size, uint64_t timestamp);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,23 +23,87 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-helpers: " msg, ##__VA_ARGS__)
 
-int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
+#define V4L2_BUFFER_COUNT 8
+
+static inline bool v4l2_is_mplane(const struct v4l2_buffer_data *buf)
+{
+	return buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+enum v4l2_buf_type v4l2_get_capture_type(int_fast32_t dev)
+{
+	struct v4l2_capability cap;
+	uint32_t caps;
+
+	if (v4l2_ioctl(dev, VIDIOC_QUERYCAP, &cap) < 0)
+		return V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+#ifndef V4L2_CAP_DEVICE_CAPS
+	caps = cap.capabilities;
+#else
+	caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+							 : cap.capabilities;
+#endif
+
+	if (!(caps & V4L2_CAP_VIDEO_CAPTURE) &&
+	    (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE))
+		return V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+	return V4L2_BUF_TYPE_VIDEO_CAPTURE;
+}
+
+void v4l2_prep_buffer(struct v4l2_buffer_data *buf, uint32_t index,
+		      struct v4l2_buffer *vbuf, struct v4l2_plane *planes)
+{
+	struct v4l2_mmap_info *info = &buf->info[index];
+
+	memset(vbuf, 0, sizeof(*vbuf));
+	vbuf->type = buf->type;
+	vbuf->memory = buf->memory;
+	vbuf->index = index;
+
+	if (v4l2_is_mplane(buf)) {
+		memset(planes, 0, sizeof(*planes) * VIDEO_MAX_PLANES);
+		vbuf->m.planes = planes;
+		vbuf->length = buf->num_planes;
+
+		if (buf->memory == V4L2_MEMORY_USERPTR) {
+			for (uint32_t p = 0; p < buf->num_planes; ++p) {
+				planes[p].m.userptr =
+					(unsigned long)info->start[p];
+				planes[p].length = info->length[p];
+			}
+		}
+	} else if (buf->memory == V4L2_MEMORY_USERPTR) {
+		vbuf->m.userptr = (unsigned long)info->start[0];
+		vbuf->length = info->length[0];
+	}
+}
+
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, struct v4l2_buffer_data *buf,
+			       uint32_t index)
 {
-	enum v4l2_buf_type type;
 	struct v4l2_buffer enq;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
 
-	memset(&enq, 0, sizeof(enq));
-	enq.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	enq.memory = V4L2_MEMORY_MMAP;
+	v4l2_prep_buffer(buf, index, &enq, planes);
+	return v4l2_ioctl(dev, VIDIOC_QBUF, &enq);
+}
+
+int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
+{
+	enum v4l2_buf_type type;
 
-	for (enq.index = 0; enq.index < buf->count; ++enq.index) {
-		if (v4l2_ioctl(dev, VIDIOC_QBUF, &enq) < 0) {
+	for (uint32_t i = 0; i < buf->count; ++i) {
+		if (buf->info[i].held)
+			continue;
+		if (v4l2_queue_buffer(dev, buf, i) < 0) {
 			blog(LOG_ERROR, "unable to queue buffer");
 			return -1;
 		}
 	}
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	type = buf->type;
 	if (v4l2_ioctl(dev, VIDIOC_STREAMON, &type) < 0) {
 		blog(LOG_ERROR, "unable to start stream");
 		return -1;
@@ -48,11 +112,11 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 	return 0;
 }
 
-int_fast32_t v4l2_stop_capture(int_fast32_t dev)
+int_fast32_t v4l2_stop_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 {
 	enum v4l2_buf_type type;
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	type = buf->type;
 	if (v4l2_ioctl(dev, VIDIOC_STREAMOFF, &type) < 0) {
 		blog(LOG_ERROR, "unable to stop stream");
 		return -1;
@@ -64,7 +128,7 @@ int_fast32_t v4l2_stop_capture(int_fast32_t dev)
 int_fast32_t v4l2_reset_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 {
 	blog(LOG_DEBUG, "attempting to reset capture");
-	if (v4l2_stop_capture(dev) < 0)
+	if (v4l2_stop_capture(dev, buf) < 0)
 		return -1;
 	if (v4l2_start_capture(dev, buf) < 0)
 		return -1;
@@ -77,14 +141,13 @@ int_fast32_t v4l2_query_all_buffers(int_fast32_t dev,
 				    struct v4l2_buffer_data *buf_data)
 {
 	struct v4l2_buffer buf;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
 
 	blog(LOG_DEBUG, "attempting to read buffer data for %ld buffers",
 	     buf_data->count);
 
 	for (uint_fast32_t i = 0; i < buf_data->count; i++) {
-		buf.index = i;
-		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		buf.memory = V4L2_MEMORY_MMAP;
+		v4l2_prep_buffer(buf_data, i, &buf, planes);
 		if (v4l2_ioctl(dev, VIDIOC_QUERYBUF, &buf) < 0) {
 			blog(LOG_DEBUG,
 			     "failed to read buffer data for buffer #%ld", i);
@@ -100,58 +163,172 @@ int_fast32_t v4l2_query_all_buffers(int_fast32_t dev,
 }
 #endif
 
-int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
+/**
+ * Request buffers from the device
+ *
+ * @return number of buffers or 0 on failure
+ */
+static uint32_t v4l2_request_buffers(int_fast32_t dev,
+				     struct v4l2_buffer_data *buf,
+				     enum v4l2_memory memory, uint32_t count)
 {
 	struct v4l2_requestbuffers req;
-	struct v4l2_buffer map;
 
 	memset(&req, 0, sizeof(req));
-	req.count = 4;
-	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	req.memory = V4L2_MEMORY_MMAP;
+	req.count = count;
+	req.type = buf->type;
+	req.memory = memory;
 
-	if (v4l2_ioctl(dev, VIDIOC_REQBUFS, &req) < 0) {
-		blog(LOG_ERROR, "Request for buffers failed !");
-		return -1;
-	}
+	if (v4l2_ioctl(dev, VIDIOC_REQBUFS, &req) < 0)
+		return 0;
 
-	if (req.count < 2) {
-		blog(LOG_ERROR, "Device returned less than 2 buffers");
-		return -1;
+	return req.count;
+}
+
+/**
+ * Allocate page aligned application memory for userptr buffers
+ */
+static int_fast32_t v4l2_alloc_userptr(struct v4l2_buffer_data *buf,
+				       const size_t *sizes)
+{
+	for (uint_fast32_t i = 0; i < buf->count; ++i) {
+		for (uint32_t p = 0; p < buf->num_planes; ++p) {
+			struct v4l2_mmap_info *info = &buf->info[i];
+
+			info->length[p] = sizes[p];
+			info->start[p] = mmap(NULL, sizes[p],
+					      PROT_READ | PROT_WRITE,
+					      MAP_PRIVATE | MAP_ANONYMOUS, -1,
+					      0);
+
+			if (info->start[p] == MAP_FAILED) {
+				blog(LOG_ERROR, "allocating buffer failed");
+				return -1;
+			}
+		}
 	}
 
-	buf->count = req.count;
-	buf->info = bzalloc(req.count * sizeof(struct v4l2_mmap_info));
+	return 0;
+}
+
+static int_fast32_t v4l2_map_buffers(int_fast32_t dev,
+				     struct v4l2_buffer_data *buf)
+{
+	struct v4l2_buffer map;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
 
-	memset(&map, 0, sizeof(map));
-	map.type = req.type;
-	map.memory = req.memory;
+	for (uint32_t i = 0; i < buf->count; ++i) {
+		struct v4l2_mmap_info *info = &buf->info[i];
 
-	for (map.index = 0; map.index < req.count; ++map.index) {
+		v4l2_prep_buffer(buf, i, &map, planes);
 		if (v4l2_ioctl(dev, VIDIOC_QUERYBUF, &map) < 0) {
 			blog(LOG_ERROR, "Failed to query buffer details");
 			return -1;
 		}
 
-		buf->info[map.index].length = map.length;
-		buf->info[map.index].start =
-			v4l2_mmap(NULL, map.length, PROT_READ | PROT_WRITE,
-				  MAP_SHARED, dev, map.m.offset);
-
-		if (buf->info[map.index].start == MAP_FAILED) {
-			blog(LOG_ERROR, "mmap for buffer failed");
-			return -1;
+		for (uint32_t p = 0; p < buf->num_planes; ++p) {
+			size_t length = v4l2_is_mplane(buf) ? planes[p].length
+							    : map.length;
+			off_t offset = v4l2_is_mplane(buf)
+					       ? planes[p].m.mem_offset
+					       : map.m.offset;
+
+			info->length[p] = length;
+			info->start[p] = v4l2_mmap(NULL, length,
+						   PROT_READ | PROT_WRITE,
+						   MAP_SHARED, dev, offset);
+
+			if (info->start[p] == MAP_FAILED) {
+				blog(LOG_ERROR, "mmap for buffer failed");
+				return -1;
+			}
 		}
 	}
 
 	return 0;
 }
 
+int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
+{
+	struct v4l2_format fmt;
+	size_t sizes[VIDEO_MAX_PLANES];
+	uint32_t count;
+
+	memset(buf, 0, sizeof(*buf));
+	buf->type = v4l2_get_capture_type(dev);
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = buf->type;
+	if (v4l2_ioctl(dev, VIDIOC_G_FMT, &fmt) < 0) {
+		blog(LOG_ERROR, "Failed to query format");
+		return -1;
+	}
+
+	if (v4l2_is_mplane(buf)) {
+		buf->num_planes = fmt.fmt.pix_mp.num_planes;
+		for (uint32_t p = 0; p < buf->num_planes; ++p)
+			sizes[p] = fmt.fmt.pix_mp.plane_fmt[p].sizeimage;
+	} else {
+		buf->num_planes = 1;
+		sizes[0] = fmt.fmt.pix.sizeimage;
+	}
+
+	if (!buf->num_planes || buf->num_planes > VIDEO_MAX_PLANES) {
+		blog(LOG_ERROR, "Invalid number of planes: %u",
+		     buf->num_planes);
+		return -1;
+	}
+
+	/* userptr lets the driver write straight to our memory, which stays
+	 * valid for as long as we hold it without keeping a driver mapping
+	 * alive. drivers that can't do it (or report no image size) use mmap */
+	buf->memory = V4L2_MEMORY_USERPTR;
+	count = sizes[0] ? v4l2_request_buffers(dev, buf, V4L2_MEMORY_USERPTR,
+						V4L2_BUFFER_COUNT)
+			 : 0;
+
+	if (!count) {
+		buf->memory = V4L2_MEMORY_MMAP;
+		count = v4l2_request_buffers(dev, buf, V4L2_MEMORY_MMAP,
+					     V4L2_BUFFER_COUNT);
+	}
+
+	if (!count) {
+		blog(LOG_ERROR, "Request for buffers failed !");
+		return -1;
+	}
+
+	if (count < 2) {
+		blog(LOG_ERROR, "Device returned less than 2 buffers");
+		return -1;
+	}
+
+	buf->count = count;
+	buf->info = bzalloc(count * sizeof(struct v4l2_mmap_info));
+
+	blog(LOG_INFO, "Using %u %s buffers with %u plane(s)", count,
+	     buf->memory == V4L2_MEMORY_USERPTR ? "userptr" : "mmap",
+	     buf->num_planes);
+
+	return buf->memory == V4L2_MEMORY_USERPTR
+		       ? v4l2_alloc_userptr(buf, sizes)
+		       : v4l2_map_buffers(dev, buf);
+}
+
 int_fast32_t v4l2_destroy_mmap(struct v4l2_buffer_data *buf)
 {
 	for (uint_fast32_t i = 0; i < buf->count; ++i) {
-		if (buf->info[i].start != MAP_FAILED && buf->info[i].start != 0)
-			v4l2_munmap(buf->info[i].start, buf->info[i].length);
+		struct v4l2_mmap_info *info = &buf->info[i];
+
+		for (uint32_t p = 0; p < buf->num_planes; ++p) {
+			if (info->start[p] == MAP_FAILED || !info->start[p])
+				continue;
+
+			if (buf->memory == V4L2_MEMORY_USERPTR)
+				munmap(info->start[p], info->length[p]);
+			else
+				v4l2_munmap(info->start[p], info->length[p]);
+		}
 	}
 
 	if (buf->count) {
@@ -198,34 +375,53 @@ int_fast32_t v4l2_set_format(int_fast32_t dev, int *resolution,
 	bool set = false;
 	int width, height;
 	struct v4l2_format fmt;
+	bool mplane;
 
 	if (!dev || !resolution || !pixelformat || !bytesperline)
 		return -1;
 
 	/* We need to set the type in order to query the settings */
-	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = v4l2_get_capture_type(dev);
+	mplane = fmt.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 
 	if (v4l2_ioctl(dev, VIDIOC_G_FMT, &fmt) < 0)
 		return -1;
 
 	if (*resolution != -1) {
 		v4l2_unpack_tuple(&width, &height, *resolution);
-		fmt.fmt.pix.width = width;
-		fmt.fmt.pix.height = height;
+		if (mplane) {
+			fmt.fmt.pix_mp.width = width;
+			fmt.fmt.pix_mp.height = height;
+		} else {
+			fmt.fmt.pix.width = width;
+			fmt.fmt.pix.height = height;
+		}
 		set = true;
 	}
 
 	if (*pixelformat != -1) {
-		fmt.fmt.pix.pixelformat = *pixelformat;
+		if (mplane)
+			fmt.fmt.pix_mp.pixelformat = *pixelformat;
+		else
+			fmt.fmt.pix.pixelformat = *pixelformat;
 		set = true;
 	}
 
 	if (set && (v4l2_ioctl(dev, VIDIOC_S_FMT, &fmt) < 0))
 		return -1;
 
-	*resolution = v4l2_pack_tuple(fmt.fmt.pix.width, fmt.fmt.pix.height);
-	*pixelformat = fmt.fmt.pix.pixelformat;
-	*bytesperline = fmt.fmt.pix.bytesperline;
+	if (mplane) {
+		*resolution = v4l2_pack_tuple(fmt.fmt.pix_mp.width,
+					      fmt.fmt.pix_mp.height);
+		*pixelformat = fmt.fmt.pix_mp.pixelformat;
+		*bytesperline = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+	} else {
+		*resolution = v4l2_pack_tuple(fmt.fmt.pix.width,
+					      fmt.fmt.pix.height);
+		*pixelformat = fmt.fmt.pix.pixelformat;
+		*bytesperline = fmt.fmt.pix.bytesperline;
+	}
 	return 0;
 }
 
@@ -239,7 +435,7 @@ int_fast32_t v4l2_set_framerate(int_fast32_t dev, int *framerate)
 		return -1;
 
 	/* We need to set the type in order to query the stream settings */
-	par.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	par.type = v4l2_get_capture_type(dev);
 
 	if (v4l2_ioctl(dev, VIDIOC_G_PARM, &par) < 0)
 		return -1;
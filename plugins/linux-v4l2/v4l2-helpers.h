@@ -31,10 +31,12 @@ extern "C" {
  * Data structure for mapped buffers
  */
 struct v4l2_mmap_info {
-	/** length of the mapped buffer */
-	size_t length;
-	/** start address of the mapped buffer */
-	void *start;
+	/** length of the mapped planes */
+	size_t length[VIDEO_MAX_PLANES];
+	/** start addresses of the mapped planes */
+	void *start[VIDEO_MAX_PLANES];
+	/** buffer is in use by the application and must not be enqueued */
+	bool held;
 };
 
 /**
@@ -45,6 +47,12 @@ struct v4l2_buffer_data {
 	uint_fast32_t count;
 	/** memory info for mapped buffers */
 	struct v4l2_mmap_info *info;
+	/** single- or multi-planar capture */
+	enum v4l2_buf_type type;
+	/** V4L2_MEMORY_USERPTR or V4L2_MEMORY_MMAP */
+	enum v4l2_memory memory;
+	/** number of memory planes per buffer */
+	uint32_t num_planes;
 };
 
 /**
@@ -64,8 +72,10 @@ static inline enum video_format v4l2_to_obs_video_format(uint_fast32_t format)
 	case V4L2_PIX_FMT_UYVY:
 		return VIDEO_FORMAT_UYVY;
 	case V4L2_PIX_FMT_NV12:
+	case V4L2_PIX_FMT_NV12M:
 		return VIDEO_FORMAT_NV12;
 	case V4L2_PIX_FMT_YUV420:
+	case V4L2_PIX_FMT_YUV420M:
 		return VIDEO_FORMAT_I420;
 	case V4L2_PIX_FMT_YVU420:
 		return VIDEO_FORMAT_I420;
@@ -162,11 +172,48 @@ static void v4l2_unpack_tuple(int *a, int *b, int packed)
 	*b = packed & 0xffff;
 }
 
+/**
+ * Get the buffer type used for video capture on the device.
+ *
+ * Devices that only support the multi-planar api (common for hdmi capture
+ * bridges and soc camera interfaces) need to use the _MPLANE variants for all
+ * format and buffer ioctls.
+ *
+ * @param dev handle for the v4l2 device
+ *
+ * @return V4L2_BUF_TYPE_VIDEO_CAPTURE or V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
+ */
+enum v4l2_buf_type v4l2_get_capture_type(int_fast32_t dev);
+
+/**
+ * Prepare a buffer struct for VIDIOC_QBUF / VIDIOC_DQBUF.
+ *
+ * @param buf buffer data
+ * @param index index of the buffer
+ * @param vbuf buffer struct to initialize
+ * @param planes plane array with at least VIDEO_MAX_PLANES entries, used for
+ *               multi-planar capture
+ */
+void v4l2_prep_buffer(struct v4l2_buffer_data *buf, uint32_t index,
+		      struct v4l2_buffer *vbuf, struct v4l2_plane *planes);
+
+/**
+ * Enqueue a single buffer.
+ *
+ * @param dev handle for the v4l2 device
+ * @param buf buffer data
+ * @param index index of the buffer
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, struct v4l2_buffer_data *buf,
+			       uint32_t index);
+
 /**
  * Start the video capture on the device.
  *
- * This enqueues the memory mapped buffers and instructs the device to start
- * the video stream.
+ * This enqueues all buffers that are not held by the application and
+ * instructs the device to start the video stream.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
@@ -179,10 +226,11 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf);
  * Stop the video capture on the device.
  *
  * @param dev handle for the v4l2 device
+ * @param buf buffer data
  *
  * @return negative on failure
  */
-int_fast32_t v4l2_stop_capture(int_fast32_t dev);
+int_fast32_t v4l2_stop_capture(int_fast32_t dev, struct v4l2_buffer_data *buf);
 
 /**
  * Resets video capture on the device.
@@ -215,7 +263,10 @@ int_fast32_t v4l2_query_all_buffers(int_fast32_t dev,
 /**
  * Create memory mapping for buffers
  *
- * This tries to map at least 2, preferably 4, buffers to application memory.
+ * This tries to set up at least 2, preferably 8, buffers. Application
+ * allocated (userptr) buffers are preferred, if the device does not support
+ * them the buffers are memory mapped from the driver instead.
+ * The format has to be set before calling this.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
@@ -37,6 +37,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "v4l2-controls.h"
 #include "v4l2-helpers.h"
+#include "v4l2-decoder.h"
 
 #if HAVE_UDEV
 #include "v4l2-udev.h"
@@ -62,6 +63,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/**
+ * Capture buffers shared by the capture thread and frames handed to libobs
+ *
+ * Raw frames are passed to libobs without copying and the buffer is only
+ * enqueued again once libobs releases the frame. That can happen after the
+ * source was destroyed, so the pool is reference counted and the device
+ * handle is cleared once capture has been shut down.
+ */
+struct v4l2_buffer_pool {
+	volatile long refs;
+	pthread_mutex_t mutex;
+	int_fast32_t dev;
+	bool streaming;
+	uint_fast32_t held;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_pool_slot {
+		struct v4l2_buffer_pool *pool;
+		uint32_t index;
+	} * slots;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -87,17 +109,160 @@ struct v4l2_data {
 	int width;
 	int height;
 	int linesize;
-	struct v4l2_buffer_data buffers;
+	struct v4l2_buffer_pool *pool;
+#if HAVE_V4L2_DECODER
+	struct v4l2_decoder *decoder;
+#endif
 
 	bool auto_reset;
 	int timeout_frames;
 };
 
+/* minimum number of buffers kept queued when handing out buffers directly */
+#define V4L2_MIN_QUEUED 2
+
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 static void v4l2_update(void *vptr, obs_data_t *settings);
 
+/**
+ * Check if frames in a pixelformat can be output, either directly or through
+ * the decoder
+ */
+static inline bool v4l2_format_supported(uint_fast32_t pixelformat)
+{
+	return v4l2_to_obs_video_format(pixelformat) != VIDEO_FORMAT_NONE ||
+	       v4l2_is_compressed_format(pixelformat);
+}
+
+static struct v4l2_buffer_pool *v4l2_pool_create(int_fast32_t dev)
+{
+	struct v4l2_buffer_pool *pool = bzalloc(sizeof(*pool));
+
+	pool->refs = 1;
+	pool->dev = dev;
+	pthread_mutex_init(&pool->mutex, NULL);
+
+	if (v4l2_create_mmap(dev, &pool->buffers) < 0) {
+		v4l2_destroy_mmap(&pool->buffers);
+		pthread_mutex_destroy(&pool->mutex);
+		bfree(pool);
+		return NULL;
+	}
+
+	pool->slots = bmalloc(pool->buffers.count * sizeof(*pool->slots));
+	for (uint32_t i = 0; i < pool->buffers.count; ++i) {
+		pool->slots[i].pool = pool;
+		pool->slots[i].index = i;
+	}
+
+	return pool;
+}
+
+static void v4l2_pool_release(struct v4l2_buffer_pool *pool)
+{
+	if (!pool || os_atomic_dec_long(&pool->refs) != 0)
+		return;
+
+	v4l2_destroy_mmap(&pool->buffers);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->slots);
+	bfree(pool);
+}
+
+/**
+ * Detach the pool from the device, outstanding frames keep their memory
+ * but are no longer enqueued on release
+ */
+static void v4l2_pool_shutdown(struct v4l2_buffer_pool *pool)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->dev = -1;
+	pool->streaming = false;
+	pthread_mutex_unlock(&pool->mutex);
+
+	v4l2_pool_release(pool);
+}
+
+/**
+ * Called by libobs once a directly output frame is no longer used
+ */
+static void v4l2_release_buffer(void *param)
+{
+	struct v4l2_pool_slot *slot = param;
+	struct v4l2_buffer_pool *pool = slot->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->buffers.info[slot->index].held = false;
+	pool->held--;
+
+	/* when the stream is stopped, starting it again enqueues the buffer */
+	if (pool->streaming &&
+	    v4l2_queue_buffer(pool->dev, &pool->buffers, slot->index) < 0)
+		blog(LOG_ERROR, "failed to enqueue released buffer");
+	pthread_mutex_unlock(&pool->mutex);
+
+	v4l2_pool_release(pool);
+}
+
+/**
+ * Try to take a dequeued buffer for direct output
+ *
+ * @return false if too few buffers would be left for the device, in which
+ *         case the frame has to be copied
+ */
+static bool v4l2_pool_hold(struct v4l2_buffer_pool *pool, uint32_t index)
+{
+	bool hold;
+
+	pthread_mutex_lock(&pool->mutex);
+	hold = pool->held + V4L2_MIN_QUEUED < pool->buffers.count;
+	if (hold) {
+		pool->buffers.info[index].held = true;
+		pool->held++;
+		os_atomic_inc_long(&pool->refs);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return hold;
+}
+
+static int_fast32_t v4l2_pool_start(struct v4l2_buffer_pool *pool)
+{
+	int_fast32_t ret;
+
+	pthread_mutex_lock(&pool->mutex);
+	ret = v4l2_start_capture(pool->dev, &pool->buffers);
+	pool->streaming = ret == 0;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return ret;
+}
+
+static void v4l2_pool_stop(struct v4l2_buffer_pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	v4l2_stop_capture(pool->dev, &pool->buffers);
+	pool->streaming = false;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static int_fast32_t v4l2_pool_reset(struct v4l2_buffer_pool *pool)
+{
+	int_fast32_t ret;
+
+	pthread_mutex_lock(&pool->mutex);
+	ret = v4l2_reset_capture(pool->dev, &pool->buffers);
+	pool->streaming = ret == 0;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return ret;
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -105,9 +270,10 @@ static void v4l2_update(void *vptr, obs_data_t *settings);
  * before the capture starts. This function prepares the obs_source_frame
  * struct with all the data that is already known.
  *
- * v4l2 uses a continuous memory segment for all planes so we simply compute
- * offsets to add to the start address in order to give obs the correct data
- * pointers for the individual planes.
+ * Single-planar formats use a continuous memory segment for all planes so we
+ * simply compute offsets to add to the start address in order to give obs the
+ * correct data pointers for the individual planes. Formats with one memory
+ * plane per image plane (NV12M, YUV420M) get all offsets left at zero.
  */
 static void v4l2_prep_obs_frame(struct v4l2_data *data,
 				struct obs_source_frame *frame,
@@ -124,6 +290,15 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 				    frame->color_range_max);
 
 	switch (data->pixfmt) {
+	case V4L2_PIX_FMT_NV12M:
+		frame->linesize[0] = data->linesize;
+		frame->linesize[1] = data->linesize;
+		break;
+	case V4L2_PIX_FMT_YUV420M:
+		frame->linesize[0] = data->linesize;
+		frame->linesize[1] = data->linesize / 2;
+		frame->linesize[2] = data->linesize / 2;
+		break;
 	case V4L2_PIX_FMT_NV12:
 		frame->linesize[0] = data->linesize;
 		frame->linesize[1] = data->linesize;
@@ -162,6 +337,12 @@ static void *v4l2_thread(void *vptr)
 	uint64_t first_ts;
 	struct timeval tv;
 	struct v4l2_buffer buf;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct v4l2_buffer_pool *pool = data->pool;
+	struct v4l2_buffer_data *buffers = &pool->buffers;
+	struct v4l2_mmap_info *info;
+	uint32_t bytesused;
+	bool multi_planar;
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
 	int fps_num, fps_denom;
@@ -180,7 +361,7 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_INFO, "%s: select timeout set to %ldus (%dx frame periods)",
 	     data->device_id, timeout_usec, data->timeout_frames);
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	if (v4l2_pool_start(pool) < 0)
 		goto exit;
 
 	blog(LOG_DEBUG, "%s: new capture started", data->device_id);
@@ -188,6 +369,7 @@ static void *v4l2_thread(void *vptr)
 	frames = 0;
 	first_ts = 0;
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
+	multi_planar = buffers->num_planes > 1;
 
 	blog(LOG_DEBUG, "%s: obs frame prepared", data->device_id);
 
@@ -210,7 +392,7 @@ static void *v4l2_thread(void *vptr)
 			     data->device_id);
 
 #ifdef _DEBUG
-			v4l2_query_all_buffers(data->dev, &data->buffers);
+			v4l2_query_all_buffers(data->dev, buffers);
 #endif
 
 			if (v4l2_ioctl(data->dev, VIDIOC_LOG_STATUS) < 0) {
@@ -219,8 +401,7 @@ static void *v4l2_thread(void *vptr)
 			}
 
 			if (data->auto_reset) {
-				if (v4l2_reset_capture(data->dev,
-						       &data->buffers) == 0)
+				if (v4l2_pool_reset(pool) == 0)
 					blog(LOG_INFO,
 					     "%s: stream reset successful",
 					     data->device_id);
@@ -232,8 +413,7 @@ static void *v4l2_thread(void *vptr)
 			continue;
 		}
 
-		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		buf.memory = V4L2_MEMORY_MMAP;
+		v4l2_prep_buffer(buffers, 0, &buf, planes);
 
 		if (v4l2_ioctl(data->dev, VIDIOC_DQBUF, &buf) < 0) {
 			if (errno == EAGAIN) {
@@ -246,20 +426,48 @@ static void *v4l2_thread(void *vptr)
 			break;
 		}
 
+		bytesused = buffers->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
+				    ? planes[0].bytesused
+				    : buf.bytesused;
+
 		blog(LOG_DEBUG,
 		     "%s: ts: %06ld buf id #%d, flags 0x%08X, seq #%d, len %d, used %d",
 		     data->device_id, buf.timestamp.tv_usec, buf.index,
-		     buf.flags, buf.sequence, buf.length, buf.bytesused);
+		     buf.flags, buf.sequence, buf.length, bytesused);
 
 		out.timestamp = timeval2ns(buf.timestamp);
 		if (!frames)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *)data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+		info = &buffers->info[buf.index];
+		start = (uint8_t *)info->start[0];
+#if HAVE_V4L2_DECODER
+		if (data->decoder) {
+			v4l2_decoder_push(data->decoder, start, bytesused,
+					  out.timestamp);
+		} else
+#endif
+		{
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
+				if (!multi_planar)
+					out.data[i] = start + plane_offsets[i];
+				else if (i < buffers->num_planes)
+					out.data[i] = info->start[i];
+				else
+					out.data[i] = NULL;
+			}
+
+			if (v4l2_pool_hold(pool, buf.index)) {
+				obs_source_output_video_external(
+					data->source, &out, v4l2_release_buffer,
+					&pool->slots[buf.index]);
+				frames++;
+				continue;
+			}
+
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_ERROR, "%s: failed to enqueue buffer",
@@ -274,7 +482,7 @@ static void *v4l2_thread(void *vptr)
 	     data->device_id, frames);
 
 exit:
-	v4l2_stop_capture(data->dev);
+	v4l2_pool_stop(pool);
 	return NULL;
 }
 
@@ -386,7 +594,8 @@ static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
 			       : video_cap.capabilities;
 #endif
 
-		if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
+		if (!(caps & (V4L2_CAP_VIDEO_CAPTURE |
+			      V4L2_CAP_VIDEO_CAPTURE_MPLANE))) {
 			blog(LOG_INFO, "%s seems to not support video capture",
 			     device.array);
 			v4l2_close(fd);
@@ -444,7 +653,7 @@ static void v4l2_input_list(int_fast32_t dev, obs_property_t *prop)
 static void v4l2_format_list(int dev, obs_property_t *prop)
 {
 	struct v4l2_fmtdesc fmt;
-	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.type = v4l2_get_capture_type(dev);
 	fmt.index = 0;
 	struct dstr buffer;
 	dstr_init(&buffer);
@@ -456,8 +665,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat) !=
-		    VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 						  fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -890,7 +1098,13 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
-	v4l2_destroy_mmap(&data->buffers);
+#if HAVE_V4L2_DECODER
+	v4l2_decoder_destroy(data->decoder);
+	data->decoder = NULL;
+#endif
+
+	v4l2_pool_shutdown(data->pool);
+	data->pool = NULL;
 
 	if (data->dev != -1) {
 		v4l2_close(data->dev);
@@ -980,7 +1194,7 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -998,11 +1212,23 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float)fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	data->pool = v4l2_pool_create(data->dev);
+	if (!data->pool) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
 
+#if HAVE_V4L2_DECODER
+	if (v4l2_is_compressed_format(data->pixfmt)) {
+		data->decoder = v4l2_decoder_create(data->source,
+						    data->device_id,
+						    data->pixfmt,
+						    data->color_range);
+		if (!data->decoder)
+			goto fail;
+	}
+#endif
+
 	/* start the capture thread */
 	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
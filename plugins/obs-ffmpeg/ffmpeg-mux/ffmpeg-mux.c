@@ -27,6 +27,7 @@
 #include "ffmpeg-mux.h"
 
 #include <util/dstr.h>
+#include <util/buffered-file-serializer.h>
 #include <libavformat/avformat.h>
 
 #define ANSI_COLOR_RED "\x1b[0;91m"
@@ -78,11 +79,17 @@ struct main_params {
 	char *file;
 	/* printable_file is file with any stream key information removed */
 	struct dstr printable_file;
-	int has_video;
+	int video_tracks;
 	int tracks;
+	char *acodec;
+	char *muxer_settings;
+	int write_buffer_mb;
+	int direct_io;
+};
+
+struct video_params {
 	char *vcodec;
 	int vbitrate;
-	int gop;
 	int width;
 	int height;
 	int fps_num;
@@ -91,8 +98,6 @@ struct main_params {
 	int color_trc;
 	int colorspace;
 	int color_range;
-	char *acodec;
-	char *muxer_settings;
 };
 
 struct audio_params {
@@ -107,6 +112,11 @@ struct header {
 	int size;
 };
 
+struct video_info {
+	AVStream *stream;
+	AVCodecContext *ctx;
+};
+
 struct audio_info {
 	AVStream *stream;
 	AVCodecContext *ctx;
@@ -114,13 +124,16 @@ struct audio_info {
 
 struct ffmpeg_mux {
 	AVFormatContext *output;
-	AVStream *video_stream;
-	AVCodecContext *video_ctx;
+	struct video_info *video_infos;
 	struct audio_info *audio_infos;
 	struct main_params params;
+	struct video_params *video;
 	struct audio_params *audio;
-	struct header video_header;
+	struct header *video_header;
 	struct header *audio_header;
+	struct serializer file;
+	bool file_open;
+	int num_video_streams;
 	int num_audio_streams;
 	bool initialized;
 	char error[4096];
@@ -131,20 +144,57 @@ static void header_free(struct header *header)
 	free(header->data);
 }
 
-static void free_avformat(struct ffmpeg_mux *ffm)
+static void close_buffered_file(struct ffmpeg_mux *ffm)
 {
-	if (ffm->output) {
-#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-		avcodec_free_context(&ffm->video_ctx);
+	struct buffered_file_serializer_stats stats;
+	AVIOContext *pb = ffm->output->pb;
+
+	if (pb) {
+		avio_flush(pb);
+		av_freep(&pb->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+		avio_context_free(&pb);
+#else
+		av_freep(&pb);
 #endif
+		ffm->output->pb = NULL;
+	}
+
+	buffered_file_serializer_get_stats(&ffm->file, &stats);
+	if (stats.stalls)
+		printf("info: Disk was too slow %llu time(s), waited %llu ms "
+		       "in total (longest write: %llu ms)\n",
+		       (unsigned long long)stats.stalls,
+		       (unsigned long long)(stats.stall_ns / 1000000),
+		       (unsigned long long)(stats.max_write_ns / 1000000));
+
+	if (!buffered_file_serializer_free(&ffm->file))
+		fprintf(stderr, "Failed to write all data to '%s'\n",
+			ffm->params.printable_file.array);
 
-		if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
+	ffm->file_open = false;
+}
+
+static void free_avformat(struct ffmpeg_mux *ffm)
+{
+	if (ffm->output) {
+		if (ffm->file_open)
+			close_buffered_file(ffm);
+		else if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
 			avio_close(ffm->output->pb);
 
 		avformat_free_context(ffm->output);
 		ffm->output = NULL;
 	}
 
+	if (ffm->video_infos) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+		for (int i = 0; i < ffm->num_video_streams; ++i)
+			avcodec_free_context(&ffm->video_infos[i].ctx);
+#endif
+		free(ffm->video_infos);
+	}
+
 	if (ffm->audio_infos) {
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 		for (int i = 0; i < ffm->num_audio_streams; ++i)
@@ -153,8 +203,9 @@ static void free_avformat(struct ffmpeg_mux *ffm)
 		free(ffm->audio_infos);
 	}
 
-	ffm->video_stream = NULL;
+	ffm->video_infos = NULL;
 	ffm->audio_infos = NULL;
+	ffm->num_video_streams = 0;
 	ffm->num_audio_streams = 0;
 }
 
@@ -166,7 +217,13 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 
 	free_avformat(ffm);
 
-	header_free(&ffm->video_header);
+	if (ffm->video_header) {
+		for (int i = 0; i < ffm->params.video_tracks; i++) {
+			header_free(&ffm->video_header[i]);
+		}
+
+		free(ffm->video_header);
+	}
 
 	if (ffm->audio_header) {
 		for (int i = 0; i < ffm->params.tracks; i++) {
@@ -176,6 +233,10 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 		free(ffm->audio_header);
 	}
 
+	if (ffm->video) {
+		free(ffm->video);
+	}
+
 	if (ffm->audio) {
 		free(ffm->audio);
 	}
@@ -214,6 +275,33 @@ static bool get_opt_int(int *p_argc, char ***p_argv, int *i, const char *opt)
 	return true;
 }
 
+static bool get_video_params(struct video_params *video, int *argc,
+			     char ***argv)
+{
+	if (!get_opt_str(argc, argv, &video->vcodec, "video codec"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->vbitrate, "video bitrate"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->width, "video width"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->height, "video height"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->color_primaries,
+			 "video color primaries"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->color_trc, "video color trc"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->colorspace, "video colorspace"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->color_range, "video color range"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->fps_num, "video fps num"))
+		return false;
+	if (!get_opt_int(argc, argv, &video->fps_den, "video fps den"))
+		return false;
+	return true;
+}
+
 static bool get_audio_params(struct audio_params *audio, int *argc,
 			     char ***argv)
 {
@@ -269,18 +357,21 @@ static void ffmpeg_log_callback(void *param, int level, const char *format,
 }
 
 static bool init_params(int *argc, char ***argv, struct main_params *params,
+			struct video_params **p_video,
 			struct audio_params **p_audio)
 {
+	struct video_params *video = NULL;
 	struct audio_params *audio = NULL;
 
 	if (!get_opt_str(argc, argv, &params->file, "file name"))
 		return false;
-	if (!get_opt_int(argc, argv, &params->has_video, "video track count"))
+	if (!get_opt_int(argc, argv, &params->video_tracks,
+			 "video track count"))
 		return false;
 	if (!get_opt_int(argc, argv, &params->tracks, "audio track count"))
 		return false;
 
-	if (params->has_video > 1 || params->has_video < 0) {
+	if (params->video_tracks < 0) {
 		puts("Invalid number of video tracks\n");
 		return false;
 	}
@@ -288,53 +379,40 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 		puts("Invalid number of audio tracks\n");
 		return false;
 	}
-	if (params->has_video == 0 && params->tracks == 0) {
+	if (params->video_tracks == 0 && params->tracks == 0) {
 		puts("Must have at least 1 audio track or 1 video track\n");
 		return false;
 	}
 
-	if (params->has_video) {
-		if (!get_opt_str(argc, argv, &params->vcodec, "video codec"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->vbitrate,
-				 "video bitrate"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->width, "video width"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->height, "video height"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->color_primaries,
-				 "video color primaries"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->color_trc,
-				 "video color trc"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->colorspace,
-				 "video colorspace"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->color_range,
-				 "video color range"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->fps_num, "video fps num"))
-			return false;
-		if (!get_opt_int(argc, argv, &params->fps_den, "video fps den"))
-			return false;
+	if (params->video_tracks) {
+		video = calloc(params->video_tracks, sizeof(*video));
+
+		for (int i = 0; i < params->video_tracks; i++) {
+			if (!get_video_params(&video[i], argc, argv)) {
+				free(video);
+				return false;
+			}
+		}
 	}
 
 	if (params->tracks) {
-		if (!get_opt_str(argc, argv, &params->acodec, "audio codec"))
+		if (!get_opt_str(argc, argv, &params->acodec, "audio codec")) {
+			free(video);
 			return false;
+		}
 
 		audio = calloc(params->tracks, sizeof(*audio));
 
 		for (int i = 0; i < params->tracks; i++) {
 			if (!get_audio_params(&audio[i], argc, argv)) {
+				free(video);
 				free(audio);
 				return false;
 			}
 		}
 	}
 
+	*p_video = video;
 	*p_audio = audio;
 
 	dstr_copy(&params->printable_file, params->file);
@@ -349,6 +427,13 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	/* optional, older callers don't pass these */
+	if (*argc)
+		get_opt_int(argc, argv, &params->write_buffer_mb,
+			    "write buffer size");
+	if (*argc)
+		get_opt_int(argc, argv, &params->direct_io, "direct io");
+
 	return true;
 }
 
@@ -379,54 +464,57 @@ static bool new_stream(struct ffmpeg_mux *ffm, AVStream **stream,
 	return true;
 }
 
-static void create_video_stream(struct ffmpeg_mux *ffm)
+static void create_video_stream(struct ffmpeg_mux *ffm, int idx)
 {
+	struct video_params *video = &ffm->video[idx];
 	AVCodec *codec;
 	AVCodecContext *context;
+	AVStream *stream;
 	void *extradata = NULL;
 
-	if (!new_stream(ffm, &ffm->video_stream, ffm->params.vcodec, &codec))
+	if (!new_stream(ffm, &stream, video->vcodec, &codec))
 		return;
 
-	if (ffm->video_header.size) {
-		extradata = av_memdup(ffm->video_header.data,
-				      ffm->video_header.size);
+	if (ffm->video_header[idx].size) {
+		extradata = av_memdup(ffm->video_header[idx].data,
+				      ffm->video_header[idx].size);
 	}
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 	context = avcodec_alloc_context3(codec);
 #else
-	context = ffm->video_stream->codec;
+	context = stream->codec;
 #endif
-	context->bit_rate = (int64_t)ffm->params.vbitrate * 1000;
-	context->width = ffm->params.width;
-	context->height = ffm->params.height;
-	context->coded_width = ffm->params.width;
-	context->coded_height = ffm->params.height;
-	context->color_primaries = ffm->params.color_primaries;
-	context->color_trc = ffm->params.color_trc;
-	context->colorspace = ffm->params.colorspace;
-	context->color_range = ffm->params.color_range;
+	context->bit_rate = (int64_t)video->vbitrate * 1000;
+	context->width = video->width;
+	context->height = video->height;
+	context->coded_width = video->width;
+	context->coded_height = video->height;
+	context->color_primaries = video->color_primaries;
+	context->color_trc = video->color_trc;
+	context->colorspace = video->colorspace;
+	context->color_range = video->color_range;
 	context->extradata = extradata;
-	context->extradata_size = ffm->video_header.size;
-	context->time_base =
-		(AVRational){ffm->params.fps_den, ffm->params.fps_num};
+	context->extradata_size = ffm->video_header[idx].size;
+	context->time_base = (AVRational){video->fps_den, video->fps_num};
 
-	ffm->video_stream->time_base = context->time_base;
+	stream->time_base = context->time_base;
 #if LIBAVFORMAT_VERSION_MAJOR < 59
 	// codec->time_base may still be used if LIBAVFORMAT_VERSION_MAJOR < 59
-	ffm->video_stream->codec->time_base = context->time_base;
+	stream->codec->time_base = context->time_base;
 #endif
-	ffm->video_stream->avg_frame_rate = av_inv_q(context->time_base);
+	stream->avg_frame_rate = av_inv_q(context->time_base);
 
 	if (ffm->output->oformat->flags & AVFMT_GLOBALHEADER)
 		context->flags |= CODEC_FLAG_GLOBAL_H;
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-	avcodec_parameters_from_context(ffm->video_stream->codecpar, context);
+	avcodec_parameters_from_context(stream->codecpar, context);
 #endif
 
-	ffm->video_ctx = context;
+	ffm->video_infos[ffm->num_video_streams].stream = stream;
+	ffm->video_infos[ffm->num_video_streams].ctx = context;
+	ffm->num_video_streams++;
 }
 
 static void create_audio_stream(struct ffmpeg_mux *ffm, int idx)
@@ -482,8 +570,13 @@ static void create_audio_stream(struct ffmpeg_mux *ffm, int idx)
 
 static bool init_streams(struct ffmpeg_mux *ffm)
 {
-	if (ffm->params.has_video)
-		create_video_stream(ffm);
+	if (ffm->params.video_tracks) {
+		ffm->video_infos = calloc(ffm->params.video_tracks,
+					  sizeof(*ffm->video_infos));
+
+		for (int i = 0; i < ffm->params.video_tracks; i++)
+			create_video_stream(ffm, i);
+	}
 
 	if (ffm->params.tracks) {
 		ffm->audio_infos =
@@ -493,7 +586,7 @@ static bool init_streams(struct ffmpeg_mux *ffm)
 			create_audio_stream(ffm, i);
 	}
 
-	if (!ffm->video_stream && !ffm->num_audio_streams)
+	if (!ffm->num_video_streams && !ffm->num_audio_streams)
 		return false;
 
 	return true;
@@ -510,7 +603,8 @@ static void ffmpeg_mux_header(struct ffmpeg_mux *ffm, uint8_t *data,
 			      struct ffm_packet_info *info)
 {
 	if (info->type == FFM_PACKET_VIDEO) {
-		set_header(&ffm->video_header, data, (size_t)info->size);
+		set_header(&ffm->video_header[info->index], data,
+			   (size_t)info->size);
 	} else {
 		set_header(&ffm->audio_header[info->index], data,
 			   (size_t)info->size);
@@ -556,7 +650,7 @@ static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
 
 static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
 {
-	if (ffm->params.has_video) {
+	for (int i = 0; i < ffm->params.video_tracks; i++) {
 		if (!ffmpeg_mux_get_header(ffm)) {
 			return false;
 		}
@@ -575,14 +669,85 @@ static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
 #pragma warning(disable : 4996)
 #endif
 
+#define AVIO_BUFFER_SIZE 65536
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+static int buffered_file_write(void *opaque, const uint8_t *buf, int buf_size)
+#else
+static int buffered_file_write(void *opaque, uint8_t *buf, int buf_size)
+#endif
+{
+	struct ffmpeg_mux *ffm = opaque;
+	size_t size = s_write(&ffm->file, buf, (size_t)buf_size);
+
+	return size == (size_t)buf_size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t buffered_file_seek(void *opaque, int64_t offset, int whence)
+{
+	struct ffmpeg_mux *ffm = opaque;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case SEEK_SET:
+		return serializer_seek(&ffm->file, offset,
+				       SERIALIZE_SEEK_START);
+	case SEEK_CUR:
+		return serializer_seek(&ffm->file, offset,
+				       SERIALIZE_SEEK_CURRENT);
+	case SEEK_END:
+		return serializer_seek(&ffm->file, offset, SERIALIZE_SEEK_END);
+	}
+
+	/* AVSEEK_SIZE, not needed for writing */
+	return -1;
+}
+
+/* local files are written through a buffered writer thread, so that slow
+ * disks don't immediately stall the pipe from obs */
+static int open_buffered_file(struct ffmpeg_mux *ffm)
+{
+	struct buffered_file_serializer_options opts = {0};
+	uint8_t *buf;
+
+	opts.buffer_size = (size_t)ffm->params.write_buffer_mb * 1024 * 1024;
+	opts.direct_io = !!ffm->params.direct_io;
+
+	if (!buffered_file_serializer_init(&ffm->file, ffm->params.file,
+					   &opts))
+		return AVERROR(EIO);
+
+	buf = av_malloc(AVIO_BUFFER_SIZE);
+	ffm->output->pb = buf ? avio_alloc_context(buf, AVIO_BUFFER_SIZE, 1,
+						   ffm, NULL,
+						   buffered_file_write,
+						   buffered_file_seek)
+			      : NULL;
+	if (!ffm->output->pb) {
+		av_free(buf);
+		buffered_file_serializer_free(&ffm->file);
+		return AVERROR(ENOMEM);
+	}
+
+	ffm->file_open = true;
+	return 0;
+}
+
+static inline bool ffmpeg_mux_is_local_file(struct ffmpeg_mux *ffm)
+{
+	return strstr(ffm->params.file, "://") == NULL;
+}
+
 static inline int open_output_file(struct ffmpeg_mux *ffm)
 {
 	AVOutputFormat *format = ffm->output->oformat;
 	int ret;
 
 	if ((format->flags & AVFMT_NOFILE) == 0) {
-		ret = avio_open(&ffm->output->pb, ffm->params.file,
-				AVIO_FLAG_WRITE);
+		if (ffmpeg_mux_is_local_file(ffm))
+			ret = open_buffered_file(ffm);
+		else
+			ret = avio_open(&ffm->output->pb, ffm->params.file,
+					AVIO_FLAG_WRITE);
 		if (ret < 0) {
 			fprintf(stderr, "Couldn't open '%s', %s\n",
 				ffm->params.printable_file.array,
@@ -697,9 +862,14 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 {
 	argc--;
 	argv++;
-	if (!init_params(&argc, &argv, &ffm->params, &ffm->audio))
+	if (!init_params(&argc, &argv, &ffm->params, &ffm->video, &ffm->audio))
 		return FFM_ERROR;
 
+	if (ffm->params.video_tracks) {
+		ffm->video_header = calloc(ffm->params.video_tracks,
+					   sizeof(*ffm->video_header));
+	}
+
 	if (ffm->params.tracks) {
 		ffm->audio_header =
 			calloc(ffm->params.tracks, sizeof(*ffm->audio_header));
@@ -733,8 +903,8 @@ static inline int get_index(struct ffmpeg_mux *ffm,
 			    struct ffm_packet_info *info)
 {
 	if (info->type == FFM_PACKET_VIDEO) {
-		if (ffm->video_stream) {
-			return ffm->video_stream->id;
+		if ((int)info->index < ffm->num_video_streams) {
+			return ffm->video_infos[info->index].stream->id;
 		}
 	} else {
 		if ((int)info->index < ffm->num_audio_streams) {
@@ -749,8 +919,8 @@ static AVCodecContext *get_codec_context(struct ffmpeg_mux *ffm,
 					 struct ffm_packet_info *info)
 {
 	if (info->type == FFM_PACKET_VIDEO) {
-		if (ffm->video_stream) {
-			return ffm->video_ctx;
+		if ((int)info->index < ffm->num_video_streams) {
+			return ffm->video_infos[info->index].ctx;
 		}
 	} else {
 		if ((int)info->index < ffm->num_audio_streams) {
@@ -21,7 +21,9 @@
 #include "util/windows/win-version.h"
 #endif
 
+#include <util/util_uint64.h>
 #include <libavformat/avformat.h>
+#include <inttypes.h>
 
 #define do_log(level, format, ...)                  \
 	blog(level, "[ffmpeg muxer: '%s'] " format, \
@@ -42,6 +44,12 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 	return obs_module_text("FFmpegMpegtsMuxer");
 }
 
+static const char *ffmpeg_abr_mux_getname(void *type)
+{
+	UNUSED_PARAMETER(type);
+	return obs_module_text("FFmpegAbrMuxer");
+}
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
 	while (stream->packets.size > 0) {
@@ -59,6 +67,14 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	stream->keyframes = 0;
 }
 
+static void release_split_packets(struct ffmpeg_muxer *stream)
+{
+	for (size_t i = 0; i < stream->split_packets.num; i++)
+		obs_encoder_packet_release(&stream->split_packets.array[i]);
+	da_resize(stream->split_packets, 0);
+	stream->split_pending = false;
+}
+
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -66,12 +82,21 @@ static void ffmpeg_mux_destroy(void *data)
 	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
+	if (stream->split_thread_joinable)
+		pthread_join(stream->split_thread, NULL);
+	os_process_pipe_destroy(stream->next_pipe);
+	release_split_packets(stream);
+	da_free(stream->split_packets);
 	da_free(stream->mux_packets);
 	circlebuf_free(&stream->packets);
 
 	os_process_pipe_destroy(stream->pipe);
 	dstr_free(&stream->path);
 	dstr_free(&stream->printable_path);
+	dstr_free(&stream->split_base);
+	dstr_free(&stream->split_ext);
+	dstr_free(&stream->closing_path);
+	dstr_free(&stream->next_path);
 	dstr_free(&stream->stream_key);
 	dstr_free(&stream->muxer_settings);
 	bfree(stream);
@@ -85,6 +110,10 @@ static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 	if (obs_output_get_flags(output) & OBS_OUTPUT_SERVICE)
 		stream->is_network = true;
 
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+	signal_handler_add(sh, "void file_changed(ptr output, "
+			       "string closed_file, string next_file)");
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -112,8 +141,7 @@ bool active(struct ffmpeg_muxer *stream)
 
 /* TODO: allow codecs other than h264 whenever we start using them */
 
-static void add_video_encoder_params(struct ffmpeg_muxer *stream,
-				     struct dstr *cmd, obs_encoder_t *vencoder)
+static void add_video_encoder_params(struct dstr *cmd, obs_encoder_t *vencoder)
 {
 	obs_data_t *settings = obs_encoder_get_settings(vencoder);
 	int bitrate = (int)obs_data_get_int(settings, "bitrate");
@@ -150,8 +178,8 @@ static void add_video_encoder_params(struct ffmpeg_muxer *stream,
 
 	dstr_catf(cmd, "%s %d %d %d %d %d %d %d %d %d ",
 		  obs_encoder_get_codec(vencoder), bitrate,
-		  obs_output_get_width(stream->output),
-		  obs_output_get_height(stream->output), (int)pri, (int)trc,
+		  (int)obs_encoder_get_width(vencoder),
+		  (int)obs_encoder_get_height(vencoder), (int)pri, (int)trc,
 		  (int)spc, (int)range, (int)info->fps_num, (int)info->fps_den);
 }
 
@@ -210,19 +238,46 @@ static void add_stream_key(struct dstr *cmd, struct ffmpeg_muxer *stream)
 			  : stream->stream_key.array);
 }
 
+/* Writes an empty moov followed by a moof/mdat fragment starting at each
+ * keyframe, once at least frag_duration_ms has passed since the previous
+ * one, so the file stays playable up to the last complete fragment.  These
+ * are prepended so custom muxer settings can still override them. */
+static void add_fragment_params(struct dstr *mux, obs_data_t *settings)
+{
+	int64_t frag_duration_ms;
+	struct dstr frag = {0};
+
+	if (!obs_data_get_bool(settings, "fragmented"))
+		return;
+
+	frag_duration_ms = obs_data_get_int(settings, "frag_duration_ms");
+
+	dstr_printf(&frag,
+		    "movflags=frag_keyframe+empty_moov+delay_moov"
+		    "+default_base_moof min_frag_duration=%" PRId64,
+		    frag_duration_ms * 1000);
+	if (!dstr_is_empty(mux))
+		dstr_cat_ch(&frag, ' ');
+
+	dstr_insert_dstr(mux, 0, &frag);
+	dstr_free(&frag);
+}
+
 static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 {
+	obs_data_t *settings = obs_output_get_settings(stream->output);
 	struct dstr mux = {0};
 
 	if (dstr_is_empty(&stream->muxer_settings)) {
-		obs_data_t *settings = obs_output_get_settings(stream->output);
 		dstr_copy(&mux,
 			  obs_data_get_string(settings, "muxer_settings"));
-		obs_data_release(settings);
 	} else {
 		dstr_copy(&mux, stream->muxer_settings.array);
 	}
 
+	add_fragment_params(&mux, settings);
+	obs_data_release(settings);
+
 	log_muxer_params(stream, mux.array);
 
 	dstr_replace(&mux, "\"", "\\\"");
@@ -232,13 +287,36 @@ static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 	dstr_free(&mux);
 }
 
+static void add_file_writer_params(struct dstr *cmd,
+				   struct ffmpeg_muxer *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	int buffer_size_mb = (int)obs_data_get_int(settings, "buffer_size_mb");
+	bool direct_io = obs_data_get_bool(settings, "direct_io");
+	obs_data_release(settings);
+
+	dstr_catf(cmd, "%d %d ", buffer_size_mb, direct_io ? 1 : 0);
+}
+
 static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 			       const char *path)
 {
-	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *vencoders[MAX_OUTPUT_VIDEO_ENCODERS];
 	obs_encoder_t *aencoders[MAX_AUDIO_MIXES];
+	struct dstr quoted_path = {0};
+	int num_video_tracks = 0;
 	int num_tracks = 0;
 
+	for (;;) {
+		obs_encoder_t *vencoder = obs_output_get_video_encoder2(
+			stream->output, num_video_tracks);
+		if (!vencoder)
+			break;
+
+		vencoders[num_video_tracks] = vencoder;
+		num_video_tracks++;
+	}
+
 	for (;;) {
 		obs_encoder_t *aencoder = obs_output_get_audio_encoder(
 			stream->output, num_tracks);
@@ -253,14 +331,15 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 	dstr_insert_ch(cmd, 0, '\"');
 	dstr_cat(cmd, "\" \"");
 
-	dstr_copy(&stream->path, path);
-	dstr_replace(&stream->path, "\"", "\"\"");
-	dstr_cat_dstr(cmd, &stream->path);
+	dstr_copy(&quoted_path, path);
+	dstr_replace(&quoted_path, "\"", "\"\"");
+	dstr_cat_dstr(cmd, &quoted_path);
+	dstr_free(&quoted_path);
 
-	dstr_catf(cmd, "\" %d %d ", vencoder ? 1 : 0, num_tracks);
+	dstr_catf(cmd, "\" %d %d ", num_video_tracks, num_tracks);
 
-	if (vencoder)
-		add_video_encoder_params(stream, cmd, vencoder);
+	for (int i = 0; i < num_video_tracks; i++)
+		add_video_encoder_params(cmd, vencoders[i]);
 
 	if (num_tracks) {
 		dstr_cat(cmd, "aac ");
@@ -272,16 +351,278 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 
 	add_stream_key(cmd, stream);
 	add_muxer_params(cmd, stream);
+	add_file_writer_params(cmd, stream);
 }
 
-void start_pipe(struct ffmpeg_muxer *stream, const char *path)
+static os_process_pipe_t *create_pipe(struct ffmpeg_muxer *stream,
+				      const char *path)
 {
+	os_process_pipe_t *pipe;
 	struct dstr cmd;
+
 	build_command_line(stream, &cmd, path);
-	stream->pipe = os_process_pipe_create(cmd.array, "w");
+	pipe = os_process_pipe_create(cmd.array, "w");
 	dstr_free(&cmd);
+	return pipe;
+}
+
+void start_pipe(struct ffmpeg_muxer *stream, const char *path)
+{
+	if (stream->path.array != path)
+		dstr_copy(&stream->path, path);
+	stream->pipe = create_pipe(stream, path);
+}
+
+/* ------------------------------------------------------------------------- */
+/* file splitting                                                            */
+
+static void init_split(struct ffmpeg_muxer *stream, const char *path)
+{
+	const char *ext = os_get_path_extension(path);
+	size_t base_len = ext ? (size_t)(ext - path) : strlen(path);
+
+	/* "name.ext" is followed by "name_002.ext", "name_003.ext", ... */
+	dstr_ncopy(&stream->split_base, path, base_len);
+	dstr_copy(&stream->split_ext, ext ? ext : "");
+	stream->split_index = 1;
+	stream->split_size = 0;
+	stream->split_start_usec = 0;
+	stream->split_pending = false;
+
+	stream->split_video_tracks = 0;
+	while (stream->split_video_tracks < MAX_OUTPUT_VIDEO_ENCODERS &&
+	       obs_output_get_video_encoder2(stream->output,
+					     stream->split_video_tracks))
+		stream->split_video_tracks++;
+}
+
+static void signal_file_changed(struct ffmpeg_muxer *stream)
+{
+	signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
+	calldata_t cd = {0};
+
+	calldata_set_ptr(&cd, "output", stream->output);
+	calldata_set_string(&cd, "closed_file", stream->closing_path.array);
+	calldata_set_string(&cd, "next_file", stream->path.array);
+	signal_handler_signal(sh, "file_changed", &cd);
+	calldata_free(&cd);
+}
+
+static void *split_file_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	/* the previous file is finalized while the next one is written */
+	if (stream->closing_pipe) {
+		int ret = os_process_pipe_destroy(stream->closing_pipe);
+		stream->closing_pipe = NULL;
+
+		if (ret != 0)
+			warn("Failed to finish file '%s' (%d)",
+			     stream->closing_path.array, ret);
+		else
+			info("Finished writing file '%s'",
+			     stream->closing_path.array);
+
+		signal_file_changed(stream);
+	}
+
+	/* ffmpeg-mux only creates the file once it receives the headers, so
+	 * the process for the next file can be started ahead of time */
+	dstr_printf(&stream->next_path, "%s_%03d%s", stream->split_base.array,
+		    ++stream->split_index, stream->split_ext.array);
+
+	stream->next_pipe = create_pipe(stream, stream->next_path.array);
+	if (stream->next_pipe)
+		os_atomic_set_bool(&stream->next_pipe_ready, true);
+	else
+		warn("Failed to create process pipe for '%s'",
+		     stream->next_path.array);
+
+	return NULL;
+}
+
+static bool start_split_thread(struct ffmpeg_muxer *stream)
+{
+	stream->split_thread_joinable =
+		pthread_create(&stream->split_thread, NULL, split_file_thread,
+			       stream) == 0;
+	if (!stream->split_thread_joinable)
+		warn("Failed to create file split thread");
+	return stream->split_thread_joinable;
+}
+
+/* each file starts at timestamp 0, which is the same point in time for
+ * every track, so the start is converted to each track's own timebase */
+static bool write_split_packet(struct ffmpeg_muxer *stream,
+			       struct encoder_packet *packet)
+{
+	struct encoder_packet pkt = *packet;
+	int64_t offset = (int64_t)util_mul_div64(
+		(uint64_t)stream->split_start_usec, (uint64_t)pkt.timebase_den,
+		(uint64_t)pkt.timebase_num * 1000000ULL);
+
+	pkt.pts -= offset;
+	pkt.dts -= offset;
+	stream->split_size += (int64_t)pkt.size;
+	return write_packet(stream, &pkt);
+}
+
+static void stop_split_thread(struct ffmpeg_muxer *stream)
+{
+	DARRAY(struct encoder_packet) packets;
+
+	if (stream->split_thread_joinable) {
+		pthread_join(stream->split_thread, NULL);
+		stream->split_thread_joinable = false;
+	}
+
+	os_process_pipe_destroy(stream->next_pipe);
+	stream->next_pipe = NULL;
+	os_atomic_set_bool(&stream->next_pipe_ready, false);
+
+	/* a split that hasn't happened yet just continues the current file.
+	 * the packets are taken out first, because a failed write
+	 * deactivates the output, which ends up back in here */
+	da_init(packets);
+	da_move(packets, stream->split_packets);
+	stream->split_pending = false;
+
+	for (size_t i = 0; active(stream) && i < packets.num; i++) {
+		if (!write_split_packet(stream, &packets.array[i]))
+			break;
+	}
+
+	for (size_t i = 0; i < packets.num; i++)
+		obs_encoder_packet_release(&packets.array[i]);
+	da_free(packets);
 }
 
+static inline bool should_split(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet)
+{
+	if (packet->type != OBS_ENCODER_VIDEO || !packet->keyframe)
+		return false;
+
+	/* next file isn't ready yet, try again at the next keyframe */
+	if (!os_atomic_load_bool(&stream->next_pipe_ready))
+		return false;
+
+	if (stream->split_max_size &&
+	    stream->split_size + (int64_t)packet->size >= stream->split_max_size)
+		return true;
+
+	return stream->split_max_time &&
+	       packet->dts_usec - stream->split_start_usec >=
+		       stream->split_max_time;
+}
+
+/* switches to the already running process of the next file, and hands the
+ * current one to the split thread to be finalized */
+static bool switch_file(struct ffmpeg_muxer *stream, int64_t start_usec)
+{
+	if (stream->split_thread_joinable) {
+		pthread_join(stream->split_thread, NULL);
+		stream->split_thread_joinable = false;
+	}
+
+	os_atomic_set_bool(&stream->next_pipe_ready, false);
+
+	stream->closing_pipe = stream->pipe;
+	stream->pipe = stream->next_pipe;
+	stream->next_pipe = NULL;
+	dstr_copy_dstr(&stream->closing_path, &stream->path);
+	dstr_copy_dstr(&stream->path, &stream->next_path);
+
+	stream->split_start_usec = start_usec;
+	stream->split_size = 0;
+
+	if (!start_split_thread(stream)) {
+		os_process_pipe_destroy(stream->closing_pipe);
+		stream->closing_pipe = NULL;
+	}
+
+	info("Writing file '%s'...", stream->path.array);
+	return send_headers(stream);
+}
+
+/* video tracks switch files at their own keyframe, audio at the earliest
+ * of those keyframes */
+static inline bool in_next_file(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet,
+				int64_t start_usec)
+{
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return packet->dts_usec >=
+		       stream->split_keyframe_usec[packet->track_idx];
+	return packet->dts_usec >= start_usec;
+}
+
+static bool finish_split(struct ffmpeg_muxer *stream)
+{
+	int64_t start_usec = stream->split_keyframe_usec[0];
+	bool success = true;
+
+	for (size_t i = 1; i < stream->split_video_tracks; i++) {
+		if (stream->split_keyframe_usec[i] < start_usec)
+			start_usec = stream->split_keyframe_usec[i];
+	}
+
+	for (size_t i = 0; success && i < stream->split_packets.num; i++) {
+		struct encoder_packet *pkt = &stream->split_packets.array[i];
+		if (!in_next_file(stream, pkt, start_usec))
+			success = write_split_packet(stream, pkt);
+	}
+
+	if (success)
+		success = switch_file(stream, start_usec);
+
+	for (size_t i = 0; success && i < stream->split_packets.num; i++) {
+		struct encoder_packet *pkt = &stream->split_packets.array[i];
+		if (in_next_file(stream, pkt, start_usec))
+			success = write_split_packet(stream, pkt);
+	}
+
+	release_split_packets(stream);
+	return success;
+}
+
+/* once a split is due, packets are held back until every video track has
+ * reached a keyframe, so that each track of the next file starts with one */
+static bool write_or_split_packet(struct ffmpeg_muxer *stream,
+				  struct encoder_packet *packet)
+{
+	struct encoder_packet pkt;
+
+	if (!stream->split_pending) {
+		if (!should_split(stream, packet))
+			return write_split_packet(stream, packet);
+
+		stream->split_pending = true;
+		memset(stream->split_keyframe, 0,
+		       sizeof(stream->split_keyframe));
+	}
+
+	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe &&
+	    !stream->split_keyframe[packet->track_idx]) {
+		stream->split_keyframe[packet->track_idx] = true;
+		stream->split_keyframe_usec[packet->track_idx] =
+			packet->dts_usec;
+	}
+
+	obs_encoder_packet_ref(&pkt, packet);
+	da_push_back(stream->split_packets, &pkt);
+
+	for (size_t i = 0; i < stream->split_video_tracks; i++) {
+		if (!stream->split_keyframe[i])
+			return true;
+	}
+
+	return finish_split(stream);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream,
 					obs_data_t *settings, const char *path)
 {
@@ -325,6 +666,16 @@ static bool ffmpeg_mux_start(void *data)
 		path = obs_data_get_string(settings, "path");
 	}
 
+	stream->split_max_time =
+		obs_data_get_int(settings, "max_time_sec") * 1000000LL;
+	stream->split_max_size =
+		obs_data_get_int(settings, "max_size_mb") * (1024 * 1024);
+	stream->split_file = !stream->is_network &&
+			     obs_data_get_bool(settings, "split_file") &&
+			     (stream->split_max_time || stream->split_max_size);
+	if (stream->split_file)
+		init_split(stream, path);
+
 	if (!stream->is_network) {
 		/* ensure output path is writable to avoid generic error
 		 * message.
@@ -351,6 +702,9 @@ static bool ffmpeg_mux_start(void *data)
 		return false;
 	}
 
+	if (stream->split_file && !start_split_thread(stream))
+		stream->split_file = false;
+
 	/* write headers and start capture */
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
@@ -374,6 +728,9 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 		}
 	}
 
+	if (stream->split_file)
+		stop_split_thread(stream);
+
 	if (active(stream)) {
 		ret = os_process_pipe_destroy(stream->pipe);
 		stream->pipe = NULL;
@@ -498,12 +855,11 @@ static bool send_audio_headers(struct ffmpeg_muxer *stream,
 	return write_packet(stream, &packet);
 }
 
-static bool send_video_headers(struct ffmpeg_muxer *stream)
+static bool send_video_headers(struct ffmpeg_muxer *stream,
+			       obs_encoder_t *vencoder, size_t idx)
 {
-	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
-
-	struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO,
-					.timebase_den = 1};
+	struct encoder_packet packet = {
+		.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .track_idx = idx};
 
 	obs_encoder_get_extra_data(vencoder, &packet.data, &packet.size);
 	return write_packet(stream, &packet);
@@ -511,11 +867,21 @@ static bool send_video_headers(struct ffmpeg_muxer *stream)
 
 bool send_headers(struct ffmpeg_muxer *stream)
 {
+	obs_encoder_t *vencoder;
 	obs_encoder_t *aencoder;
 	size_t idx = 0;
 
-	if (!send_video_headers(stream))
-		return false;
+	do {
+		vencoder = obs_output_get_video_encoder2(stream->output, idx);
+		if (vencoder) {
+			if (!send_video_headers(stream, vencoder, idx)) {
+				return false;
+			}
+			idx++;
+		}
+	} while (vencoder);
+
+	idx = 0;
 
 	do {
 		aencoder = obs_output_get_audio_encoder(stream->output, idx);
@@ -557,6 +923,11 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
+	if (stream->split_file) {
+		write_or_split_packet(stream, packet);
+		return;
+	}
+
 	write_packet(stream, packet);
 }
 
@@ -568,6 +939,14 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 
 	obs_properties_add_text(props, "path", obs_module_text("FilePath"),
 				OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "split_file",
+				obs_module_text("SplitFile"));
+	obs_properties_add_int(props, "max_time_sec",
+			       obs_module_text("SplitFile.MaxTime"), 0,
+			       24 * 60 * 60, 1);
+	obs_properties_add_int(props, "max_size_mb",
+			       obs_module_text("SplitFile.MaxSize"), 0,
+			       1024 * 1024, 1);
 	return props;
 }
 
@@ -591,6 +970,22 @@ struct obs_output_info ffmpeg_muxer = {
 	.get_properties = ffmpeg_mux_properties,
 };
 
+/* writes every rendition of an encoder group (set with
+ * obs_output_set_video_encoder2) as its own video stream of one file */
+struct obs_output_info ffmpeg_abr_muxer = {
+	.id = "ffmpeg_abr_muxer",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK |
+		 OBS_OUTPUT_MULTI_TRACK_VIDEO,
+	.get_name = ffmpeg_abr_mux_getname,
+	.create = ffmpeg_mux_create,
+	.destroy = ffmpeg_mux_destroy,
+	.start = ffmpeg_mux_start,
+	.stop = ffmpeg_mux_stop,
+	.encoded_packet = ffmpeg_mux_data,
+	.get_total_bytes = ffmpeg_mux_total_bytes,
+	.get_properties = ffmpeg_mux_properties,
+};
+
 static int connect_time(struct ffmpeg_muxer *stream)
 {
 	UNUSED_PARAMETER(stream);
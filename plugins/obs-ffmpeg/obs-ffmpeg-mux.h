@@ -40,6 +40,28 @@ struct ffmpeg_muxer {
 	bool mux_thread_joinable;
 	struct circlebuf packets;
 
+	/* file splitting */
+	bool split_file;
+	int64_t split_max_size;
+	int64_t split_max_time;
+	int64_t split_size;
+	int64_t split_start_usec;
+	size_t split_video_tracks;
+	bool split_pending;
+	bool split_keyframe[MAX_OUTPUT_VIDEO_ENCODERS];
+	int64_t split_keyframe_usec[MAX_OUTPUT_VIDEO_ENCODERS];
+	DARRAY(struct encoder_packet) split_packets;
+	int split_index;
+	struct dstr split_base;
+	struct dstr split_ext;
+	struct dstr closing_path;
+	os_process_pipe_t *closing_pipe;
+	struct dstr next_path;
+	os_process_pipe_t *next_pipe;
+	volatile bool next_pipe_ready;
+	pthread_t split_thread;
+	bool split_thread_joinable;
+
 	/* HLS only */
 	int keyint_sec;
 	pthread_mutex_t write_mutex;
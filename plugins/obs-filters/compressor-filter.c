@@ -8,6 +8,8 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 
+#include "dynamics.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)                \
@@ -76,6 +78,9 @@ struct compressor_data {
 	float envelope;
 	float slope;
 
+	struct dyn_gain_table gain_table;
+	volatile bool gain_table_dirty;
+
 	pthread_mutex_t sidechain_update_mutex;
 	uint64_t sidechain_check_time;
 	obs_weak_source_t *weak_sidechain;
@@ -187,6 +192,12 @@ unlock:
 	pthread_mutex_unlock(&cd->sidechain_mutex);
 }
 
+static float compressor_curve(void *param, float env_db)
+{
+	const struct compressor_data *cd = param;
+	return fminf(0, cd->slope * (cd->threshold - env_db));
+}
+
 static void compressor_update(void *data, obs_data_t *s)
 {
 	struct compressor_data *cd = data;
@@ -212,6 +223,8 @@ static void compressor_update(void *data, obs_data_t *s)
 	cd->sample_rate = sample_rate;
 	cd->slope = 1.0f - (1.0f / cd->ratio);
 
+	os_atomic_set_bool(&cd->gain_table_dirty, true);
+
 	bool valid_sidechain = *sidechain_name &&
 			       strcmp(sidechain_name, "none") != 0;
 	obs_weak_source_t *old_weak_sidechain = NULL;
@@ -317,27 +330,9 @@ static void analyze_envelope(struct compressor_data *cd, float **samples,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	dyn_peak_envelope(cd->envelope_buf, samples, cd->num_channels,
+			  num_samples, &cd->envelope, cd->attack_gain,
+			  cd->release_gain);
 }
 
 static void analyze_sidechain(struct compressor_data *cd,
@@ -348,46 +343,19 @@ static void analyze_sidechain(struct compressor_data *cd,
 	}
 
 	get_sidechain_data(cd, num_samples);
-
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-	float **sidechain_buf = cd->sidechain_buf;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!sidechain_buf[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(sidechain_buf[chan][i]);
-
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	analyze_envelope(cd, cd->sidechain_buf, num_samples);
 }
 
 static inline void process_compression(const struct compressor_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
-
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
-	}
+	/* envelope -> gain, in place */
+	for (size_t i = 0; i < num_samples; ++i)
+		cd->envelope_buf[i] = dyn_gain_table_lookup(
+			&cd->gain_table, cd->envelope_buf[i]);
+
+	dyn_apply_gain(samples, cd->num_channels, cd->envelope_buf,
+		       cd->output_gain, num_samples);
 }
 
 static void compressor_tick(void *data, float seconds)
@@ -448,6 +416,10 @@ compressor_filter_audio(void *data, struct obs_audio_data *audio)
 	if (num_samples == 0)
 		return audio;
 
+	if (os_atomic_exchange_bool(&cd->gain_table_dirty, false))
+		dyn_gain_table_build(&cd->gain_table, compressor_curve, cd,
+				     true);
+
 	float **samples = (float **)audio->data;
 
 	pthread_mutex_lock(&cd->sidechain_update_mutex);
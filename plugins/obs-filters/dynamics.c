@@ -0,0 +1,317 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include <obs-module.h>
+#include <media-io/audio-math.h>
+#include <util/sse-intrin.h>
+
+#include "dynamics.h"
+
+/* -------------------------------------------------------- */
+
+#define DB_TABLE_RANGE 120
+#define DB_TABLE_MIN (-(float)DB_TABLE_RANGE)
+#define DB_TABLE_STEPS_PER_DB 20
+#define DB_TABLE_SIZE (DB_TABLE_RANGE * DB_TABLE_STEPS_PER_DB)
+
+static float db_table[DB_TABLE_SIZE + 1];
+
+void dynamics_init(void)
+{
+	for (size_t i = 0; i <= DB_TABLE_SIZE; i++) {
+		float db = DB_TABLE_MIN + (float)i / DB_TABLE_STEPS_PER_DB;
+		db_table[i] = db_to_mul(db);
+	}
+}
+
+float dyn_db_to_mul(float db)
+{
+	float pos;
+	size_t idx;
+
+	if (db >= 0.0f || !isfinite(db))
+		return db_to_mul(db);
+	if (db <= DB_TABLE_MIN)
+		return db_table[0];
+
+	pos = (db - DB_TABLE_MIN) * DB_TABLE_STEPS_PER_DB;
+	idx = (size_t)pos;
+	if (idx >= DB_TABLE_SIZE)
+		return db_table[DB_TABLE_SIZE];
+
+	return db_table[idx] + (pos - (float)idx) *
+				       (db_table[idx + 1] - db_table[idx]);
+}
+
+void dyn_gain_table_build(struct dyn_gain_table *table, dyn_curve_t curve,
+			  void *param, bool linear)
+{
+	for (size_t i = 0; i <= DYN_TABLE_SIZE; i++) {
+		/* same exponent/mantissa split as dyn_gain_table_lookup */
+		float mantissa =
+			1.0f + (float)(i % DYN_TABLE_STEPS) / DYN_TABLE_STEPS;
+		int exp = DYN_TABLE_MIN_EXP + (int)(i / DYN_TABLE_STEPS);
+		float env = ldexpf(mantissa, exp);
+		float gain = curve(param, mul_to_db(env));
+
+		table->values[i] = linear ? db_to_mul(gain) : gain;
+	}
+}
+
+/* -------------------------------------------------------- */
+
+static inline __m128 load_channel(const float *channel, uint32_t i)
+{
+	return channel ? _mm_loadu_ps(channel + i) : _mm_setzero_ps();
+}
+
+static inline __m128 follow(__m128 env, __m128 in, __m128 attack,
+			    __m128 release)
+{
+	__m128 rising = _mm_cmplt_ps(env, in);
+	__m128 coef = _mm_or_ps(_mm_and_ps(rising, attack),
+				_mm_andnot_ps(rising, release));
+	return _mm_add_ps(in, _mm_mul_ps(coef, _mm_sub_ps(env, in)));
+}
+
+/* runs the follower for up to four channels at once, one channel per lane.
+ * blocks of four samples are transposed so each step works on one sample
+ * of every channel, then transposed back to take the max across channels */
+static void peak_envelope4(float *env_buf, float *const *channels,
+			   size_t count, uint32_t frames, float start_env,
+			   float attack_gain, float release_gain)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 attack = _mm_set1_ps(attack_gain);
+	const __m128 release = _mm_set1_ps(release_gain);
+	const float *ch[4] = {NULL, NULL, NULL, NULL};
+	__m128 env = _mm_set1_ps(start_env);
+	float lanes[4];
+	uint32_t i = 0;
+
+	for (size_t c = 0; c < count; c++)
+		ch[c] = channels[c];
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 s0 = load_channel(ch[0], i);
+		__m128 s1 = load_channel(ch[1], i);
+		__m128 s2 = load_channel(ch[2], i);
+		__m128 s3 = load_channel(ch[3], i);
+
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+		__m128 e0 = follow(env, _mm_and_ps(s0, abs_mask), attack,
+				   release);
+		__m128 e1 = follow(e0, _mm_and_ps(s1, abs_mask), attack,
+				   release);
+		__m128 e2 = follow(e1, _mm_and_ps(s2, abs_mask), attack,
+				   release);
+		__m128 e3 = follow(e2, _mm_and_ps(s3, abs_mask), attack,
+				   release);
+		env = e3;
+
+		_MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+
+		__m128 max = _mm_max_ps(_mm_max_ps(e0, e1), _mm_max_ps(e2, e3));
+		max = _mm_max_ps(max, _mm_loadu_ps(env_buf + i));
+		_mm_storeu_ps(env_buf + i, max);
+	}
+
+	_mm_storeu_ps(lanes, env);
+
+	for (size_t c = 0; c < 4; c++) {
+		float e = lanes[c];
+
+		if (!ch[c])
+			continue;
+
+		for (uint32_t j = i; j < frames; j++) {
+			const float in = fabsf(ch[c][j]);
+			const float coef = e < in ? attack_gain : release_gain;
+
+			e = in + coef * (e - in);
+			env_buf[j] = fmaxf(env_buf[j], e);
+		}
+	}
+}
+
+void dyn_peak_envelope(float *env_buf, float *const *channels,
+		       size_t num_channels, uint32_t frames, float *env,
+		       float attack_gain, float release_gain)
+{
+	memset(env_buf, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < num_channels; c += 4) {
+		size_t count = num_channels - c;
+		if (count > 4)
+			count = 4;
+
+		peak_envelope4(env_buf, channels + c, count, frames, *env,
+			       attack_gain, release_gain);
+	}
+
+	*env = env_buf[frames - 1];
+}
+
+void dyn_apply_gain(float *const *channels, size_t num_channels,
+		    const float *gains, float output_gain, uint32_t frames)
+{
+	const __m128 out_gain = _mm_set1_ps(output_gain);
+
+	for (size_t c = 0; c < num_channels; c++) {
+		float *samples = channels[c];
+		uint32_t i = 0;
+
+		if (!samples)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 g = _mm_mul_ps(_mm_loadu_ps(gains + i),
+					      out_gain);
+			__m128 s = _mm_loadu_ps(samples + i);
+			_mm_storeu_ps(samples + i, _mm_mul_ps(s, g));
+		}
+
+		for (; i < frames; i++)
+			samples[i] *= gains[i] * output_gain;
+	}
+}
+
+/* -------------------------------------------------------- */
+
+void dyn_lookahead_init(struct dyn_lookahead *la, uint32_t sample_rate,
+			float lookahead_ms, float release_gain)
+{
+	size_t delay = (size_t)(sample_rate * lookahead_ms / 1000.0f);
+
+	if (delay == la->delay) {
+		la->release_gain = release_gain;
+		return;
+	}
+
+	dyn_lookahead_free(la);
+
+	la->delay = delay;
+	la->release_gain = release_gain;
+	la->gain = 1.0f;
+	if (!delay)
+		return;
+
+	la->window = delay + 1;
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		la->delay_buf[c] = bzalloc(delay * sizeof(float));
+
+	la->min_vals = bmalloc(la->window * sizeof(float));
+	la->min_idx = bmalloc(la->window * sizeof(size_t));
+	la->avg_buf = bmalloc(la->window * sizeof(float));
+	for (size_t i = 0; i < la->window; i++)
+		la->avg_buf[i] = 1.0f;
+	la->avg_sum = (double)la->window;
+}
+
+void dyn_lookahead_free(struct dyn_lookahead *la)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		bfree(la->delay_buf[c]);
+	bfree(la->min_vals);
+	bfree(la->min_idx);
+	bfree(la->avg_buf);
+	memset(la, 0, sizeof(*la));
+}
+
+static inline float sliding_min(struct dyn_lookahead *la, float gain)
+{
+	const size_t window = la->window;
+	const size_t n = la->sample_idx;
+
+	/* drop gains that have left the window from the front */
+	while (la->min_count && la->min_idx[la->min_head] + window <= n) {
+		la->min_head = (la->min_head + 1) % window;
+		la->min_count--;
+	}
+
+	/* drop larger gains from the back, they can never be the minimum
+	 * again */
+	while (la->min_count) {
+		size_t back = (la->min_head + la->min_count - 1) % window;
+		if (la->min_vals[back] < gain)
+			break;
+		la->min_count--;
+	}
+
+	size_t tail = (la->min_head + la->min_count) % window;
+	la->min_vals[tail] = gain;
+	la->min_idx[tail] = n;
+	la->min_count++;
+
+	return la->min_vals[la->min_head];
+}
+
+void dyn_lookahead_process(struct dyn_lookahead *la,
+			   const struct dyn_gain_table *table,
+			   float *const *channels, size_t num_channels,
+			   float output_gain, uint32_t frames)
+{
+	if (!la->delay)
+		return;
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float peak = 0.0f;
+
+		for (size_t c = 0; c < num_channels; c++) {
+			if (channels[c])
+				peak = fmaxf(peak, fabsf(channels[c][i]));
+		}
+
+		/* the minimum over the window, averaged over the same
+		 * window, has fully reached every gain in the window by the
+		 * time its sample leaves the delay line */
+		float min_gain =
+			sliding_min(la, dyn_gain_table_lookup(table, peak));
+		size_t avg_pos = la->sample_idx % la->window;
+
+		la->avg_sum += (double)(min_gain - la->avg_buf[avg_pos]);
+		la->avg_buf[avg_pos] = min_gain;
+
+		float target = (float)(la->avg_sum / (double)la->window);
+		if (target < la->gain)
+			la->gain = target;
+		else
+			la->gain = target +
+				   la->release_gain * (la->gain - target);
+
+		const float gain = la->gain * output_gain;
+
+		for (size_t c = 0; c < num_channels; c++) {
+			float *delayed = la->delay_buf[c];
+			float in;
+
+			if (!channels[c])
+				continue;
+
+			in = channels[c][i];
+			channels[c][i] = delayed[la->pos] * gain;
+			delayed[la->pos] = in;
+		}
+
+		la->pos = (la->pos + 1) % la->delay;
+		la->sample_idx++;
+	}
+}
@@ -0,0 +1,125 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <media-io/audio-io.h>
+
+/*
+ * Shared dynamics processing for the compressor, limiter and expander
+ * filters: envelope followers, table-based gain curves, and a look-ahead
+ * peak limiter.
+ */
+
+/* gain tables are indexed by the envelope's float exponent and the top six
+ * bits of its mantissa, so a lookup needs no log10f/powf */
+#define DYN_TABLE_MIN_EXP -20 /* 2^-20, about -120 dB */
+#define DYN_TABLE_MAX_EXP 4   /* 2^4, about +24 dB */
+#define DYN_TABLE_STEPS 64    /* entries per octave */
+#define DYN_TABLE_SIZE \
+	((DYN_TABLE_MAX_EXP - DYN_TABLE_MIN_EXP) * DYN_TABLE_STEPS)
+
+#define DYN_MAX_LOOKAHEAD_MS 20
+
+/* returns the gain in dB for an envelope level in dB */
+typedef float (*dyn_curve_t)(void *param, float env_db);
+
+struct dyn_gain_table {
+	float values[DYN_TABLE_SIZE + 1];
+};
+
+struct dyn_lookahead {
+	size_t delay;
+	size_t window;
+	size_t pos;
+	float release_gain;
+
+	float *delay_buf[MAX_AUDIO_CHANNELS];
+
+	/* sliding minimum of the required gain over the window */
+	float *min_vals;
+	size_t *min_idx;
+	size_t min_head;
+	size_t min_count;
+	size_t sample_idx;
+
+	/* moving average of the sliding minimum */
+	float *avg_buf;
+	double avg_sum;
+
+	float gain;
+};
+
+extern void dynamics_init(void);
+
+/* builds a table of curve(env_db), stored as a linear multiplier when
+ * linear is true and as dB otherwise.  the filters only flag their table
+ * as dirty in update and rebuild it on the audio thread, so a lookup never
+ * sees a half-written table. */
+extern void dyn_gain_table_build(struct dyn_gain_table *table,
+				 dyn_curve_t curve, void *param, bool linear);
+
+static inline float dyn_gain_table_lookup(const struct dyn_gain_table *table,
+					  float env)
+{
+	union {
+		float f;
+		uint32_t u;
+	} bits = {env};
+	const int32_t base = (127 + DYN_TABLE_MIN_EXP) * DYN_TABLE_STEPS;
+	int32_t idx = (int32_t)(bits.u >> 17) - base;
+	float frac;
+
+	if (idx < 0 || env <= 0.0f)
+		return table->values[0];
+	if (idx >= DYN_TABLE_SIZE)
+		return table->values[DYN_TABLE_SIZE];
+
+	frac = (float)(bits.u & 0x1ffff) * (1.0f / 131072.0f);
+	return table->values[idx] +
+	       frac * (table->values[idx + 1] - table->values[idx]);
+}
+
+/* table based db_to_mul for gains between -120 and 0 dB */
+extern float dyn_db_to_mul(float db);
+
+/* Peak envelope follower.  Every channel starts from *env, and env_buf
+ * receives the maximum envelope across channels for each sample.  NULL
+ * channels are skipped. */
+extern void dyn_peak_envelope(float *env_buf, float *const *channels,
+			      size_t num_channels, uint32_t frames, float *env,
+			      float attack_gain, float release_gain);
+
+/* multiplies every channel by gains[i] * output_gain */
+extern void dyn_apply_gain(float *const *channels, size_t num_channels,
+			   const float *gains, float output_gain,
+			   uint32_t frames);
+
+extern void dyn_lookahead_init(struct dyn_lookahead *la,
+			       uint32_t sample_rate, float lookahead_ms,
+			       float release_gain);
+extern void dyn_lookahead_free(struct dyn_lookahead *la);
+
+/* Look-ahead peak limiter.  Delays the audio by the look-ahead time and
+ * applies a gain that is already fully reduced when a peak arrives, so the
+ * output stays below the table's threshold (to within the table's
+ * interpolation error).  Only sample peaks are considered. */
+extern void dyn_lookahead_process(struct dyn_lookahead *la,
+				  const struct dyn_gain_table *table,
+				  float *const *channels, size_t num_channels,
+				  float output_gain, uint32_t frames);
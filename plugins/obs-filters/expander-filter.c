@@ -8,6 +8,8 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 
+#include "dynamics.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)              \
@@ -92,6 +94,9 @@ struct expander_data {
 	float gaindB_buf[MAX_AUDIO_CHANNELS];
 	float *env_in;
 	size_t env_in_len;
+
+	struct dyn_gain_table gain_table;
+	volatile bool gain_table_dirty;
 };
 
 enum { RMS_DETECT,
@@ -161,6 +166,14 @@ static void expander_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, S_DETECTOR, "RMS");
 }
 
+static float expander_curve(void *param, float env_db)
+{
+	const struct expander_data *cd = param;
+	return cd->threshold - env_db > 0.0f
+		       ? fmaxf(cd->slope * (cd->threshold - env_db), -60.0f)
+		       : 0.0f;
+}
+
 static void expander_update(void *data, obs_data_t *s)
 {
 	struct expander_data *cd = data;
@@ -199,6 +212,8 @@ static void expander_update(void *data, obs_data_t *s)
 	cd->sample_rate = sample_rate;
 	cd->slope = 1.0f - cd->ratio;
 
+	os_atomic_set_bool(&cd->gain_table_dirty, true);
+
 	const char *detect_mode = obs_data_get_string(s, S_DETECTOR);
 	if (strcmp(detect_mode, "RMS") == 0)
 		cd->detector = RMS_DETECT;
@@ -280,18 +295,19 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 		if (cd->detector == RMS_DETECT) {
 			runave[0] =
 				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
+				(1 - rmscoef) * samples[chan][0] *
+					samples[chan][0];
 			env_in[0] = sqrtf(fmaxf(runave[0], 0));
 			for (uint32_t i = 1; i < num_samples; ++i) {
 				runave[i] =
 					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
+					(1 - rmscoef) * samples[chan][i] *
+						samples[chan][i];
 				env_in[i] = sqrtf(runave[i]);
 			}
 		} else if (cd->detector == PEAK_DETECT) {
 			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
+				runave[i] = samples[chan][i] * samples[chan][i];
 				env_in[i] = fabsf(samples[chan][i]);
 			}
 		}
@@ -319,13 +335,8 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
 		for (size_t i = 0; i < num_samples; ++i) {
 			// gain stage of expansion
-			float env_db = mul_to_db(cd->envelope_buf[chan][i]);
-			float gain =
-				cd->threshold - env_db > 0.0f
-					? fmaxf(cd->slope * (cd->threshold -
-							     env_db),
-						-60.0f)
-					: 0.0f;
+			float gain = dyn_gain_table_lookup(
+				&cd->gain_table, cd->envelope_buf[chan][i]);
 			// ballistics (attack/release)
 			if (i > 0) {
 				if (gain > cd->gaindB[chan][i - 1])
@@ -351,7 +362,7 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 						(1.0f - release_gain) * gain;
 			}
 
-			gain = db_to_mul(fminf(0, cd->gaindB[chan][i]));
+			gain = dyn_db_to_mul(fminf(0, cd->gaindB[chan][i]));
 			if (samples[chan])
 				samples[chan][i] *= gain * cd->output_gain;
 		}
@@ -368,6 +379,10 @@ expander_filter_audio(void *data, struct obs_audio_data *audio)
 	if (num_samples == 0)
 		return audio;
 
+	if (os_atomic_exchange_bool(&cd->gain_table_dirty, false))
+		dyn_gain_table_build(&cd->gain_table, expander_curve, cd,
+				     false);
+
 	float **samples = (float **)audio->data;
 
 	analyze_envelope(cd, samples, num_samples);
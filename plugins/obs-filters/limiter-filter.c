@@ -5,6 +5,9 @@
 #include <obs-module.h>
 #include <media-io/audio-math.h>
 #include <util/platform.h>
+#include <util/threading.h>
+
+#include "dynamics.h"
 
 /* -------------------------------------------------------- */
 
@@ -27,10 +30,12 @@
 
 #define S_THRESHOLD                     "threshold"
 #define S_RELEASE_TIME                  "release_time"
+#define S_LOOKAHEAD                     "lookahead"
 
 #define MT_ obs_module_text
 #define TEXT_THRESHOLD                  MT_("Limiter.Threshold")
 #define TEXT_RELEASE_TIME               MT_("Limiter.ReleaseTime")
+#define TEXT_LOOKAHEAD                  MT_("Limiter.Lookahead")
 
 #define MIN_THRESHOLD_DB                -60.0
 #define MAX_THRESHOLD_DB                0.0f
@@ -59,6 +64,11 @@ struct limiter_data {
 	size_t sample_rate;
 	float envelope;
 	float slope;
+	float lookahead_ms;
+
+	struct dyn_gain_table gain_table;
+	volatile bool gain_table_dirty;
+	struct dyn_lookahead lookahead;
 };
 
 /* -------------------------------------------------------- */
@@ -74,6 +84,12 @@ static inline float gain_coefficient(uint32_t sample_rate, float time)
 	return (float)exp(-1.0f / (sample_rate * time));
 }
 
+static float limiter_curve(void *param, float env_db)
+{
+	const struct limiter_data *cd = param;
+	return fminf(0, cd->slope * (cd->threshold - env_db));
+}
+
 static const char *limiter_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -104,6 +120,10 @@ static void limiter_update(void *data, obs_data_t *s)
 	cd->sample_rate = sample_rate;
 	cd->slope = 1.0f;
 
+	cd->lookahead_ms = (float)obs_data_get_int(s, S_LOOKAHEAD);
+
+	os_atomic_set_bool(&cd->gain_table_dirty, true);
+
 	size_t sample_len = sample_rate * DEFAULT_AUDIO_BUF_MS / MS_IN_S;
 	if (cd->envelope_buf_len == 0)
 		resize_env_buffer(cd, sample_len);
@@ -122,6 +142,7 @@ static void limiter_destroy(void *data)
 {
 	struct limiter_data *cd = data;
 
+	dyn_lookahead_free(&cd->lookahead);
 	bfree(cd->envelope_buf);
 	bfree(cd);
 }
@@ -133,43 +154,21 @@ static void analyze_envelope(struct limiter_data *cd, float **samples,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	dyn_peak_envelope(cd->envelope_buf, samples, cd->num_channels,
+			  num_samples, &cd->envelope, cd->attack_gain,
+			  cd->release_gain);
 }
 
 static inline void process_compression(const struct limiter_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
-
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
-	}
+	/* envelope -> gain, in place */
+	for (size_t i = 0; i < num_samples; ++i)
+		cd->envelope_buf[i] = dyn_gain_table_lookup(
+			&cd->gain_table, cd->envelope_buf[i]);
+
+	dyn_apply_gain(samples, cd->num_channels, cd->envelope_buf,
+		       cd->output_gain, num_samples);
 }
 
 static struct obs_audio_data *limiter_filter_audio(void *data,
@@ -181,7 +180,23 @@ static struct obs_audio_data *limiter_filter_audio(void *data,
 	if (num_samples == 0)
 		return audio;
 
+	if (os_atomic_exchange_bool(&cd->gain_table_dirty, false))
+		dyn_gain_table_build(&cd->gain_table, limiter_curve, cd, true);
+
 	float **samples = (float **)audio->data;
+
+	/* the delay line is (re)allocated here rather than in update so it
+	 * never changes under the audio thread */
+	dyn_lookahead_init(&cd->lookahead, (uint32_t)cd->sample_rate,
+			   cd->lookahead_ms, cd->release_gain);
+
+	if (cd->lookahead.delay) {
+		dyn_lookahead_process(&cd->lookahead, &cd->gain_table, samples,
+				      cd->num_channels, cd->output_gain,
+				      num_samples);
+		return audio;
+	}
+
 	analyze_envelope(cd, samples, num_samples);
 	process_compression(cd, samples, num_samples);
 	return audio;
@@ -191,6 +206,7 @@ static void limiter_defaults(obs_data_t *s)
 {
 	obs_data_set_default_double(s, S_THRESHOLD, -6.0f);
 	obs_data_set_default_int(s, S_RELEASE_TIME, 60);
+	obs_data_set_default_int(s, S_LOOKAHEAD, 0);
 }
 
 static obs_properties_t *limiter_properties(void *data)
@@ -206,6 +222,9 @@ static obs_properties_t *limiter_properties(void *data)
 					  TEXT_RELEASE_TIME, MIN_ATK_RLS_MS,
 					  MAX_RLS_MS, 1);
 	obs_property_int_set_suffix(p, " ms");
+	p = obs_properties_add_int_slider(props, S_LOOKAHEAD, TEXT_LOOKAHEAD,
+					  0, DYN_MAX_LOOKAHEAD_MS, 1);
+	obs_property_int_set_suffix(p, " ms");
 
 	UNUSED_PARAMETER(data);
 	return props;
@@ -658,11 +658,18 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 	}
 
 	/* Execute */
+#ifdef LIBRNNOISE_BATCH_ENABLED
+	/* all channels go through the network together */
+	rnnoise_process_frames(ng->rnn_states, ng->rnn_segment_buffers,
+			       (const float **)ng->rnn_segment_buffers, NULL,
+			       (int)ng->channels);
+#else
 	for (size_t i = 0; i < ng->channels; i++) {
 		rnnoise_process_frame(ng->rnn_states[i],
 				      ng->rnn_segment_buffers[i],
 				      ng->rnn_segment_buffers[i]);
 	}
+#endif
 
 	/* Revert signal level adjustment, resample back if necessary */
 	if (ng->rnn_resampler) {
@@ -38,9 +38,12 @@ extern struct obs_source_info limiter_filter;
 extern struct obs_source_info expander_filter;
 extern struct obs_source_info luma_key_filter;
 extern struct obs_source_info luma_key_filter_v2;
+extern void dynamics_init(void);
 
 bool obs_module_load(void)
 {
+	dynamics_init();
+
 	obs_register_source(&mask_filter);
 	obs_register_source(&mask_filter_v2);
 	obs_register_source(&crop_filter);
@@ -61,6 +61,11 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/* Processes one frame for each of `count` states, evaluating the network for
+   all of them together.  Equivalent to calling rnnoise_process_frame() on
+   each state in turn.  vad_prob may be NULL. */
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState **st, float **out, const float **in, float *vad_prob, int count);
+
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_file(FILE *f);
 
 RNNOISE_EXPORT void rnnoise_model_free(RNNModel *model);
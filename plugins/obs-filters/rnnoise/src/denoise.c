@@ -85,6 +85,19 @@ typedef struct {
   float dct_table[NB_BANDS*NB_BANDS];
 } CommonState;
 
+/* Per-frame analysis kept between the feature and synthesis passes of
+   rnnoise_process_frames(). */
+typedef struct {
+  kiss_fft_cpx X[FREQ_SIZE];
+  kiss_fft_cpx P[WINDOW_SIZE];
+  float Ex[NB_BANDS], Ep[NB_BANDS];
+  float Exp[NB_BANDS];
+  float features[NB_FEATURES];
+  float g[NB_BANDS];
+  float vad_prob;
+  int silence;
+} FrameAnalysis;
+
 struct DenoiseState {
   float analysis_mem[FRAME_SIZE];
   float cepstral_mem[CEPS_MEM][NB_BANDS];
@@ -97,6 +110,7 @@ struct DenoiseState {
   float mem_hp_x[2];
   float lastg[NB_BANDS];
   RNNState rnn;
+  FrameAnalysis frame;
 };
 
 void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
@@ -453,8 +467,29 @@ void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const
   }
 }
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+static void apply_frame_gains(DenoiseState *st, kiss_fft_cpx *X, const kiss_fft_cpx *P,
+                              const float *Ex, const float *Ep, const float *Exp, float *g) {
   int i;
+  float gf[FREQ_SIZE]={1};
+  pitch_filter(X, P, Ex, Ep, Exp, g);
+  for (i=0;i<NB_BANDS;i++) {
+    float alpha = .6f;
+    g[i] = MAX16(g[i], alpha*st->lastg[i]);
+    st->lastg[i] = g[i];
+  }
+  interp_band_gain(gf, g);
+#if 1
+  for (i=0;i<FREQ_SIZE;i++) {
+    X[i].r *= gf[i];
+    X[i].i *= gf[i];
+  }
+#endif
+}
+
+static const float a_hp[2] = {-1.99599f, 0.99600f};
+static const float b_hp[2] = {-2, 1};
+
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
   kiss_fft_cpx X[FREQ_SIZE];
   kiss_fft_cpx P[WINDOW_SIZE];
   float x[FRAME_SIZE];
@@ -462,35 +497,61 @@ float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
   float Exp[NB_BANDS];
   float features[NB_FEATURES];
   float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
   float vad_prob = 0;
   int silence;
-  static const float a_hp[2] = {-1.99599f, 0.99600f};
-  static const float b_hp[2] = {-2, 1};
   biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
   silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
 
   if (!silence) {
     compute_rnn(&st->rnn, g, &vad_prob, features);
-    pitch_filter(X, P, Ex, Ep, Exp, g);
-    for (i=0;i<NB_BANDS;i++) {
-      float alpha = .6f;
-      g[i] = MAX16(g[i], alpha*st->lastg[i]);
-      st->lastg[i] = g[i];
-    }
-    interp_band_gain(gf, g);
-#if 1
-    for (i=0;i<FREQ_SIZE;i++) {
-      X[i].r *= gf[i];
-      X[i].i *= gf[i];
-    }
-#endif
+    apply_frame_gains(st, X, P, Ex, Ep, Exp, g);
   }
 
   frame_synthesis(st, out, X);
   return vad_prob;
 }
 
+void rnnoise_process_frames(DenoiseState **st, float **out, const float **in, float *vad_prob, int count) {
+  int i;
+  for (i=0;i<count;i+=RNN_MAX_BATCH) {
+    RNNState *rnn[RNN_MAX_BATCH];
+    float *gains[RNN_MAX_BATCH];
+    float *vad[RNN_MAX_BATCH];
+    const float *features[RNN_MAX_BATCH];
+    int n = IMIN(count - i, RNN_MAX_BATCH);
+    int active = 0;
+    int k;
+
+    for (k=0;k<n;k++) {
+      DenoiseState *s = st[i+k];
+      FrameAnalysis *f = &s->frame;
+      float x[FRAME_SIZE];
+      biquad(x, s->mem_hp_x, in[i+k], b_hp, a_hp, FRAME_SIZE);
+      f->silence = compute_frame_features(s, f->X, f->P, f->Ex, f->Ep, f->Exp, f->features, x);
+      f->vad_prob = 0;
+      if (!f->silence) {
+        rnn[active] = &s->rnn;
+        gains[active] = f->g;
+        vad[active] = &f->vad_prob;
+        features[active] = f->features;
+        active++;
+      }
+    }
+
+    compute_rnn_batch(rnn, gains, vad, features, active);
+
+    for (k=0;k<n;k++) {
+      DenoiseState *s = st[i+k];
+      FrameAnalysis *f = &s->frame;
+      if (!f->silence)
+        apply_frame_gains(s, f->X, f->P, f->Ex, f->Ep, f->Exp, f->g);
+      frame_synthesis(s, out[i+k], f->X);
+      if (vad_prob)
+        vad_prob[i+k] = f->vad_prob;
+    }
+  }
+}
+
 #if TRAINING
 
 static float uni_rand() {
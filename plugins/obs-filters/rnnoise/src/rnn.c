@@ -37,6 +37,8 @@
 #include "rnn.h"
 #include "rnn_data.h"
 #include <stdio.h>
+#include <string.h>
+#include <util/sse-intrin.h>
 
 static OPUS_INLINE float tansig_approx(float x)
 {
@@ -176,3 +178,205 @@ void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
   compute_gru(rnn->model->denoise_gru, rnn->denoise_gru_state, denoise_input);
   compute_dense(rnn->model->denoise_output, gains, rnn->denoise_gru_state);
 }
+
+/* Batched, vectorized evaluation.
+
+   Weight matrices are stored input-major (weights[j*stride + i]), so four
+   consecutive neurons share one 32-bit load of int8 weights.  Each block of
+   four neurons accumulates every frame of the batch in its own register,
+   keeping the per-neuron summation order of the scalar code above. */
+
+static OPUS_INLINE __m128 load_weights4(const rnn_weight *w)
+{
+   int packed;
+   __m128i v;
+   memcpy(&packed, w, sizeof(packed));
+   v = _mm_cvtsi32_si128(packed);
+   v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+   v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+   return _mm_cvtepi32_ps(v);
+}
+
+/* acc[b][offset+i] += sum_j weights[j*stride + offset + i] * input[b][j] */
+static void batch_accumulate(float acc[][MAX_NEURONS], const rnn_weight *weights,
+                             int stride, int offset, int N, const float *const *input,
+                             int M, int count)
+{
+   int i, j, b;
+   for (i=0;i+4<=N;i+=4)
+   {
+      __m128 sum[RNN_MAX_BATCH];
+      for (b=0;b<count;b++)
+         sum[b] = _mm_loadu_ps(&acc[b][i]);
+      for (j=0;j<M;j++)
+      {
+         __m128 w = load_weights4(&weights[j*stride + offset + i]);
+         for (b=0;b<count;b++)
+            sum[b] = _mm_add_ps(sum[b], _mm_mul_ps(w, _mm_set1_ps(input[b][j])));
+      }
+      for (b=0;b<count;b++)
+         _mm_storeu_ps(&acc[b][i], sum[b]);
+   }
+   for (;i<N;i++)
+   {
+      for (b=0;b<count;b++)
+      {
+         float sum = acc[b][i];
+         for (j=0;j<M;j++)
+            sum += weights[j*stride + offset + i]*input[b][j];
+         acc[b][i] = sum;
+      }
+   }
+}
+
+static void batch_bias(float acc[][MAX_NEURONS], const rnn_weight *bias, int N, int count)
+{
+   int i, b;
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         acc[b][i] = bias[i];
+}
+
+static OPUS_INLINE float activate(int activation, float x)
+{
+   if (activation == ACTIVATION_SIGMOID) return sigmoid_approx(x);
+   else if (activation == ACTIVATION_TANH) return tansig_approx(x);
+   else if (activation == ACTIVATION_RELU) return relu(x);
+   *(int*)0=0;
+   return 0;
+}
+
+static void compute_dense_batch(const DenseLayer *layer, float **output, const float *const *input, int count)
+{
+   float acc[RNN_MAX_BATCH][MAX_NEURONS];
+   int i, b;
+   int N = layer->nb_neurons;
+   batch_bias(acc, layer->bias, N, count);
+   batch_accumulate(acc, layer->input_weights, N, 0, N, input, layer->nb_inputs, count);
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         output[b][i] = activate(layer->activation, WEIGHTS_SCALE*acc[b][i]);
+}
+
+static void compute_gru_batch(const GRULayer *gru, float **state, const float *const *input, int count)
+{
+   float z[RNN_MAX_BATCH][MAX_NEURONS];
+   float r[RNN_MAX_BATCH][MAX_NEURONS];
+   float h[RNN_MAX_BATCH][MAX_NEURONS];
+   float state_r[RNN_MAX_BATCH][MAX_NEURONS];
+   const float *state_in[RNN_MAX_BATCH];
+   const float *state_r_in[RNN_MAX_BATCH];
+   int i, b;
+   int M = gru->nb_inputs;
+   int N = gru->nb_neurons;
+   int stride = 3*N;
+
+   for (b=0;b<count;b++)
+   {
+      state_in[b] = state[b];
+      state_r_in[b] = state_r[b];
+   }
+
+   /* Compute update gate. */
+   batch_bias(z, gru->bias, N, count);
+   batch_accumulate(z, gru->input_weights, stride, 0, N, input, M, count);
+   batch_accumulate(z, gru->recurrent_weights, stride, 0, N, state_in, N, count);
+
+   /* Compute reset gate. */
+   batch_bias(r, gru->bias + N, N, count);
+   batch_accumulate(r, gru->input_weights, stride, N, N, input, M, count);
+   batch_accumulate(r, gru->recurrent_weights, stride, N, N, state_in, N, count);
+
+   for (b=0;b<count;b++)
+   {
+      for (i=0;i<N;i++)
+      {
+         z[b][i] = sigmoid_approx(WEIGHTS_SCALE*z[b][i]);
+         r[b][i] = sigmoid_approx(WEIGHTS_SCALE*r[b][i]);
+         state_r[b][i] = state[b][i]*r[b][i];
+      }
+   }
+
+   /* Compute output. */
+   batch_bias(h, gru->bias + 2*N, N, count);
+   batch_accumulate(h, gru->input_weights, stride, 2*N, N, input, M, count);
+   batch_accumulate(h, gru->recurrent_weights, stride, 2*N, N, state_r_in, N, count);
+
+   for (b=0;b<count;b++)
+   {
+      for (i=0;i<N;i++)
+      {
+         float sum = activate(gru->activation, WEIGHTS_SCALE*h[b][i]);
+         state[b][i] = z[b][i]*state[b][i] + (1-z[b][i])*sum;
+      }
+   }
+}
+
+void compute_rnn_batch(RNNState **rnn, float **gains, float **vad, const float **input, int count) {
+  int i, b;
+  const RNNModel *model;
+  float dense_out[RNN_MAX_BATCH][MAX_NEURONS];
+  float noise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float denoise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float *dense_ptr[RNN_MAX_BATCH];
+  float *vad_state[RNN_MAX_BATCH];
+  float *noise_state[RNN_MAX_BATCH];
+  float *denoise_state[RNN_MAX_BATCH];
+  const float *dense_in[RNN_MAX_BATCH];
+  const float *vad_in[RNN_MAX_BATCH];
+  const float *noise_in[RNN_MAX_BATCH];
+  const float *denoise_in[RNN_MAX_BATCH];
+  const float *denoise_out_in[RNN_MAX_BATCH];
+
+  while (count > RNN_MAX_BATCH) {
+    compute_rnn_batch(rnn, gains, vad, input, RNN_MAX_BATCH);
+    rnn += RNN_MAX_BATCH;
+    gains += RNN_MAX_BATCH;
+    vad += RNN_MAX_BATCH;
+    input += RNN_MAX_BATCH;
+    count -= RNN_MAX_BATCH;
+  }
+  if (count <= 0)
+    return;
+
+  /* Frames can only share weights when they use the same model. */
+  model = rnn[0]->model;
+  for (b=1;b<count;b++) {
+    if (rnn[b]->model != model) {
+      for (b=0;b<count;b++)
+        compute_rnn(rnn[b], gains[b], vad[b], input[b]);
+      return;
+    }
+  }
+
+  for (b=0;b<count;b++) {
+    dense_ptr[b] = dense_out[b];
+    dense_in[b] = dense_out[b];
+    vad_state[b] = rnn[b]->vad_gru_state;
+    vad_in[b] = rnn[b]->vad_gru_state;
+    noise_state[b] = rnn[b]->noise_gru_state;
+    noise_in[b] = noise_input[b];
+    denoise_state[b] = rnn[b]->denoise_gru_state;
+    denoise_in[b] = denoise_input[b];
+    denoise_out_in[b] = rnn[b]->denoise_gru_state;
+  }
+
+  compute_dense_batch(model->input_dense, dense_ptr, input, count);
+  compute_gru_batch(model->vad_gru, vad_state, dense_in, count);
+  compute_dense_batch(model->vad_output, vad, vad_in, count);
+
+  for (b=0;b<count;b++) {
+    for (i=0;i<model->input_dense_size;i++) noise_input[b][i] = dense_out[b][i];
+    for (i=0;i<model->vad_gru_size;i++) noise_input[b][i+model->input_dense_size] = vad_state[b][i];
+    for (i=0;i<INPUT_SIZE;i++) noise_input[b][i+model->input_dense_size+model->vad_gru_size] = input[b][i];
+  }
+  compute_gru_batch(model->noise_gru, noise_state, noise_in, count);
+
+  for (b=0;b<count;b++) {
+    for (i=0;i<model->vad_gru_size;i++) denoise_input[b][i] = vad_state[b][i];
+    for (i=0;i<model->noise_gru_size;i++) denoise_input[b][i+model->vad_gru_size] = noise_state[b][i];
+    for (i=0;i<INPUT_SIZE;i++) denoise_input[b][i+model->vad_gru_size+model->noise_gru_size] = input[b][i];
+  }
+  compute_gru_batch(model->denoise_gru, denoise_state, denoise_in, count);
+  compute_dense_batch(model->denoise_output, gains, denoise_out_in, count);
+}
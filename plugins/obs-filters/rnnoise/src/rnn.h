@@ -62,4 +62,13 @@ typedef struct RNNState RNNState;
 
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input);
 
+/* Maximum number of frames evaluated together by compute_rnn_batch. */
+#define RNN_MAX_BATCH 8
+
+/* Evaluates the network for several independent states at once.  Each
+   weight is loaded once per batch instead of once per frame, and the
+   matrix products are vectorized.  Results match compute_rnn() up to
+   float rounding. */
+void compute_rnn_batch(RNNState **rnn, float **gains, float **vad, const float **input, int count);
+
 #endif /* _MLP_H_ */
@@ -0,0 +1,250 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+#include "bandwidth-estimator.h"
+
+#define MSEC_TO_NSEC 1000000ULL
+#define SEC_TO_NSEC 1000000000ULL
+
+#define BWE_INTERVAL (500ULL * MSEC_TO_NSEC)
+#define BWE_MIN_BITRATE 50
+#define BWE_BITRATE_ROUNDING 50
+
+/* fraction of the estimated capacity to use, leaves room for keyframes */
+#define BWE_HEADROOM 0.85
+/* ignore changes smaller than this fraction of the current bitrate */
+#define BWE_HYSTERESIS 0.95
+/* weight of higher samples, lower ones are taken as is */
+#define BWE_SMOOTHING 0.25
+
+/* queue above this is drained over BWE_DRAIN_SEC by lowering the bitrate
+ * further; growth is extrapolated over BWE_PREDICT_NSEC */
+#define BWE_QUEUE_TARGET_USEC 100000
+#define BWE_DRAIN_SEC 2.0
+#define BWE_PREDICT_NSEC (1ULL * SEC_TO_NSEC)
+
+/* fraction of an interval spent blocked in send to count as busy */
+#define BWE_BUSY_RATIO 0.9
+
+/* RTT over the minimum by this much (or by half the minimum) with the
+ * congestion window mostly used means a standing queue in the network */
+#define BWE_RTT_INFLATION_US 30000
+#define BWE_CWND_USED 0.8
+#define BWE_MIN_RTT_WINDOW (30ULL * SEC_TO_NSEC)
+
+#define BWE_HOLD (2ULL * SEC_TO_NSEC)
+#define BWE_ESTIMATE_TTL (30ULL * SEC_TO_NSEC)
+#define BWE_PROBE_INTERVAL (2ULL * SEC_TO_NSEC)
+
+void bwe_init(struct bandwidth_estimator *bwe, long max_bitrate,
+	      long audio_bitrate, uint64_t ts)
+{
+	memset(bwe, 0, sizeof(*bwe));
+	bwe->max_bitrate = max_bitrate;
+	bwe->audio_bitrate = audio_bitrate;
+	bwe->bitrate = max_bitrate;
+	bwe->interval_start = ts;
+	bwe->last_change = ts;
+}
+
+void bwe_add_send(struct bandwidth_estimator *bwe, uint64_t beg, uint64_t end,
+		  size_t size)
+{
+	bwe->bytes += size;
+	if (end > beg)
+		bwe->busy_ns += end - beg;
+}
+
+void bwe_add_tcp_info(struct bandwidth_estimator *bwe,
+		      const struct bwe_tcp_info *info, uint64_t ts)
+{
+	if (!info->rtt_us)
+		return;
+
+	bwe->tcp = *info;
+	bwe->got_tcp_info = true;
+
+	if (!bwe->min_rtt_us || info->rtt_us < bwe->min_rtt_us ||
+	    ts - bwe->min_rtt_ts > BWE_MIN_RTT_WINDOW) {
+		bwe->min_rtt_us = info->rtt_us;
+		bwe->min_rtt_ts = ts;
+	}
+}
+
+void bwe_add_queue(struct bandwidth_estimator *bwe, int64_t usec)
+{
+	if (!bwe->got_queue || usec < bwe->min_queue_usec)
+		bwe->min_queue_usec = usec;
+	bwe->last_queue_usec = usec;
+	bwe->got_queue = true;
+}
+
+static bool tcp_queue_standing(struct bandwidth_estimator *bwe)
+{
+	uint32_t inflation = bwe->min_rtt_us / 2;
+
+	if (!bwe->got_tcp_info)
+		return false;
+	if (inflation < BWE_RTT_INFLATION_US)
+		inflation = BWE_RTT_INFLATION_US;
+
+	return bwe->tcp.rtt_us > bwe->min_rtt_us + inflation &&
+	       bwe->tcp.inflight_bytes >=
+		       (uint32_t)(bwe->tcp.cwnd_bytes * BWE_CWND_USED);
+}
+
+static void update_estimate(struct bandwidth_estimator *bwe, uint64_t ts,
+			    uint64_t elapsed)
+{
+	double rate = (double)bwe->bytes * 8000000.0 / (double)elapsed;
+	bool queued = bwe->got_queue && bwe->min_queue_usec > 0;
+	bool busy = (double)bwe->busy_ns >= (double)elapsed * BWE_BUSY_RATIO;
+	bool standing = tcp_queue_standing(bwe);
+
+	bwe->congested = queued || busy || standing;
+
+	if (bwe->congested) {
+		double sample = rate;
+
+		/* while the socket buffer absorbs the excess, the send rate
+		 * is the encoder's rather than the link's */
+		if (standing) {
+			double tcp_rate = (double)bwe->tcp.inflight_bytes *
+					  8000.0 / (double)bwe->tcp.rtt_us;
+			if (!(queued || busy) || tcp_rate < sample)
+				sample = tcp_rate;
+		}
+
+		if (bwe->estimate == 0.0 || sample < bwe->estimate)
+			bwe->estimate = sample;
+		else
+			bwe->estimate += (sample - bwe->estimate) *
+					 BWE_SMOOTHING;
+		bwe->estimate_ts = ts;
+
+	} else if (bwe->estimate != 0.0 && rate > bwe->estimate) {
+		bwe->estimate = rate;
+	}
+
+	bwe->got_tcp_info = false;
+}
+
+static bool set_bitrate(struct bandwidth_estimator *bwe, double bitrate,
+			uint64_t ts)
+{
+	long new_bitrate;
+
+	if (bitrate >= (double)bwe->max_bitrate) {
+		new_bitrate = bwe->max_bitrate;
+	} else {
+		new_bitrate = (long)bitrate;
+		new_bitrate -= new_bitrate % BWE_BITRATE_ROUNDING;
+		if (new_bitrate < BWE_MIN_BITRATE)
+			new_bitrate = BWE_MIN_BITRATE;
+	}
+
+	if (new_bitrate == bwe->bitrate)
+		return false;
+
+	bwe->bitrate = new_bitrate;
+	bwe->last_change = ts;
+	return true;
+}
+
+static bool lower_bitrate(struct bandwidth_estimator *bwe, uint64_t ts,
+			  int64_t queue_usec)
+{
+	double total = (double)(bwe->bitrate + bwe->audio_bitrate);
+	double target = bwe->estimate * BWE_HEADROOM -
+			(double)bwe->audio_bitrate;
+
+	if (queue_usec > BWE_QUEUE_TARGET_USEC) {
+		double excess = (double)(queue_usec - BWE_QUEUE_TARGET_USEC);
+		double drain = excess / 1000000.0 * total / BWE_DRAIN_SEC;
+
+		/* the queue drains at the full capacity anyway, so don't
+		 * starve the encoder to get rid of it */
+		if (drain > target / 2.0)
+			drain = target / 2.0;
+		target -= drain;
+	}
+
+	if (target >= (double)bwe->bitrate * BWE_HYSTERESIS)
+		return false;
+
+	bwe->hold_until = ts + BWE_HOLD;
+	return set_bitrate(bwe, target, ts);
+}
+
+static bool raise_bitrate(struct bandwidth_estimator *bwe, uint64_t ts)
+{
+	if (bwe->estimate != 0.0 && ts - bwe->estimate_ts < BWE_ESTIMATE_TTL) {
+		double ceiling = bwe->estimate * BWE_HEADROOM -
+				 (double)bwe->audio_bitrate;
+		double step = (ceiling - (double)bwe->bitrate) / 2.0;
+
+		if ((double)bwe->bitrate >= ceiling * BWE_HYSTERESIS)
+			return false;
+		if (step < (double)(bwe->max_bitrate / 20))
+			step = (double)(bwe->max_bitrate / 20);
+		if ((double)bwe->bitrate + step > ceiling)
+			step = ceiling - (double)bwe->bitrate;
+
+		return set_bitrate(bwe, (double)bwe->bitrate + step, ts);
+	}
+
+	/* the estimate is stale, so probe for more bandwidth */
+	if (ts - bwe->last_change < BWE_PROBE_INTERVAL)
+		return false;
+
+	return set_bitrate(bwe, (double)(bwe->bitrate + bwe->max_bitrate / 10),
+			   ts);
+}
+
+bool bwe_update(struct bandwidth_estimator *bwe, uint64_t ts)
+{
+	uint64_t elapsed = ts - bwe->interval_start;
+	int64_t queue_usec = bwe->last_queue_usec;
+	int64_t predicted_usec = queue_usec;
+	int64_t growth = queue_usec - bwe->prev_queue_usec;
+
+	if (ts < bwe->interval_start || elapsed < BWE_INTERVAL)
+		return false;
+
+	update_estimate(bwe, ts, elapsed);
+
+	if (growth > 0)
+		predicted_usec += (int64_t)((double)growth *
+					    (double)BWE_PREDICT_NSEC /
+					    (double)elapsed);
+
+	bwe->prev_queue_usec = queue_usec;
+	bwe->interval_start = ts;
+	bwe->bytes = 0;
+	bwe->busy_ns = 0;
+	bwe->got_queue = false;
+
+	if (bwe->congested)
+		return lower_bitrate(bwe, ts, predicted_usec);
+
+	if (ts < bwe->hold_until || queue_usec > BWE_QUEUE_TARGET_USEC ||
+	    bwe->bitrate >= bwe->max_bitrate)
+		return false;
+
+	return raise_bitrate(bwe, ts);
+}
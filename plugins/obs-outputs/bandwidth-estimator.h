@@ -0,0 +1,105 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ *   Bandwidth estimation and bitrate control for dynamic bitrate.
+ *
+ *   The estimator works in fixed intervals.  An interval in which the
+ * sender was busy the whole time (packets were waiting in the output queue,
+ * or the socket reports a standing queue in the network) gives a sample of
+ * the link capacity: the rate at which data left the sender, and when TCP
+ * statistics are available, the amount in flight divided by the RTT.  The
+ * estimate follows lower samples immediately and higher ones gradually.
+ *
+ *   The controller then sets the video bitrate to a fraction of the
+ * estimate, minus audio and whatever is needed to drain the queue that has
+ * built up (or is about to, going by how fast it grows).  Once the bitrate
+ * matches the estimate it is held there for a while instead of being
+ * raised right away, which is what makes a threshold-based controller
+ * oscillate; after the estimate has gone stale it is probed upwards again.
+ *
+ *   Timestamps are in nanoseconds, bitrates in kbps.  Nothing in here is
+ * thread safe.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bwe_tcp_info {
+	uint32_t rtt_us;
+	uint32_t cwnd_bytes;
+	uint32_t inflight_bytes;
+};
+
+struct bandwidth_estimator {
+	long max_bitrate;
+	long audio_bitrate;
+
+	/** Current video bitrate */
+	long bitrate;
+
+	/** Estimated link capacity including audio, 0 if unknown */
+	double estimate;
+	uint64_t estimate_ts;
+
+	/* current interval */
+	uint64_t interval_start;
+	uint64_t bytes;
+	uint64_t busy_ns;
+	int64_t min_queue_usec;
+	int64_t last_queue_usec;
+	bool got_queue;
+
+	int64_t prev_queue_usec;
+
+	bool got_tcp_info;
+	struct bwe_tcp_info tcp;
+	uint32_t min_rtt_us;
+	uint64_t min_rtt_ts;
+
+	bool congested;
+	uint64_t hold_until;
+	uint64_t last_change;
+};
+
+extern void bwe_init(struct bandwidth_estimator *bwe, long max_bitrate,
+		     long audio_bitrate, uint64_t ts);
+
+/** Records a packet that took from beg to end to be handed to the socket */
+extern void bwe_add_send(struct bandwidth_estimator *bwe, uint64_t beg,
+			 uint64_t end, size_t size);
+
+extern void bwe_add_tcp_info(struct bandwidth_estimator *bwe,
+			     const struct bwe_tcp_info *info, uint64_t ts);
+
+/** Records the duration of the data waiting in the output queue */
+extern void bwe_add_queue(struct bandwidth_estimator *bwe, int64_t usec);
+
+/**
+ * Updates the estimate and the bitrate if an interval has passed.  Returns
+ * true if bwe->bitrate changed.
+ */
+extern bool bwe_update(struct bandwidth_estimator *bwe, uint64_t ts);
+
+#ifdef __cplusplus
+}
+#endif
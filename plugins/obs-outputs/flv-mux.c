@@ -44,18 +44,18 @@ static inline double encoder_bitrate(obs_encoder_t *encoder)
 
 #define FLV_INFO_SIZE_OFFSET 42
 
-void write_file_info(FILE *file, int64_t duration_ms, int64_t size)
+void write_file_info(struct serializer *s, int64_t duration_ms, int64_t size)
 {
 	char buf[64];
 	char *enc = buf;
 	char *end = enc + sizeof(buf);
 
-	fseek(file, FLV_INFO_SIZE_OFFSET, SEEK_SET);
+	serializer_seek(s, FLV_INFO_SIZE_OFFSET, SERIALIZE_SEEK_START);
 
 	enc_num_val(&enc, end, "duration", (double)duration_ms / 1000.0);
 	enc_num_val(&enc, end, "fileSize", (double)size);
 
-	fwrite(buf, 1, enc - buf, file);
+	s_write(s, buf, enc - buf);
 }
 
 static void build_flv_meta_data(obs_output_t *context, uint8_t **output,
@@ -169,19 +169,31 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
-static void flv_video(struct serializer *s, int32_t dts_offset,
-		      struct encoder_packet *packet, bool is_header)
+static inline uint8_t *put_b24(uint8_t *p, uint32_t val)
 {
-	int64_t offset = packet->pts - packet->dts;
-	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	*p++ = (uint8_t)(val >> 16);
+	*p++ = (uint8_t)(val >> 8);
+	*p++ = (uint8_t)val;
+	return p;
+}
 
-	if (!packet->data || !packet->size)
-		return;
+static inline uint8_t *put_b32(uint8_t *p, uint32_t val)
+{
+	*p++ = (uint8_t)(val >> 24);
+	return put_b24(p, val);
+}
+
+static size_t flv_tag_header(uint8_t *header, int32_t dts_offset,
+			     struct encoder_packet *packet, bool is_header)
+{
+	bool video = packet->type == OBS_ENCODER_VIDEO;
+	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	uint8_t *p = header;
 
-	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
+	*p++ = video ? RTMP_PACKET_TYPE_VIDEO : RTMP_PACKET_TYPE_AUDIO;
 
 #ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Video: %lu", time_ms);
+	blog(LOG_DEBUG, "%s: %lu", video ? "Video" : "Audio", time_ms);
 
 	if (last_time > time_ms)
 		blog(LOG_DEBUG, "Non-monotonic");
@@ -189,52 +201,42 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	last_time = time_ms;
 #endif
 
-	s_wb24(s, (uint32_t)packet->size + 5);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
+	p = put_b24(p, (uint32_t)packet->size + (video ? 5 : 2));
+	p = put_b24(p, time_ms);
+	*p++ = (time_ms >> 24) & 0x7F;
+	p = put_b24(p, 0);
 
-	/* these are the 5 extra bytes mentioned above */
-	s_w8(s, packet->keyframe ? 0x17 : 0x27);
-	s_w8(s, is_header ? 0 : 1);
-	s_wb24(s, get_ms_time(packet, offset));
-	s_write(s, packet->data, packet->size);
+	if (video) {
+		int64_t offset = packet->pts - packet->dts;
 
-	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+		/* these are the 5 extra bytes mentioned above */
+		*p++ = packet->keyframe ? 0x17 : 0x27;
+		*p++ = is_header ? 0 : 1;
+		p = put_b24(p, get_ms_time(packet, offset));
+	} else {
+		/* these are the two extra bytes mentioned above */
+		*p++ = 0xaf;
+		*p++ = is_header ? 0 : 1;
+	}
+
+	return p - header;
 }
 
-static void flv_audio(struct serializer *s, int32_t dts_offset,
-		      struct encoder_packet *packet, bool is_header)
+bool flv_packet_mux_iov(struct encoder_packet *packet, int32_t dts_offset,
+			bool is_header, struct flv_packet_iov *iov)
 {
-	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
-
 	if (!packet->data || !packet->size)
-		return;
+		return false;
 
-	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
-
-#ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Audio: %lu", time_ms);
-
-	if (last_time > time_ms)
-		blog(LOG_DEBUG, "Non-monotonic");
-
-	last_time = time_ms;
-#endif
-
-	s_wb24(s, (uint32_t)packet->size + 2);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
-
-	/* these are the two extra bytes mentioned above */
-	s_w8(s, 0xaf);
-	s_w8(s, is_header ? 0 : 1);
-	s_write(s, packet->data, packet->size);
+	iov->header_size =
+		flv_tag_header(iov->header, dts_offset, packet, is_header);
+	iov->payload = packet->data;
+	iov->payload_size = packet->size;
 
 	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	put_b32(iov->trailer,
+		(uint32_t)(iov->header_size + iov->payload_size - 1));
+	return true;
 }
 
 void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
@@ -242,13 +244,16 @@ void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
 {
 	struct array_output_data data;
 	struct serializer s;
+	struct flv_packet_iov iov;
 
 	array_output_serializer_init(&s, &data);
 
-	if (packet->type == OBS_ENCODER_VIDEO)
-		flv_video(&s, dts_offset, packet, is_header);
-	else
-		flv_audio(&s, dts_offset, packet, is_header);
+	if (flv_packet_mux_iov(packet, dts_offset, is_header, &iov)) {
+		da_reserve(data.bytes, flv_packet_iov_size(&iov));
+		s_write(&s, iov.header, iov.header_size);
+		s_write(&s, iov.payload, iov.payload_size);
+		s_write(&s, iov.trailer, FLV_TAG_TRAILER_SIZE);
+	}
 
 	*output = data.bytes.array;
 	*size = data.bytes.num;
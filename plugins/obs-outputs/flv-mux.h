@@ -18,6 +18,7 @@
 #pragma once
 
 #include <obs.h>
+#include <util/serializer.h>
 
 #define MILLISECOND_DEN 1000
 
@@ -26,7 +27,27 @@ static int32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 	return (int32_t)(val * MILLISECOND_DEN / packet->timebase_den);
 }
 
-extern void write_file_info(FILE *file, int64_t duration_ms, int64_t size);
+/* tag header + extra video/audio bytes */
+#define FLV_TAG_HEADER_MAX_SIZE (11 + 5)
+#define FLV_TAG_TRAILER_SIZE 4
+
+/* A muxed packet split into the tag header, the packet's own payload (not
+ * copied) and the trailing tag size, for writing with separate calls. */
+struct flv_packet_iov {
+	uint8_t header[FLV_TAG_HEADER_MAX_SIZE];
+	size_t header_size;
+	const uint8_t *payload;
+	size_t payload_size;
+	uint8_t trailer[FLV_TAG_TRAILER_SIZE];
+};
+
+static inline size_t flv_packet_iov_size(const struct flv_packet_iov *iov)
+{
+	return iov->header_size + iov->payload_size + FLV_TAG_TRAILER_SIZE;
+}
+
+extern void write_file_info(struct serializer *s, int64_t duration_ms,
+			    int64_t size);
 
 extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 			  bool write_header);
@@ -34,6 +55,9 @@ extern void flv_additional_meta_data(obs_output_t *context, uint8_t **output,
 				     size_t *size);
 extern void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
 			   uint8_t **output, size_t *size, bool is_header);
+extern bool flv_packet_mux_iov(struct encoder_packet *packet,
+			       int32_t dts_offset, bool is_header,
+			       struct flv_packet_iov *iov);
 extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
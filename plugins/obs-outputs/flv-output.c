@@ -21,6 +21,7 @@
 #include <util/platform.h>
 #include <util/dstr.h>
 #include <util/threading.h>
+#include <util/buffered-file-serializer.h>
 #include <inttypes.h>
 #include "flv-mux.h"
 
@@ -34,7 +35,8 @@
 struct flv_output {
 	obs_output_t *output;
 	struct dstr path;
-	FILE *file;
+	struct serializer file;
+	bool file_open;
 	volatile bool active;
 	volatile bool stopping;
 	uint64_t stop_ts;
@@ -69,6 +71,9 @@ static void flv_output_destroy(void *data)
 {
 	struct flv_output *stream = data;
 
+	if (stream->file_open)
+		buffered_file_serializer_free(&stream->file);
+
 	pthread_mutex_destroy(&stream->mutex);
 	dstr_free(&stream->path);
 	bfree(stream);
@@ -87,18 +92,25 @@ static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 static int write_packet(struct flv_output *stream,
 			struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t size;
-	int ret = 0;
+	struct flv_packet_iov iov;
 
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
-	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset, &data,
-		       &size, is_header);
-	fwrite(data, 1, size, stream->file);
-	bfree(data);
-
-	return ret;
+	if (!flv_packet_mux_iov(packet,
+				is_header ? 0 : stream->start_dts_offset,
+				is_header, &iov))
+		return 0;
+
+	/* the payload goes straight from the packet to the file */
+	if (s_write(&stream->file, iov.header, iov.header_size) !=
+		    iov.header_size ||
+	    s_write(&stream->file, iov.payload, iov.payload_size) !=
+		    iov.payload_size ||
+	    s_write(&stream->file, iov.trailer, FLV_TAG_TRAILER_SIZE) !=
+		    FLV_TAG_TRAILER_SIZE)
+		return -1;
+
+	return 0;
 }
 
 static void write_meta_data(struct flv_output *stream)
@@ -107,7 +119,7 @@ static void write_meta_data(struct flv_output *stream)
 	size_t meta_data_size;
 
 	flv_meta_data(stream->output, &meta_data, &meta_data_size, true);
-	fwrite(meta_data, 1, meta_data_size, stream->file);
+	s_write(&stream->file, meta_data, meta_data_size);
 	bfree(meta_data);
 }
 
@@ -146,9 +158,19 @@ static void write_headers(struct flv_output *stream)
 	write_audio_header(stream);
 }
 
+static void flv_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "buffer_size_mb",
+				 BUFFERED_FILE_DEFAULT_BUFFER_SIZE /
+					 (1024 * 1024));
+	obs_data_set_default_bool(settings, "direct_io", false);
+	obs_data_set_default_int(settings, "preallocate_mb", 0);
+}
+
 static bool flv_output_start(void *data)
 {
 	struct flv_output *stream = data;
+	struct buffered_file_serializer_options opts = {0};
 	obs_data_t *settings;
 	const char *path;
 
@@ -165,10 +187,19 @@ static bool flv_output_start(void *data)
 	settings = obs_output_get_settings(stream->output);
 	path = obs_data_get_string(settings, "path");
 	dstr_copy(&stream->path, path);
+
+	opts.buffer_size =
+		(size_t)obs_data_get_int(settings, "buffer_size_mb") * 1024 *
+		1024;
+	opts.direct_io = obs_data_get_bool(settings, "direct_io");
+	opts.prealloc_size =
+		(uint64_t)obs_data_get_int(settings, "preallocate_mb") * 1024 *
+		1024;
 	obs_data_release(settings);
 
-	stream->file = os_fopen(stream->path.array, "wb");
-	if (!stream->file) {
+	stream->file_open = buffered_file_serializer_init(
+		&stream->file, stream->path.array, &opts);
+	if (!stream->file_open) {
 		warn("Unable to open FLV file '%s'", stream->path.array);
 		return false;
 	}
@@ -188,16 +219,32 @@ static void flv_output_stop(void *data, uint64_t ts)
 	os_atomic_set_bool(&stream->stopping, true);
 }
 
+static void close_file(struct flv_output *stream)
+{
+	struct buffered_file_serializer_stats stats;
+
+	write_file_info(&stream->file, stream->last_packet_ts,
+			serializer_get_pos(&stream->file));
+
+	buffered_file_serializer_get_stats(&stream->file, &stats);
+	if (stats.stalls)
+		warn("Disk was too slow %" PRIu64 " time(s), waited "
+		     "%" PRIu64 " ms in total (longest write: %" PRIu64 " ms)",
+		     stats.stalls, stats.stall_ns / 1000000,
+		     stats.max_write_ns / 1000000);
+
+	if (!buffered_file_serializer_free(&stream->file))
+		warn("Failed to write all data to '%s'", stream->path.array);
+
+	stream->file_open = false;
+}
+
 static void flv_output_actual_stop(struct flv_output *stream, int code)
 {
 	os_atomic_set_bool(&stream->active, false);
 
-	if (stream->file) {
-		write_file_info(stream->file, stream->last_packet_ts,
-				os_ftelli64(stream->file));
-
-		fclose(stream->file);
-	}
+	if (stream->file_open)
+		close_file(stream);
 	if (code) {
 		obs_output_signal_stop(stream->output, code);
 	} else {
@@ -211,6 +258,7 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 {
 	struct flv_output *stream = data;
 	struct encoder_packet parsed_packet;
+	int ret;
 
 	pthread_mutex_lock(&stream->mutex);
 
@@ -242,10 +290,15 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 		}
 
 		obs_parse_avc_packet(&parsed_packet, packet);
-		write_packet(stream, &parsed_packet, false);
+		ret = write_packet(stream, &parsed_packet, false);
 		obs_encoder_packet_release(&parsed_packet);
 	} else {
-		write_packet(stream, packet, false);
+		ret = write_packet(stream, packet, false);
+	}
+
+	if (ret < 0) {
+		warn("Failed to write to '%s'", stream->path.array);
+		flv_output_actual_stop(stream, OBS_OUTPUT_ERROR);
 	}
 
 unlock:
@@ -261,6 +314,14 @@ static obs_properties_t *flv_output_properties(void *unused)
 	obs_properties_add_text(props, "path",
 				obs_module_text("FLVOutput.FilePath"),
 				OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, "buffer_size_mb",
+			       obs_module_text("FLVOutput.BufferSize"), 2, 1024,
+			       1);
+	obs_properties_add_bool(props, "direct_io",
+				obs_module_text("FLVOutput.DirectIO"));
+	obs_properties_add_int(props, "preallocate_mb",
+			       obs_module_text("FLVOutput.Preallocate"), 0,
+			       4096, 64);
 	return props;
 }
 
@@ -275,5 +336,6 @@ struct obs_output_info flv_output_info = {
 	.start = flv_output_start,
 	.stop = flv_output_stop,
 	.encoded_packet = flv_output_data,
+	.get_defaults = flv_output_defaults,
 	.get_properties = flv_output_properties,
 };
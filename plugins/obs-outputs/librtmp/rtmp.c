@@ -5363,8 +5363,13 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
                 return -1;
             buf += 4;
             s2 -= 4;
+            /* the previous tag size may be left out when the tag is
+             * written in pieces */
             if (s2 < 0)
+            {
+                s2 = 0;
                 break;
+            }
         }
     }
     return size+s2;
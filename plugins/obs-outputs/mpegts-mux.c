@@ -0,0 +1,389 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-avc.h>
+#include "mpegts-mux.h"
+
+#define PID_PMT 0x1000
+#define PID_VIDEO 0x100
+#define PID_AUDIO 0x101
+
+#define STREAM_TYPE_AAC 0x0F
+#define STREAM_TYPE_H264 0x1B
+
+#define STREAM_ID_AUDIO 0xC0
+#define STREAM_ID_VIDEO 0xE0
+
+#define TS_CLOCK 90000
+/* keeps early audio and the PCR offset from going negative */
+#define TS_START_OFFSET TS_CLOCK
+#define PCR_DELAY (TS_CLOCK / 10)
+#define PSI_INTERVAL (TS_CLOCK / 4)
+#define TS_MASK ((1LL << 33) - 1)
+
+#define TS_PAYLOAD_SIZE (MPEGTS_PACKET_SIZE - 4)
+
+static const uint8_t aud_nal[] = {0, 0, 0, 1, 9, 0xF0};
+
+/* MPEG-2 CRC (poly 0x04C11DB7, not reflected) */
+static uint32_t mpeg_crc32(const uint8_t *data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < size; i++) {
+		crc ^= (uint32_t)data[i] << 24;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7
+						 : (crc << 1);
+	}
+
+	return crc;
+}
+
+void mpegts_mux_init(struct mpegts_mux *mux, const uint8_t *video_header,
+		     size_t video_header_size, const uint8_t *audio_config,
+		     size_t audio_config_size)
+{
+	memset(mux, 0, sizeof(*mux));
+
+	if (video_header_size) {
+		mux->video_header = bmemdup(video_header, video_header_size);
+		mux->video_header_size = video_header_size;
+	}
+
+	if (audio_config && audio_config_size >= 2) {
+		mux->has_audio = true;
+		mux->aac_object_type = audio_config[0] >> 3;
+		mux->aac_sample_rate_idx = ((audio_config[0] & 0x7) << 1) |
+					   (audio_config[1] >> 7);
+		mux->aac_channels = (audio_config[1] >> 3) & 0xF;
+	}
+}
+
+void mpegts_mux_free(struct mpegts_mux *mux)
+{
+	da_free(mux->output);
+	da_free(mux->pes);
+	bfree(mux->video_header);
+	memset(mux, 0, sizeof(*mux));
+}
+
+static inline int64_t to_ts_clock(const struct encoder_packet *packet,
+				  int64_t val)
+{
+	return val * TS_CLOCK * packet->timebase_num / packet->timebase_den;
+}
+
+static void write_psi(struct mpegts_mux *mux, uint16_t pid, uint8_t *cc,
+		      const uint8_t *section, size_t size)
+{
+	uint8_t pkt[MPEGTS_PACKET_SIZE];
+
+	pkt[0] = 0x47;
+	pkt[1] = 0x40 | (uint8_t)(pid >> 8);
+	pkt[2] = (uint8_t)pid;
+	pkt[3] = 0x10 | *cc;
+	pkt[4] = 0; /* pointer field */
+	*cc = (*cc + 1) & 0xF;
+
+	memcpy(pkt + 5, section, size);
+	memset(pkt + 5 + size, 0xFF, sizeof(pkt) - 5 - size);
+
+	da_push_back_array(mux->output, pkt, sizeof(pkt));
+}
+
+static size_t finish_section(uint8_t *section, uint8_t *end)
+{
+	size_t size = end - section;
+	uint32_t crc;
+
+	/* section length counts everything after itself, including CRC */
+	size_t section_length = size - 3 + 4;
+	section[1] = 0xB0 | (uint8_t)(section_length >> 8);
+	section[2] = (uint8_t)section_length;
+
+	crc = mpeg_crc32(section, size);
+	*end++ = (uint8_t)(crc >> 24);
+	*end++ = (uint8_t)(crc >> 16);
+	*end++ = (uint8_t)(crc >> 8);
+	*end++ = (uint8_t)crc;
+	return size + 4;
+}
+
+static void write_pat_pmt(struct mpegts_mux *mux)
+{
+	uint8_t section[64];
+	uint8_t *p;
+
+	p = section;
+	*p++ = 0x00; /* table id: PAT */
+	p += 2;
+	*p++ = 0x00; /* transport stream id */
+	*p++ = 0x01;
+	*p++ = 0xC1; /* version 0, current */
+	*p++ = 0x00;
+	*p++ = 0x00;
+	*p++ = 0x00; /* program number 1 */
+	*p++ = 0x01;
+	*p++ = 0xE0 | (PID_PMT >> 8);
+	*p++ = PID_PMT & 0xFF;
+	write_psi(mux, 0, &mux->cc_pat, section, finish_section(section, p));
+
+	p = section;
+	*p++ = 0x02; /* table id: PMT */
+	p += 2;
+	*p++ = 0x00; /* program number 1 */
+	*p++ = 0x01;
+	*p++ = 0xC1;
+	*p++ = 0x00;
+	*p++ = 0x00;
+	*p++ = 0xE0 | (PID_VIDEO >> 8); /* PCR pid */
+	*p++ = PID_VIDEO & 0xFF;
+	*p++ = 0xF0; /* no program info */
+	*p++ = 0x00;
+
+	*p++ = STREAM_TYPE_H264;
+	*p++ = 0xE0 | (PID_VIDEO >> 8);
+	*p++ = PID_VIDEO & 0xFF;
+	*p++ = 0xF0;
+	*p++ = 0x00;
+
+	if (mux->has_audio) {
+		*p++ = STREAM_TYPE_AAC;
+		*p++ = 0xE0 | (PID_AUDIO >> 8);
+		*p++ = PID_AUDIO & 0xFF;
+		*p++ = 0xF0;
+		*p++ = 0x00;
+	}
+	write_psi(mux, PID_PMT, &mux->cc_pmt, section,
+		  finish_section(section, p));
+}
+
+static uint8_t *write_pcr(uint8_t *p, int64_t pcr)
+{
+	uint64_t base = (uint64_t)pcr & TS_MASK;
+
+	*p++ = (uint8_t)(base >> 25);
+	*p++ = (uint8_t)(base >> 17);
+	*p++ = (uint8_t)(base >> 9);
+	*p++ = (uint8_t)(base >> 1);
+	*p++ = (uint8_t)((base & 1) << 7) | 0x7E;
+	*p++ = 0;
+	return p;
+}
+
+/* splits mux->pes into TS packets, using adaptation field stuffing to fill
+ * the last one */
+static void write_pes_packets(struct mpegts_mux *mux, uint16_t pid,
+			      uint8_t *cc, bool random_access, int64_t pcr)
+{
+	const uint8_t *data = mux->pes.array;
+	size_t size = mux->pes.num;
+	bool first = true;
+
+	while (size) {
+		uint8_t pkt[MPEGTS_PACKET_SIZE];
+		uint8_t *p = pkt;
+		uint8_t flags = 0;
+		size_t af_size = 0;
+		size_t chunk;
+
+		if (first) {
+			if (random_access)
+				flags |= 0x40;
+			if (pcr >= 0)
+				flags |= 0x10;
+		}
+		if (flags)
+			af_size = 2 + ((flags & 0x10) ? 6 : 0);
+
+		chunk = TS_PAYLOAD_SIZE - af_size;
+		if (size < chunk) {
+			af_size += chunk - size;
+			chunk = size;
+		}
+
+		*p++ = 0x47;
+		*p++ = (first ? 0x40 : 0) | (uint8_t)(pid >> 8);
+		*p++ = (uint8_t)pid;
+		*p++ = (af_size ? 0x30 : 0x10) | *cc;
+		*cc = (*cc + 1) & 0xF;
+
+		if (af_size) {
+			uint8_t *af_end = p + af_size;
+
+			*p++ = (uint8_t)(af_size - 1);
+			if (af_size > 1) {
+				*p++ = flags;
+				if (flags & 0x10)
+					p = write_pcr(p, pcr);
+				memset(p, 0xFF, af_end - p);
+				p = af_end;
+			}
+		}
+
+		memcpy(p, data, chunk);
+		da_push_back_array(mux->output, pkt, sizeof(pkt));
+
+		data += chunk;
+		size -= chunk;
+		first = false;
+	}
+}
+
+static uint8_t *write_timestamp(uint8_t *p, uint8_t prefix, int64_t ts)
+{
+	uint64_t val = (uint64_t)ts & TS_MASK;
+
+	*p++ = (uint8_t)(prefix << 4) | (uint8_t)((val >> 29) & 0x0E) | 1;
+	*p++ = (uint8_t)(val >> 22);
+	*p++ = (uint8_t)((val >> 14) & 0xFE) | 1;
+	*p++ = (uint8_t)(val >> 7);
+	*p++ = (uint8_t)((val << 1) & 0xFE) | 1;
+	return p;
+}
+
+static void begin_pes(struct mpegts_mux *mux, uint8_t stream_id,
+		      size_t payload_size, int64_t pts, int64_t dts)
+{
+	uint8_t header[19];
+	uint8_t *p = header;
+	bool has_dts = pts != dts;
+	size_t header_data_size = has_dts ? 10 : 5;
+	size_t pes_size = 3 + header_data_size + payload_size;
+
+	*p++ = 0;
+	*p++ = 0;
+	*p++ = 1;
+	*p++ = stream_id;
+
+	/* video PES packets can exceed 64k, so leave their size unbounded */
+	if (stream_id == STREAM_ID_VIDEO || pes_size > 0xFFFF)
+		pes_size = 0;
+	*p++ = (uint8_t)(pes_size >> 8);
+	*p++ = (uint8_t)pes_size;
+
+	*p++ = 0x80;
+	*p++ = has_dts ? 0xC0 : 0x80;
+	*p++ = (uint8_t)header_data_size;
+	p = write_timestamp(p, has_dts ? 3 : 2, pts);
+	if (has_dts)
+		p = write_timestamp(p, 1, dts);
+
+	da_resize(mux->pes, 0);
+	da_push_back_array(mux->pes, header, p - header);
+}
+
+static bool has_sps(const uint8_t *data, size_t size)
+{
+	const uint8_t *end = data + size;
+	const uint8_t *nal = obs_avc_find_startcode(data, end);
+
+	while (nal < end) {
+		while (nal < end && !*nal++)
+			;
+		if (nal == end)
+			break;
+
+		if ((*nal & 0x1F) == OBS_NAL_SPS)
+			return true;
+
+		nal = obs_avc_find_startcode(nal, end);
+	}
+
+	return false;
+}
+
+static void mux_video(struct mpegts_mux *mux,
+		      const struct encoder_packet *packet, int64_t pts,
+		      int64_t dts)
+{
+	bool add_header = packet->keyframe && mux->video_header_size &&
+			  !has_sps(packet->data, packet->size);
+	size_t size = sizeof(aud_nal) + packet->size;
+
+	if (add_header)
+		size += mux->video_header_size;
+
+	if (packet->keyframe || dts - mux->last_psi_ts >= PSI_INTERVAL) {
+		write_pat_pmt(mux);
+		mux->last_psi_ts = dts;
+	}
+
+	begin_pes(mux, STREAM_ID_VIDEO, size, pts, dts);
+	da_push_back_array(mux->pes, aud_nal, sizeof(aud_nal));
+	if (add_header)
+		da_push_back_array(mux->pes, mux->video_header,
+				   mux->video_header_size);
+	da_push_back_array(mux->pes, packet->data, packet->size);
+
+	write_pes_packets(mux, PID_VIDEO, &mux->cc_video, packet->keyframe,
+			  dts - PCR_DELAY);
+}
+
+static void mux_audio(struct mpegts_mux *mux,
+		      const struct encoder_packet *packet, int64_t pts,
+		      int64_t dts)
+{
+	uint8_t adts[7];
+	size_t frame_size = sizeof(adts) + packet->size;
+
+	adts[0] = 0xFF;
+	adts[1] = 0xF1; /* MPEG-4, no CRC */
+	adts[2] = (uint8_t)((mux->aac_object_type - 1) << 6) |
+		  (uint8_t)(mux->aac_sample_rate_idx << 2) |
+		  (mux->aac_channels >> 2);
+	adts[3] = (uint8_t)((mux->aac_channels & 3) << 6) |
+		  (uint8_t)(frame_size >> 11);
+	adts[4] = (uint8_t)(frame_size >> 3);
+	adts[5] = (uint8_t)((frame_size & 7) << 5) | 0x1F;
+	adts[6] = 0xFC;
+
+	begin_pes(mux, STREAM_ID_AUDIO, frame_size, pts, dts);
+	da_push_back_array(mux->pes, adts, sizeof(adts));
+	da_push_back_array(mux->pes, packet->data, packet->size);
+
+	write_pes_packets(mux, PID_AUDIO, &mux->cc_audio, true, -1);
+}
+
+void mpegts_mux_packet(struct mpegts_mux *mux,
+		       const struct encoder_packet *packet)
+{
+	int64_t pts = to_ts_clock(packet, packet->pts);
+	int64_t dts = to_ts_clock(packet, packet->dts);
+
+	if (!packet->data || !packet->size)
+		return;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (!mux->got_first_video) {
+			mux->start_ts = dts;
+			mux->last_psi_ts = 0;
+			mux->got_first_video = true;
+		}
+	} else if (!mux->got_first_video || !mux->has_audio) {
+		return;
+	}
+
+	pts = pts - mux->start_ts + TS_START_OFFSET;
+	dts = dts - mux->start_ts + TS_START_OFFSET;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		mux_video(mux, packet, pts, dts);
+	else
+		mux_audio(mux, packet, pts, dts);
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+
+/* Minimal MPEG-TS muxer for one H.264 and one AAC stream.  Video packets
+ * are expected in Annex B format (as they come from the encoder), audio
+ * packets as raw AAC frames which get ADTS headers added. */
+
+#define MPEGTS_PACKET_SIZE 188
+
+struct mpegts_mux {
+	DARRAY(uint8_t) output;
+	DARRAY(uint8_t) pes;
+
+	uint8_t *video_header;
+	size_t video_header_size;
+
+	bool has_audio;
+	uint8_t aac_object_type;
+	uint8_t aac_sample_rate_idx;
+	uint8_t aac_channels;
+
+	uint8_t cc_pat;
+	uint8_t cc_pmt;
+	uint8_t cc_video;
+	uint8_t cc_audio;
+
+	bool got_first_video;
+	int64_t start_ts;
+	int64_t last_psi_ts;
+};
+
+/**
+ * video_header is the encoder's Annex B SPS/PPS, repeated in front of every
+ * keyframe.  audio_config is the AAC AudioSpecificConfig, or NULL if there
+ * is no audio stream.
+ */
+extern void mpegts_mux_init(struct mpegts_mux *mux, const uint8_t *video_header,
+			    size_t video_header_size,
+			    const uint8_t *audio_config,
+			    size_t audio_config_size);
+extern void mpegts_mux_free(struct mpegts_mux *mux);
+
+/**
+ * Appends the TS packets for an encoded packet to mux->output.  The caller
+ * consumes and clears the output array.  Audio packets before the first
+ * video packet are discarded so the stream starts on a keyframe.
+ */
+extern void mpegts_mux_packet(struct mpegts_mux *mux,
+			      const struct encoder_packet *packet);
@@ -0,0 +1,1121 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <inttypes.h>
+#include "librtmp/rtmp.h"
+#include "librtmp/log.h"
+#include "flv-mux.h"
+#include "net-if.h"
+
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#endif
+
+/*
+ *   Streams one program to several RTMP servers.  Every packet is parsed
+ * and FLV muxed once into a reference counted tag that is shared by the
+ * queues of all destinations.  Each destination has its own send thread,
+ * connection, reconnect logic and frame dropping, so a slow or failing
+ * server only affects its own stream.
+ *
+ *   A destination that (re)connects starts at the next keyframe with its
+ * own timestamps starting at zero, which is why tags are muxed without a
+ * time offset and the timestamp is rewritten in a copy of the tag header
+ * when it's sent.
+ */
+
+#define do_log(level, format, ...)                       \
+	blog(level, "[rtmp multi stream: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#define dest_log(level, format, ...)                                  \
+	blog(level, "[rtmp multi stream: '%s'] [%s] " format,          \
+	     obs_output_get_name(dest->stream->output), dest->url.array, \
+	     ##__VA_ARGS__)
+
+#define OPT_DESTINATIONS "destinations"
+#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+#define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
+#define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
+#define OPT_RETRY_DELAY "retry_delay_sec"
+#define OPT_MAX_RETRIES "max_retries"
+#define OPT_BIND_IP "bind_ip"
+
+#define MAX_RETRY_DELAY_SEC 60
+#define SEND_WAIT_MS 100
+
+/* ------------------------------------------------------------------------- */
+
+struct flv_tag {
+	volatile long refs;
+	struct encoder_packet packet;
+	struct flv_packet_iov iov;
+	int32_t time_ms;
+};
+
+static inline struct flv_tag *flv_tag_addref(struct flv_tag *tag)
+{
+	os_atomic_inc_long(&tag->refs);
+	return tag;
+}
+
+static void flv_tag_release(struct flv_tag *tag)
+{
+	if (tag && os_atomic_dec_long(&tag->refs) == 0) {
+		obs_encoder_packet_release(&tag->packet);
+		bfree(tag);
+	}
+}
+
+static struct flv_tag *flv_tag_create(struct encoder_packet *packet)
+{
+	struct flv_tag *tag = bzalloc(sizeof(struct flv_tag));
+	tag->refs = 1;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		obs_parse_avc_packet(&tag->packet, packet);
+	else
+		obs_encoder_packet_ref(&tag->packet, packet);
+
+	if (!flv_packet_mux_iov(&tag->packet, 0, false, &tag->iov)) {
+		flv_tag_release(tag);
+		return NULL;
+	}
+
+	tag->time_ms = get_ms_time(&tag->packet, tag->packet.dts);
+	return tag;
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct rtmp_multi_stream;
+
+struct rtmp_destination {
+	struct rtmp_multi_stream *stream;
+
+	struct dstr url, key;
+	struct dstr encoder_name;
+	RTMP rtmp;
+
+	pthread_t send_thread;
+	bool send_thread_active;
+	os_event_t *data_event;
+
+	pthread_mutex_t tags_mutex;
+	struct circlebuf tags;
+	volatile bool connected;
+	bool waiting_for_keyframe;
+	bool sent_headers;
+	int32_t start_time_ms;
+	int64_t last_dts_usec;
+	int min_priority;
+	float congestion;
+
+	volatile bool failed;
+	int last_error;
+	int reconnects;
+	uint64_t total_bytes_sent;
+	int dropped_frames;
+};
+
+struct rtmp_multi_stream {
+	obs_output_t *output;
+
+	DARRAY(struct rtmp_destination *) dests;
+	pthread_mutex_t dests_mutex;
+
+	os_event_t *stop_event;
+	volatile long running;
+	volatile bool encode_error;
+	volatile bool reached_stop;
+	uint64_t stop_ts;
+	uint64_t shutdown_timeout_ts;
+
+	int64_t drop_threshold_usec;
+	int64_t pframe_drop_threshold_usec;
+	int max_shutdown_time_sec;
+	int retry_delay_sec;
+	int max_retries;
+	struct dstr bind_ip;
+};
+
+static const char *rtmp_multi_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("RTMPMultiStream");
+}
+
+static void log_rtmp(int level, const char *format, va_list args)
+{
+	if (level > RTMP_LOGWARNING)
+		return;
+
+	blogva(LOG_INFO, format, args);
+}
+
+static inline bool running(struct rtmp_multi_stream *stream)
+{
+	return os_atomic_load_long(&stream->running) > 0;
+}
+
+static inline bool stopping(struct rtmp_multi_stream *stream)
+{
+	return os_event_try(stream->stop_event) != EAGAIN;
+}
+
+static inline bool connected(struct rtmp_destination *dest)
+{
+	return os_atomic_load_bool(&dest->connected);
+}
+
+/* ------------------------------------------------------------------------- */
+/* destination queue, called with tags_mutex locked                          */
+
+static inline size_t num_buffered_tags(struct rtmp_destination *dest)
+{
+	return dest->tags.size / sizeof(struct flv_tag *);
+}
+
+static inline struct flv_tag *peek_tag(struct rtmp_destination *dest,
+				       size_t idx)
+{
+	return *(struct flv_tag **)circlebuf_data(
+		&dest->tags, idx * sizeof(struct flv_tag *));
+}
+
+static void free_tags(struct rtmp_destination *dest)
+{
+	while (dest->tags.size) {
+		struct flv_tag *tag;
+		circlebuf_pop_front(&dest->tags, &tag, sizeof(tag));
+		flv_tag_release(tag);
+	}
+}
+
+static void drop_frames(struct rtmp_destination *dest, int highest_priority)
+{
+	struct circlebuf new_buf = {0};
+	int num_frames_dropped = 0;
+
+	circlebuf_reserve(&new_buf, sizeof(struct flv_tag *) * 8);
+
+	while (dest->tags.size) {
+		struct flv_tag *tag;
+		circlebuf_pop_front(&dest->tags, &tag, sizeof(tag));
+
+		/* do not drop audio data or video keyframes */
+		if (tag->packet.type == OBS_ENCODER_AUDIO ||
+		    tag->packet.drop_priority >= highest_priority) {
+			circlebuf_push_back(&new_buf, &tag, sizeof(tag));
+		} else {
+			num_frames_dropped++;
+			flv_tag_release(tag);
+		}
+	}
+
+	circlebuf_free(&dest->tags);
+	dest->tags = new_buf;
+
+	if (dest->min_priority < highest_priority)
+		dest->min_priority = highest_priority;
+
+	dest->dropped_frames += num_frames_dropped;
+}
+
+static bool find_first_video_tag(struct rtmp_destination *dest,
+				 struct flv_tag **first)
+{
+	size_t count = num_buffered_tags(dest);
+
+	for (size_t i = 0; i < count; i++) {
+		struct flv_tag *tag = peek_tag(dest, i);
+		if (tag->packet.type == OBS_ENCODER_VIDEO &&
+		    !tag->packet.keyframe) {
+			*first = tag;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void check_to_drop_frames(struct rtmp_destination *dest, bool pframes)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+	struct flv_tag *first;
+	int64_t buffer_duration_usec;
+	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST
+			       : OBS_NAL_PRIORITY_HIGH;
+	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
+					 : stream->drop_threshold_usec;
+
+	if (num_buffered_tags(dest) < 5) {
+		if (!pframes)
+			dest->congestion = 0.0f;
+		return;
+	}
+
+	if (!find_first_video_tag(dest, &first))
+		return;
+
+	buffer_duration_usec = dest->last_dts_usec - first->packet.dts_usec;
+
+	if (!pframes)
+		dest->congestion =
+			(float)buffer_duration_usec / (float)drop_threshold;
+
+	if (buffer_duration_usec > drop_threshold)
+		drop_frames(dest, priority);
+}
+
+static bool add_tag(struct rtmp_destination *dest, struct flv_tag *tag)
+{
+	bool video = tag->packet.type == OBS_ENCODER_VIDEO;
+
+	/* start (or restart after reconnecting) on a keyframe */
+	if (dest->waiting_for_keyframe) {
+		if (!video || !tag->packet.keyframe)
+			return false;
+
+		dest->waiting_for_keyframe = false;
+		dest->start_time_ms = tag->time_ms;
+		dest->min_priority = 0;
+	}
+
+	if (video) {
+		check_to_drop_frames(dest, false);
+		check_to_drop_frames(dest, true);
+
+		if (tag->packet.drop_priority < dest->min_priority) {
+			dest->dropped_frames++;
+			return false;
+		}
+
+		dest->min_priority = 0;
+		dest->last_dts_usec = tag->packet.dts_usec;
+	}
+
+	flv_tag_addref(tag);
+	circlebuf_push_back(&dest->tags, &tag, sizeof(tag));
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* sending                                                                   */
+
+static inline void set_rtmp_dstr(AVal *val, struct dstr *str)
+{
+	bool valid = !dstr_is_empty(str);
+	val->av_val = valid ? str->array : NULL;
+	val->av_len = valid ? (int)str->len : 0;
+}
+
+static void set_tag_time(uint8_t *header, int32_t time_ms)
+{
+	if (time_ms < 0)
+		time_ms = 0;
+
+	header[4] = (uint8_t)(time_ms >> 16);
+	header[5] = (uint8_t)(time_ms >> 8);
+	header[6] = (uint8_t)time_ms;
+	header[7] = (uint8_t)((time_ms >> 24) & 0x7F);
+}
+
+static bool discard_recv_data(struct rtmp_destination *dest)
+{
+	RTMP *rtmp = &dest->rtmp;
+	int recv_size = 0;
+	uint8_t buf[512];
+	int ret;
+
+#ifdef _WIN32
+	ret = ioctlsocket(rtmp->m_sb.sb_socket, FIONREAD,
+			  (u_long *)&recv_size);
+#else
+	ret = ioctl(rtmp->m_sb.sb_socket, FIONREAD, &recv_size);
+#endif
+
+	while (ret >= 0 && recv_size > 0) {
+		int bytes = recv_size > 512 ? 512 : recv_size;
+
+		ret = (int)recv(rtmp->m_sb.sb_socket, (char *)buf, bytes, 0);
+		if (ret <= 0)
+			return false;
+
+		recv_size -= ret;
+	}
+
+	return true;
+}
+
+static bool send_tag(struct rtmp_destination *dest, struct flv_tag *tag)
+{
+	uint8_t header[FLV_TAG_HEADER_MAX_SIZE];
+	int ret;
+
+	if (!discard_recv_data(dest))
+		return false;
+
+	memcpy(header, tag->iov.header, tag->iov.header_size);
+	set_tag_time(header, tag->time_ms - dest->start_time_ms);
+
+	/* the payload goes straight from the shared packet into the RTMP
+	 * packet, see send_packet in rtmp-stream.c */
+	ret = RTMP_Write(&dest->rtmp, (const char *)header,
+			 (int)tag->iov.header_size, 0);
+	if (ret > 0)
+		ret = RTMP_Write(&dest->rtmp, (const char *)tag->iov.payload,
+				 (int)tag->iov.payload_size, 0);
+	if (ret < 0)
+		return false;
+
+	dest->total_bytes_sent += flv_packet_iov_size(&tag->iov);
+	return true;
+}
+
+static bool send_header_packet(struct rtmp_destination *dest,
+			       struct encoder_packet *packet)
+{
+	uint8_t *data;
+	size_t size;
+	int ret;
+
+	flv_packet_mux(packet, 0, &data, &size, true);
+	ret = RTMP_Write(&dest->rtmp, (char *)data, (int)size, 0);
+	bfree(data);
+
+	if (ret >= 0)
+		dest->total_bytes_sent += size;
+	return ret >= 0;
+}
+
+static bool send_headers(struct rtmp_destination *dest)
+{
+	obs_output_t *context = dest->stream->output;
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context, 0);
+	uint8_t *meta_data;
+	size_t meta_data_size;
+	uint8_t *header;
+	size_t size;
+	bool success;
+
+	flv_meta_data(context, &meta_data, &meta_data_size, false);
+	success = RTMP_Write(&dest->rtmp, (char *)meta_data,
+			     (int)meta_data_size, 0) >= 0;
+	bfree(meta_data);
+	if (!success)
+		return false;
+
+	if (aencoder) {
+		struct encoder_packet packet = {.type = OBS_ENCODER_AUDIO,
+						.timebase_den = 1};
+
+		obs_encoder_get_extra_data(aencoder, &packet.data,
+					   &packet.size);
+		if (!send_header_packet(dest, &packet))
+			return false;
+	}
+
+	struct encoder_packet packet = {
+		.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .keyframe = true};
+
+	obs_encoder_get_extra_data(vencoder, &header, &size);
+	packet.size = obs_parse_avc_header(&packet.data, header, size);
+	success = send_header_packet(dest, &packet);
+	bfree(packet.data);
+
+	dest->sent_headers = success;
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* connection                                                                */
+
+static int try_connect(struct rtmp_destination *dest)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+	RTMP *rtmp = &dest->rtmp;
+
+	dest_log(LOG_INFO, "Connecting...");
+
+	RTMP_Reset(rtmp);
+	memset(&rtmp->Link, 0, sizeof(rtmp->Link));
+	rtmp->last_error_code = 0;
+
+	if (!RTMP_SetupURL(rtmp, dest->url.array))
+		return OBS_OUTPUT_BAD_PATH;
+
+	RTMP_EnableWrite(rtmp);
+
+	dstr_copy(&dest->encoder_name, "FMLE/3.0 (compatible; FMSc/1.0)");
+	set_rtmp_dstr(&rtmp->Link.flashVer, &dest->encoder_name);
+	rtmp->Link.swfUrl = rtmp->Link.tcUrl;
+
+	if (dstr_is_empty(&stream->bind_ip) ||
+	    dstr_cmp(&stream->bind_ip, "default") == 0) {
+		memset(&rtmp->m_bindIP, 0, sizeof(rtmp->m_bindIP));
+	} else {
+		netif_str_to_addr(&rtmp->m_bindIP.addr, &rtmp->m_bindIP.addrLen,
+				  stream->bind_ip.array);
+	}
+
+	RTMP_AddStream(rtmp, dest->key.array);
+
+	rtmp->m_outChunkSize = 4096;
+	rtmp->m_bSendChunkSizeInfo = true;
+	rtmp->m_bUseNagle = true;
+
+	if (!RTMP_Connect(rtmp, NULL))
+		return OBS_OUTPUT_CONNECT_FAILED;
+	if (!RTMP_ConnectStream(rtmp, 0))
+		return OBS_OUTPUT_INVALID_STREAM;
+
+	dest_log(LOG_INFO, "Connection successful");
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static void set_connected(struct rtmp_destination *dest, bool connected)
+{
+	pthread_mutex_lock(&dest->tags_mutex);
+	os_atomic_set_bool(&dest->connected, connected);
+	dest->waiting_for_keyframe = true;
+	dest->congestion = 0.0f;
+	free_tags(dest);
+	pthread_mutex_unlock(&dest->tags_mutex);
+}
+
+/* returns false if the destination should give up */
+static bool connect_with_retries(struct rtmp_destination *dest)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+	int delay_sec = stream->retry_delay_sec;
+	int retries = 0;
+
+	while (!stopping(stream)) {
+		int ret = try_connect(dest);
+		if (ret == OBS_OUTPUT_SUCCESS) {
+			set_connected(dest, true);
+			return true;
+		}
+
+		RTMP_Close(&dest->rtmp);
+		dest->last_error = ret;
+
+		if (ret == OBS_OUTPUT_BAD_PATH ||
+		    (stream->max_retries && ++retries > stream->max_retries)) {
+			dest_log(LOG_WARNING,
+				 "Connection failed: %d, giving up", ret);
+			return false;
+		}
+
+		dest_log(LOG_WARNING,
+			 "Connection failed: %d, retrying in %d seconds", ret,
+			 delay_sec);
+
+		if (os_event_timedwait(stream->stop_event,
+				       (unsigned long)delay_sec * 1000) == 0)
+			return false;
+
+		delay_sec *= 2;
+		if (delay_sec > MAX_RETRY_DELAY_SEC)
+			delay_sec = MAX_RETRY_DELAY_SEC;
+	}
+
+	return false;
+}
+
+static void disconnect(struct rtmp_destination *dest)
+{
+	set_connected(dest, false);
+	RTMP_Close(&dest->rtmp);
+	dest->sent_headers = false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool done_sending(struct rtmp_destination *dest, bool queue_empty)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+
+	if (!stopping(stream))
+		return false;
+	if (stream->stop_ts == 0 || !connected(dest))
+		return true;
+	if (os_gettime_ns() >= stream->shutdown_timeout_ts)
+		return true;
+
+	return queue_empty && os_atomic_load_bool(&stream->reached_stop);
+}
+
+static void finish_destination(struct rtmp_destination *dest)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+	bool any_connected = false;
+
+	if (os_atomic_dec_long(&stream->running) > 0)
+		return;
+
+	/* last destination to finish stops the output */
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		if (!os_atomic_load_bool(&stream->dests.array[i]->failed))
+			any_connected = true;
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	if (os_atomic_load_bool(&stream->encode_error))
+		obs_output_signal_stop(stream->output,
+				       OBS_OUTPUT_ENCODE_ERROR);
+	else if (stopping(stream) || any_connected)
+		obs_output_end_data_capture(stream->output);
+	else
+		obs_output_signal_stop(stream->output, dest->last_error);
+}
+
+static void *send_thread(void *data)
+{
+	struct rtmp_destination *dest = data;
+	struct rtmp_multi_stream *stream = dest->stream;
+
+	os_set_thread_name("rtmp-multi-stream: send_thread");
+
+	while (!stopping(stream)) {
+		if (!connected(dest) && !connect_with_retries(dest)) {
+			if (!stopping(stream))
+				os_atomic_set_bool(&dest->failed, true);
+			break;
+		}
+
+		for (;;) {
+			struct flv_tag *tag = NULL;
+			bool ok = true;
+
+			pthread_mutex_lock(&dest->tags_mutex);
+			if (dest->tags.size)
+				circlebuf_pop_front(&dest->tags, &tag,
+						    sizeof(tag));
+			pthread_mutex_unlock(&dest->tags_mutex);
+
+			if (done_sending(dest, !tag)) {
+				flv_tag_release(tag);
+				goto done;
+			}
+
+			if (!tag) {
+				os_event_timedwait(dest->data_event,
+						   SEND_WAIT_MS);
+				continue;
+			}
+
+			if (!dest->sent_headers)
+				ok = send_headers(dest);
+			if (ok)
+				ok = send_tag(dest, tag);
+
+			flv_tag_release(tag);
+
+			if (!ok) {
+				dest_log(LOG_WARNING, "Disconnected");
+				disconnect(dest);
+				dest->reconnects++;
+				break;
+			}
+		}
+	}
+
+done:
+	if (connected(dest))
+		disconnect(dest);
+
+	dest_log(LOG_INFO,
+		 "Stopped, sent %" PRIu64 " bytes, dropped %d frames, "
+		 "reconnected %d times",
+		 dest->total_bytes_sent, dest->dropped_frames,
+		 dest->reconnects);
+
+	finish_destination(dest);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void destination_destroy(struct rtmp_destination *dest)
+{
+	free_tags(dest);
+	circlebuf_free(&dest->tags);
+	RTMP_TLS_Free(&dest->rtmp);
+	dstr_free(&dest->url);
+	dstr_free(&dest->key);
+	dstr_free(&dest->encoder_name);
+	os_event_destroy(dest->data_event);
+	pthread_mutex_destroy(&dest->tags_mutex);
+	bfree(dest);
+}
+
+static struct rtmp_destination *
+destination_create(struct rtmp_multi_stream *stream, const char *url,
+		   const char *key)
+{
+	struct rtmp_destination *dest = bzalloc(sizeof(*dest));
+	dest->stream = stream;
+	dest->waiting_for_keyframe = true;
+	dstr_copy(&dest->url, url);
+	dstr_copy(&dest->key, key);
+	dstr_depad(&dest->url);
+	dstr_depad(&dest->key);
+	RTMP_Init(&dest->rtmp);
+
+	if (pthread_mutex_init(&dest->tags_mutex, NULL) != 0 ||
+	    os_event_init(&dest->data_event, OS_EVENT_TYPE_AUTO) != 0) {
+		destination_destroy(dest);
+		return NULL;
+	}
+
+	return dest;
+}
+
+/* waits for the send threads and removes all destinations */
+static void free_destinations(struct rtmp_multi_stream *stream)
+{
+	/* the list only changes on this thread, but a finishing send thread
+	 * locks it, so join without holding the lock */
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		struct rtmp_destination *dest = stream->dests.array[i];
+
+		if (dest->send_thread_active) {
+			pthread_join(dest->send_thread, NULL);
+			dest->send_thread_active = false;
+		}
+	}
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++)
+		destination_destroy(stream->dests.array[i]);
+	da_free(stream->dests);
+	pthread_mutex_unlock(&stream->dests_mutex);
+}
+
+/* destinations are "url key" strings (as stored by an editable list), or
+ * objects with separate url and key */
+static void add_destination(struct rtmp_multi_stream *stream,
+			    obs_data_t *item)
+{
+	struct rtmp_destination *dest;
+	struct dstr url = {0};
+	const char *key = obs_data_get_string(item, "key");
+	const char *value = obs_data_get_string(item, "value");
+
+	dstr_copy(&url, obs_data_get_string(item, "url"));
+
+	if (dstr_is_empty(&url) && value && *value) {
+		const char *space = strpbrk(value, " \t");
+
+		if (space) {
+			dstr_ncopy(&url, value, space - value);
+			key = space + 1;
+		} else {
+			dstr_copy(&url, value);
+		}
+	}
+
+	if (dstr_is_empty(&url)) {
+		dstr_free(&url);
+		return;
+	}
+
+	dest = destination_create(stream, url.array, key);
+	if (dest)
+		da_push_back(stream->dests, &dest);
+	dstr_free(&url);
+}
+
+static bool init_destinations(struct rtmp_multi_stream *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	obs_data_array_t *array;
+	size_t count;
+
+	array = obs_data_get_array(settings, OPT_DESTINATIONS);
+	count = obs_data_array_count(array);
+
+	stream->drop_threshold_usec =
+		1000 * obs_data_get_int(settings, OPT_DROP_THRESHOLD);
+	stream->pframe_drop_threshold_usec =
+		1000 * obs_data_get_int(settings, OPT_PFRAME_DROP_THRESHOLD);
+	if (stream->pframe_drop_threshold_usec <
+	    stream->drop_threshold_usec + 200000)
+		stream->pframe_drop_threshold_usec =
+			stream->drop_threshold_usec + 200000;
+
+	stream->max_shutdown_time_sec =
+		(int)obs_data_get_int(settings, OPT_MAX_SHUTDOWN_TIME_SEC);
+	stream->retry_delay_sec =
+		(int)obs_data_get_int(settings, OPT_RETRY_DELAY);
+	if (stream->retry_delay_sec < 1)
+		stream->retry_delay_sec = 1;
+	stream->max_retries = (int)obs_data_get_int(settings, OPT_MAX_RETRIES);
+	dstr_copy(&stream->bind_ip, obs_data_get_string(settings, OPT_BIND_IP));
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		add_destination(stream, item);
+		obs_data_release(item);
+	}
+	count = stream->dests.num;
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	obs_data_array_release(array);
+	obs_data_release(settings);
+	return count > 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void rtmp_multi_stream_destroy(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	if (running(stream)) {
+		stream->stop_ts = 0;
+		os_event_signal(stream->stop_event);
+	}
+
+	free_destinations(stream);
+	dstr_free(&stream->bind_ip);
+	os_event_destroy(stream->stop_event);
+	pthread_mutex_destroy(&stream->dests_mutex);
+	bfree(stream);
+}
+
+static void get_destination_stats(void *data, calldata_t *cd)
+{
+	struct rtmp_multi_stream *stream = data;
+	size_t idx = (size_t)calldata_int(cd, "index");
+	struct rtmp_destination *dest = NULL;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	if (idx < stream->dests.num)
+		dest = stream->dests.array[idx];
+
+	if (dest) {
+		calldata_set_string(cd, "url", dest->url.array);
+		calldata_set_bool(cd, "connected", connected(dest));
+		calldata_set_int(cd, "total_bytes",
+				 (long long)dest->total_bytes_sent);
+		calldata_set_int(cd, "dropped_frames", dest->dropped_frames);
+		calldata_set_int(cd, "reconnects", dest->reconnects);
+		calldata_set_float(cd, "congestion", dest->congestion);
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+}
+
+static void get_destination_count(void *data, calldata_t *cd)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	calldata_set_int(cd, "count", (long long)stream->dests.num);
+	pthread_mutex_unlock(&stream->dests_mutex);
+}
+
+static void *rtmp_multi_stream_create(obs_data_t *settings,
+				      obs_output_t *output)
+{
+	struct rtmp_multi_stream *stream =
+		bzalloc(sizeof(struct rtmp_multi_stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	stream->output = output;
+	pthread_mutex_init_value(&stream->dests_mutex);
+
+	RTMP_LogSetCallback(log_rtmp);
+	RTMP_LogSetLevel(RTMP_LOGWARNING);
+
+	if (pthread_mutex_init(&stream->dests_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	proc_handler_add(ph, "void get_destination_count(out int count)",
+			 get_destination_count, stream);
+	proc_handler_add(ph,
+			 "void get_destination_stats(in int index, "
+			 "out string url, out bool connected, "
+			 "out int total_bytes, out int dropped_frames, "
+			 "out int reconnects, out float congestion)",
+			 get_destination_stats, stream);
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	rtmp_multi_stream_destroy(stream);
+	return NULL;
+}
+
+static bool rtmp_multi_stream_start(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	/* threads of the previous session are done (or finishing) at this
+	 * point */
+	free_destinations(stream);
+
+	if (!init_destinations(stream)) {
+		warn("No destinations");
+		return false;
+	}
+
+	os_event_reset(stream->stop_event);
+	os_atomic_set_bool(&stream->encode_error, false);
+	os_atomic_set_bool(&stream->reached_stop, false);
+	stream->stop_ts = 0;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		struct rtmp_destination *dest = stream->dests.array[i];
+
+		os_atomic_inc_long(&stream->running);
+		dest->send_thread_active = pthread_create(&dest->send_thread,
+							  NULL, send_thread,
+							  dest) == 0;
+		if (!dest->send_thread_active) {
+			os_atomic_dec_long(&stream->running);
+			warn("Failed to create send thread for %s",
+			     dest->url.array);
+		}
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	if (!running(stream))
+		return false;
+
+	info("Streaming to %d destinations", (int)stream->dests.num);
+	obs_output_begin_data_capture(stream->output, 0);
+	return true;
+}
+
+static void wake_destinations(struct rtmp_multi_stream *stream)
+{
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++)
+		os_event_signal(stream->dests.array[i]->data_event);
+	pthread_mutex_unlock(&stream->dests_mutex);
+}
+
+static void rtmp_multi_stream_stop(void *data, uint64_t ts)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	if (stopping(stream) && ts != 0)
+		return;
+
+	if (!running(stream)) {
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_SUCCESS);
+		return;
+	}
+
+	stream->stop_ts = ts / 1000ULL;
+	if (ts)
+		stream->shutdown_timeout_ts =
+			ts +
+			(uint64_t)stream->max_shutdown_time_sec * 1000000000ULL;
+
+	os_event_signal(stream->stop_event);
+	wake_destinations(stream);
+}
+
+static void rtmp_multi_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct rtmp_multi_stream *stream = data;
+	struct flv_tag *tag;
+
+	if (!running(stream) || os_atomic_load_bool(&stream->reached_stop))
+		return;
+
+	/* encoder fail */
+	if (!packet) {
+		os_atomic_set_bool(&stream->encode_error, true);
+		stream->stop_ts = 0;
+		os_event_signal(stream->stop_event);
+		wake_destinations(stream);
+		return;
+	}
+
+	if (stopping(stream) && stream->stop_ts &&
+	    packet->sys_dts_usec >= (int64_t)stream->stop_ts) {
+		os_atomic_set_bool(&stream->reached_stop, true);
+		wake_destinations(stream);
+		return;
+	}
+
+	tag = flv_tag_create(packet);
+	if (!tag)
+		return;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		struct rtmp_destination *dest = stream->dests.array[i];
+		bool added = false;
+
+		if (!connected(dest))
+			continue;
+
+		pthread_mutex_lock(&dest->tags_mutex);
+		if (connected(dest))
+			added = add_tag(dest, tag);
+		pthread_mutex_unlock(&dest->tags_mutex);
+
+		if (added)
+			os_event_signal(dest->data_event);
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	flv_tag_release(tag);
+}
+
+static void rtmp_multi_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 700);
+	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
+	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
+	obs_data_set_default_int(defaults, OPT_RETRY_DELAY, 2);
+	obs_data_set_default_int(defaults, OPT_MAX_RETRIES, 25);
+	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
+}
+
+static obs_properties_t *rtmp_multi_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	struct netif_saddr_data addrs = {0};
+	obs_property_t *p;
+
+	obs_properties_add_editable_list(
+		props, OPT_DESTINATIONS,
+		obs_module_text("RTMPMultiStream.Destinations"),
+		OBS_EDITABLE_LIST_TYPE_STRINGS, NULL, NULL);
+	obs_properties_add_int(props, OPT_DROP_THRESHOLD,
+			       obs_module_text("RTMPStream.DropThreshold"), 200,
+			       10000, 100);
+	obs_properties_add_int(props, OPT_RETRY_DELAY,
+			       obs_module_text("RTMPMultiStream.RetryDelay"),
+			       1, 60, 1);
+	obs_properties_add_int(props, OPT_MAX_RETRIES,
+			       obs_module_text("RTMPMultiStream.MaxRetries"),
+			       0, 10000, 1);
+
+	p = obs_properties_add_list(props, OPT_BIND_IP,
+				    obs_module_text("RTMPStream.BindIP"),
+				    OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_STRING);
+
+	obs_property_list_add_string(p, obs_module_text("Default"), "default");
+
+	netif_get_addrs(&addrs);
+	for (size_t i = 0; i < addrs.addrs.num; i++) {
+		struct netif_saddr_item item = addrs.addrs.array[i];
+		obs_property_list_add_string(p, item.name, item.addr);
+	}
+	netif_saddr_data_free(&addrs);
+
+	return props;
+}
+
+static uint64_t rtmp_multi_stream_total_bytes_sent(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	uint64_t total = 0;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++)
+		total += stream->dests.array[i]->total_bytes_sent;
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	return total;
+}
+
+/* the worst destination is reported, as each one drops on its own */
+static int rtmp_multi_stream_dropped_frames(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	int dropped = 0;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		struct rtmp_destination *dest = stream->dests.array[i];
+		if (dest->dropped_frames > dropped)
+			dropped = dest->dropped_frames;
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	return dropped;
+}
+
+static float rtmp_multi_stream_congestion(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	float congestion = 0.0f;
+
+	pthread_mutex_lock(&stream->dests_mutex);
+	for (size_t i = 0; i < stream->dests.num; i++) {
+		struct rtmp_destination *dest = stream->dests.array[i];
+		float cur = dest->min_priority > 0 ? 1.0f : dest->congestion;
+
+		if (connected(dest) && cur > congestion)
+			congestion = cur;
+	}
+	pthread_mutex_unlock(&stream->dests_mutex);
+
+	return congestion;
+}
+
+struct obs_output_info rtmp_multi_output_info = {
+	.id = "rtmp_multi_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = rtmp_multi_stream_getname,
+	.create = rtmp_multi_stream_create,
+	.destroy = rtmp_multi_stream_destroy,
+	.start = rtmp_multi_stream_start,
+	.stop = rtmp_multi_stream_stop,
+	.encoded_packet = rtmp_multi_stream_data,
+	.get_defaults = rtmp_multi_stream_defaults,
+	.get_properties = rtmp_multi_stream_properties,
+	.get_total_bytes = rtmp_multi_stream_total_bytes_sent,
+	.get_congestion = rtmp_multi_stream_congestion,
+	.get_dropped_frames = rtmp_multi_stream_dropped_frames,
+};
@@ -29,11 +29,8 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
-/* dynamic bitrate coefficients */
-#define DBR_INC_TIMER (30ULL * SEC_TO_NSEC)
-#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
-#define MIN_ESTIMATE_DURATION_MS 1000
-#define MAX_ESTIMATE_DURATION_MS 2000
+/* how often to sample TCP statistics for dynamic bitrate */
+#define DBR_TCP_INFO_INTERVAL (100ULL * MSEC_TO_NSEC)
 
 static const char *rtmp_stream_getname(void *unused)
 {
@@ -125,7 +122,6 @@ static void rtmp_stream_destroy(void *data)
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
-	circlebuf_free(&stream->dbr_frames);
 	pthread_mutex_destroy(&stream->dbr_mutex);
 
 	os_event_destroy(stream->buffer_space_available_event);
@@ -402,6 +398,7 @@ static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
+	struct flv_packet_iov iov;
 	uint8_t *data;
 	size_t size;
 	int recv_size = 0;
@@ -427,17 +424,36 @@ static int send_packet(struct rtmp_stream *stream,
 		flv_additional_packet_mux(
 			packet, is_header ? 0 : stream->start_dts_offset, &data,
 			&size, is_header, idx);
-	} else {
-		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
-	}
 
 #ifdef TEST_FRAMEDROPS
-	droptest_cap_data_rate(stream, size);
+		droptest_cap_data_rate(stream, size);
+#endif
+
+		ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
+		bfree(data);
+	} else if (flv_packet_mux_iov(packet,
+				      is_header ? 0 : stream->start_dts_offset,
+				      is_header, &iov)) {
+		size = flv_packet_iov_size(&iov);
+
+#ifdef TEST_FRAMEDROPS
+		droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+		/* RTMP_Write picks up a partially written tag on the next
+		 * call, so the payload is copied directly from the packet
+		 * into the RTMP packet body.  It skips the tag size, so the
+		 * trailer doesn't need to be sent. */
+		ret = RTMP_Write(&stream->rtmp, (const char *)iov.header,
+				 (int)iov.header_size, 0);
+		if (ret > 0)
+			ret = RTMP_Write(&stream->rtmp,
+					 (const char *)iov.payload,
+					 (int)iov.payload_size, 0);
+	} else {
+		size = 0;
+		ret = 0;
+	}
 
 	if (is_header)
 		bfree(packet->data);
@@ -536,35 +552,57 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
+static bool get_tcp_info(struct rtmp_stream *stream, struct bwe_tcp_info *info)
 {
-	struct dbr_frame front;
-	uint64_t dur;
+#if defined(__linux__)
+	struct tcp_info ti;
+	socklen_t size = sizeof(ti);
 
-	circlebuf_push_back(&stream->dbr_frames, back, sizeof(*back));
-	circlebuf_peek_front(&stream->dbr_frames, &front, sizeof(front));
+	if (getsockopt(stream->rtmp.m_sb.sb_socket, IPPROTO_TCP, TCP_INFO, &ti,
+		       &size) != 0)
+		return false;
 
-	stream->dbr_data_size += back->size;
+	info->rtt_us = ti.tcpi_rtt;
+	info->cwnd_bytes = ti.tcpi_snd_cwnd * ti.tcpi_snd_mss;
+	info->inflight_bytes = ti.tcpi_unacked * ti.tcpi_snd_mss;
+	return true;
+#elif defined(_WIN32) && defined(SIO_TCP_INFO)
+	TCP_INFO_v0 ti;
+	DWORD version = 0;
+	DWORD size = 0;
 
-	dur = (back->send_end - front.send_beg) / 1000000;
+	if (WSAIoctl(stream->rtmp.m_sb.sb_socket, SIO_TCP_INFO, &version,
+		     sizeof(version), &ti, sizeof(ti), &size, NULL, NULL) != 0)
+		return false;
 
-	if (dur >= MAX_ESTIMATE_DURATION_MS) {
-		stream->dbr_data_size -= front.size;
-		circlebuf_pop_front(&stream->dbr_frames, NULL, sizeof(front));
-	}
+	info->rtt_us = ti.RttUs;
+	info->cwnd_bytes = ti.Cwnd;
+	info->inflight_bytes = ti.BytesInFlight;
+	return true;
+#else
+	UNUSED_PARAMETER(stream);
+	UNUSED_PARAMETER(info);
+	return false;
+#endif
+}
 
-	stream->dbr_est_bitrate =
-		(dur >= MIN_ESTIMATE_DURATION_MS)
-			? (long)(stream->dbr_data_size * 1000 / dur)
-			: 0;
-	stream->dbr_est_bitrate *= 8;
-	stream->dbr_est_bitrate /= 1000;
-
-	if (stream->dbr_est_bitrate) {
-		stream->dbr_est_bitrate -= stream->audio_bitrate;
-		if (stream->dbr_est_bitrate < 50)
-			stream->dbr_est_bitrate = 50;
+static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *frame)
+{
+	struct bwe_tcp_info info;
+	bool got_info = false;
+
+	if (frame->send_end - stream->dbr_last_tcp_info >=
+	    DBR_TCP_INFO_INTERVAL) {
+		got_info = get_tcp_info(stream, &info);
+		stream->dbr_last_tcp_info = frame->send_end;
 	}
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	bwe_add_send(&stream->dbr_bwe, frame->send_beg, frame->send_end,
+		     frame->size);
+	if (got_info)
+		bwe_add_tcp_info(&stream->dbr_bwe, &info, frame->send_end);
+	pthread_mutex_unlock(&stream->dbr_mutex);
 }
 
 static void dbr_set_bitrate(struct rtmp_stream *stream);
@@ -612,10 +650,7 @@ static void *send_thread(void *data)
 
 		if (stream->dbr_enabled) {
 			dbr_frame.send_end = os_gettime_ns();
-
-			pthread_mutex_lock(&stream->dbr_mutex);
 			dbr_add_frame(stream, &dbr_frame);
-			pthread_mutex_unlock(&stream->dbr_mutex);
 		}
 	}
 
@@ -1072,14 +1107,12 @@ static bool init_connect(struct rtmp_stream *stream)
 	obs_data_t *vsettings = obs_encoder_get_settings(venc);
 	obs_data_t *asettings = obs_encoder_get_settings(aenc);
 
-	circlebuf_free(&stream->dbr_frames);
 	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
-	stream->dbr_data_size = 0;
 	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
 	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-	stream->dbr_est_bitrate = 0;
-	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
-	stream->dbr_inc_timeout = 0;
+	stream->dbr_last_tcp_info = 0;
+	bwe_init(&stream->dbr_bwe, stream->dbr_orig_bitrate,
+		 stream->audio_bitrate, os_gettime_ns());
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
 
 	caps = obs_encoder_get_caps(venc);
@@ -1232,69 +1265,6 @@ static bool find_first_video_packet(struct rtmp_stream *stream,
 	return false;
 }
 
-static bool dbr_bitrate_lowered(struct rtmp_stream *stream)
-{
-	long prev_bitrate = stream->dbr_prev_bitrate;
-	long est_bitrate = 0;
-	long new_bitrate;
-
-	if (stream->dbr_est_bitrate &&
-	    stream->dbr_est_bitrate < stream->dbr_cur_bitrate) {
-		stream->dbr_data_size = 0;
-		circlebuf_pop_front(&stream->dbr_frames, NULL,
-				    stream->dbr_frames.size);
-		est_bitrate = stream->dbr_est_bitrate / 100 * 100;
-		if (est_bitrate < 50) {
-			est_bitrate = 50;
-		}
-	}
-
-#if 0
-	if (prev_bitrate && est_bitrate) {
-		if (prev_bitrate < est_bitrate) {
-			blog(LOG_INFO, "going back to prev bitrate: "
-					"prev_bitrate (%d) < est_bitrate (%d)",
-					prev_bitrate,
-					est_bitrate);
-			new_bitrate = prev_bitrate;
-		} else {
-			new_bitrate = est_bitrate;
-		}
-		new_bitrate = est_bitrate;
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else {
-		return false;
-	}
-#else
-	if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else {
-		return false;
-	}
-
-	if (new_bitrate == stream->dbr_cur_bitrate) {
-		return false;
-	}
-#endif
-
-	stream->dbr_prev_bitrate = 0;
-	stream->dbr_cur_bitrate = new_bitrate;
-	stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-	info("bitrate decreased to: %ld", stream->dbr_cur_bitrate);
-	return true;
-}
-
 static void dbr_set_bitrate(struct rtmp_stream *stream)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
@@ -1306,20 +1276,30 @@ static void dbr_set_bitrate(struct rtmp_stream *stream)
 	obs_data_release(settings);
 }
 
-static void dbr_inc_bitrate(struct rtmp_stream *stream)
+static void dbr_update(struct rtmp_stream *stream,
+		       int64_t buffer_duration_usec)
 {
-	stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
-	stream->dbr_cur_bitrate += stream->dbr_inc_bitrate;
-
-	if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate) {
-		stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-		info("bitrate increased to: %ld, done",
-		     stream->dbr_cur_bitrate);
-	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate) {
-		stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-		info("bitrate increased to: %ld, waiting",
-		     stream->dbr_cur_bitrate);
-	}
+	bool bitrate_changed;
+	long new_bitrate;
+	long estimate;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	bwe_add_queue(&stream->dbr_bwe, buffer_duration_usec);
+	bitrate_changed = bwe_update(&stream->dbr_bwe, os_gettime_ns());
+	new_bitrate = stream->dbr_bwe.bitrate;
+	estimate = (long)stream->dbr_bwe.estimate;
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	if (!bitrate_changed)
+		return;
+
+	info("bitrate %s to: %ld (estimated bandwidth: %ld, buffer: %" PRId64
+	     " ms)",
+	     new_bitrate < stream->dbr_cur_bitrate ? "decreased" : "increased",
+	     new_bitrate, estimate, buffer_duration_usec / 1000);
+
+	stream->dbr_cur_bitrate = new_bitrate;
+	dbr_set_bitrate(stream);
 }
 
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
@@ -1333,21 +1313,12 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
 					 : stream->drop_threshold_usec;
 
-	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
-			uint64_t t = os_gettime_ns();
-
-			if (t >= stream->dbr_inc_timeout) {
-				stream->dbr_inc_timeout = 0;
-				dbr_inc_bitrate(stream);
-				dbr_set_bitrate(stream);
-			}
-		}
-	}
-
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			if (stream->dbr_enabled)
+				dbr_update(stream, 0);
+		}
 		return;
 	}
 
@@ -1368,23 +1339,8 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	 * but let's test without dropping frames
 	 * at all first */
 	if (stream->dbr_enabled) {
-		bool bitrate_changed = false;
-
-		if (pframes) {
-			return;
-		}
-
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
-			pthread_mutex_lock(&stream->dbr_mutex);
-			bitrate_changed = dbr_bitrate_lowered(stream);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
-
-		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64,
-			      buffer_duration_usec / 1000);
-			dbr_set_bitrate(stream);
-		}
+		if (!pframes)
+			dbr_update(stream, buffer_duration_usec);
 		return;
 	}
 
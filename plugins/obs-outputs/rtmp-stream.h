@@ -9,11 +9,14 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "bandwidth-estimator.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
+#include <mstcpip.h>
 #else
 #include <sys/ioctl.h>
+#include <netinet/tcp.h>
 #endif
 
 #define do_log(level, format, ...)                 \
@@ -102,15 +105,11 @@ struct rtmp_stream {
 #endif
 
 	pthread_mutex_t dbr_mutex;
-	struct circlebuf dbr_frames;
-	size_t dbr_data_size;
-	uint64_t dbr_inc_timeout;
+	struct bandwidth_estimator dbr_bwe;
+	uint64_t dbr_last_tcp_info;
 	long audio_bitrate;
-	long dbr_est_bitrate;
 	long dbr_orig_bitrate;
-	long dbr_prev_bitrate;
 	long dbr_cur_bitrate;
-	long dbr_inc_bitrate;
 	bool dbr_enabled;
 
 	RTMP rtmp;
@@ -0,0 +1,600 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <inttypes.h>
+#include "mpegts-mux.h"
+#include "udp-transport.h"
+#include "net-if.h"
+
+#define do_log(level, format, ...)                \
+	blog(level, "[udp stream: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#define OPT_LATENCY "latency_ms"
+#define OPT_MAX_BITRATE "max_bitrate"
+#define OPT_ARQ "arq"
+#define OPT_BIND_IP "bind_ip"
+
+/* headroom on top of the encoder bitrates for TS overhead, transport
+ * headers and retransmits when the send rate is picked automatically */
+#define AUTO_BITRATE_PERCENT 150
+
+/* loss rate that counts as fully congested */
+#define MAX_LOSS 0.1f
+
+struct udp_stream {
+	obs_output_t *output;
+
+	pthread_mutex_t mutex;
+	struct udp_sender *sender;
+	struct mpegts_mux mux;
+
+	volatile bool active;
+	volatile bool stopping;
+	pthread_t connect_thread;
+	bool connect_thread_active;
+	pthread_t stop_thread;
+	bool stop_thread_active;
+	int64_t stop_ts;
+	int stop_code;
+
+	struct dstr host;
+	int port;
+	uint32_t latency_ms;
+	uint64_t bitrate;
+
+	bool waiting_for_keyframe;
+	uint64_t total_bytes_sent;
+	int dropped_frames;
+	float congestion;
+};
+
+static const char *udp_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("UDPStream");
+}
+
+static inline bool active(struct udp_stream *stream)
+{
+	return os_atomic_load_bool(&stream->active);
+}
+
+static inline bool stopping(struct udp_stream *stream)
+{
+	return os_atomic_load_bool(&stream->stopping);
+}
+
+static void log_stats(struct udp_stream *stream, struct udp_sender *sender)
+{
+	struct udp_sender_stats stats;
+
+	udp_sender_get_stats(sender, &stats);
+	info("Sent %" PRIu64 " packets, %" PRIu64 " retransmits, "
+	     "%" PRIu64 " lost, RTT %" PRIu32 "ms, loss %.2f%%",
+	     stats.packets_sent, stats.retransmits, stats.lost, stats.rtt_ms,
+	     stats.loss * 100.0f);
+}
+
+static void close_sender(struct udp_stream *stream, bool flush)
+{
+	struct udp_sender *sender;
+
+	/* give the last packets and their retransmits time to get out before
+	 * closing the socket */
+	if (flush && stream->sender &&
+	    udp_sender_flush(stream->sender, 1000))
+		os_sleep_ms(stream->latency_ms);
+
+	pthread_mutex_lock(&stream->mutex);
+	sender = stream->sender;
+	stream->sender = NULL;
+	mpegts_mux_free(&stream->mux);
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (sender) {
+		log_stats(stream, sender);
+		udp_sender_destroy(sender);
+	}
+}
+
+static void *stop_thread(void *data)
+{
+	struct udp_stream *stream = data;
+	int code = stream->stop_code;
+
+	os_set_thread_name("udp-stream: stop_thread");
+
+	close_sender(stream, code == OBS_OUTPUT_SUCCESS);
+	info("Stream to %s:%d stopped", stream->host.array, stream->port);
+
+	if (code)
+		obs_output_signal_stop(stream->output, code);
+	else
+		obs_output_end_data_capture(stream->output);
+
+	os_atomic_set_bool(&stream->stopping, false);
+	return NULL;
+}
+
+/* flushing and closing the sender can take up to a second plus the latency,
+ * so it happens on its own thread instead of blocking the encoded packet
+ * callback or the caller of obs_output_stop */
+static void deactivate(struct udp_stream *stream, int code)
+{
+	pthread_mutex_lock(&stream->mutex);
+
+	if (!active(stream)) {
+		pthread_mutex_unlock(&stream->mutex);
+		return;
+	}
+
+	os_atomic_set_bool(&stream->active, false);
+	os_atomic_set_bool(&stream->stopping, true);
+	stream->stop_code = code;
+	stream->stop_thread_active = pthread_create(&stream->stop_thread, NULL,
+						    stop_thread, stream) == 0;
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (!stream->stop_thread_active) {
+		warn("Failed to create stop thread");
+		stop_thread(stream);
+	}
+}
+
+static inline void join_connect_thread(struct udp_stream *stream)
+{
+	if (stream->connect_thread_active) {
+		pthread_join(stream->connect_thread, NULL);
+		stream->connect_thread_active = false;
+	}
+}
+
+static inline void join_stop_thread(struct udp_stream *stream)
+{
+	if (stream->stop_thread_active) {
+		pthread_join(stream->stop_thread, NULL);
+		stream->stop_thread_active = false;
+	}
+}
+
+static void udp_stream_destroy(void *data)
+{
+	struct udp_stream *stream = data;
+
+	join_connect_thread(stream);
+	join_stop_thread(stream);
+
+	if (os_atomic_exchange_bool(&stream->active, false)) {
+		close_sender(stream, false);
+		obs_output_end_data_capture(stream->output);
+	}
+
+	dstr_free(&stream->host);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream);
+}
+
+static void get_transport_stats(void *data, calldata_t *cd)
+{
+	struct udp_stream *stream = data;
+	struct udp_sender_stats stats = {0};
+
+	pthread_mutex_lock(&stream->mutex);
+	if (stream->sender)
+		udp_sender_get_stats(stream->sender, &stats);
+	pthread_mutex_unlock(&stream->mutex);
+
+	calldata_set_int(cd, "rtt_ms", stats.rtt_ms);
+	calldata_set_int(cd, "retransmits", (long long)stats.retransmits);
+	calldata_set_int(cd, "lost", (long long)stats.lost);
+	calldata_set_float(cd, "loss", stats.loss);
+}
+
+static void *udp_stream_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct udp_stream *stream = bzalloc(sizeof(struct udp_stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	stream->output = output;
+	pthread_mutex_init(&stream->mutex, NULL);
+
+	proc_handler_add(ph,
+			 "void get_transport_stats(out int rtt_ms, "
+			 "out int retransmits, out int lost, out float loss)",
+			 get_transport_stats, stream);
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+}
+
+/* accepts scheme://host:port, with the host in brackets for IPv6 */
+static bool parse_url(struct udp_stream *stream, const char *url)
+{
+	const char *host;
+	const char *port;
+	const char *end;
+
+	if (!url || !*url)
+		return false;
+
+	host = strstr(url, "://");
+	host = host ? host + 3 : url;
+
+	if (*host == '[') {
+		end = strchr(++host, ']');
+		if (!end || end[1] != ':')
+			return false;
+		port = end + 2;
+	} else {
+		end = strrchr(host, ':');
+		if (!end)
+			return false;
+		port = end + 1;
+	}
+
+	dstr_ncopy(&stream->host, host, end - host);
+	stream->port = atoi(port);
+	return !dstr_is_empty(&stream->host) && stream->port > 0 &&
+	       stream->port < 65536;
+}
+
+static uint64_t get_encoder_bitrate(obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	uint64_t bitrate = (uint64_t)obs_data_get_int(settings, "bitrate");
+
+	obs_data_release(settings);
+	return bitrate * 1000;
+}
+
+static uint64_t get_auto_bitrate(struct udp_stream *stream)
+{
+	obs_encoder_t *venc = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aenc = obs_output_get_audio_encoder(stream->output, 0);
+	uint64_t bitrate = get_encoder_bitrate(venc);
+
+	/* rate control modes without a bitrate can't be paced safely */
+	if (!bitrate)
+		return 0;
+
+	if (aenc)
+		bitrate += get_encoder_bitrate(aenc);
+	return bitrate * AUTO_BITRATE_PERCENT / 100;
+}
+
+static void init_mux(struct udp_stream *stream)
+{
+	obs_encoder_t *venc = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aenc = obs_output_get_audio_encoder(stream->output, 0);
+	uint8_t *video_header = NULL;
+	uint8_t *audio_config = NULL;
+	size_t video_header_size = 0;
+	size_t audio_config_size = 0;
+
+	obs_encoder_get_extra_data(venc, &video_header, &video_header_size);
+	if (aenc)
+		obs_encoder_get_extra_data(aenc, &audio_config,
+					   &audio_config_size);
+
+	mpegts_mux_init(&stream->mux, video_header, video_header_size,
+			audio_config, audio_config_size);
+}
+
+static int init_connect(struct udp_stream *stream)
+{
+	obs_service_t *service = obs_output_get_service(stream->output);
+	obs_data_t *settings;
+	struct udp_transport_options opts = {0};
+	const char *bind_ip;
+	struct udp_sender *sender;
+
+	if (!service || !parse_url(stream, obs_service_get_url(service))) {
+		warn("Invalid stream URL, expected scheme://host:port");
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	settings = obs_output_get_settings(stream->output);
+	stream->latency_ms = (uint32_t)obs_data_get_int(settings, OPT_LATENCY);
+	stream->bitrate =
+		(uint64_t)obs_data_get_int(settings, OPT_MAX_BITRATE) * 1000;
+	if (!stream->bitrate)
+		stream->bitrate = get_auto_bitrate(stream);
+
+	bind_ip = obs_data_get_string(settings, OPT_BIND_IP);
+	if (strcmp(bind_ip, "default") == 0)
+		bind_ip = NULL;
+
+	opts.latency_ms = stream->latency_ms;
+	opts.max_bitrate = stream->bitrate;
+	opts.bind_ip = bind_ip;
+	opts.disable_arq = !obs_data_get_bool(settings, OPT_ARQ);
+
+	sender = udp_sender_create(stream->host.array, stream->port, &opts);
+	obs_data_release(settings);
+
+	if (!sender)
+		return OBS_OUTPUT_CONNECT_FAILED;
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->sender = sender;
+	init_mux(stream);
+	pthread_mutex_unlock(&stream->mutex);
+
+	stream->waiting_for_keyframe = false;
+	stream->total_bytes_sent = 0;
+	stream->dropped_frames = 0;
+	stream->congestion = 0.0f;
+
+	info("Streaming to %s:%d, send rate %" PRIu64 " kbps",
+	     stream->host.array, stream->port, stream->bitrate / 1000);
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static void *connect_thread(void *data)
+{
+	struct udp_stream *stream = data;
+	int ret;
+
+	os_set_thread_name("udp-stream: connect_thread");
+
+	ret = init_connect(stream);
+	if (ret == OBS_OUTPUT_SUCCESS) {
+		os_atomic_set_bool(&stream->active, true);
+		obs_output_begin_data_capture(stream->output, 0);
+	} else {
+		obs_output_signal_stop(stream->output, ret);
+	}
+
+	return NULL;
+}
+
+static bool udp_stream_start(void *data)
+{
+	struct udp_stream *stream = data;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	join_connect_thread(stream);
+	join_stop_thread(stream);
+
+	stream->connect_thread_active =
+		pthread_create(&stream->connect_thread, NULL, connect_thread,
+			       stream) == 0;
+	return stream->connect_thread_active;
+}
+
+static void udp_stream_stop(void *data, uint64_t ts)
+{
+	struct udp_stream *stream = data;
+
+	join_connect_thread(stream);
+
+	pthread_mutex_lock(&stream->mutex);
+
+	/* a running stop thread signals the stop itself */
+	if (!active(stream)) {
+		bool closing = stopping(stream);
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (!closing)
+			obs_output_signal_stop(stream->output,
+					       OBS_OUTPUT_SUCCESS);
+		return;
+	}
+
+	if (ts == 0) {
+		pthread_mutex_unlock(&stream->mutex);
+		deactivate(stream, 0);
+		return;
+	}
+
+	stream->stop_ts = (int64_t)ts / 1000LL;
+	os_atomic_set_bool(&stream->stopping, true);
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+static void update_congestion(struct udp_stream *stream,
+			      const struct udp_sender_stats *stats)
+{
+	float latency_usec = (float)stream->latency_ms * 1000.0f;
+	float queue_usec = stream->bitrate ? (float)stats->queued_bytes * 8e6f /
+						     (float)stream->bitrate
+					   : 0.0f;
+	float congestion = queue_usec / latency_usec;
+
+	/* once the RTT gets close to the latency budget retransmits stop
+	 * arriving in time */
+	if (stats->got_ack) {
+		float rtt = (float)stats->rtt_ms / (float)stream->latency_ms;
+		float loss = stats->loss / MAX_LOSS;
+
+		if (rtt > congestion)
+			congestion = rtt;
+		if (loss > congestion)
+			congestion = loss;
+	}
+
+	stream->congestion = congestion > 1.0f ? 1.0f : congestion;
+}
+
+/* drops video until the next keyframe once there is more data queued than
+ * the latency budget allows for */
+static bool drop_video(struct udp_stream *stream,
+		       const struct udp_sender_stats *stats,
+		       struct encoder_packet *packet)
+{
+	uint64_t queued_bits = stats->queued_bytes * 8;
+	uint64_t budget_bits = stream->bitrate * stream->latency_ms / 1000;
+
+	if (stream->bitrate && queued_bits > budget_bits && !packet->keyframe)
+		stream->waiting_for_keyframe = true;
+	else if (packet->keyframe)
+		stream->waiting_for_keyframe = false;
+
+	return stream->waiting_for_keyframe;
+}
+
+static void udp_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct udp_stream *stream = data;
+	struct udp_sender_stats stats;
+	bool video;
+
+	if (!active(stream))
+		return;
+
+	/* encoder failure */
+	if (!packet) {
+		deactivate(stream, OBS_OUTPUT_ENCODE_ERROR);
+		return;
+	}
+
+	if (stopping(stream) && packet->sys_dts_usec >= stream->stop_ts) {
+		deactivate(stream, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (!stream->sender) {
+		pthread_mutex_unlock(&stream->mutex);
+		return;
+	}
+
+	udp_sender_get_stats(stream->sender, &stats);
+	if (stats.error) {
+		pthread_mutex_unlock(&stream->mutex);
+		deactivate(stream, OBS_OUTPUT_DISCONNECTED);
+		return;
+	}
+
+	update_congestion(stream, &stats);
+
+	video = packet->type == OBS_ENCODER_VIDEO;
+	if (video && drop_video(stream, &stats, packet)) {
+		stream->dropped_frames++;
+		pthread_mutex_unlock(&stream->mutex);
+		return;
+	}
+
+	mpegts_mux_packet(&stream->mux, packet);
+
+	if (stream->mux.output.num) {
+		if (udp_sender_send(stream->sender, stream->mux.output.array,
+				    stream->mux.output.num)) {
+			stream->total_bytes_sent += stream->mux.output.num;
+		} else if (video) {
+			stream->dropped_frames++;
+			stream->waiting_for_keyframe = true;
+		}
+
+		da_resize(stream->mux.output, 0);
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+static void udp_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_LATENCY,
+				 UDP_TRANSPORT_DEFAULT_LATENCY_MS);
+	obs_data_set_default_int(defaults, OPT_MAX_BITRATE, 0);
+	obs_data_set_default_bool(defaults, OPT_ARQ, true);
+	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
+}
+
+static obs_properties_t *udp_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	struct netif_saddr_data addrs = {0};
+	obs_property_t *p;
+
+	obs_properties_add_int(props, OPT_LATENCY,
+			       obs_module_text("UDPStream.Latency"), 20, 5000,
+			       10);
+	obs_properties_add_int(props, OPT_MAX_BITRATE,
+			       obs_module_text("UDPStream.MaxBitrate"), 0,
+			       1000000, 100);
+	obs_properties_add_bool(props, OPT_ARQ,
+				obs_module_text("UDPStream.ARQ"));
+
+	p = obs_properties_add_list(props, OPT_BIND_IP,
+				    obs_module_text("UDPStream.BindIP"),
+				    OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_STRING);
+
+	obs_property_list_add_string(p, obs_module_text("Default"), "default");
+
+	netif_get_addrs(&addrs);
+	for (size_t i = 0; i < addrs.addrs.num; i++) {
+		struct netif_saddr_item item = addrs.addrs.array[i];
+		obs_property_list_add_string(p, item.name, item.addr);
+	}
+	netif_saddr_data_free(&addrs);
+
+	return props;
+}
+
+static uint64_t udp_stream_total_bytes_sent(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->total_bytes_sent;
+}
+
+static int udp_stream_dropped_frames(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->dropped_frames;
+}
+
+static float udp_stream_congestion(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->waiting_for_keyframe ? 1.0f : stream->congestion;
+}
+
+struct obs_output_info udp_output_info = {
+	.id = "udp_arq_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = udp_stream_getname,
+	.create = udp_stream_create,
+	.destroy = udp_stream_destroy,
+	.start = udp_stream_start,
+	.stop = udp_stream_stop,
+	.encoded_packet = udp_stream_data,
+	.get_defaults = udp_stream_defaults,
+	.get_properties = udp_stream_properties,
+	.get_total_bytes = udp_stream_total_bytes_sent,
+	.get_congestion = udp_stream_congestion,
+	.get_dropped_frames = udp_stream_dropped_frames,
+};
@@ -0,0 +1,1321 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/base.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "udp-transport.h"
+
+#ifdef _WIN32
+typedef SOCKET udp_socket_t;
+#define socket_errno() WSAGetLastError()
+#else
+typedef int udp_socket_t;
+#define INVALID_SOCKET -1
+#define closesocket close
+#define socket_errno() errno
+#endif
+
+#define do_log(level, format, ...) \
+	blog(level, "[udp transport] " format, ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+/* ------------------------------------------------------------------------- */
+/* wire format                                                               */
+
+/*
+ *   byte 0     version (2 bits) | type (6 bits)
+ *   byte 1     flags
+ *   byte 2-3   distance of the sequence number from the first one of the
+ *              stream, capped at 0xFFFF (data) or 0
+ *   byte 4-7   sequence number (data) or 0
+ *   byte 8-11  sender timestamp in microseconds
+ *
+ *   NACK body: pairs of (uint32 first sequence number, uint16 count)
+ *   ACK body:  one past the highest sequence number received, echoed
+ *              timestamp of the latest data packet, microseconds since it
+ *              arrived, and the receiver's totals of received, missing and
+ *              lost packets
+ */
+
+#define HEADER_SIZE 12
+#define PROTOCOL_VERSION 1
+
+#define TYPE_DATA 0
+#define TYPE_NACK 1
+#define TYPE_ACK 2
+
+#define FLAG_RETRANSMIT 0x01
+
+#define NACK_ENTRY_SIZE 6
+#define MAX_NACK_ENTRIES 128
+#define ACK_BODY_SIZE 24
+
+#define MAX_DATAGRAM_SIZE 2048
+#define MAX_BATCH_SIZE 64
+
+/* must be a power of two */
+#define NUM_SLOTS 8192
+#define SLOT_MASK (NUM_SLOTS - 1)
+
+#define ACK_INTERVAL_NS 10000000ULL
+#define MIN_NACK_INTERVAL_NS 20000000ULL
+#define NACK_SCANS_PER_INTERVAL 4
+#define RECV_TIMEOUT_MS 5
+#define SEND_IDLE_TIMEOUT_MS 100
+#define SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+
+static inline void put_be16(uint8_t *p, uint16_t val)
+{
+	p[0] = (uint8_t)(val >> 8);
+	p[1] = (uint8_t)val;
+}
+
+static inline void put_be32(uint8_t *p, uint32_t val)
+{
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void write_header(uint8_t *p, uint8_t type, uint8_t flags,
+				uint32_t seq, uint32_t ts)
+{
+	p[0] = (PROTOCOL_VERSION << 6) | type;
+	p[1] = flags;
+	p[2] = 0;
+	p[3] = 0;
+	put_be32(p + 4, seq);
+	put_be32(p + 8, ts);
+}
+
+static inline bool parse_header(const uint8_t *p, size_t size, uint8_t *type)
+{
+	if (size < HEADER_SIZE || (p[0] >> 6) != PROTOCOL_VERSION)
+		return false;
+
+	*type = p[0] & 0x3F;
+	return true;
+}
+
+/* sequence number comparison that survives wrapping */
+static inline int32_t seq_diff(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b);
+}
+
+static inline uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static inline bool simulate_loss(float loss_rate, uint32_t *rng)
+{
+	return loss_rate > 0.0f &&
+	       (float)(xorshift(rng) & 0xFFFFFF) / (float)0x1000000 <
+		       loss_rate;
+}
+
+/* ------------------------------------------------------------------------- */
+/* sockets                                                                   */
+
+static inline bool socket_error_is_transient(int error)
+{
+#ifdef _WIN32
+	return error == WSAEWOULDBLOCK || error == WSAETIMEDOUT ||
+	       error == WSAECONNRESET || error == WSAENOBUFS ||
+	       error == WSAEINTR;
+#else
+	return error == EAGAIN || error == EWOULDBLOCK ||
+	       error == ECONNREFUSED || error == ENOBUFS || error == EINTR;
+#endif
+}
+
+static void set_recv_timeout(udp_socket_t sock, uint32_t ms)
+{
+#ifdef _WIN32
+	DWORD timeout = ms;
+#else
+	struct timeval timeout = {.tv_sec = ms / 1000,
+				  .tv_usec = (ms % 1000) * 1000};
+#endif
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
+		   sizeof(timeout));
+}
+
+/* larger buffers absorb keyframe bursts and scheduling hiccups of the
+ * receiving thread, the OS may clamp this to its own limit */
+static void set_buffer_size(udp_socket_t sock, int option)
+{
+	int size = SOCKET_BUFFER_SIZE;
+	setsockopt(sock, SOL_SOCKET, option, (const char *)&size,
+		   sizeof(size));
+}
+
+static struct addrinfo *resolve(const char *host, int port, bool passive)
+{
+	struct addrinfo hints = {0};
+	struct addrinfo *result = NULL;
+	char port_str[16];
+	int ret;
+
+	snprintf(port_str, sizeof(port_str), "%d", port);
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	if (passive)
+		hints.ai_flags = AI_PASSIVE;
+
+	ret = getaddrinfo(host, port_str, &hints, &result);
+	if (ret != 0) {
+		warn("Failed to resolve '%s': %s", host ? host : "(any)",
+		     gai_strerror(ret));
+		return NULL;
+	}
+
+	return result;
+}
+
+static bool bind_local(udp_socket_t sock, int family, const char *bind_ip,
+		       int port)
+{
+	struct addrinfo *local;
+	struct addrinfo *ai;
+	bool success = false;
+
+	if ((!bind_ip || !*bind_ip) && !port)
+		return true;
+
+	local = resolve(bind_ip && *bind_ip ? bind_ip : NULL, port, true);
+	if (!local)
+		return false;
+
+	for (ai = local; ai; ai = ai->ai_next) {
+		if (ai->ai_family != family)
+			continue;
+		if (bind(sock, ai->ai_addr, (socklen_t)ai->ai_addrlen) == 0) {
+			success = true;
+			break;
+		}
+	}
+
+	if (!success)
+		warn("Failed to bind to %s:%d (%d)",
+		     bind_ip && *bind_ip ? bind_ip : "*", port, socket_errno());
+
+	freeaddrinfo(local);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* sender                                                                    */
+
+struct tx_slot {
+	uint8_t *data; /* header + payload */
+	size_t size;
+	uint32_t seq;
+	uint64_t first_sent_ns;
+	uint64_t last_sent_ns;
+};
+
+struct udp_sender {
+	udp_socket_t sock;
+	size_t payload_size;
+	uint64_t latency_ns;
+	int batch_size;
+	bool arq;
+	float loss_rate;
+	uint32_t rng;
+	uint64_t start_ns;
+
+	pthread_mutex_t mutex;
+	struct tx_slot *slots;
+	uint32_t next_seq; /* next sequence number to queue */
+	uint32_t send_seq; /* next queued packet to send for the first time */
+	struct circlebuf resend;
+
+	/* token bucket */
+	uint64_t bytes_per_sec;
+	double tokens;
+	uint64_t last_refill_ns;
+
+	uint8_t *batch_buf;
+	size_t batch_sizes[MAX_BATCH_SIZE];
+
+	os_event_t *event;
+	volatile bool stop;
+	pthread_t send_thread;
+	pthread_t recv_thread;
+	bool send_thread_active;
+	bool recv_thread_active;
+
+	struct udp_sender_stats stats;
+	double srtt_us;
+	uint32_t last_received;
+	uint32_t last_missing;
+};
+
+static inline uint32_t sender_time_us(struct udp_sender *s)
+{
+	return (uint32_t)((os_gettime_ns() - s->start_ns) / 1000);
+}
+
+static inline size_t datagram_size(struct udp_sender *s, size_t payload)
+{
+	return (s->arq ? HEADER_SIZE : 0) + payload;
+}
+
+static inline uint64_t bucket_size(struct udp_sender *s)
+{
+	/* allow a couple of datagrams or 5ms worth of data at once */
+	uint64_t min_size = 2 * datagram_size(s, s->payload_size);
+	uint64_t size = s->bytes_per_sec / 200;
+	return size > min_size ? size : min_size;
+}
+
+static void refill_tokens(struct udp_sender *s, uint64_t now)
+{
+	double max_tokens = (double)bucket_size(s);
+
+	s->tokens += (double)(now - s->last_refill_ns) *
+		     (double)s->bytes_per_sec / 1000000000.0;
+	if (s->tokens > max_tokens)
+		s->tokens = max_tokens;
+	s->last_refill_ns = now;
+}
+
+static inline bool take_tokens(struct udp_sender *s, size_t size)
+{
+	if (!s->bytes_per_sec)
+		return true;
+	if (s->tokens < (double)size)
+		return false;
+
+	s->tokens -= (double)size;
+	return true;
+}
+
+/* copies the slot into the batch buffer, mutex must be locked */
+static void add_to_batch(struct udp_sender *s, size_t idx,
+			 struct tx_slot *slot, bool retransmit, uint64_t now)
+{
+	uint8_t *dst = s->batch_buf + idx * MAX_DATAGRAM_SIZE;
+	size_t size = datagram_size(s, slot->size);
+
+	if (s->arq) {
+		write_header(slot->data, TYPE_DATA,
+			     retransmit ? FLAG_RETRANSMIT : 0, slot->seq,
+			     (uint32_t)((now - s->start_ns) / 1000));
+
+		/* sequence numbers start at 0, this lets the receiver
+		 * request whatever it missed before its first datagram */
+		put_be16(slot->data + 2,
+			 slot->seq < 0xFFFF ? (uint16_t)slot->seq : 0xFFFF);
+	}
+
+	memcpy(dst, s->arq ? slot->data : slot->data + HEADER_SIZE, size);
+	s->batch_sizes[idx] = size;
+
+	if (!retransmit)
+		slot->first_sent_ns = now;
+	slot->last_sent_ns = now;
+
+	s->stats.bytes_sent += size;
+	if (retransmit)
+		s->stats.retransmits++;
+	else
+		s->stats.packets_sent++;
+}
+
+static bool can_resend(struct udp_sender *s, struct tx_slot *slot,
+		       uint32_t seq, uint64_t now)
+{
+	uint64_t min_interval = (uint64_t)(s->srtt_us * 500.0);
+
+	if (slot->seq != seq || !slot->first_sent_ns)
+		return false;
+	if (now - slot->first_sent_ns >= s->latency_ns)
+		return false;
+
+	/* ignore repeated NACKs for a packet that was just resent */
+	return now - slot->last_sent_ns >= min_interval;
+}
+
+/* fills the batch with retransmits first and then new data, as far as
+ * the token bucket allows.  mutex must be locked. */
+static size_t fill_batch(struct udp_sender *s, uint64_t now,
+			 uint64_t *wait_ns)
+{
+	size_t count = 0;
+
+	*wait_ns = 0;
+
+	while (count < (size_t)s->batch_size && s->resend.size) {
+		uint32_t seq;
+		struct tx_slot *slot;
+
+		circlebuf_peek_front(&s->resend, &seq, sizeof(seq));
+		slot = &s->slots[seq & SLOT_MASK];
+
+		if (!can_resend(s, slot, seq, now)) {
+			circlebuf_pop_front(&s->resend, NULL, sizeof(seq));
+			continue;
+		}
+		if (!take_tokens(s, datagram_size(s, slot->size)))
+			goto out_of_tokens;
+
+		circlebuf_pop_front(&s->resend, NULL, sizeof(seq));
+		add_to_batch(s, count++, slot, true, now);
+	}
+
+	while (count < (size_t)s->batch_size && s->send_seq != s->next_seq) {
+		struct tx_slot *slot = &s->slots[s->send_seq & SLOT_MASK];
+
+		if (!take_tokens(s, datagram_size(s, slot->size)))
+			goto out_of_tokens;
+
+		add_to_batch(s, count++, slot, false, now);
+		s->stats.queued_bytes -= slot->size;
+		s->send_seq++;
+	}
+
+	return count;
+
+out_of_tokens:
+	*wait_ns = (uint64_t)(((double)datagram_size(s, s->payload_size) -
+			       s->tokens) *
+			      1000000000.0 / (double)s->bytes_per_sec);
+	return count;
+}
+
+static bool send_batch(struct udp_sender *s, size_t count)
+{
+	size_t sent = 0;
+
+#ifdef __linux__
+	struct mmsghdr msgs[MAX_BATCH_SIZE];
+	struct iovec iov[MAX_BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+
+	for (size_t i = 0; i < count; i++) {
+		iov[i].iov_base = s->batch_buf + i * MAX_DATAGRAM_SIZE;
+		iov[i].iov_len = s->batch_sizes[i];
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	while (sent < count) {
+		int ret = sendmmsg(s->sock, msgs + sent,
+				   (unsigned int)(count - sent), 0);
+		if (ret < 0) {
+			int error = socket_errno();
+			if (socket_error_is_transient(error)) {
+				/* the datagram is lost, ARQ will deal with it
+				 * like with any other loss */
+				sent++;
+				continue;
+			}
+
+			warn("sendmmsg failed: %d", error);
+			return false;
+		}
+
+		sent += (size_t)ret;
+	}
+#else
+	for (; sent < count; sent++) {
+		const char *buf =
+			(const char *)s->batch_buf + sent * MAX_DATAGRAM_SIZE;
+		int ret = send(s->sock, buf, (int)s->batch_sizes[sent], 0);
+
+		if (ret < 0) {
+			int error = socket_errno();
+			if (socket_error_is_transient(error))
+				continue;
+
+			warn("send failed: %d", error);
+			return false;
+		}
+	}
+#endif
+
+	return true;
+}
+
+/* loss injection happens after filling the batch so that the dropped
+ * packets still count as sent */
+static size_t drop_from_batch(struct udp_sender *s, size_t count)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (simulate_loss(s->loss_rate, &s->rng))
+			continue;
+
+		memmove(s->batch_buf + kept * MAX_DATAGRAM_SIZE,
+			s->batch_buf + i * MAX_DATAGRAM_SIZE,
+			s->batch_sizes[i]);
+		s->batch_sizes[kept++] = s->batch_sizes[i];
+	}
+
+	return kept;
+}
+
+static void *sender_send_thread(void *data)
+{
+	struct udp_sender *s = data;
+
+	os_set_thread_name("udp-transport: send_thread");
+
+	while (!os_atomic_load_bool(&s->stop)) {
+		uint64_t now = os_gettime_ns();
+		uint64_t wait_ns;
+		size_t count;
+
+		pthread_mutex_lock(&s->mutex);
+		if (s->bytes_per_sec)
+			refill_tokens(s, now);
+		count = fill_batch(s, now, &wait_ns);
+		pthread_mutex_unlock(&s->mutex);
+
+		if (count) {
+			size_t send_count = s->loss_rate > 0.0f
+						    ? drop_from_batch(s, count)
+						    : count;
+
+			if (!send_batch(s, send_count)) {
+				pthread_mutex_lock(&s->mutex);
+				s->stats.error = true;
+				pthread_mutex_unlock(&s->mutex);
+				break;
+			}
+		}
+
+		if (wait_ns)
+			os_sleepto_ns(now + wait_ns);
+		else if (!count)
+			os_event_timedwait(s->event, SEND_IDLE_TIMEOUT_MS);
+	}
+
+	return NULL;
+}
+
+static void sender_handle_nack(struct udp_sender *s, const uint8_t *body,
+			       size_t size)
+{
+	uint64_t now = os_gettime_ns();
+	bool queued = false;
+
+	pthread_mutex_lock(&s->mutex);
+
+	for (; size >= NACK_ENTRY_SIZE;
+	     body += NACK_ENTRY_SIZE, size -= NACK_ENTRY_SIZE) {
+		uint32_t seq = get_be32(body);
+		uint16_t count = get_be16(body + 4);
+
+		for (uint32_t i = 0; i < count; i++, seq++) {
+			struct tx_slot *slot = &s->slots[seq & SLOT_MASK];
+
+			s->stats.nacks++;
+
+			/* only packets that were already sent once */
+			if (seq_diff(seq, s->send_seq) >= 0)
+				continue;
+			if (!can_resend(s, slot, seq, now))
+				continue;
+
+			circlebuf_push_back(&s->resend, &seq, sizeof(seq));
+			queued = true;
+		}
+	}
+
+	pthread_mutex_unlock(&s->mutex);
+
+	if (queued)
+		os_event_signal(s->event);
+}
+
+/* the receiver can't notice loss at the end of the data it got, so once
+ * nothing newer has been sent for a while, resend what it hasn't seen.
+ * mutex must be locked. */
+static bool resend_tail(struct udp_sender *s, uint32_t end_seq, uint64_t now)
+{
+	struct tx_slot *last = &s->slots[(s->send_seq - 1) & SLOT_MASK];
+	uint64_t timeout = (uint64_t)(s->srtt_us * 1000.0);
+	timeout += 2 * ACK_INTERVAL_NS;
+	bool queued = false;
+
+	if (seq_diff(s->send_seq, end_seq) <= 0 ||
+	    seq_diff(s->send_seq, end_seq) > NUM_SLOTS / 2)
+		return false;
+	if (now - last->last_sent_ns < timeout)
+		return false;
+
+	for (uint32_t seq = end_seq; seq != s->send_seq; seq++) {
+		struct tx_slot *slot = &s->slots[seq & SLOT_MASK];
+
+		if (can_resend(s, slot, seq, now)) {
+			circlebuf_push_back(&s->resend, &seq, sizeof(seq));
+			queued = true;
+		}
+	}
+
+	return queued;
+}
+
+static void sender_handle_ack(struct udp_sender *s, const uint8_t *body,
+			      size_t size)
+{
+	uint32_t now_us = sender_time_us(s);
+	uint32_t end_seq, echo_ts, echo_delay, received, missing, lost;
+	uint32_t rtt_us;
+	bool queued;
+
+	if (size < ACK_BODY_SIZE)
+		return;
+
+	end_seq = get_be32(body);
+	echo_ts = get_be32(body + 4);
+	echo_delay = get_be32(body + 8);
+	received = get_be32(body + 12);
+	missing = get_be32(body + 16);
+	lost = get_be32(body + 20);
+
+	rtt_us = now_us - echo_ts - echo_delay;
+
+	pthread_mutex_lock(&s->mutex);
+
+	/* ignore obviously bogus samples (reordered ACKs, clock wrap) */
+	if (rtt_us < 10000000) {
+		s->srtt_us = s->stats.got_ack
+				     ? (s->srtt_us * 7.0 + (double)rtt_us) / 8.0
+				     : (double)rtt_us;
+		s->stats.rtt_ms = (uint32_t)(s->srtt_us / 1000.0);
+	}
+
+	if (s->stats.got_ack) {
+		uint32_t d_received = received - s->last_received;
+		uint32_t d_missing = missing - s->last_missing;
+
+		if (d_received + d_missing) {
+			float sample = (float)d_missing /
+				       (float)(d_received + d_missing);
+			s->stats.loss = s->stats.loss * 0.8f + sample * 0.2f;
+		}
+	}
+
+	s->last_received = received;
+	s->last_missing = missing;
+	s->stats.lost = lost;
+	s->stats.got_ack = true;
+
+	queued = resend_tail(s, end_seq, os_gettime_ns());
+
+	pthread_mutex_unlock(&s->mutex);
+
+	if (queued)
+		os_event_signal(s->event);
+}
+
+static void *sender_recv_thread(void *data)
+{
+	struct udp_sender *s = data;
+	uint8_t buf[MAX_DATAGRAM_SIZE];
+
+	os_set_thread_name("udp-transport: recv_thread");
+
+	while (!os_atomic_load_bool(&s->stop)) {
+		int ret = recv(s->sock, (char *)buf, sizeof(buf), 0);
+		uint8_t type;
+
+		if (ret <= 0 || !parse_header(buf, (size_t)ret, &type))
+			continue;
+
+		if (type == TYPE_NACK)
+			sender_handle_nack(s, buf + HEADER_SIZE,
+					   (size_t)ret - HEADER_SIZE);
+		else if (type == TYPE_ACK)
+			sender_handle_ack(s, buf + HEADER_SIZE,
+					  (size_t)ret - HEADER_SIZE);
+	}
+
+	return NULL;
+}
+
+static void apply_options(const struct udp_transport_options *opts,
+			  size_t *payload_size, uint32_t *latency_ms,
+			  int *batch_size)
+{
+	*payload_size = opts && opts->payload_size
+				? opts->payload_size
+				: UDP_TRANSPORT_DEFAULT_PAYLOAD_SIZE;
+	*latency_ms = opts && opts->latency_ms
+			      ? opts->latency_ms
+			      : UDP_TRANSPORT_DEFAULT_LATENCY_MS;
+	*batch_size = opts && opts->batch_size
+			      ? opts->batch_size
+			      : UDP_TRANSPORT_DEFAULT_BATCH_SIZE;
+
+	if (*payload_size > MAX_DATAGRAM_SIZE - HEADER_SIZE)
+		*payload_size = MAX_DATAGRAM_SIZE - HEADER_SIZE;
+	if (*batch_size > MAX_BATCH_SIZE)
+		*batch_size = MAX_BATCH_SIZE;
+}
+
+struct udp_sender *udp_sender_create(const char *host, int port,
+				     const struct udp_transport_options *opts)
+{
+	struct udp_sender *s;
+	struct addrinfo *remote;
+	struct addrinfo *ai;
+	uint32_t latency_ms;
+
+	remote = resolve(host, port, false);
+	if (!remote)
+		return NULL;
+
+	s = bzalloc(sizeof(*s));
+	s->sock = INVALID_SOCKET;
+	apply_options(opts, &s->payload_size, &latency_ms, &s->batch_size);
+	s->latency_ns = (uint64_t)latency_ms * 1000000ULL;
+	s->arq = !opts || !opts->disable_arq;
+	s->loss_rate = opts ? opts->loss_rate : 0.0f;
+	s->bytes_per_sec = opts ? opts->max_bitrate / 8 : 0;
+	s->start_ns = os_gettime_ns();
+	s->last_refill_ns = s->start_ns;
+	s->rng = (uint32_t)s->start_ns | 1;
+
+	for (ai = remote; ai; ai = ai->ai_next) {
+		s->sock = socket(ai->ai_family, ai->ai_socktype,
+				 ai->ai_protocol);
+		if (s->sock == INVALID_SOCKET)
+			continue;
+
+		if (bind_local(s->sock, ai->ai_family,
+			       opts ? opts->bind_ip : NULL, 0) &&
+		    connect(s->sock, ai->ai_addr, (socklen_t)ai->ai_addrlen) ==
+			    0)
+			break;
+
+		closesocket(s->sock);
+		s->sock = INVALID_SOCKET;
+	}
+
+	freeaddrinfo(remote);
+
+	if (s->sock == INVALID_SOCKET) {
+		warn("Failed to create socket for %s:%d", host, port);
+		bfree(s);
+		return NULL;
+	}
+
+	set_recv_timeout(s->sock, SEND_IDLE_TIMEOUT_MS);
+	set_buffer_size(s->sock, SO_SNDBUF);
+
+	s->slots = bzalloc(sizeof(struct tx_slot) * NUM_SLOTS);
+	s->batch_buf = bmalloc(MAX_DATAGRAM_SIZE * MAX_BATCH_SIZE);
+	pthread_mutex_init(&s->mutex, NULL);
+	os_event_init(&s->event, OS_EVENT_TYPE_AUTO);
+
+	s->send_thread_active = pthread_create(&s->send_thread, NULL,
+					       sender_send_thread, s) == 0;
+	if (s->arq)
+		s->recv_thread_active =
+			pthread_create(&s->recv_thread, NULL,
+				       sender_recv_thread, s) == 0;
+
+	if (!s->send_thread_active || (s->arq && !s->recv_thread_active)) {
+		udp_sender_destroy(s);
+		return NULL;
+	}
+
+	info("Sending to %s:%d (latency: %ums, ARQ: %s)", host, port,
+	     latency_ms, s->arq ? "on" : "off");
+	return s;
+}
+
+void udp_sender_destroy(struct udp_sender *s)
+{
+	if (!s)
+		return;
+
+	os_atomic_set_bool(&s->stop, true);
+	os_event_signal(s->event);
+
+	if (s->send_thread_active)
+		pthread_join(s->send_thread, NULL);
+	if (s->recv_thread_active)
+		pthread_join(s->recv_thread, NULL);
+
+	closesocket(s->sock);
+
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+		bfree(s->slots[i].data);
+	bfree(s->slots);
+	bfree(s->batch_buf);
+	circlebuf_free(&s->resend);
+	os_event_destroy(s->event);
+	pthread_mutex_destroy(&s->mutex);
+	bfree(s);
+}
+
+bool udp_sender_send(struct udp_sender *s, const uint8_t *data, size_t size)
+{
+	size_t count = (size + s->payload_size - 1) / s->payload_size;
+	bool success = false;
+
+	pthread_mutex_lock(&s->mutex);
+
+	if (s->stats.error)
+		goto unlock;
+
+	/* keep half of the slots for packets that may still be resent */
+	if ((s->next_seq - s->send_seq) + count > NUM_SLOTS / 2)
+		goto unlock;
+
+	while (size) {
+		struct tx_slot *slot = &s->slots[s->next_seq & SLOT_MASK];
+		size_t chunk = size < s->payload_size ? size : s->payload_size;
+
+		if (!slot->data)
+			slot->data = bmalloc(HEADER_SIZE + s->payload_size);
+
+		memcpy(slot->data + HEADER_SIZE, data, chunk);
+		slot->size = chunk;
+		slot->seq = s->next_seq++;
+		slot->first_sent_ns = 0;
+		slot->last_sent_ns = 0;
+
+		s->stats.queued_bytes += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	success = true;
+
+unlock:
+	pthread_mutex_unlock(&s->mutex);
+
+	if (success)
+		os_event_signal(s->event);
+	return success;
+}
+
+bool udp_sender_flush(struct udp_sender *s, uint32_t timeout_ms)
+{
+	uint64_t end = os_gettime_ns() + (uint64_t)timeout_ms * 1000000ULL;
+
+	for (;;) {
+		bool drained;
+
+		pthread_mutex_lock(&s->mutex);
+		drained = s->send_seq == s->next_seq || s->stats.error;
+		pthread_mutex_unlock(&s->mutex);
+
+		if (drained)
+			return true;
+		if (os_gettime_ns() >= end)
+			return false;
+
+		os_sleep_ms(5);
+	}
+}
+
+void udp_sender_set_bitrate(struct udp_sender *s, uint64_t max_bitrate)
+{
+	pthread_mutex_lock(&s->mutex);
+	s->bytes_per_sec = max_bitrate / 8;
+	s->tokens = 0.0;
+	s->last_refill_ns = os_gettime_ns();
+	pthread_mutex_unlock(&s->mutex);
+}
+
+void udp_sender_get_stats(struct udp_sender *s, struct udp_sender_stats *stats)
+{
+	pthread_mutex_lock(&s->mutex);
+	*stats = s->stats;
+	pthread_mutex_unlock(&s->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* receiver                                                                  */
+
+struct rx_slot {
+	uint8_t *data;
+	size_t size;
+	uint32_t seq;
+	bool present;
+	bool missing;
+	uint64_t missing_since_ns;
+	uint64_t last_nack_ns;
+};
+
+struct udp_receiver {
+	udp_socket_t sock;
+	int port;
+	size_t payload_size;
+	uint64_t latency_ns;
+	uint64_t nack_interval_ns;
+	bool arq;
+	float loss_rate;
+	uint32_t rng;
+
+	struct sockaddr_storage peer;
+	socklen_t peer_len;
+
+	struct rx_slot *slots;
+	bool started;
+	uint32_t next_seq; /* next sequence number to deliver */
+	uint32_t end_seq;  /* one past the highest sequence number seen */
+	uint32_t missing;
+	uint32_t echo_ts;
+	uint64_t echo_recv_ns;
+	uint64_t last_ack_ns;
+	uint64_t next_nack_scan_ns;
+
+	pthread_mutex_t mutex;
+	struct circlebuf output;
+	os_event_t *data_event;
+	struct udp_receiver_stats stats;
+
+	volatile bool stop;
+	pthread_t thread;
+	bool thread_active;
+};
+
+static inline void receiver_send(struct udp_receiver *r, const uint8_t *buf,
+				 size_t size)
+{
+	if (r->peer_len)
+		sendto(r->sock, (const char *)buf, (int)size, 0,
+		       (const struct sockaddr *)&r->peer, r->peer_len);
+}
+
+/* the receiver state below is only touched with the mutex locked */
+
+static inline void deliver(struct udp_receiver *r, const uint8_t *data,
+			   size_t size)
+{
+	circlebuf_push_back(&r->output, data, size);
+	os_event_signal(r->data_event);
+}
+
+static void deliver_ready(struct udp_receiver *r, uint64_t now)
+{
+	while (r->next_seq != r->end_seq) {
+		struct rx_slot *slot = &r->slots[r->next_seq & SLOT_MASK];
+
+		if (slot->seq == r->next_seq && slot->present) {
+			deliver(r, slot->data, slot->size);
+			slot->present = false;
+
+		} else if (slot->seq == r->next_seq && slot->missing &&
+			   now - slot->missing_since_ns >= r->latency_ns) {
+			slot->missing = false;
+			r->stats.lost++;
+
+		} else {
+			break;
+		}
+
+		r->next_seq++;
+	}
+}
+
+/* gives up on everything that doesn't fit in the slots anymore */
+static void skip_to(struct udp_receiver *r, uint32_t seq)
+{
+	while (seq_diff(seq, r->next_seq) >= NUM_SLOTS) {
+		struct rx_slot *slot = &r->slots[r->next_seq & SLOT_MASK];
+
+		if (slot->seq == r->next_seq && slot->present)
+			deliver(r, slot->data, slot->size);
+		else
+			r->stats.lost++;
+
+		slot->present = false;
+		slot->missing = false;
+		r->next_seq++;
+	}
+
+	if (seq_diff(r->next_seq, r->end_seq) > 0)
+		r->end_seq = r->next_seq;
+}
+
+static void send_nack(struct udp_receiver *r, uint32_t first, uint32_t count)
+{
+	uint8_t buf[HEADER_SIZE + NACK_ENTRY_SIZE];
+
+	write_header(buf, TYPE_NACK, 0, 0, 0);
+	put_be32(buf + HEADER_SIZE, first);
+	put_be16(buf + HEADER_SIZE + 4, (uint16_t)count);
+	receiver_send(r, buf, sizeof(buf));
+
+	r->stats.nacks_sent += count;
+}
+
+static void receiver_handle_data(struct udp_receiver *r, const uint8_t *buf,
+				 size_t size, uint64_t now)
+{
+	uint32_t seq = get_be32(buf + 4);
+	struct rx_slot *slot;
+
+	r->echo_ts = get_be32(buf + 8);
+	r->echo_recv_ns = now;
+
+	/* if the first datagrams of the stream were lost, start at the first
+	 * one so that they are requested like any other gap.  a receiver
+	 * that joins later just starts where it joined. */
+	if (!r->started) {
+		uint16_t offset = get_be16(buf + 2);
+
+		r->next_seq = offset < NUM_SLOTS / 2 ? seq - offset : seq;
+		r->end_seq = r->next_seq;
+		r->started = true;
+	}
+
+	if (seq_diff(seq, r->next_seq) < 0) {
+		r->stats.duplicates++;
+		return;
+	}
+
+	if (seq_diff(seq, r->next_seq) >= NUM_SLOTS)
+		skip_to(r, seq);
+
+	slot = &r->slots[seq & SLOT_MASK];
+
+	if (seq_diff(seq, r->end_seq) >= 0) {
+		for (uint32_t s = r->end_seq; s != seq; s++) {
+			struct rx_slot *gap = &r->slots[s & SLOT_MASK];
+
+			gap->seq = s;
+			gap->present = false;
+			gap->missing = true;
+			gap->missing_since_ns = now;
+			gap->last_nack_ns = now;
+			r->missing++;
+		}
+
+		/* new gaps are requested right away, the scan in
+		 * receiver_send_nacks only repeats requests */
+		if (seq != r->end_seq)
+			send_nack(r, r->end_seq, seq - r->end_seq);
+
+		r->end_seq = seq + 1;
+
+	} else if (slot->seq == seq && slot->present) {
+		r->stats.duplicates++;
+		return;
+
+	} else if (slot->seq == seq && slot->missing) {
+		r->stats.recovered++;
+	}
+
+	size -= HEADER_SIZE;
+	if (!slot->data)
+		slot->data = bmalloc(MAX_DATAGRAM_SIZE);
+
+	memcpy(slot->data, buf + HEADER_SIZE, size);
+	slot->size = size;
+	slot->seq = seq;
+	slot->present = true;
+	slot->missing = false;
+	r->stats.packets_received++;
+}
+
+/* scanning the whole window for every datagram would be far too slow at
+ * high packet rates, so this only runs a few times per NACK interval */
+static void receiver_send_nacks(struct udp_receiver *r, uint64_t now)
+{
+	uint8_t buf[HEADER_SIZE + MAX_NACK_ENTRIES * NACK_ENTRY_SIZE];
+	size_t entries = 0;
+	uint32_t first = 0;
+	uint32_t count = 0;
+
+	if (now < r->next_nack_scan_ns)
+		return;
+	r->next_nack_scan_ns = now + r->nack_interval_ns /
+					     NACK_SCANS_PER_INTERVAL;
+
+	for (uint32_t seq = r->next_seq; seq != r->end_seq; seq++) {
+		struct rx_slot *slot = &r->slots[seq & SLOT_MASK];
+		bool request = slot->seq == seq && slot->missing &&
+			       now - slot->last_nack_ns >= r->nack_interval_ns;
+
+		if (request) {
+			slot->last_nack_ns = now;
+			r->stats.nacks_sent++;
+
+			if (count && first + count == seq && count < 0xFFFF) {
+				count++;
+				continue;
+			}
+		}
+
+		if (count) {
+			uint8_t *entry = buf + HEADER_SIZE +
+					 entries * NACK_ENTRY_SIZE;
+			put_be32(entry, first);
+			put_be16(entry + 4, (uint16_t)count);
+			count = 0;
+
+			if (++entries == MAX_NACK_ENTRIES) {
+				write_header(buf, TYPE_NACK, 0, 0, 0);
+				receiver_send(r, buf, sizeof(buf));
+				entries = 0;
+			}
+		}
+
+		if (request) {
+			first = seq;
+			count = 1;
+		}
+	}
+
+	if (count) {
+		uint8_t *entry = buf + HEADER_SIZE + entries * NACK_ENTRY_SIZE;
+		put_be32(entry, first);
+		put_be16(entry + 4, (uint16_t)count);
+		entries++;
+	}
+
+	if (entries) {
+		write_header(buf, TYPE_NACK, 0, 0, 0);
+		receiver_send(r, buf, HEADER_SIZE + entries * NACK_ENTRY_SIZE);
+	}
+}
+
+static void receiver_send_ack(struct udp_receiver *r, uint64_t now)
+{
+	uint8_t buf[HEADER_SIZE + ACK_BODY_SIZE];
+	uint8_t *body = buf + HEADER_SIZE;
+
+	write_header(buf, TYPE_ACK, 0, 0, 0);
+	put_be32(body, r->end_seq);
+	put_be32(body + 4, r->echo_ts);
+	put_be32(body + 8, (uint32_t)((now - r->echo_recv_ns) / 1000));
+	put_be32(body + 12, (uint32_t)r->stats.packets_received);
+	put_be32(body + 16, r->missing);
+	put_be32(body + 20, (uint32_t)r->stats.lost);
+	receiver_send(r, buf, sizeof(buf));
+
+	r->last_ack_ns = now;
+}
+
+static void *receiver_thread(void *data)
+{
+	struct udp_receiver *r = data;
+	uint8_t buf[MAX_DATAGRAM_SIZE];
+
+	os_set_thread_name("udp-transport: receiver_thread");
+
+	while (!os_atomic_load_bool(&r->stop)) {
+		struct sockaddr_storage addr;
+		socklen_t addr_len = sizeof(addr);
+		int ret = recvfrom(r->sock, (char *)buf, sizeof(buf), 0,
+				   (struct sockaddr *)&addr, &addr_len);
+		uint64_t now = os_gettime_ns();
+		uint8_t type;
+
+		pthread_mutex_lock(&r->mutex);
+
+		if (ret > 0 && simulate_loss(r->loss_rate, &r->rng)) {
+			r->stats.dropped++;
+
+		} else if (ret > 0 && !r->arq) {
+			r->stats.packets_received++;
+			deliver(r, buf, (size_t)ret);
+
+		} else if (ret > 0 && parse_header(buf, (size_t)ret, &type) &&
+			   type == TYPE_DATA) {
+			/* replies go to wherever the data comes from */
+			memcpy(&r->peer, &addr, addr_len);
+			r->peer_len = addr_len;
+
+			receiver_handle_data(r, buf, (size_t)ret, now);
+		}
+
+		if (r->arq && r->started) {
+			deliver_ready(r, now);
+			receiver_send_nacks(r, now);
+
+			if (now - r->last_ack_ns >= ACK_INTERVAL_NS)
+				receiver_send_ack(r, now);
+		}
+
+		pthread_mutex_unlock(&r->mutex);
+	}
+
+	return NULL;
+}
+
+struct udp_receiver *
+udp_receiver_create(int port, const struct udp_transport_options *opts)
+{
+	struct udp_receiver *r = bzalloc(sizeof(*r));
+	const char *bind_ip = opts ? opts->bind_ip : NULL;
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	uint32_t latency_ms;
+	int batch_size;
+	int family;
+
+	apply_options(opts, &r->payload_size, &latency_ms, &batch_size);
+	r->latency_ns = (uint64_t)latency_ms * 1000000ULL;
+	r->nack_interval_ns = r->latency_ns / 8;
+	if (r->nack_interval_ns < MIN_NACK_INTERVAL_NS)
+		r->nack_interval_ns = MIN_NACK_INTERVAL_NS;
+	r->arq = !opts || !opts->disable_arq;
+	r->loss_rate = opts ? opts->loss_rate : 0.0f;
+	r->rng = (uint32_t)os_gettime_ns() | 1;
+
+	family = bind_ip && strchr(bind_ip, ':') ? AF_INET6 : AF_INET;
+	r->sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+	if (r->sock == INVALID_SOCKET) {
+		warn("Failed to create receiver socket");
+		bfree(r);
+		return NULL;
+	}
+
+	if (!bind_ip || !*bind_ip)
+		bind_ip = family == AF_INET6 ? "::" : "0.0.0.0";
+
+	if (!bind_local(r->sock, family, bind_ip, port)) {
+		closesocket(r->sock);
+		bfree(r);
+		return NULL;
+	}
+
+	if (getsockname(r->sock, (struct sockaddr *)&addr, &addr_len) == 0)
+		r->port = ntohs(addr.ss_family == AF_INET6
+					? ((struct sockaddr_in6 *)&addr)
+						  ->sin6_port
+					: ((struct sockaddr_in *)&addr)
+						  ->sin_port);
+
+	set_recv_timeout(r->sock, RECV_TIMEOUT_MS);
+	set_buffer_size(r->sock, SO_RCVBUF);
+
+	r->slots = bzalloc(sizeof(struct rx_slot) * NUM_SLOTS);
+	pthread_mutex_init(&r->mutex, NULL);
+	os_event_init(&r->data_event, OS_EVENT_TYPE_AUTO);
+
+	r->thread_active =
+		pthread_create(&r->thread, NULL, receiver_thread, r) == 0;
+	if (!r->thread_active) {
+		udp_receiver_destroy(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+void udp_receiver_destroy(struct udp_receiver *r)
+{
+	if (!r)
+		return;
+
+	os_atomic_set_bool(&r->stop, true);
+	if (r->thread_active)
+		pthread_join(r->thread, NULL);
+
+	closesocket(r->sock);
+
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+		bfree(r->slots[i].data);
+	bfree(r->slots);
+	circlebuf_free(&r->output);
+	os_event_destroy(r->data_event);
+	pthread_mutex_destroy(&r->mutex);
+	bfree(r);
+}
+
+int udp_receiver_get_port(struct udp_receiver *r)
+{
+	return r->port;
+}
+
+size_t udp_receiver_read(struct udp_receiver *r, uint8_t *data, size_t size,
+			 uint32_t timeout_ms)
+{
+	size_t available;
+
+	pthread_mutex_lock(&r->mutex);
+	available = r->output.size;
+	pthread_mutex_unlock(&r->mutex);
+
+	if (!available && timeout_ms)
+		os_event_timedwait(r->data_event, timeout_ms);
+
+	pthread_mutex_lock(&r->mutex);
+	if (size > r->output.size)
+		size = r->output.size;
+	circlebuf_pop_front(&r->output, data, size);
+	pthread_mutex_unlock(&r->mutex);
+
+	return size;
+}
+
+void udp_receiver_get_stats(struct udp_receiver *r,
+			    struct udp_receiver_stats *stats)
+{
+	pthread_mutex_lock(&r->mutex);
+	*stats = r->stats;
+	pthread_mutex_unlock(&r->mutex);
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ *   Low latency datagram transport with NACK based retransmission.
+ *
+ *   Each datagram carries a small header with a sequence number and a send
+ * timestamp.  The receiver reports gaps in the sequence with NACKs, which
+ * the sender answers from its retransmit buffer for as long as the packet
+ * is still within the latency budget, and sends periodic ACKs that the
+ * sender uses to measure RTT and loss.  The receiver delivers data in
+ * order, holding back anything behind a gap for up to the latency budget
+ * to give the retransmit time to arrive before skipping it.
+ *
+ *   New data is paced by a token bucket so that bursts (keyframes) don't
+ * overflow the buffers of routers along the path.  On Linux datagrams are
+ * sent in batches with sendmmsg.
+ *
+ *   With ARQ disabled the payload is sent as is, which for MPEG-TS is plain
+ * UDP that any player can receive.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UDP_TRANSPORT_DEFAULT_PAYLOAD_SIZE (7 * 188)
+#define UDP_TRANSPORT_DEFAULT_LATENCY_MS 200
+#define UDP_TRANSPORT_DEFAULT_BATCH_SIZE 16
+
+struct udp_transport_options {
+	/** Maximum payload per datagram, 0 for the default */
+	size_t payload_size;
+
+	/** How long packets can be retransmitted and are held back by the
+	 * receiver, 0 for the default */
+	uint32_t latency_ms;
+
+	/** Pacing rate in bits per second, 0 to send as fast as possible */
+	uint64_t max_bitrate;
+
+	/** Maximum number of datagrams per send call, 0 for the default */
+	int batch_size;
+
+	/** Local address to bind to, NULL or empty for any */
+	const char *bind_ip;
+
+	/** Disables the transport header and retransmission */
+	bool disable_arq;
+
+	/** Fraction of incoming (receiver) or outgoing (sender) datagrams to
+	 * drop on purpose, for testing */
+	float loss_rate;
+};
+
+struct udp_sender_stats {
+	uint64_t packets_sent;  /**< Datagrams sent, excluding retransmits */
+	uint64_t bytes_sent;    /**< Bytes sent, including retransmits */
+	uint64_t retransmits;   /**< Datagrams retransmitted */
+	uint64_t nacks;         /**< Sequence numbers requested by NACKs */
+	uint64_t lost;          /**< Datagrams the receiver gave up on */
+	uint64_t queued_bytes;  /**< Bytes waiting to be sent */
+	uint32_t rtt_ms;        /**< Smoothed round trip time */
+	float loss;             /**< Recent loss rate before retransmission */
+	bool got_ack;           /**< An ACK has been received */
+	bool error;             /**< Sending failed, the sender is stopped */
+};
+
+struct udp_receiver_stats {
+	uint64_t packets_received; /**< Unique datagrams received */
+	uint64_t duplicates;       /**< Datagrams received more than once */
+	uint64_t recovered;        /**< Missing datagrams that arrived later */
+	uint64_t lost;             /**< Datagrams skipped after the latency */
+	uint64_t nacks_sent;       /**< Sequence numbers requested */
+	uint64_t dropped;          /**< Datagrams dropped by loss_rate */
+};
+
+struct udp_sender;
+struct udp_receiver;
+
+/**
+ * Creates a sender that sends to host:port.  Returns NULL if the address
+ * can't be resolved or the socket can't be created.
+ */
+extern struct udp_sender *
+udp_sender_create(const char *host, int port,
+		  const struct udp_transport_options *opts);
+extern void udp_sender_destroy(struct udp_sender *sender);
+
+/**
+ * Queues data to be sent, split into datagrams of at most payload_size
+ * bytes.  Returns false if the send queue is full or the sender failed.
+ */
+extern bool udp_sender_send(struct udp_sender *sender, const uint8_t *data,
+			    size_t size);
+
+/**
+ * Waits up to timeout_ms for the send queue to drain, returns true if it
+ * did.
+ */
+extern bool udp_sender_flush(struct udp_sender *sender, uint32_t timeout_ms);
+
+extern void udp_sender_set_bitrate(struct udp_sender *sender,
+				   uint64_t max_bitrate);
+extern void udp_sender_get_stats(struct udp_sender *sender,
+				 struct udp_sender_stats *stats);
+
+/**
+ * Creates a receiver listening on port, or on a free port if port is 0.
+ */
+extern struct udp_receiver *
+udp_receiver_create(int port, const struct udp_transport_options *opts);
+extern void udp_receiver_destroy(struct udp_receiver *receiver);
+
+extern int udp_receiver_get_port(struct udp_receiver *receiver);
+
+/**
+ * Reads received data in order, waiting up to timeout_ms for some to
+ * arrive.  Returns the number of bytes read.
+ */
+extern size_t udp_receiver_read(struct udp_receiver *receiver,
+				uint8_t *data, size_t size,
+				uint32_t timeout_ms);
+
+extern void udp_receiver_get_stats(struct udp_receiver *receiver,
+				   struct udp_receiver_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -48,14 +48,17 @@ struct obs_x264 {
 	x264_param_t params;
 	x264_t *context;
 
-	DARRAY(uint8_t) packet_data;
-
 	uint8_t *extra_data;
 	uint8_t *sei;
 
 	size_t extra_data_size;
 	size_t sei_size;
 
+	struct encoder_frame_stats frame_stats;
+
+	uint32_t idr_interval;
+	uint32_t frames_since_idr;
+
 	os_performance_token_t *performance_token;
 };
 
@@ -89,7 +92,6 @@ static void obs_x264_destroy(void *data)
 	if (obsx264) {
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
-		da_free(obsx264->packet_data);
 		bfree(obsx264);
 	}
 }
@@ -106,6 +108,8 @@ static void obs_x264_defaults(obs_data_t *settings)
 #endif
 	obs_data_set_default_string(settings, "rate_control", "CBR");
 
+	obs_data_set_default_string(settings, "latency", "normal");
+	obs_data_set_default_bool(settings, "intra_refresh", false);
 	obs_data_set_default_string(settings, "preset", "veryfast");
 	obs_data_set_default_string(settings, "profile", "");
 	obs_data_set_default_string(settings, "tune", "");
@@ -133,6 +137,11 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_TUNE obs_module_text("Tune")
 #define TEXT_NONE obs_module_text("None")
 #define TEXT_X264_OPTS obs_module_text("EncoderOptions")
+#define TEXT_LATENCY obs_module_text("Latency")
+#define TEXT_LATENCY_NORMAL obs_module_text("Latency.Normal")
+#define TEXT_LATENCY_LOW obs_module_text("Latency.Low")
+#define TEXT_LATENCY_ULTRA_LOW obs_module_text("Latency.UltraLow")
+#define TEXT_INTRA_REFRESH obs_module_text("IntraRefresh")
 
 static bool use_bufsize_modified(obs_properties_t *ppts, obs_property_t *p,
 				 obs_data_t *settings)
@@ -198,6 +207,15 @@ static obs_properties_t *obs_x264_props(void *unused)
 
 	obs_properties_add_int(props, "keyint_sec", TEXT_KEYINT_SEC, 0, 20, 1);
 
+	list = obs_properties_add_list(props, "latency", TEXT_LATENCY,
+				       OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(list, TEXT_LATENCY_NORMAL, "normal");
+	obs_property_list_add_string(list, TEXT_LATENCY_LOW, "low");
+	obs_property_list_add_string(list, TEXT_LATENCY_ULTRA_LOW, "ultra_low");
+
+	obs_properties_add_bool(props, "intra_refresh", TEXT_INTRA_REFRESH);
+
 	list = obs_properties_add_list(props, "preset", TEXT_PRESET,
 				       OBS_COMBO_TYPE_LIST,
 				       OBS_COMBO_FORMAT_STRING);
@@ -383,6 +401,51 @@ enum rate_control {
 	RATE_CONTROL_CRF
 };
 
+#define LOW_LATENCY_RC_LOOKAHEAD 10
+
+/* low latency trades compression for delay: sliced threads split every
+ * frame across threads instead of encoding several frames at once, and
+ * B-frames and the threaded lookahead go away.  ultra low latency also
+ * drops the rate control lookahead */
+static void apply_latency_mode(struct obs_x264 *obsx264, const char *latency)
+{
+	bool low = astrcmpi(latency, "low") == 0;
+	bool ultra_low = astrcmpi(latency, "ultra_low") == 0;
+
+	if (!low && !ultra_low)
+		return;
+
+	obsx264->params.b_sliced_threads = 1;
+	obsx264->params.i_sync_lookahead = 0;
+	obsx264->params.i_bframe = 0;
+
+	if (ultra_low) {
+		obsx264->params.rc.i_lookahead = 0;
+		obsx264->params.rc.b_mb_tree = 0;
+	} else if (obsx264->params.rc.i_lookahead > LOW_LATENCY_RC_LOOKAHEAD) {
+		obsx264->params.rc.i_lookahead = LOW_LATENCY_RC_LOOKAHEAD;
+	}
+}
+
+#define INTRA_REFRESH_IDR_SEC 10
+
+/* intra refresh replaces keyframes with a column of intra blocks that moves
+ * across the picture once per keyframe interval, so there are no large
+ * frames to send at once.  outputs still need real keyframes to start,
+ * split or join a stream though, so an IDR frame is forced every
+ * INTRA_REFRESH_IDR_SEC seconds */
+static void apply_intra_refresh(struct obs_x264 *obsx264, bool intra_refresh,
+				const struct video_output_info *voi)
+{
+	obsx264->params.b_intra_refresh = intra_refresh;
+	obsx264->idr_interval = 0;
+	obsx264->frames_since_idr = 0;
+
+	if (intra_refresh)
+		obsx264->idr_interval = (uint32_t)(INTRA_REFRESH_IDR_SEC *
+						   voi->fps_num / voi->fps_den);
+}
+
 static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 			  const struct obs_x264_options *options, bool update)
 {
@@ -398,6 +461,8 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 
 	const char *rate_control =
 		obs_data_get_string(settings, "rate_control");
+	const char *latency = obs_data_get_string(settings, "latency");
+	bool intra_refresh = obs_data_get_bool(settings, "intra_refresh");
 
 	int bitrate = (int)obs_data_get_int(settings, "bitrate");
 	int buffer_size = (int)obs_data_get_int(settings, "buffer_size");
@@ -469,6 +534,12 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	if (obs_data_has_user_value(settings, "bf"))
 		obsx264->params.i_bframe = bf;
 
+	/* threading can't be reconfigured while encoding */
+	if (!obsx264->context) {
+		apply_latency_mode(obsx264, latency);
+		apply_intra_refresh(obsx264, intra_refresh, voi);
+	}
+
 	static const char *const smpte170m = "smpte170m";
 	static const char *const bt709 = "bt709";
 	static const char *const iec61966_2_1 = "iec61966-2-1";
@@ -546,11 +617,14 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 		     "\tfps_den:      %d\n"
 		     "\twidth:        %d\n"
 		     "\theight:       %d\n"
-		     "\tkeyint:       %d\n",
+		     "\tkeyint:       %d\n"
+		     "\tlatency:      %s\n"
+		     "\tintra_refresh: %s\n",
 		     rate_control, obsx264->params.rc.i_vbv_max_bitrate,
 		     obsx264->params.rc.i_vbv_buffer_size,
 		     (int)obsx264->params.rc.f_rf_constant, voi->fps_num,
-		     voi->fps_den, width, height, obsx264->params.i_keyint_max);
+		     voi->fps_den, width, height, obsx264->params.i_keyint_max,
+		     latency, intra_refresh ? "true" : "false");
 	}
 }
 
@@ -708,27 +782,42 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	return obsx264;
 }
 
+static inline enum obs_encoder_frame_type get_frame_type(int type)
+{
+	if (IS_X264_TYPE_I(type))
+		return OBS_ENCODER_FRAME_I;
+	if (IS_X264_TYPE_B(type))
+		return OBS_ENCODER_FRAME_B;
+	if (type == X264_TYPE_P)
+		return OBS_ENCODER_FRAME_P;
+	return OBS_ENCODER_FRAME_UNKNOWN;
+}
+
 static void parse_packet(struct obs_x264 *obsx264,
 			 struct encoder_packet *packet, x264_nal_t *nals,
 			 int nal_count, x264_picture_t *pic_out)
 {
+	size_t size = 0;
+
 	if (!nal_count)
 		return;
 
-	da_resize(obsx264->packet_data, 0);
-
-	for (int i = 0; i < nal_count; i++) {
-		x264_nal_t *nal = nals + i;
-		da_push_back_array(obsx264->packet_data, nal->p_payload,
-				   nal->i_payload);
-	}
+	/* x264 guarantees the payloads of all NALs of a frame are sequential
+	 * in its own output buffer, which stays valid until the next call to
+	 * x264_encoder_encode.  libobs copies the packet before that happens,
+	 * so hand the buffer over directly instead of copying it first */
+	for (int i = 0; i < nal_count; i++)
+		size += nals[i].i_payload;
 
-	packet->data = obsx264->packet_data.array;
-	packet->size = obsx264->packet_data.num;
+	packet->data = nals[0].p_payload;
+	packet->size = size;
 	packet->type = OBS_ENCODER_VIDEO;
 	packet->pts = pic_out->i_pts;
 	packet->dts = pic_out->i_dts;
 	packet->keyframe = pic_out->b_keyframe != 0;
+
+	obsx264->frame_stats.type = get_frame_type(pic_out->i_type);
+	obsx264->frame_stats.qp = pic_out->i_qpplus1 - 1;
 }
 
 static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
@@ -768,6 +857,12 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	if (frame)
 		init_pic_data(obsx264, &pic, frame);
 
+	if (obsx264->idr_interval &&
+	    ++obsx264->frames_since_idr >= obsx264->idr_interval) {
+		pic.i_type = X264_TYPE_IDR;
+		obsx264->frames_since_idr = 0;
+	}
+
 	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
 				  (frame ? &pic : NULL), &pic_out);
 	if (ret < 0) {
@@ -805,6 +900,14 @@ static bool obs_x264_sei(void *data, uint8_t **sei, size_t *size)
 	return true;
 }
 
+static bool obs_x264_frame_stats(void *data, struct encoder_frame_stats *stats)
+{
+	struct obs_x264 *obsx264 = data;
+
+	*stats = obsx264->frame_stats;
+	return true;
+}
+
 static inline bool valid_format(enum video_format format)
 {
 	return format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12 ||
@@ -840,5 +943,6 @@ struct obs_encoder_info obs_x264_encoder = {
 	.get_extra_data = obs_x264_extra_data,
 	.get_sei_data = obs_x264_sei,
 	.get_video_info = obs_x264_video_info,
+	.get_frame_stats = obs_x264_frame_stats,
 	.caps = OBS_ENCODER_CAP_DYN_BITRATE,
 };
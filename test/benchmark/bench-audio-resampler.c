@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+#define BLOCK_FRAMES 480
+#define BENCH_SECONDS 60
+
+struct bench_case {
+	uint32_t src_rate;
+	uint32_t dst_rate;
+	enum audio_format src_format;
+};
+
+static const struct bench_case cases[] = {
+	{44100, 48000, AUDIO_FORMAT_FLOAT_PLANAR},
+	{48000, 44100, AUDIO_FORMAT_FLOAT_PLANAR},
+	{96000, 48000, AUDIO_FORMAT_FLOAT_PLANAR},
+	{44100, 48000, AUDIO_FORMAT_16BIT},
+	{32000, 48000, AUDIO_FORMAT_16BIT},
+};
+
+static const char *type_name(enum audio_resampler_type type)
+{
+	switch (type) {
+	case AUDIO_RESAMPLER_AUTO:
+		return "auto";
+	case AUDIO_RESAMPLER_FFMPEG:
+		return "swresample";
+	case AUDIO_RESAMPLER_POLYPHASE:
+		return "polyphase";
+	}
+
+	return "unknown";
+}
+
+static void fill_input(const struct bench_case *bc, uint8_t *data[2],
+		       uint32_t frames, uint64_t offset)
+{
+	for (uint32_t i = 0; i < frames; i++) {
+		double t = (double)(offset + i) / (double)bc->src_rate;
+		float l = (float)(0.5 * sin(2.0 * M_PI * 440.0 * t));
+		float r = (float)(0.5 * sin(2.0 * M_PI * 1000.0 * t));
+
+		if (bc->src_format == AUDIO_FORMAT_16BIT) {
+			int16_t *out = (int16_t *)data[0];
+			out[i * 2] = (int16_t)(l * 32767.0f);
+			out[i * 2 + 1] = (int16_t)(r * 32767.0f);
+		} else {
+			((float *)data[0])[i] = l;
+			((float *)data[1])[i] = r;
+		}
+	}
+}
+
+static double run_case(const struct bench_case *bc,
+		       enum audio_resampler_type type)
+{
+	struct resample_info src = {bc->src_rate, bc->src_format,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {bc->dst_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	const uint64_t blocks = (uint64_t)bc->src_rate * BENCH_SECONDS /
+				BLOCK_FRAMES;
+	uint8_t *input[2];
+	uint64_t total_ns = 0;
+	audio_resampler_t *rs;
+
+	rs = audio_resampler_create_type(&dst, &src, type);
+	if (!rs)
+		return -1.0;
+
+	input[0] = bmalloc(sizeof(float) * 2 * BLOCK_FRAMES);
+	input[1] = bmalloc(sizeof(float) * BLOCK_FRAMES);
+
+	for (uint64_t block = 0; block < blocks; block++) {
+		uint8_t *output[MAX_AV_PLANES];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+		uint64_t start;
+
+		fill_input(bc, input, BLOCK_FRAMES, block * BLOCK_FRAMES);
+
+		start = os_gettime_ns();
+		audio_resampler_resample(rs, output, &out_frames, &ts_offset,
+					 (const uint8_t *const *)input,
+					 BLOCK_FRAMES);
+		total_ns += os_gettime_ns() - start;
+	}
+
+	bfree(input[0]);
+	bfree(input[1]);
+	audio_resampler_destroy(rs);
+
+	/* microseconds of CPU per second of audio */
+	return (double)total_ns / 1000.0 / BENCH_SECONDS;
+}
+
+int main(void)
+{
+	static const enum audio_resampler_type types[] = {
+		AUDIO_RESAMPLER_FFMPEG,
+		AUDIO_RESAMPLER_POLYPHASE,
+	};
+
+	printf("%-8s %-8s %-8s %-12s %s\n", "src", "dst", "format", "resampler",
+	       "us per second of audio");
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const struct bench_case *bc = &cases[i];
+
+		for (size_t j = 0; j < sizeof(types) / sizeof(types[0]); j++) {
+			double us = run_case(bc, types[j]);
+
+			printf("%-8u %-8u %-8s %-12s ", bc->src_rate,
+			       bc->dst_rate,
+			       bc->src_format == AUDIO_FORMAT_16BIT ? "s16"
+								    : "fltp",
+			       type_name(types[j]));
+			if (us < 0.0)
+				printf("unsupported\n");
+			else
+				printf("%.1f\n", us);
+		}
+	}
+
+	return 0;
+}
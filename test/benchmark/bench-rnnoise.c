@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <rnnoise.h>
+
+#define FRAME_SIZE 480
+#define DEFAULT_CHANNELS 12
+#define SYNTH_SECONDS 30
+
+/* Usage: bench-rnnoise [raw 48 kHz s16le mono file] [channels]
+ *
+ * The recording is fed to every channel with a per-channel offset so the
+ * channels do not stay in lockstep.  Without a file, a tone over noise is
+ * synthesized instead. */
+
+static int16_t *load_pcm(const char *path, size_t *frames)
+{
+	int16_t *pcm;
+	FILE *f = os_fopen(path, "rb");
+	int64_t size;
+
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size < (int64_t)(FRAME_SIZE * sizeof(int16_t))) {
+		fclose(f);
+		return NULL;
+	}
+
+	pcm = bmalloc((size_t)size);
+	*frames = fread(pcm, sizeof(int16_t), (size_t)size / sizeof(int16_t),
+			f);
+	fclose(f);
+	return pcm;
+}
+
+static int16_t *synth_pcm(size_t *frames)
+{
+	int16_t *pcm;
+
+	*frames = 48000 * SYNTH_SECONDS;
+	pcm = bmalloc(*frames * sizeof(int16_t));
+
+	srand(1);
+	for (size_t i = 0; i < *frames; i++) {
+		double tone = 6000.0 * sin(2.0 * M_PI * 220.0 * i / 48000.0);
+		double noise = (double)(rand() % 4000 - 2000);
+		pcm[i] = (int16_t)(tone + noise);
+	}
+
+	return pcm;
+}
+
+int main(int argc, char *argv[])
+{
+	int channels = argc > 2 ? atoi(argv[2]) : DEFAULT_CHANNELS;
+	DenoiseState **single;
+	DenoiseState **batched;
+	float **in;
+	float **out;
+	uint64_t single_ns = 0;
+	uint64_t batched_ns = 0;
+	size_t frames = 0;
+	size_t blocks;
+	int16_t *pcm;
+
+	pcm = argc > 1 ? load_pcm(argv[1], &frames) : synth_pcm(&frames);
+	if (!pcm) {
+		fprintf(stderr, "Failed to load '%s'\n", argv[1]);
+		return 1;
+	}
+	if (channels < 1)
+		channels = 1;
+
+	single = bzalloc(sizeof(DenoiseState *) * channels);
+	batched = bzalloc(sizeof(DenoiseState *) * channels);
+	in = bzalloc(sizeof(float *) * channels);
+	out = bzalloc(sizeof(float *) * channels);
+
+	for (int ch = 0; ch < channels; ch++) {
+		single[ch] = rnnoise_create(NULL);
+		batched[ch] = rnnoise_create(NULL);
+		in[ch] = bmalloc(FRAME_SIZE * sizeof(float));
+		out[ch] = bmalloc(FRAME_SIZE * sizeof(float));
+	}
+
+	blocks = frames / FRAME_SIZE;
+
+	for (size_t block = 0; block < blocks; block++) {
+		uint64_t start;
+
+		for (int ch = 0; ch < channels; ch++) {
+			size_t offset = (block + (size_t)ch * 7) % blocks;
+			const int16_t *src = pcm + offset * FRAME_SIZE;
+
+			for (size_t i = 0; i < FRAME_SIZE; i++)
+				in[ch][i] = (float)src[i];
+		}
+
+		start = os_gettime_ns();
+		for (int ch = 0; ch < channels; ch++)
+			rnnoise_process_frame(single[ch], out[ch], in[ch]);
+		single_ns += os_gettime_ns() - start;
+
+		start = os_gettime_ns();
+		rnnoise_process_frames(batched, out, (const float **)in, NULL,
+				       channels);
+		batched_ns += os_gettime_ns() - start;
+	}
+
+	double audio_sec = (double)(blocks * FRAME_SIZE) / 48000.0;
+	printf("%d channel(s), %.1f seconds of audio\n", channels, audio_sec);
+	printf("per-channel rnnoise_process_frame: %.2f%% of one core\n",
+	       (double)single_ns / 1e7 / audio_sec);
+	printf("batched rnnoise_process_frames:    %.2f%% of one core\n",
+	       (double)batched_ns / 1e7 / audio_sec);
+
+	for (int ch = 0; ch < channels; ch++) {
+		rnnoise_destroy(single[ch]);
+		rnnoise_destroy(batched[ch]);
+		bfree(in[ch]);
+		bfree(out[ch]);
+	}
+
+	bfree(single);
+	bfree(batched);
+	bfree(in);
+	bfree(out);
+	bfree(pcm);
+	return 0;
+}
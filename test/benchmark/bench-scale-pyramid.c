@@ -0,0 +1,163 @@
+#include <stdio.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/video-frame.h>
+#include <media-io/video-scaler.h>
+
+#define SRC_WIDTH 1920
+#define SRC_HEIGHT 1080
+#define BENCH_FRAMES 600
+
+struct rendition {
+	uint32_t width;
+	uint32_t height;
+};
+
+/* a typical ABR ladder below the 1080p source, largest first */
+static const struct rendition ladder[] = {
+	{1280, 720},
+	{854, 480},
+	{640, 360},
+};
+
+#define NUM_RENDITIONS (sizeof(ladder) / sizeof(ladder[0]))
+
+static void fill_frame(struct video_frame *frame, uint32_t width,
+		       uint32_t height, uint32_t frame_idx)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+		for (uint32_t x = 0; x < width; x++)
+			line[x] = (uint8_t)(x + y + frame_idx);
+	}
+
+	for (size_t plane = 1; plane < 3; plane++) {
+		for (uint32_t y = 0; y < height / 2; y++) {
+			uint8_t *line = frame->data[plane] +
+					y * frame->linesize[plane];
+			for (uint32_t x = 0; x < width / 2; x++)
+				line[x] = (uint8_t)(x * plane + frame_idx);
+		}
+	}
+}
+
+static bool create_scaler(video_scaler_t **scaler, uint32_t src_width,
+			  uint32_t src_height, const struct rendition *dst)
+{
+	struct video_scale_info src_info = {VIDEO_FORMAT_I420, src_width,
+					    src_height, VIDEO_RANGE_PARTIAL,
+					    VIDEO_CS_709};
+	struct video_scale_info dst_info = {VIDEO_FORMAT_I420, dst->width,
+					    dst->height, VIDEO_RANGE_PARTIAL,
+					    VIDEO_CS_709};
+
+	return video_scaler_create(scaler, &dst_info, &src_info,
+				   VIDEO_SCALE_FAST_BILINEAR) ==
+	       VIDEO_SCALER_SUCCESS;
+}
+
+/* every rendition scaled from the full size frame, the way N independent
+ * encoders each get their own scaled video connection */
+static double run_independent(struct video_frame *src,
+			      struct video_frame *out)
+{
+	video_scaler_t *scalers[NUM_RENDITIONS] = {0};
+	uint64_t total_ns = 0;
+
+	for (size_t i = 0; i < NUM_RENDITIONS; i++) {
+		if (!create_scaler(&scalers[i], SRC_WIDTH, SRC_HEIGHT,
+				   &ladder[i]))
+			goto fail;
+	}
+
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		uint64_t start;
+
+		fill_frame(src, SRC_WIDTH, SRC_HEIGHT, f);
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < NUM_RENDITIONS; i++)
+			video_scaler_scale(scalers[i], out[i].data,
+					   out[i].linesize,
+					   (const uint8_t *const *)src->data,
+					   src->linesize);
+		total_ns += os_gettime_ns() - start;
+	}
+
+fail:
+	for (size_t i = 0; i < NUM_RENDITIONS; i++)
+		video_scaler_destroy(scalers[i]);
+
+	return (double)total_ns / 1000.0 / BENCH_FRAMES;
+}
+
+/* every rendition scaled from the next larger one, the way an encoder
+ * group builds its scaling pyramid */
+static double run_pyramid(struct video_frame *src, struct video_frame *out)
+{
+	video_scaler_t *scalers[NUM_RENDITIONS] = {0};
+	uint64_t total_ns = 0;
+
+	for (size_t i = 0; i < NUM_RENDITIONS; i++) {
+		uint32_t width = i ? ladder[i - 1].width : SRC_WIDTH;
+		uint32_t height = i ? ladder[i - 1].height : SRC_HEIGHT;
+
+		if (!create_scaler(&scalers[i], width, height, &ladder[i]))
+			goto fail;
+	}
+
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		uint64_t start;
+
+		fill_frame(src, SRC_WIDTH, SRC_HEIGHT, f);
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < NUM_RENDITIONS; i++) {
+			struct video_frame *in = i ? &out[i - 1] : src;
+
+			video_scaler_scale(scalers[i], out[i].data,
+					   out[i].linesize,
+					   (const uint8_t *const *)in->data,
+					   in->linesize);
+		}
+		total_ns += os_gettime_ns() - start;
+	}
+
+fail:
+	for (size_t i = 0; i < NUM_RENDITIONS; i++)
+		video_scaler_destroy(scalers[i]);
+
+	return (double)total_ns / 1000.0 / BENCH_FRAMES;
+}
+
+int main(void)
+{
+	struct video_frame src;
+	struct video_frame out[NUM_RENDITIONS];
+	double independent_us;
+	double pyramid_us;
+
+	video_frame_init(&src, VIDEO_FORMAT_I420, SRC_WIDTH, SRC_HEIGHT);
+	for (size_t i = 0; i < NUM_RENDITIONS; i++)
+		video_frame_init(&out[i], VIDEO_FORMAT_I420, ladder[i].width,
+				 ladder[i].height);
+
+	independent_us = run_independent(&src, out);
+	pyramid_us = run_pyramid(&src, out);
+
+	printf("%ux%u I420 to", SRC_WIDTH, SRC_HEIGHT);
+	for (size_t i = 0; i < NUM_RENDITIONS; i++)
+		printf(" %ux%u", ladder[i].width, ladder[i].height);
+	printf("\n");
+
+	printf("%-12s %s\n", "scaling", "us per frame");
+	printf("%-12s %.1f\n", "independent", independent_us);
+	printf("%-12s %.1f\n", "pyramid", pyramid_us);
+
+	video_frame_free(&src);
+	for (size_t i = 0; i < NUM_RENDITIONS; i++)
+		video_frame_free(&out[i]);
+
+	return 0;
+}
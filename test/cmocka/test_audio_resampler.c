@@ -0,0 +1,96 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <media-io/audio-resampler.h>
+
+#define BLOCK_FRAMES 441
+#define BLOCKS 100
+
+static void polyphase_selected_test(void **state)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info mono = {44100, AUDIO_FORMAT_FLOAT_PLANAR,
+				     SPEAKERS_MONO};
+	audio_resampler_t *rs;
+
+	rs = audio_resampler_create(&dst, &src);
+	assert_non_null(rs);
+	assert_int_equal(audio_resampler_get_type(rs),
+			 AUDIO_RESAMPLER_POLYPHASE);
+	audio_resampler_destroy(rs);
+
+	/* remixing is left to swresample */
+	rs = audio_resampler_create_type(&dst, &mono,
+					 AUDIO_RESAMPLER_POLYPHASE);
+	assert_null(rs);
+}
+
+static void polyphase_sine_test(void **state)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_16BIT, SPEAKERS_MONO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_MONO};
+	int16_t input[BLOCK_FRAMES];
+	uint64_t in_total = 0;
+	uint64_t out_total = 0;
+	double max_error = 0.0;
+	audio_resampler_t *rs;
+
+	rs = audio_resampler_create_type(&dst, &src,
+					 AUDIO_RESAMPLER_POLYPHASE);
+	assert_non_null(rs);
+
+	for (int block = 0; block < BLOCKS; block++) {
+		const uint8_t *in[1] = {(const uint8_t *)input};
+		uint8_t *out[MAX_AV_PLANES];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+
+		for (int i = 0; i < BLOCK_FRAMES; i++) {
+			double t = (double)(in_total + i) / 44100.0;
+			input[i] = (int16_t)(16384.0 * sin(2.0 * M_PI * 1000.0 * t));
+		}
+		in_total += BLOCK_FRAMES;
+
+		assert_true(audio_resampler_resample(rs, out, &out_frames,
+						     &ts_offset, in,
+						     BLOCK_FRAMES));
+
+		/* the kernel delay never exceeds one millisecond */
+		assert_true(ts_offset < 1000000);
+
+		for (uint32_t i = 0; i < out_frames; i++) {
+			double t = (double)(out_total + i) / 48000.0;
+			double expected = 0.5 * sin(2.0 * M_PI * 1000.0 * t);
+			double error = fabs(((float *)out[0])[i] - expected);
+
+			/* skip the ramp-up against the zeroed history */
+			if (out_total + i >= 64 && error > max_error)
+				max_error = error;
+		}
+		out_total += out_frames;
+	}
+
+	/* output length tracks the ratio, minus the kernel delay */
+	assert_true(out_total <= in_total * 48000 / 44100);
+	assert_true(out_total + 32 >= in_total * 48000 / 44100);
+	assert_true(max_error < 0.001);
+
+	audio_resampler_destroy(rs);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(polyphase_selected_test),
+		cmocka_unit_test(polyphase_sine_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
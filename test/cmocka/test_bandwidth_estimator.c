@@ -0,0 +1,360 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "bandwidth-estimator.h"
+
+/*
+ * Replays a network trace against the estimator in simulated time.  The
+ * encoder produces frames at the current bitrate into an output queue, the
+ * sender moves them into a socket buffer that drains at the capacity given
+ * by the trace, and TCP statistics are derived from a congestion window
+ * that fills the bottleneck buffer.
+ *
+ * Run with a trace file ("<duration_ms> <kbps>" per line) as the argument
+ * to print a per-second log of a replay instead of running the tests.
+ */
+
+#define MS_TO_NS 1000000ULL
+
+#define SIM_MAX_BITRATE 6000
+#define SIM_AUDIO_BITRATE 160
+#define SIM_FPS 30
+#define SIM_KEYINT 60
+#define SIM_AUDIO_FRAME_US 21333
+#define SIM_BASE_RTT_MS 40
+#define SIM_BOTTLENECK_BUFFER_MS 150
+#define SIM_MIN_SNDBUF 65536
+#define SIM_MAX_FRAMES 16384
+
+struct trace_segment {
+	uint32_t duration_ms;
+	uint32_t kbps;
+};
+
+struct sim_frame {
+	size_t size;
+	int64_t ts_us;
+	bool video;
+};
+
+struct sim_result {
+	double avg_bitrate;
+	double avg_capacity;
+	int64_t max_queue_ms;
+	int changes;
+	int reversals;
+	long final_bitrate;
+};
+
+struct sim {
+	struct bandwidth_estimator bwe;
+	struct sim_frame frames[SIM_MAX_FRAMES];
+	size_t head;
+	size_t count;
+
+	double sock_bytes;
+	bool sending;
+	size_t send_size;
+	size_t send_left;
+	uint64_t send_beg;
+
+	long bitrate;
+	int last_dir;
+	struct sim_result result;
+	FILE *log;
+};
+
+static void sim_push(struct sim *sim, size_t size, int64_t ts_us, bool video)
+{
+	struct sim_frame *frame;
+
+	assert_true(sim->count < SIM_MAX_FRAMES);
+	frame = &sim->frames[(sim->head + sim->count++) % SIM_MAX_FRAMES];
+	frame->size = size;
+	frame->ts_us = ts_us;
+	frame->video = video;
+}
+
+static int64_t sim_queue_usec(struct sim *sim, int64_t now_us)
+{
+	if (sim->count < 5)
+		return 0;
+	return now_us - sim->frames[sim->head].ts_us;
+}
+
+static void sim_encode_video(struct sim *sim, uint64_t frame_idx,
+			     int64_t now_us)
+{
+	size_t avg = (size_t)sim->bitrate * 1000 / 8 / SIM_FPS;
+	size_t size = (frame_idx % SIM_KEYINT) == 0
+			      ? avg * 3
+			      : avg * (SIM_KEYINT - 3) / (SIM_KEYINT - 1);
+	int dir;
+
+	sim_push(sim, size, now_us, true);
+
+	bwe_add_queue(&sim->bwe, sim_queue_usec(sim, now_us));
+	if (!bwe_update(&sim->bwe, (uint64_t)now_us * 1000))
+		return;
+
+	dir = sim->bwe.bitrate > sim->bitrate ? 1 : -1;
+	if (sim->last_dir && dir != sim->last_dir)
+		sim->result.reversals++;
+	sim->last_dir = dir;
+	sim->result.changes++;
+	sim->bitrate = sim->bwe.bitrate;
+}
+
+static void sim_send(struct sim *sim, double sndbuf, uint64_t now)
+{
+	for (;;) {
+		double space;
+
+		if (!sim->sending) {
+			struct sim_frame *frame;
+
+			if (!sim->count)
+				break;
+
+			frame = &sim->frames[sim->head];
+			sim->head = (sim->head + 1) % SIM_MAX_FRAMES;
+			sim->count--;
+
+			sim->sending = true;
+			sim->send_size = frame->size;
+			sim->send_left = frame->size;
+			sim->send_beg = now;
+		}
+
+		space = sndbuf - sim->sock_bytes;
+		if (space < (double)sim->send_left) {
+			if (space > 0.0) {
+				sim->send_left -= (size_t)space;
+				sim->sock_bytes += (double)(size_t)space;
+			}
+			break;
+		}
+
+		sim->sock_bytes += (double)sim->send_left;
+		sim->send_left = 0;
+		sim->sending = false;
+		bwe_add_send(&sim->bwe, sim->send_beg, now, sim->send_size);
+	}
+}
+
+static void sim_run(const struct trace_segment *trace, size_t segments,
+		    struct sim_result *result, FILE *log)
+{
+	struct sim *sim = calloc(1, sizeof(*sim));
+	uint64_t total_ms = 0;
+	uint64_t video_frames = 0;
+	int64_t next_video_us = 0;
+	int64_t next_audio_us = 0;
+	double bitrate_sum = 0.0;
+	double capacity_sum = 0.0;
+	size_t seg = 0;
+	uint64_t seg_end;
+	size_t audio_size = SIM_AUDIO_BITRATE * 1000 / 8 * SIM_AUDIO_FRAME_US /
+			    1000000;
+
+	assert_non_null(sim);
+	sim->log = log;
+	sim->bitrate = SIM_MAX_BITRATE;
+	bwe_init(&sim->bwe, SIM_MAX_BITRATE, SIM_AUDIO_BITRATE, 0);
+
+	seg_end = trace[0].duration_ms;
+
+	for (uint64_t ms = 0;; ms++) {
+		int64_t now_us = (int64_t)ms * 1000;
+		uint64_t now = ms * MS_TO_NS;
+		double kbps, bytes_per_ms, bdp, cwnd, inflight, queue;
+		int64_t queue_ms;
+
+		while (ms >= seg_end && ++seg < segments)
+			seg_end += trace[seg].duration_ms;
+		if (seg >= segments)
+			break;
+
+		kbps = (double)trace[seg].kbps;
+		bytes_per_ms = kbps / 8.0;
+		bdp = bytes_per_ms * SIM_BASE_RTT_MS;
+		cwnd = bdp + bytes_per_ms * SIM_BOTTLENECK_BUFFER_MS;
+		if (cwnd < 1460.0 * 4)
+			cwnd = 1460.0 * 4;
+
+		while (next_video_us <= now_us) {
+			sim_encode_video(sim, video_frames++, now_us);
+			next_video_us = (int64_t)(video_frames * 1000000 /
+						  SIM_FPS);
+		}
+		while (next_audio_us <= now_us) {
+			sim_push(sim, audio_size, now_us, false);
+			next_audio_us += SIM_AUDIO_FRAME_US;
+		}
+
+		sim_send(sim, cwnd * 2.0 > SIM_MIN_SNDBUF ? cwnd * 2.0
+							   : SIM_MIN_SNDBUF,
+			 now);
+
+		inflight = sim->sock_bytes < cwnd ? sim->sock_bytes : cwnd;
+		queue = inflight > bdp ? inflight - bdp : 0.0;
+
+		if (ms % 100 == 0) {
+			struct bwe_tcp_info info;
+			double rtt_ms = SIM_BASE_RTT_MS;
+
+			if (bytes_per_ms > 0.0)
+				rtt_ms += queue / bytes_per_ms;
+
+			info.rtt_us = (uint32_t)(rtt_ms * 1000.0);
+			info.cwnd_bytes = (uint32_t)cwnd;
+			info.inflight_bytes = (uint32_t)inflight;
+			bwe_add_tcp_info(&sim->bwe, &info, now);
+		}
+
+		sim->sock_bytes -= sim->sock_bytes < bytes_per_ms
+					   ? sim->sock_bytes
+					   : bytes_per_ms;
+
+		queue_ms = 0;
+		if (sim->count)
+			queue_ms = (now_us - sim->frames[sim->head].ts_us) /
+				   1000;
+		if (queue_ms > sim->result.max_queue_ms)
+			sim->result.max_queue_ms = queue_ms;
+
+		bitrate_sum += (double)(sim->bitrate + SIM_AUDIO_BITRATE);
+		capacity_sum += kbps;
+		total_ms++;
+
+		if (sim->log && ms % 1000 == 0)
+			fprintf(sim->log, "%llu,%.0f,%ld,%.0f,%lld\n",
+				(unsigned long long)(ms / 1000), kbps,
+				sim->bitrate, sim->bwe.estimate,
+				(long long)queue_ms);
+	}
+
+	sim->result.avg_bitrate = bitrate_sum / (double)total_ms;
+	sim->result.avg_capacity = capacity_sum / (double)total_ms;
+	sim->result.final_bitrate = sim->bitrate;
+	*result = sim->result;
+	free(sim);
+}
+
+#define run_trace(trace, result) \
+	sim_run(trace, sizeof(trace) / sizeof(trace[0]), result, NULL)
+
+static void steady_link_test(void **state)
+{
+	const struct trace_segment trace[] = {{120000, 8000}};
+	struct sim_result result;
+
+	run_trace(trace, &result);
+
+	assert_int_equal(result.changes, 0);
+	assert_int_equal(result.final_bitrate, SIM_MAX_BITRATE);
+	assert_true(result.max_queue_ms < 200);
+}
+
+static void capacity_drop_test(void **state)
+{
+	const struct trace_segment trace[] = {{20000, 8000}, {100000, 2500}};
+	struct sim_result result;
+
+	run_trace(trace, &result);
+
+	/* settles below the new capacity without letting the queue grow to
+	 * where frames would be dropped */
+	assert_true(result.final_bitrate + SIM_AUDIO_BITRATE <= 2500);
+	assert_true(result.final_bitrate + SIM_AUDIO_BITRATE >= 2500 / 2);
+	assert_true(result.max_queue_ms < 1000);
+	assert_true(result.reversals <= 10);
+}
+
+static void capacity_recovery_test(void **state)
+{
+	const struct trace_segment trace[] = {
+		{10000, 8000}, {30000, 2000}, {90000, 8000}};
+	struct sim_result result;
+
+	run_trace(trace, &result);
+
+	assert_int_equal(result.final_bitrate, SIM_MAX_BITRATE);
+	assert_true(result.max_queue_ms < 1500);
+}
+
+static void bursty_link_test(void **state)
+{
+	struct trace_segment trace[120];
+	struct sim_result result;
+
+	for (size_t i = 0; i < 120; i++) {
+		trace[i].duration_ms = 1000;
+		trace[i].kbps = (i & 1) ? 1500 : 5000;
+	}
+
+	run_trace(trace, &result);
+
+	/* follows the lower capacity instead of chasing every burst */
+	assert_true(result.reversals <= 10);
+	assert_true(result.max_queue_ms < 1500);
+}
+
+static int replay_trace_file(const char *path)
+{
+	struct trace_segment *trace = NULL;
+	size_t count = 0;
+	unsigned int duration, kbps;
+	struct sim_result result;
+	FILE *f = fopen(path, "r");
+
+	if (!f) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return 1;
+	}
+
+	while (fscanf(f, "%u %u", &duration, &kbps) == 2) {
+		trace = realloc(trace, sizeof(*trace) * (count + 1));
+		trace[count].duration_ms = duration;
+		trace[count].kbps = kbps;
+		count++;
+	}
+	fclose(f);
+
+	if (!count) {
+		fprintf(stderr, "No segments in %s\n", path);
+		free(trace);
+		return 1;
+	}
+
+	printf("sec,capacity,bitrate,estimate,queue_ms\n");
+	sim_run(trace, count, &result, stdout);
+	printf("# avg bitrate %.0f, avg capacity %.0f, max queue %lldms, "
+	       "%d changes, %d reversals\n",
+	       result.avg_bitrate, result.avg_capacity,
+	       (long long)result.max_queue_ms, result.changes,
+	       result.reversals);
+
+	free(trace);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(steady_link_test),
+		cmocka_unit_test(capacity_drop_test),
+		cmocka_unit_test(capacity_recovery_test),
+		cmocka_unit_test(bursty_link_test),
+	};
+
+	if (argc > 1)
+		return replay_trace_file(argv[1]);
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,153 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <obs-internal.h>
+
+/*
+ * Checks which encoders get textures of the main mix.  This pokes at libobs
+ * internals, so it runs without graphics: the video outputs that stand in
+ * for the main mix and for a canvas are plain media-io outputs.
+ */
+
+static const char *texture_encoder_name(void *type)
+{
+	UNUSED_PARAMETER(type);
+	return "texture encoder";
+}
+
+static void *texture_encoder_create(obs_data_t *settings,
+				    obs_encoder_t *encoder)
+{
+	UNUSED_PARAMETER(settings);
+	return encoder;
+}
+
+static void texture_encoder_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool texture_encoder_encode(void *data, struct encoder_frame *frame,
+				   struct encoder_packet *packet,
+				   bool *received_packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(frame);
+	UNUSED_PARAMETER(packet);
+	*received_packet = false;
+	return true;
+}
+
+static bool texture_encoder_encode_texture(void *data, uint32_t handle,
+					   int64_t pts, uint64_t lock_key,
+					   uint64_t *next_key,
+					   struct encoder_packet *packet,
+					   bool *received_packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(handle);
+	UNUSED_PARAMETER(pts);
+	UNUSED_PARAMETER(lock_key);
+	UNUSED_PARAMETER(next_key);
+	UNUSED_PARAMETER(packet);
+	*received_packet = false;
+	return true;
+}
+
+static struct obs_encoder_info texture_encoder_info = {
+	.id = "test_texture_encoder",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "h264",
+	.caps = OBS_ENCODER_CAP_PASS_TEXTURE,
+	.get_name = texture_encoder_name,
+	.create = texture_encoder_create,
+	.destroy = texture_encoder_destroy,
+	.encode = texture_encoder_encode,
+	.encode_texture = texture_encoder_encode_texture,
+};
+
+static video_t *open_video(const char *name)
+{
+	struct video_output_info vi = {
+		.name = name,
+		.format = VIDEO_FORMAT_NV12,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = 64,
+		.height = 64,
+		.cache_size = 2,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	video_t *video = NULL;
+
+	assert_int_equal(video_output_open(&video, &vi), VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+static void canvas_texture_encoder_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	video_t *main_video = open_video("main");
+	video_t *canvas_video = open_video("canvas");
+	obs_encoder_t *encoder;
+
+	obs->video.video = main_video;
+	obs->video.using_nv12_tex = true;
+
+	encoder = obs_video_encoder_create("test_texture_encoder", "encoder",
+					   NULL, NULL);
+	assert_non_null(encoder);
+
+	obs_encoder_set_video(encoder, main_video);
+	assert_true(gpu_encode_available(encoder));
+
+	/* a canvas has its own picture, the encoder needs its raw frames */
+	obs_encoder_set_video(encoder, canvas_video);
+	assert_false(gpu_encode_available(encoder));
+
+	/* frame rate divisors give the encoder a child of the mix */
+	obs_encoder_set_frame_rate_divisor(encoder, 2);
+	obs_encoder_set_video(encoder, canvas_video);
+	assert_false(gpu_encode_available(encoder));
+	obs_encoder_set_video(encoder, main_video);
+	assert_true(gpu_encode_available(encoder));
+
+	obs->video.using_nv12_tex = false;
+	assert_false(gpu_encode_available(encoder));
+
+	obs_encoder_release(encoder);
+
+	obs->video.video = NULL;
+	video_output_close(canvas_video);
+	video_output_close(main_video);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_encoder(&texture_encoder_info);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canvas_texture_encoder_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
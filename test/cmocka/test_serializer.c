@@ -1,9 +1,13 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
+#include <string.h>
 #include <cmocka.h>
 
 #include <util/array-serializer.h>
+#include <util/buffered-file-serializer.h>
+#include <util/file-serializer.h>
+#include <util/platform.h>
 
 static void serialize_test(void **state)
 {
@@ -22,10 +26,90 @@ static void serialize_test(void **state)
 	assert_memory_equal(output.bytes.array, expected, 3);
 }
 
+static void buffered_file_serialize_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	const char *path = "test_buffered_file.bin";
+	struct buffered_file_serializer_options opts = {
+		.buffer_size = 8192,
+		.chunk_size = 4096,
+	};
+	uint8_t expected[20000];
+	uint8_t data[20000];
+	struct serializer s;
+
+	for (size_t i = 0; i < sizeof(expected); i++)
+		expected[i] = (uint8_t)(i * 7);
+
+	assert_true(buffered_file_serializer_init(&s, path, &opts));
+
+	/* small writes spanning many chunks, more than fits in the buffer */
+	for (size_t i = 0; i < sizeof(expected); i += 100)
+		assert_int_equal(s_write(&s, expected + i, 100), 100);
+	assert_int_equal(serializer_get_pos(&s), sizeof(expected));
+
+	/* rewrite a header, then continue at the end */
+	memset(expected + 10, 0xaa, 4);
+	assert_int_equal(serializer_seek(&s, 10, SERIALIZE_SEEK_START), 10);
+	s_wb32(&s, 0xaaaaaaaa);
+	assert_int_equal(serializer_seek(&s, 0, SERIALIZE_SEEK_END),
+			 sizeof(expected));
+
+	assert_true(buffered_file_serializer_free(&s));
+
+	assert_true(file_input_serializer_init(&s, path));
+	assert_int_equal(s_read(&s, data, sizeof(data)), sizeof(data));
+	assert_memory_equal(data, expected, sizeof(expected));
+	file_input_serializer_free(&s);
+
+	os_unlink(path);
+}
+
+static void buffered_file_direct_io_seek_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	const char *path = "test_buffered_file_direct.bin";
+	struct buffered_file_serializer_options opts = {
+		.buffer_size = 8192,
+		.chunk_size = 4096,
+		.direct_io = true,
+	};
+	uint8_t expected[4096 * 3 + 100];
+	uint8_t data[sizeof(expected)];
+	struct serializer s;
+
+	for (size_t i = 0; i < sizeof(expected); i++)
+		expected[i] = (uint8_t)(i * 13);
+
+	assert_true(buffered_file_serializer_init(&s, path, &opts));
+
+	/* end on a chunk boundary so nothing is left buffered when seeking */
+	assert_int_equal(s_write(&s, expected, 4096 * 3), 4096 * 3);
+
+	/* rewrite a whole chunk at an unaligned offset */
+	memset(expected + 10, 0x55, 4096);
+	assert_int_equal(serializer_seek(&s, 10, SERIALIZE_SEEK_START), 10);
+	assert_int_equal(s_write(&s, expected + 10, 4096), 4096);
+
+	assert_int_equal(serializer_seek(&s, 0, SERIALIZE_SEEK_END), 4096 * 3);
+	assert_int_equal(s_write(&s, expected + 4096 * 3, 100), 100);
+
+	assert_true(buffered_file_serializer_free(&s));
+
+	assert_true(file_input_serializer_init(&s, path));
+	assert_int_equal(s_read(&s, data, sizeof(data)), sizeof(data));
+	assert_memory_equal(data, expected, sizeof(expected));
+	file_input_serializer_free(&s);
+
+	os_unlink(path);
+}
+
 int main()
 {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(serialize_test),
+		cmocka_unit_test(buffered_file_serialize_test),
+		cmocka_unit_test(buffered_file_direct_io_seek_test),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "udp-transport.h"
+
+#define TEST_DATA_SIZE (4 * 1024 * 1024)
+
+static void fill_test_data(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)((i * 7) % 251);
+}
+
+static size_t read_all(struct udp_receiver *r, uint8_t *data, size_t size,
+		       uint32_t timeout_ms)
+{
+	uint64_t end = os_gettime_ns() + (uint64_t)timeout_ms * 1000000ULL;
+	size_t total = 0;
+
+	while (total < size && os_gettime_ns() < end)
+		total += udp_receiver_read(r, data + total, size - total, 50);
+
+	return total;
+}
+
+/* sends the test data over loopback in frame sized pieces, and checks that
+ * it arrives complete and in order */
+static void send_and_check(const struct udp_transport_options *sender_opts,
+			   const struct udp_transport_options *receiver_opts,
+			   struct udp_sender_stats *sender_stats,
+			   struct udp_receiver_stats *receiver_stats)
+{
+	uint8_t *expected = bmalloc(TEST_DATA_SIZE);
+	uint8_t *data = bzalloc(TEST_DATA_SIZE);
+	struct udp_receiver *r;
+	struct udp_sender *s;
+	size_t frame_size = 20000;
+
+	fill_test_data(expected, TEST_DATA_SIZE);
+
+	r = udp_receiver_create(0, receiver_opts);
+	assert_non_null(r);
+	assert_true(udp_receiver_get_port(r) > 0);
+
+	s = udp_sender_create("127.0.0.1", udp_receiver_get_port(r),
+			      sender_opts);
+	assert_non_null(s);
+
+	for (size_t pos = 0; pos < TEST_DATA_SIZE; pos += frame_size) {
+		size_t size = TEST_DATA_SIZE - pos;
+		if (size > frame_size)
+			size = frame_size;
+
+		while (!udp_sender_send(s, expected + pos, size))
+			os_sleep_ms(1);
+	}
+
+	assert_true(udp_sender_flush(s, 10000));
+	assert_int_equal(read_all(r, data, TEST_DATA_SIZE, 10000),
+			 TEST_DATA_SIZE);
+	assert_memory_equal(data, expected, TEST_DATA_SIZE);
+
+	/* let the last ACKs arrive */
+	os_sleep_ms(50);
+
+	udp_sender_get_stats(s, sender_stats);
+	udp_receiver_get_stats(r, receiver_stats);
+
+	udp_sender_destroy(s);
+	udp_receiver_destroy(r);
+	bfree(expected);
+	bfree(data);
+}
+
+static void loopback_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	struct udp_transport_options opts = {
+		.max_bitrate = 50 * 1000 * 1000,
+	};
+	struct udp_sender_stats sender_stats;
+	struct udp_receiver_stats receiver_stats;
+
+	send_and_check(&opts, NULL, &sender_stats, &receiver_stats);
+
+	assert_true(sender_stats.got_ack);
+	assert_false(sender_stats.error);
+	assert_int_equal(sender_stats.queued_bytes, 0);
+	assert_int_equal(receiver_stats.lost, 0);
+	assert_int_equal(receiver_stats.packets_received,
+			 sender_stats.packets_sent);
+}
+
+static void loss_recovery_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	struct udp_transport_options sender_opts = {
+		.latency_ms = 1000,
+		.max_bitrate = 50 * 1000 * 1000,
+		.loss_rate = 0.05f,
+	};
+	struct udp_transport_options receiver_opts = {
+		.latency_ms = 1000,
+		.loss_rate = 0.1f,
+	};
+	struct udp_sender_stats sender_stats;
+	struct udp_receiver_stats receiver_stats;
+
+	send_and_check(&sender_opts, &receiver_opts, &sender_stats,
+		       &receiver_stats);
+
+	assert_true(sender_stats.nacks > 0);
+	assert_true(sender_stats.retransmits > 0);
+	assert_true(sender_stats.loss > 0.0f);
+	assert_true(receiver_stats.dropped > 0);
+	assert_true(receiver_stats.recovered > 0);
+	assert_int_equal(receiver_stats.lost, 0);
+}
+
+static void no_arq_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	struct udp_transport_options opts = {
+		.disable_arq = true,
+		.max_bitrate = 50 * 1000 * 1000,
+	};
+	struct udp_sender_stats sender_stats;
+	struct udp_receiver_stats receiver_stats;
+
+	send_and_check(&opts, &opts, &sender_stats, &receiver_stats);
+
+	assert_false(sender_stats.got_ack);
+	assert_int_equal(sender_stats.retransmits, 0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(loopback_test),
+		cmocka_unit_test(loss_recovery_test),
+		cmocka_unit_test(no_arq_test),
+	};
+	int ret;
+
+#ifdef _WIN32
+	WSADATA wsad;
+	WSAStartup(MAKEWORD(2, 2), &wsad);
+#endif
+
+	ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return ret;
+}